@@ -0,0 +1,161 @@
+/**
+ * @file HTTPResponseParser.cpp
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Implements the HTTPResponseParser class.
+ */
+
+#include "HTTPResponseParser.h"
+
+// Constructor
+HTTPResponseParser::HTTPResponseParser() {
+    reset();
+}
+// Destructor
+HTTPResponseParser::~HTTPResponseParser() {}
+
+
+void HTTPResponseParser::reset(void) {
+    _state         = HTTP_PARSER_STATUS_LINE;
+    _statusCode    = 0;
+    _contentLength = -1;
+    _chunked       = false;
+    _retryAfter_s  = 0;
+    _bodyLength    = 0;
+    _remaining     = 0;
+    _lineLength    = 0;
+    _line[0]       = '\0';
+}
+
+
+bool HTTPResponseParser::parse(Stream* stream) {
+    while (!isComplete() && stream->available() > 0) {
+        parse(static_cast<char>(stream->read()));
+    }
+    return isComplete();
+}
+
+
+bool HTTPResponseParser::parse(char c) {
+    switch (_state) {
+        case HTTP_PARSER_DONE: return true;
+        case HTTP_PARSER_BODY:
+            _bodyLength++;
+            if (--_remaining == 0) _state = HTTP_PARSER_DONE;
+            break;
+        case HTTP_PARSER_CHUNK_DATA:
+            _bodyLength++;
+            if (--_remaining == 0) _state = HTTP_PARSER_CHUNK_END;
+            break;
+        default:
+            // Everything else is read a line at a time
+            if (c == '\n') {
+                if (_lineLength > 0 && _line[_lineLength - 1] == '\r') {
+                    _lineLength--;
+                }
+                _line[_lineLength] = '\0';
+                parseLine();
+                _lineLength = 0;
+            } else if (_lineLength < MS_HTTP_LINE_BUFFER_SIZE - 1) {
+                _line[_lineLength++] = c;
+            }
+            break;
+    }
+    return isComplete();
+}
+
+
+bool HTTPResponseParser::isComplete(void) {
+    return _state == HTTP_PARSER_DONE;
+}
+int16_t HTTPResponseParser::getStatusCode(void) {
+    return _statusCode;
+}
+int32_t HTTPResponseParser::getContentLength(void) {
+    return _contentLength;
+}
+bool HTTPResponseParser::isChunked(void) {
+    return _chunked;
+}
+uint32_t HTTPResponseParser::getRetryAfter(void) {
+    return _retryAfter_s;
+}
+uint32_t HTTPResponseParser::getBodyLength(void) {
+    return _bodyLength;
+}
+
+
+void HTTPResponseParser::parseLine(void) {
+    const char* value;
+    switch (_state) {
+        case HTTP_PARSER_STATUS_LINE:
+            // ie, "HTTP/1.1 201 Created"; anything else is skipped
+            if (strncmp(_line, "HTTP/", 5) == 0) {
+                const char* code = strchr(_line, ' ');
+                if (code != NULL) _statusCode = atoi(code + 1);
+                MS_DBG(F("Status:"), _statusCode);
+                _state = HTTP_PARSER_HEADERS;
+            }
+            break;
+        case HTTP_PARSER_HEADERS:
+            if (_lineLength == 0) {
+                endHeaders();
+            } else if ((value = headerValue("Content-Length")) != NULL) {
+                _contentLength = atol(value);
+            } else if ((value = headerValue("Transfer-Encoding")) != NULL) {
+                // Chunked is always the last encoding listed
+                size_t length = strlen(value);
+                _chunked      = length >= 7 &&
+                    strcasecmp(value + length - 7, "chunked") == 0;
+            } else if ((value = headerValue("Retry-After")) != NULL) {
+                // Only the number of seconds, not a date
+                if (isdigit(value[0])) _retryAfter_s = atol(value);
+            }
+            break;
+        case HTTP_PARSER_CHUNK_SIZE:
+            // The size is in hex, maybe followed by extensions after a ';'
+            _remaining = strtoul(_line, NULL, 16);
+            MS_DBG(F("Chunk of"), _remaining, F("bytes"));
+            _state = _remaining > 0 ? HTTP_PARSER_CHUNK_DATA
+                                    : HTTP_PARSER_TRAILERS;
+            break;
+        case HTTP_PARSER_CHUNK_END: _state = HTTP_PARSER_CHUNK_SIZE; break;
+        case HTTP_PARSER_TRAILERS:
+            if (_lineLength == 0) _state = HTTP_PARSER_DONE;
+            break;
+        default: break;
+    }
+}
+
+
+void HTTPResponseParser::endHeaders(void) {
+    if (_statusCode >= 100 && _statusCode < 200) {
+        // An informational response (ie, 100 Continue); the real one follows
+        MS_DBG(F("Skipping informational response"), _statusCode);
+        reset();
+    } else if (_statusCode == 204 || _statusCode == 304) {
+        // Never has a body, whatever the headers say
+        _state = HTTP_PARSER_DONE;
+    } else if (_chunked) {
+        _state = HTTP_PARSER_CHUNK_SIZE;
+    } else if (_contentLength > 0) {
+        _remaining = _contentLength;
+        _state     = HTTP_PARSER_BODY;
+    } else {
+        // No body, or one that runs until the connection closes
+        _state = HTTP_PARSER_DONE;
+    }
+}
+
+
+const char* HTTPResponseParser::headerValue(const char* name) {
+    size_t length = strlen(name);
+    if (strncasecmp(_line, name, length) != 0 || _line[length] != ':') {
+        return NULL;
+    }
+    const char* value = _line + length + 1;
+    while (*value == ' ' || *value == '\t') value++;
+    return value;
+}
@@ -0,0 +1,189 @@
+/**
+ * @file HTTPResponseParser.h
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the HTTPResponseParser class - a small streaming parser for
+ * the responses to the requests sent by the publishers.
+ */
+
+// Header Guards
+#ifndef SRC_HTTPRESPONSEPARSER_H_
+#define SRC_HTTPRESPONSEPARSER_H_
+
+// Debugging Statement
+// #define MS_HTTPRESPONSEPARSER_DEBUG
+
+#ifdef MS_HTTPRESPONSEPARSER_DEBUG
+#define MS_DEBUGGING_STD "HTTPResponseParser"
+#endif
+
+/**
+ * @def MS_HTTP_LINE_BUFFER_SIZE
+ * @brief The number of characters of each line of the status and headers
+ * kept for parsing.
+ *
+ * Anything past this in a line is skipped.  It only needs to be long enough
+ * for the header names and values that are used.
+ *
+ * This can be changed by setting the build flag MS_HTTP_LINE_BUFFER_SIZE when
+ * compiling.
+ *
+ * @ingroup the_publishers
+ */
+#ifndef MS_HTTP_LINE_BUFFER_SIZE
+#define MS_HTTP_LINE_BUFFER_SIZE 48
+#endif
+
+// Included Dependencies
+#include "ModSensorDebugger.h"
+#undef MS_DEBUGGING_STD
+#include <Stream.h>
+
+/**
+ * @brief The parts of an HTTP response the parser can be in the middle of.
+ *
+ * @ingroup the_publishers
+ */
+typedef enum httpParserState {
+    HTTP_PARSER_STATUS_LINE = 0,  ///< Waiting for the status line
+    HTTP_PARSER_HEADERS,          ///< Reading the headers
+    HTTP_PARSER_BODY,             ///< Reading a body of known length
+    HTTP_PARSER_CHUNK_SIZE,       ///< Reading the size line of a chunk
+    HTTP_PARSER_CHUNK_DATA,       ///< Reading the data of a chunk
+    HTTP_PARSER_CHUNK_END,        ///< Reading the line end after a chunk
+    HTTP_PARSER_TRAILERS,         ///< Reading the trailers after the last chunk
+    HTTP_PARSER_DONE              ///< The whole response has been read
+} httpParserState;
+
+/**
+ * @brief The HTTPResponseParser class reads an HTTP/1.x response a character
+ * at a time, as it arrives, without ever waiting for more.
+ *
+ * It picks out the status code and the `Content-Length`,
+ * `Transfer-Encoding: chunked` and `Retry-After` headers and reads through the
+ * body so the end of the response is known.  The body itself is thrown away.
+ * Any informational (1xx) responses before the final one are skipped.
+ *
+ * A response with neither a content length nor chunked encoding has a body
+ * that runs until the server closes the connection.  None of the publishers
+ * need that body, so the response is treated as complete at the end of its
+ * headers.
+ *
+ * Only a `Retry-After` given in seconds is understood; one given as a date is
+ * ignored.
+ *
+ * @ingroup the_publishers
+ */
+class HTTPResponseParser {
+ public:
+    /**
+     * @brief Construct a new HTTP Response Parser object, ready for a
+     * response.
+     */
+    HTTPResponseParser();
+    /**
+     * @brief Destroy the HTTP Response Parser object - no action taken.
+     */
+    virtual ~HTTPResponseParser();
+
+    /**
+     * @brief Forget everything about the last response and get ready for a
+     * new one.
+     */
+    void reset(void);
+
+    /**
+     * @brief Parse every character already waiting in a stream.
+     *
+     * This never waits for more characters to arrive.  Nothing past the end of
+     * the response is read.
+     *
+     * @param stream The stream (ie, client) the response is arriving on
+     * @return **bool** True once the whole response has been read
+     */
+    bool parse(Stream* stream);
+    /**
+     * @brief Parse one character of the response.
+     *
+     * @param c The next character of the response
+     * @return **bool** True once the whole response has been read
+     */
+    bool parse(char c);
+
+    /**
+     * @brief Check if the whole response has been read.
+     *
+     * @return **bool** True if the response is complete
+     */
+    bool isComplete(void);
+    /**
+     * @brief Get the status code of the response.
+     *
+     * @return **int16_t** The status code, or 0 if no status line has been
+     * read yet.
+     */
+    int16_t getStatusCode(void);
+    /**
+     * @brief Get the content length given in the headers.
+     *
+     * @return **int32_t** The content length, or -1 if none was given.
+     */
+    int32_t getContentLength(void);
+    /**
+     * @brief Check if the body was sent in chunks.
+     *
+     * @return **bool** True if the body is chunked
+     */
+    bool isChunked(void);
+    /**
+     * @brief Get the time the server asked to wait before trying again.
+     *
+     * @return **uint32_t** The Retry-After time in seconds, or 0 if none was
+     * given.
+     */
+    uint32_t getRetryAfter(void);
+    /**
+     * @brief Get the number of body bytes read so far.
+     *
+     * @return **uint32_t** The number of body bytes, not counting the chunk
+     * sizes
+     */
+    uint32_t getBodyLength(void);
+
+ protected:
+    /**
+     * @brief Act on a complete line of the status or headers.
+     *
+     * The line is in #_line, without the line end.
+     */
+    void parseLine(void);
+    /**
+     * @brief Move on after the blank line ending the headers.
+     */
+    void endHeaders(void);
+    /**
+     * @brief Check if the line held starts with a header name, ignoring case.
+     *
+     * @param name The header name, without the colon
+     * @return **const char*** The start of the header value, or NULL if the
+     * line is a different header.
+     */
+    const char* headerValue(const char* name);
+
+ private:
+    httpParserState _state;
+    int16_t         _statusCode;
+    int32_t         _contentLength;
+    bool            _chunked;
+    uint32_t        _retryAfter_s;
+    uint32_t        _bodyLength;
+    // The body or chunk bytes still to come
+    uint32_t _remaining;
+    // The start of the current line
+    char    _line[MS_HTTP_LINE_BUFFER_SIZE];
+    uint8_t _lineLength;
+};
+
+#endif  // SRC_HTTPRESPONSEPARSER_H_
@@ -0,0 +1,133 @@
+/**
+ * @file LogBuffer.cpp
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Implements the LogBuffer class.
+ */
+
+#include "LogBuffer.h"
+
+// Constructor
+LogBuffer::LogBuffer() {
+    _numVariables = 0;
+    _recordSize   = sizeof(uint32_t);
+    _firstRecord  = 0;
+    _nextRecord   = 0;
+}
+// Destructor
+LogBuffer::~LogBuffer() {}
+
+
+void LogBuffer::setNumVariables(uint8_t numVariables) {
+    if (numVariables == _numVariables) return;
+    _numVariables = numVariables;
+    // The timestamp, the values, and then one bit per value for reporting
+    _recordSize = sizeof(uint32_t) + sizeof(float) * numVariables +
+        (numVariables + 7) / 8;
+    // The old records don't fit the new layout
+    clear();
+}
+uint8_t LogBuffer::getNumVariables(void) {
+    return _numVariables;
+}
+
+
+void LogBuffer::clear(void) {
+    MS_DBG(F("Emptying the log buffer"));
+    _firstRecord = _nextRecord;
+}
+
+
+uint16_t LogBuffer::getCapacity(void) {
+    return MS_LOG_BUFFER_SIZE / _recordSize;
+}
+uint16_t LogBuffer::getNumRecords(void) {
+    return _nextRecord - _firstRecord;
+}
+uint32_t LogBuffer::getFirstRecordNumber(void) {
+    return _firstRecord;
+}
+uint32_t LogBuffer::getNextRecordNumber(void) {
+    return _nextRecord;
+}
+bool LogBuffer::isRecordAvailable(uint32_t recordNum) {
+    return recordNum >= _firstRecord && recordNum < _nextRecord;
+}
+
+
+uint32_t LogBuffer::addRecord(uint32_t timestamp) {
+    if (getCapacity() == 0) return _nextRecord;
+    // Drop the oldest record if we're out of room
+    if (getNumRecords() >= getCapacity()) {
+        MS_DBG(F("Log buffer is full, dropping record"), _firstRecord);
+        _firstRecord++;
+    }
+    uint32_t recordNum = _nextRecord++;
+    memcpy(recordPointer(recordNum), &timestamp, sizeof(uint32_t));
+    for (uint8_t i = 0; i < _numVariables; i++) {
+        setRecordValue(recordNum, i, -9999);
+        setRecordValueReported(recordNum, i, true);
+    }
+    MS_DBG(F("Added record"), recordNum, F("to the log buffer;"),
+           getNumRecords(), F("of"), getCapacity(), F("records in use"));
+    return recordNum;
+}
+
+
+void LogBuffer::setRecordValue(uint32_t recordNum, uint8_t varIndex,
+                               float value) {
+    if (!isRecordAvailable(recordNum) || varIndex >= _numVariables) return;
+    memcpy(recordPointer(recordNum) + sizeof(uint32_t) +
+               sizeof(float) * varIndex,
+           &value, sizeof(float));
+}
+
+
+void LogBuffer::setRecordValueReported(uint32_t recordNum, uint8_t varIndex,
+                                       bool reported) {
+    if (!isRecordAvailable(recordNum) || varIndex >= _numVariables) return;
+    uint8_t* flags = recordPointer(recordNum) + sizeof(uint32_t) +
+        sizeof(float) * _numVariables + varIndex / 8;
+    if (reported) {
+        *flags |= 1 << (varIndex % 8);
+    } else {
+        *flags &= ~(1 << (varIndex % 8));
+    }
+}
+
+
+uint32_t LogBuffer::getRecordTimestamp(uint32_t recordNum) {
+    if (!isRecordAvailable(recordNum)) return 0;
+    uint32_t timestamp;
+    memcpy(&timestamp, recordPointer(recordNum), sizeof(uint32_t));
+    return timestamp;
+}
+float LogBuffer::getRecordValue(uint32_t recordNum, uint8_t varIndex) {
+    if (!isRecordAvailable(recordNum) || varIndex >= _numVariables) {
+        return -9999;
+    }
+    float value;
+    memcpy(&value,
+           recordPointer(recordNum) + sizeof(uint32_t) +
+               sizeof(float) * varIndex,
+           sizeof(float));
+    return value;
+}
+
+
+bool LogBuffer::isRecordValueReported(uint32_t recordNum, uint8_t varIndex) {
+    if (!isRecordAvailable(recordNum) || varIndex >= _numVariables) {
+        return true;
+    }
+    uint8_t flags = *(recordPointer(recordNum) + sizeof(uint32_t) +
+                      sizeof(float) * _numVariables + varIndex / 8);
+    return flags & (1 << (varIndex % 8));
+}
+
+
+uint8_t* LogBuffer::recordPointer(uint32_t recordNum) {
+    return _buffer +
+        static_cast<uint16_t>(recordNum % getCapacity()) * _recordSize;
+}
@@ -0,0 +1,212 @@
+/**
+ * @file LogBuffer.h
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the LogBuffer class - an in-memory outbox of logged records
+ * waiting to be published.
+ */
+
+// Header Guards
+#ifndef SRC_LOGBUFFER_H_
+#define SRC_LOGBUFFER_H_
+
+// Debugging Statement
+// #define MS_LOGBUFFER_DEBUG
+
+#ifdef MS_LOGBUFFER_DEBUG
+#define MS_DEBUGGING_STD "LogBuffer"
+#endif
+
+/**
+ * @def MS_LOG_BUFFER_SIZE
+ * @brief Log Buffer Size
+ *
+ * The number of bytes of memory reserved for records waiting to be published.
+ * Each record takes 4 bytes for the timestamp plus 4 bytes for each variable,
+ * plus one more byte for every 8 variables to flag which values are reported.
+ *
+ * This can be changed by setting the build flag MS_LOG_BUFFER_SIZE when
+ * compiling.
+ *
+ * @ingroup base_classes
+ */
+#ifndef MS_LOG_BUFFER_SIZE
+#if defined(ARDUINO_ARCH_SAMD)
+#define MS_LOG_BUFFER_SIZE 4096
+#else
+#define MS_LOG_BUFFER_SIZE 1024
+#endif
+#endif
+
+// Included Dependencies
+#include "ModSensorDebugger.h"
+#undef MS_DEBUGGING_STD
+
+/**
+ * @brief The LogBuffer class holds logged records in memory until every
+ * publisher has had the chance to send them.
+ *
+ * The buffer is a ring.  Every record gets a record number one greater than the
+ * record before it.  Each publisher keeps track of the number of the next
+ * record it needs to send, so a single copy of the data is shared by all of the
+ * publishers attached to a logger.  When the buffer is full, the oldest record
+ * is dropped to make room for the newest.
+ *
+ * Attach a buffer to a logger with Logger::attachLogBuffer(LogBuffer&).
+ *
+ * @ingroup base_classes
+ */
+class LogBuffer {
+ public:
+    /**
+     * @brief Construct a new, empty, LogBuffer object.
+     */
+    LogBuffer();
+    /**
+     * @brief Destroy the LogBuffer object - no action taken.
+     */
+    virtual ~LogBuffer();
+
+    /**
+     * @brief Set the number of variables in each record.
+     *
+     * @note Changing the number of variables empties the buffer.
+     *
+     * @param numVariables The number of variables in each record
+     */
+    void setNumVariables(uint8_t numVariables);
+    /**
+     * @brief Get the number of variables in each record.
+     *
+     * @return **uint8_t** The number of variables in each record
+     */
+    uint8_t getNumVariables(void);
+
+    /**
+     * @brief Drop all records from the buffer.
+     */
+    void clear(void);
+
+    /**
+     * @brief Get the maximum number of records the buffer can hold.
+     *
+     * @return **uint16_t** The number of records that fit in the buffer
+     */
+    uint16_t getCapacity(void);
+    /**
+     * @brief Get the number of records currently held.
+     *
+     * @return **uint16_t** The number of records in the buffer
+     */
+    uint16_t getNumRecords(void);
+    /**
+     * @brief Get the record number of the oldest record still in the buffer.
+     *
+     * @return **uint32_t** The oldest record number
+     */
+    uint32_t getFirstRecordNumber(void);
+    /**
+     * @brief Get the record number that will be given to the next record
+     * added.
+     *
+     * @return **uint32_t** One more than the newest record number
+     */
+    uint32_t getNextRecordNumber(void);
+    /**
+     * @brief Check if a record is still in the buffer.
+     *
+     * @param recordNum The record number to check
+     * @return **bool** True if the record can be read
+     */
+    bool isRecordAvailable(uint32_t recordNum);
+
+    /**
+     * @brief Add a new record to the buffer, dropping the oldest record if the
+     * buffer is full.
+     *
+     * All values of the new record are set to -9999 and flagged as reported
+     * until they are set.
+     *
+     * @param timestamp The timestamp of the record (the logger's local epoch
+     * time)
+     * @return **uint32_t** The record number of the new record
+     */
+    uint32_t addRecord(uint32_t timestamp);
+    /**
+     * @brief Set one value in a record.
+     *
+     * @param recordNum The record number
+     * @param varIndex The position of the variable in the variable array
+     * @param value The value to store
+     */
+    void setRecordValue(uint32_t recordNum, uint8_t varIndex, float value);
+    /**
+     * @brief Get the timestamp of a record.
+     *
+     * @param recordNum The record number
+     * @return **uint32_t** The timestamp of the record or 0 if the record is
+     * not available
+     */
+    uint32_t getRecordTimestamp(uint32_t recordNum);
+    /**
+     * @brief Get one value from a record.
+     *
+     * @param recordNum The record number
+     * @param varIndex The position of the variable in the variable array
+     * @return **float** The value or -9999 if the record is not available
+     */
+    float getRecordValue(uint32_t recordNum, uint8_t varIndex);
+    /**
+     * @brief Flag whether one value in a record needs to be reported.
+     *
+     * @see Variable::setReportByException(float, uint32_t)
+     *
+     * @param recordNum The record number
+     * @param varIndex The position of the variable in the variable array
+     * @param reported True if the value needs to be reported
+     */
+    void setRecordValueReported(uint32_t recordNum, uint8_t varIndex,
+                                bool reported);
+    /**
+     * @brief Check whether one value in a record needs to be reported.
+     *
+     * @param recordNum The record number
+     * @param varIndex The position of the variable in the variable array
+     * @return **bool** True if the value needs to be reported or the record is
+     * not available
+     */
+    bool isRecordValueReported(uint32_t recordNum, uint8_t varIndex);
+
+ protected:
+    /**
+     * @brief Get a pointer to the start of a record within the buffer.
+     *
+     * @param recordNum The record number
+     * @return **uint8_t*** The start of the record
+     */
+    uint8_t* recordPointer(uint32_t recordNum);
+    /**
+     * @brief The number of bytes taken by each record.
+     */
+    uint16_t _recordSize;
+    /**
+     * @brief The number of variables in each record.
+     */
+    uint8_t _numVariables;
+    /**
+     * @brief The number of the oldest record held.
+     */
+    uint32_t _firstRecord;
+    /**
+     * @brief The number to be given to the next record added.
+     */
+    uint32_t _nextRecord;
+    /**
+     * @brief The memory for the records.
+     */
+    uint8_t _buffer[MS_LOG_BUFFER_SIZE];
+};
+
+#endif  // SRC_LOGBUFFER_H_
@@ -67,13 +67,22 @@ Logger::Logger(const char* loggerID, uint16_t loggingIntervalMinutes,
     // Start with no feature UUID
     _samplingFeatureUUID = NULL;
 
-    // Start with no modem attached
-    _logModem = NULL;
-
-    // Clear arrays
-    for (uint8_t i = 0; i < MAX_NUMBER_SENDERS; i++) {
-        dataPublishers[i] = NULL;
-    }
+    // Start with no modem or log buffer attached
+    _logModem  = NULL;
+    _logBuffer = NULL;
+    // Start the modem after measuring
+    _overlapModemStartup = false;
+    // Put the modem to sleep after each interval
+    _alwaysConnected = false;
+    _lastLinkCheck   = 0;
+
+    // Start with no publishers
+    _firstPublisher      = NULL;
+    _publishingBudget_ms = MS_LOGGER_PUBLISH_BUDGET_MS;
+    // Publish whatever the signal
+    _minPublishRSSI           = 0;
+    _minPublishSuccessPercent = 0;
+    _deferredPublishes        = 0;
 
     // MS_DBG(F("Logger object created"));
 }
@@ -102,13 +111,22 @@ Logger::Logger(const char* loggerID, uint16_t loggingIntervalMinutes,
     // Start with no feature UUID
     _samplingFeatureUUID = NULL;
 
-    // Start with no modem attached
-    _logModem = NULL;
-
-    // Clear arrays
-    for (uint8_t i = 0; i < MAX_NUMBER_SENDERS; i++) {
-        dataPublishers[i] = NULL;
-    }
+    // Start with no modem or log buffer attached
+    _logModem  = NULL;
+    _logBuffer = NULL;
+    // Start the modem after measuring
+    _overlapModemStartup = false;
+    // Put the modem to sleep after each interval
+    _alwaysConnected = false;
+    _lastLinkCheck   = 0;
+
+    // Start with no publishers
+    _firstPublisher      = NULL;
+    _publishingBudget_ms = MS_LOGGER_PUBLISH_BUDGET_MS;
+    // Publish whatever the signal
+    _minPublishRSSI           = 0;
+    _minPublishSuccessPercent = 0;
+    _deferredPublishes        = 0;
 
     // MS_DBG(F("Logger object created"));
 }
@@ -131,13 +149,22 @@ Logger::Logger() {
     // Start with no feature UUID
     _samplingFeatureUUID = NULL;
 
-    // Start with no modem attached
-    _logModem = NULL;
-
-    // Clear arrays
-    for (uint8_t i = 0; i < MAX_NUMBER_SENDERS; i++) {
-        dataPublishers[i] = NULL;
-    }
+    // Start with no modem or log buffer attached
+    _logModem  = NULL;
+    _logBuffer = NULL;
+    // Start the modem after measuring
+    _overlapModemStartup = false;
+    // Put the modem to sleep after each interval
+    _alwaysConnected = false;
+    _lastLinkCheck   = 0;
+
+    // Start with no publishers
+    _firstPublisher      = NULL;
+    _publishingBudget_ms = MS_LOGGER_PUBLISH_BUDGET_MS;
+    // Publish whatever the signal
+    _minPublishRSSI           = 0;
+    _minPublishSuccessPercent = 0;
+    _deferredPublishes        = 0;
 
     // MS_DBG(F("Logger object created"));
 }
@@ -304,6 +331,26 @@ String Logger::getVarUUIDAtI(uint8_t position_i) {
 String Logger::getValueStringAtI(uint8_t position_i) {
     return _internalArray->arrayOfVars[position_i]->getValueString();
 }
+String Logger::formatValueStringAtI(uint8_t position_i, float value) {
+    return _internalArray->arrayOfVars[position_i]->formatValueString(value);
+}
+// This returns whether the current value needs to be reported
+bool Logger::isValueReportedAtI(uint8_t position_i) {
+    return _internalArray->arrayOfVars[position_i]->isValueReported();
+}
+// This decides which of the current values need to be reported
+void Logger::markReportedValues(void) {
+    for (uint8_t i = 0; i < getArrayVarCount(); i++) {
+        _internalArray->arrayOfVars[i]->checkValueReported(
+            Logger::markedEpochTime);
+    }
+}
+// This moves the deadbands to the values that were just published
+void Logger::confirmReportedValues(void) {
+    for (uint8_t i = 0; i < getArrayVarCount(); i++) {
+        _internalArray->arrayOfVars[i]->confirmValueReported();
+    }
+}
 
 
 // ===================================================================== //
@@ -318,17 +365,53 @@ void Logger::attachModem(loggerModem& modem) {
 }
 
 
+// Adds a buffer to hold records until they're published
+void Logger::attachLogBuffer(LogBuffer& logBuffer) {
+    _logBuffer = &logBuffer;
+}
+LogBuffer* Logger::getLogBuffer(void) {
+    return _logBuffer;
+}
+
+
+// Sets whether the modem registers on the network while the sensors measure
+void Logger::setOverlapModemStartup(bool overlap) {
+    _overlapModemStartup = overlap;
+}
+void Logger::pollModem(void* logger) {
+    static_cast<Logger*>(logger)->_logModem->poll();
+}
+// Sets whether the modem stays connected between logging intervals
+void Logger::setAlwaysConnected(bool alwaysConnected) {
+    _alwaysConnected = alwaysConnected;
+}
+
+
+// Copies the current values into the log buffer
+void Logger::addRecordToLogBuffer(void) {
+    if (_logBuffer == NULL) return;
+    _logBuffer->setNumVariables(getArrayVarCount());
+    uint32_t recordNum = _logBuffer->addRecord(Logger::markedEpochTime);
+    for (uint8_t i = 0; i < getArrayVarCount(); i++) {
+        _logBuffer->setRecordValue(
+            recordNum, i, _internalArray->arrayOfVars[i]->getValue());
+        _logBuffer->setRecordValueReported(
+            recordNum, i, _internalArray->arrayOfVars[i]->isValueReported());
+    }
+}
+
+
 // Takes advantage of the modem to synchronize the clock
 bool Logger::syncRTC() {
     bool success = false;
     if (_logModem != NULL) {
-        // Synchronize the RTC with NIST
+        // Synchronize the RTC with a time server
         PRINTOUT(F("Attempting to connect to the internet and synchronize RTC "
-                   "with NIST"));
+                   "with a time server"));
         PRINTOUT(F("This may take up to two minutes!"));
         if (_logModem->modemWake()) {
             if (_logModem->connectInternet(120000L)) {
-                setRTClock(_logModem->getNISTTime());
+                setRTClock(_logModem->getNetworkTime());
                 success = true;
                 _logModem->updateModemMetadata();
             } else {
@@ -352,39 +435,219 @@ bool Logger::syncRTC() {
 
 
 void Logger::registerDataPublisher(dataPublisher* publisher) {
-    // find the next empty spot in the publisher array
-    uint8_t i = 0;
-    for (; i < MAX_NUMBER_SENDERS; i++) {
-        if (dataPublishers[i] == publisher) {
-            MS_DBG(F("dataPublisher already registered."));
-            return;
+    // Take the publisher out of the list if it's already in it
+    dataPublisher** link = &_firstPublisher;
+    while (*link != NULL) {
+        if (*link == publisher) {
+            MS_DBG(F("dataPublisher already registered; re-ordering."));
+            *link = publisher->_nextPublisher;
+            break;
         }
-        if (dataPublishers[i] == NULL) break;
+        link = &(*link)->_nextPublisher;
     }
 
-    // register the publisher there
-    dataPublishers[i] = publisher;
+    // Put it in after everything with the same or a higher priority
+    link = &_firstPublisher;
+    while (*link != NULL &&
+           (*link)->getPriority() <= publisher->getPriority()) {
+        link = &(*link)->_nextPublisher;
+    }
+    publisher->_nextPublisher = *link;
+    *link                     = publisher;
+}
+dataPublisher* Logger::getFirstPublisher(void) {
+    return _firstPublisher;
+}
+void Logger::setPublishingBudget(uint32_t budget_ms) {
+    _publishingBudget_ms = budget_ms;
+}
+void Logger::setPublishSignalGate(int16_t minRSSI, uint8_t minSuccessPercent) {
+    _minPublishRSSI           = minRSSI;
+    _minPublishSuccessPercent = minSuccessPercent;
 }
 
 
-void Logger::publishDataToRemotes(void) {
+bool Logger::publishDataToRemotes(void) {
     MS_DBG(F("Sending out remote data."));
 
-    for (uint8_t i = 0; i < MAX_NUMBER_SENDERS; i++) {
-        if (dataPublishers[i] != NULL) {
-            PRINTOUT(F("\nSending data to ["), i, F("]"),
-                     dataPublishers[i]->getEndpoint());
-            // dataPublishers[i]->publishData(_logModem->getClient());
-            dataPublishers[i]->publishData();
-            watchDogTimer.resetWatchDog();
+    bool     allSent     = true;
+    bool     allReported = true;
+    uint32_t cycleStart  = millis();
+    uint8_t  numPending  = 0;
+    for (dataPublisher* p = _firstPublisher; p != NULL; p = p->_nextPublisher) {
+        p->_publishPending = true;
+        numPending++;
+    }
+
+    // Start each publisher as soon as its client is free and then keep
+    // checking on all of them until every one has finished
+    while (numPending > 0) {
+        bool outOfTime = _publishingBudget_ms > 0 &&
+            millis() - cycleStart >= _publishingBudget_ms;
+        bool           progressed = false;
+        bool           receiving  = false;
+        dataPublisher* p          = _firstPublisher;
+        for (; p != NULL; p = p->_nextPublisher) {
+            if (!p->_publishPending) continue;
+            publisherState startState = p->getPublishState();
+            // Once the time is up, the cycle's budget only stops publishers
+            // that will find the record in the LogBuffer next cycle; the
+            // others would lose it, so they carry on
+            bool stopForCycle = outOfTime && _logBuffer != NULL &&
+                p->usesLogBuffer();
+            if (startState == PUBLISHER_IDLE) {
+                if (stopForCycle) {
+                    PRINTOUT(F("\nNo time left to send data to"),
+                             p->getEndpoint());
+                    p->_publishPending = false;
+                    numPending--;
+                    continue;
+                }
+
+                // Don't start if another publisher is still using the client
+                if (isPublisherClientBusy(p)) continue;
+
+                PRINTOUT(F("\nSending data to"), p->getEndpoint());
+                p->_budgetStart = millis();
+                p->publishDataBegin();
+                watchDogTimer.resetWatchDog();
+            } else if (stopForCycle || p->isOverTimeBudget()) {
+                PRINTOUT(F("Out of time for sending data to"),
+                         p->getEndpoint());
+                p->publishDataAbort();
+            }
+            if (p->publishDataPoll()) {
+                int16_t result = p->publishDataFinish();
+                // Go by each publisher's own result, not its byte counts
+                if (!p->isPublishSuccess(result)) allSent = false;
+                // A publisher sending from the LogBuffer keeps the reported
+                // values with the record, so only the others need to succeed
+                if ((_logBuffer == NULL || !p->usesLogBuffer()) &&
+                    !p->isPublishSuccess(result)) {
+                    allReported = false;
+                }
+                p->_publishPending = false;
+                numPending--;
+                progressed = true;
+                watchDogTimer.resetWatchDog();
+            } else if (p->getPublishState() != startState) {
+                progressed = true;
+            }
+            if (p->getPublishState() == PUBLISHER_AWAITING_RESPONSE) {
+                receiving = true;
+            }
+        }
+        // Don't pester the modem if nothing moved on.  A response that's
+        // coming in must be read before the serial buffer fills, so only
+        // pause briefly then.
+        if (numPending > 0 && !progressed) {
+            delay(receiving ? 10 : MS_MODEM_POLL_INTERVAL_MS);
+        }
+    }
+    // Keep comparing against the last values that actually went out
+    if (allReported) confirmReportedValues();
+    return allSent;
+}
+bool Logger::isPublisherClientBusy(dataPublisher* publisher) {
+    for (dataPublisher* p = _firstPublisher; p != NULL; p = p->_nextPublisher) {
+        if (p != publisher && p->getPublishState() != PUBLISHER_IDLE &&
+            p->getClient() == publisher->getClient()) {
+            return true;
         }
     }
+    return false;
 }
 void Logger::sendDataToRemotes(void) {
     publishDataToRemotes();
 }
 
 
+bool Logger::connectToPublish(int16_t& rssi, bool& deferred) {
+    rssi     = 0;
+    deferred = false;
+    if (_minPublishRSSI == 0 && _minPublishSuccessPercent == 0) {
+        return _logModem->connectInternet();
+    }
+
+    // Wait only for registration, and check the signal before going on to
+    // the data connection
+    _logModem->connectInternetBegin();
+    while (!_logModem->poll() &&
+           _logModem->getModemState() < MODEM_ATTACHED) {
+        _logModem->waitForPoll();
+    }
+    if (_logModem->getModemState() == MODEM_FAILED) return false;
+
+    int16_t percent;
+    _logModem->getModemSignalQuality(rssi, percent);
+    deferred = shouldDeferPublish(rssi);
+    if (deferred) {
+        _deferredPublishes++;
+        return false;
+    }
+    _deferredPublishes = 0;
+
+    while (!_logModem->poll()) { _logModem->waitForPoll(); }
+    return _logModem->getModemState() == MODEM_CONNECTED;
+}
+bool Logger::shouldDeferPublish(int16_t rssi) {
+    // Without an outbox, the data would be lost
+    if (_logBuffer == NULL) return false;
+    // So it would for any publisher that only sends the current values
+    uint32_t nextRecord   = _logBuffer->getNextRecordNumber();
+    uint32_t oldestUnsent = nextRecord;
+    for (dataPublisher* p = _firstPublisher; p != NULL; p = p->_nextPublisher) {
+        if (!p->usesLogBuffer()) return false;
+        uint32_t firstUnsent = p->getFirstUnsentRecord();
+        if (firstUnsent < oldestUnsent) oldestUnsent = firstUnsent;
+    }
+    // And for the oldest record still waiting, once the next one would
+    // overwrite it; sent records are only ever overwritten, never freed
+    if (nextRecord - oldestUnsent >= _logBuffer->getCapacity()) return false;
+    if (_deferredPublishes >= MS_LOGGER_MAX_DEFERRED_PUBLISHES) {
+        MS_DBG(F("Trying to publish after"), _deferredPublishes,
+               F("deferrals"));
+        return false;
+    }
+    if (_minPublishRSSI != 0 && (rssi == 0 || rssi < _minPublishRSSI)) {
+        MS_DBG(F("RSSI of"), rssi, F("is under the minimum of"),
+               _minPublishRSSI);
+        return true;
+    }
+    int8_t successPercent = loggerModem::getSignalSuccessPercent(rssi);
+    if (successPercent >= 0 && successPercent < _minPublishSuccessPercent) {
+        MS_DBG(F("Only"), successPercent, F("percent of recent attempts at"),
+               rssi, F("dBm worked"));
+        return true;
+    }
+    return false;
+}
+void Logger::checkModemLink(void) {
+    uint32_t now = getNowEpoch();
+    if (now - _lastLinkCheck < MS_LOGGER_LINK_CHECK_INTERVAL_S) return;
+    _lastLinkCheck = now;
+    watchDogTimer.resetWatchDog();
+
+    // Re-checking a live connection only takes a couple of commands
+    MS_DBG(F("Checking the connection of"), _logModem->getModemName());
+    if (_logModem->getModemState() == MODEM_CONNECTED &&
+        _logModem->connectInternet()) {
+        return;
+    }
+
+    // Start over from a clean power-up rather than waiting for the next
+    // interval
+    PRINTOUT(F("Modem not connected; reconnecting..."));
+    _logModem->modemSleepPowerDown();
+    watchDogTimer.resetWatchDog();
+    if (!_logModem->modemWake() || !_logModem->connectInternet()) {
+        MS_DBG(F("Could not reconnect; will try again at the next check"));
+        _logModem->modemSleepPowerDown();
+    }
+    watchDogTimer.resetWatchDog();
+}
+
+
 // ===================================================================== //
 // Public functions to access the clock in proper format and time zone
 // ===================================================================== //
@@ -552,16 +815,17 @@ bool Logger::setRTClock(uint32_t UTCEpochSeconds) {
     uint32_t set_logTZ = UTCEpochSeconds +
         ((uint32_t)getLoggerTimeZone()) * 3600;
     uint32_t set_rtcTZ = set_logTZ - ((uint32_t)getTZOffset()) * 3600;
-    MS_DBG(F("    Time for Logger supplied by NIST:"), set_logTZ, F("->"),
+    MS_DBG(F("    Time for Logger from the time server:"), set_logTZ, F("->"),
            formatDateTime_ISO8601(set_logTZ));
 
     // Check the current RTC time
     uint32_t cur_logTZ = getNowEpoch();
     MS_DBG(F("    Current Time on RTC:"), cur_logTZ, F("->"),
            formatDateTime_ISO8601(cur_logTZ));
-    MS_DBG(F("    Offset between NIST and RTC:"), abs(set_logTZ - cur_logTZ));
+    MS_DBG(F("    Offset between time server and RTC:"),
+           abs(set_logTZ - cur_logTZ));
 
-    // If the RTC and NIST disagree by more than 5 seconds, set the clock
+    // If the RTC and time server disagree by more than 5 seconds, set the clock
     if (abs(set_logTZ - cur_logTZ) > 5) {
         setNowEpoch(set_rtcTZ);
         PRINTOUT(F("Clock set!"));
@@ -1542,6 +1806,23 @@ void Logger::logDataAndPublish(void) {
         // the card and writing to it.  Could we turn it on just before writing?
         turnOnSDcard(false);
 
+        // An always-connected modem is already awake and online
+        bool wasConnected = _logModem != NULL && _alwaysConnected &&
+            _logModem->getModemState() == MODEM_CONNECTED;
+        bool stayConnected = false;
+
+        // Start the modem first, so it can wake and register on the network
+        // while the sensors are warming up and measuring
+        bool modemAwake = wasConnected;
+        bool overlap    = _logModem != NULL && _overlapModemStartup &&
+            !wasConnected;
+        if (overlap) {
+            MS_DBG(F("Starting"), _logModem->getModemName(),
+                   F("to register while the sensors measure..."));
+            _logModem->connectInternetBegin();
+            _logModem->poll();
+        }
+
         // Do a complete update on the variable array.
         // This this includes powering all of the sensors, getting updated
         // values, and turing them back off.
@@ -1549,22 +1830,38 @@ void Logger::logDataAndPublish(void) {
         // to run if the sensor was not previously set up.
         MS_DBG(F("Running a complete sensor update..."));
         watchDogTimer.resetWatchDog();
-        _internalArray->completeUpdate();
+        _internalArray->completeUpdate(overlap ? &Logger::pollModem : NULL,
+                                       this);
         watchDogTimer.resetWatchDog();
+        if (overlap) {
+            modemAwake = _logModem->getModemState() != MODEM_FAILED;
+        }
+        // Decide which values have changed enough to be reported
+        markReportedValues();
 
         // Create a csv data record and save it to the log file
         logToSD();
+        // And keep a copy of it until it's been published
+        addRecordToLogBuffer();
 
         if (_logModem != NULL) {
-            MS_DBG(F("Waking up"), _logModem->getModemName(), F("..."));
-            if (_logModem->modemWake()) {
-                // Connect to the network
+            if (!_overlapModemStartup && !wasConnected) {
+                MS_DBG(F("Waking up"), _logModem->getModemName(), F("..."));
+                modemAwake = _logModem->modemWake();
+            }
+            if (modemAwake) {
+                // Connect to the network; with the modem woken before the
+                // sensor update, registration is usually already done
                 watchDogTimer.resetWatchDog();
                 MS_DBG(F("Connecting to the Internet..."));
-                if (_logModem->connectInternet()) {
+                int16_t rssi;
+                bool    deferred;
+                bool    connected = connectToPublish(rssi, deferred);
+                bool    published = false;
+                if (connected) {
                     // Publish data to remotes
                     watchDogTimer.resetWatchDog();
-                    publishDataToRemotes();
+                    published = publishDataToRemotes();
                     watchDogTimer.resetWatchDog();
 
                     if ((Logger::markedEpochTime != 0 &&
@@ -1572,7 +1869,7 @@ void Logger::logDataAndPublish(void) {
                         !isRTCSane(Logger::markedEpochTime)) {
                         // Sync the clock at noon
                         MS_DBG(F("Running a daily clock sync..."));
-                        setRTClock(_logModem->getNISTTime());
+                        setRTClock(_logModem->getNetworkTime());
                         watchDogTimer.resetWatchDog();
                     }
 
@@ -1580,16 +1877,38 @@ void Logger::logDataAndPublish(void) {
                     MS_DBG(F("Updating modem metadata..."));
                     _logModem->updateModemMetadata();
 
-                    // Disconnect from the network
-                    MS_DBG(F("Disconnecting from the Internet..."));
-                    _logModem->disconnectInternet();
+                    if (_alwaysConnected) {
+                        MS_DBG(F("Staying connected for the next interval"));
+                        stayConnected = true;
+                    } else {
+                        // Disconnect from the network
+                        MS_DBG(F("Disconnecting from the Internet..."));
+                        _logModem->disconnectInternet();
+                    }
+                } else if (deferred) {
+                    PRINTOUT(F("Signal too poor; leaving the data to publish "
+                               "next time"));
                 } else {
                     MS_DBG(F("Could not connect to the internet!"));
                     watchDogTimer.resetWatchDog();
                 }
+                // Count the attempt by signal strength, for the gate
+                if (rssi != 0 && !deferred) {
+                    loggerModem::recordSignalResult(rssi, published);
+                }
+            }
+            if (stayConnected) {
+                // Publishing counts as a check of the connection
+                _lastLinkCheck = getNowEpoch();
+                // Keep the times; they'd otherwise only be saved at power down
+                loggerModem::saveModemTelemetry();
+            } else {
+                // Turn the modem off
+                _logModem->modemSleepPowerDown();
+                // If it should have stayed connected, reconnect at the next
+                // wake rather than waiting out the check interval
+                _lastLinkCheck = 0;
             }
-            // Turn the modem off
-            _logModem->modemSleepPowerDown();
         }
 
 
@@ -1607,6 +1926,9 @@ void Logger::logDataAndPublish(void) {
 
         // Unset flag
         Logger::isLoggingNow = false;
+    } else if (_logModem != NULL && _alwaysConnected) {
+        // Between intervals, make sure the modem is still connected
+        checkModemLink();
     }
 
     // Check if it was instead the testing interrupt that woke us up
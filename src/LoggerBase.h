@@ -26,6 +26,7 @@
 #undef MS_DEBUGGING_STD
 #include "VariableArray.h"
 #include "LoggerModem.h"
+#include "LogBuffer.h"
 
 // Bring in the libraries to handle the processor sleep/standby modes
 // The SAMD library can also the built-in clock on those modules
@@ -54,10 +55,57 @@
 #include <SdFat.h>  // To communicate with the SD card
 
 /**
- * @brief The largest number of variables from a single sensor
+ * @def MS_LOGGER_PUBLISH_BUDGET_MS
+ * @brief The default time in milliseconds the logger may spend publishing in
+ * each logging cycle; 0 for no limit.
+ *
+ * This can be changed for a logger with Logger::setPublishingBudget(uint32_t)
+ * or by setting the build flag MS_LOGGER_PUBLISH_BUDGET_MS when compiling.
+ *
+ * @ingroup base_classes
+ */
+#ifndef MS_LOGGER_PUBLISH_BUDGET_MS
+#define MS_LOGGER_PUBLISH_BUDGET_MS 0
+#endif
+
+/**
+ * @brief The number of data publishers a logger used to be limited to.
+ *
+ * @deprecated There is no longer any limit on the number of publishers; this
+ * is only kept for sketches that refer to it.
  */
 #define MAX_NUMBER_SENDERS 4
 
+/**
+ * @def MS_LOGGER_MAX_DEFERRED_PUBLISHES
+ * @brief The most logging cycles in a row that publishing can be put off for a
+ * poor signal.
+ *
+ * Publishing is tried after this many deferrals whatever the signal, so the
+ * success rates for a poor signal keep being updated.  See
+ * Logger::setPublishSignalGate(int16_t, uint8_t).  This can be changed by
+ * setting the build flag MS_LOGGER_MAX_DEFERRED_PUBLISHES when compiling.
+ *
+ * @ingroup base_classes
+ */
+#ifndef MS_LOGGER_MAX_DEFERRED_PUBLISHES
+#define MS_LOGGER_MAX_DEFERRED_PUBLISHES 12
+#endif
+
+/**
+ * @def MS_LOGGER_LINK_CHECK_INTERVAL_S
+ * @brief The least time in seconds between checks of an always-connected
+ * modem's connection between logging intervals.
+ *
+ * See Logger::setAlwaysConnected(bool).  This can be changed by setting the
+ * build flag MS_LOGGER_LINK_CHECK_INTERVAL_S when compiling.
+ *
+ * @ingroup base_classes
+ */
+#ifndef MS_LOGGER_LINK_CHECK_INTERVAL_S
+#define MS_LOGGER_LINK_CHECK_INTERVAL_S 300
+#endif
+
 
 class dataPublisher;  // Forward declaration
 
@@ -445,6 +493,46 @@ class Logger {
      * number of significant figures.
      */
     String getValueStringAtI(uint8_t position_i);
+    /**
+     * @brief Format any value with the correct number of significant figures
+     * for the variable at the given position in the internal variable array
+     * object.
+     *
+     * @param position_i The position of the variable in the array.
+     * @param value The value to format
+     * @return **String** The value as a string with the correct number of
+     * significant figures.
+     */
+    String formatValueStringAtI(uint8_t position_i, float value);
+    /**
+     * @brief Check if the most recent value of the variable at the given
+     * position in the internal variable array object needs to be reported.
+     *
+     * @see Variable::setReportByException(float, uint32_t)
+     *
+     * @param position_i The position of the variable in the array.
+     * @return **bool** True if the value needs to be reported.
+     */
+    bool isValueReportedAtI(uint8_t position_i);
+    /**
+     * @brief Decide which of the most recent values need to be reported.
+     *
+     * This is called once per record by logDataAndPublish(), after the
+     * variables are updated.  Variables without a deadband set are always
+     * reported.
+     */
+    void markReportedValues(void);
+    /**
+     * @brief Remember the values marked by markReportedValues() as the last
+     * values reported.
+     *
+     * This is called by publishDataToRemotes() once every publisher that
+     * sends the current values has had them accepted.  Publishers sending
+     * from the LogBuffer don't need to succeed, since the record keeps its
+     * reported values until they send it.  Until then, the next values are
+     * still compared against the last ones that went out.
+     */
+    void confirmReportedValues(void);
 
  protected:
     /**
@@ -476,9 +564,97 @@ class Logger {
      * @param modem An instance of the loggerModem class
      */
     void attachModem(loggerModem& modem);
+    /**
+     * @brief Attach a LogBuffer to the logger to hold records until they have
+     * been published.
+     *
+     * If a buffer is attached, every record logged by logDataAndPublish() is
+     * added to it and publishers which support it will send any records they
+     * were not able to send earlier.  If no buffer is attached, publishers
+     * only send the current values.
+     *
+     * @param logBuffer An instance of the LogBuffer class
+     */
+    void attachLogBuffer(LogBuffer& logBuffer);
+    /**
+     * @brief Get the attached LogBuffer.
+     *
+     * @return **LogBuffer*** The attached buffer, or NULL if none is attached
+     */
+    LogBuffer* getLogBuffer(void);
+    /**
+     * @brief Set whether logDataAndPublish() wakes the modem before or after
+     * updating the sensors.
+     *
+     * By default, the modem is only woken once the values have been saved.
+     * With this turned on, the modem is started at the beginning of the
+     * logging cycle and stepped along with loggerModem::poll() between checks
+     * on the sensors, so it wakes and registers on the network while the
+     * sensors are warming up and measuring.  Data is then published as soon
+     * as both are done.
+     *
+     * Leave this off if the modem's current draw or radio interferes with any
+     * of the sensors.
+     *
+     * @param overlap True to wake the modem before updating the sensors
+     */
+    void setOverlapModemStartup(bool overlap);
+    /**
+     * @brief Set whether logDataAndPublish() keeps the modem connected between
+     * logging intervals.
+     *
+     * This is meant for stations on line power, where the time to publish
+     * matters more than the power used.  Once connected, the modem isn't
+     * disconnected or put to sleep after publishing.  At the next interval,
+     * the connection is only re-checked - usually a couple of commands -
+     * before publishing.  Between intervals, the connection is checked every
+     * #MS_LOGGER_LINK_CHECK_INTERVAL_S seconds.  If it's been lost, or if it
+     * fails at an interval, the modem is powered down and woken again to
+     * reconnect.
+     *
+     * @param alwaysConnected True to keep the modem connected
+     */
+    void setAlwaysConnected(bool alwaysConnected);
+    /**
+     * @brief Set the signal needed for logDataAndPublish() to publish.
+     *
+     * With a gate set, the signal strength is checked once the modem has
+     * registered on the network, before the data connection is made.  If the
+     * RSSI is under the minimum, or the recent publishing success rate at
+     * that signal strength (see loggerModem::getSignalSuccessPercent()) is
+     * under the minimum, publishing is put off.  The modem is powered down
+     * right away and the records wait in the LogBuffer for the next cycle.
+     *
+     * Publishing is never put off without a LogBuffer attached, when the next
+     * record would overwrite one that hasn't been sent, when any publisher
+     * only sends the current values (see dataPublisher::usesLogBuffer()), or
+     * after #MS_LOGGER_MAX_DEFERRED_PUBLISHES cycles in a row.
+     *
+     * Every attempt made with a gate set is counted by signal strength, with
+     * the modem's connection phase histograms.
+     *
+     * @note Checking the signal takes one extra command for most modems, but
+     * the XBee WiFi measures its signal by pinging a server.
+     *
+     * @param minRSSI The lowest RSSI in dBm to publish at; 0 for no minimum.
+     * @param minSuccessPercent The lowest recent success rate in percent to
+     * publish at; 0 for no minimum.
+     */
+    void setPublishSignalGate(int16_t minRSSI, uint8_t minSuccessPercent = 0);
+    /**
+     * @brief Add the current values of all variables to the attached
+     * LogBuffer, if there is one.
+     *
+     * The values are flagged with whether they need to be reported, as last
+     * decided by markReportedValues().
+     */
+    void addRecordToLogBuffer(void);
     /**
      * @brief Use the attahed loggerModem to synchronize the real-time clock
-     * with NIST time servers.
+     * with a time server.
+     *
+     * This uses SNTP if an SNTPClient is attached to the modem and NIST
+     * otherwise; see loggerModem::getNetworkTime().
      *
      * @return **bool** True if clock synchronization was successful
      */
@@ -487,13 +663,52 @@ class Logger {
     /**
      * @brief Register a data publisher object to receive data from the logger.
      *
+     * There is no limit on the number of publishers.  They are kept in order
+     * of their priority (see dataPublisher::setPriority(uint8_t)), and in the
+     * order they were registered within the same priority.  Registering a
+     * publisher again moves it to its place for its current priority.
+     *
      * @param publisher A dataPublisher object
      */
     void registerDataPublisher(dataPublisher* publisher);
+    /**
+     * @brief Get the first registered data publisher; the rest follow with
+     * dataPublisher::getNextPublisher().
+     *
+     * @return **dataPublisher*** The publisher with the highest priority, or
+     * NULL if none are registered.
+     */
+    dataPublisher* getFirstPublisher(void);
+    /**
+     * @brief Set the longest time publishDataToRemotes() may take.
+     *
+     * Once the time is up, any publisher still working is stopped and any
+     * publisher not yet started is skipped for this cycle, as long as it
+     * sends from the LogBuffer (see dataPublisher::usesLogBuffer()) and a
+     * LogBuffer is attached.  Their records stay in the buffer and are sent
+     * with the next cycle.  Publishers that only send the current values
+     * would lose the record, so they are still run.  Since publishers are
+     * started in order of priority, the most important ones get the time
+     * first.
+     *
+     * @param budget_ms The time in milliseconds; 0 for no limit.
+     */
+    void setPublishingBudget(uint32_t budget_ms);
     /**
      * @brief Publish data to all registered data publishers.
+     *
+     * Publishers are started in order of priority, without waiting on each
+     * other's responses.  Publishers which share a client wait until the
+     * client is free again, so the one with the higher priority goes first.
+     * A publisher which takes longer than its own time budget (see
+     * dataPublisher::setTimeBudget(uint32_t)) is stopped.
+     *
+     * If the values were all accepted, the reported values are confirmed;
+     * see confirmReportedValues().
+     *
+     * @return **bool** True if every publisher that was started succeeded.
      */
-    void publishDataToRemotes(void);
+    bool publishDataToRemotes(void);
     /**
      * @brief Retained for backwards compatibility.
      *
@@ -513,9 +728,83 @@ class Logger {
     //
 
     /**
-     * @brief An array of all of the attached data publishers
+     * @brief The internal log buffer instance, if any.
+     */
+    LogBuffer* _logBuffer;
+    /**
+     * @brief True to wake the modem before updating the sensors.
+     */
+    bool _overlapModemStartup;
+    /**
+     * @brief True to keep the modem connected between logging intervals.
+     */
+    bool _alwaysConnected;
+    /**
+     * @brief The time the always-connected modem's connection was last
+     * checked or used, in seconds since the epoch.
+     */
+    uint32_t _lastLinkCheck;
+
+    /**
+     * @brief The first of the registered data publishers, in order of
+     * priority
+     */
+    dataPublisher* _firstPublisher;
+    /**
+     * @brief The longest time in milliseconds to spend publishing in each
+     * cycle; 0 for no limit.
+     */
+    uint32_t _publishingBudget_ms;
+    /**
+     * @brief The lowest RSSI in dBm to publish at; 0 for no minimum.
+     */
+    int16_t _minPublishRSSI;
+    /**
+     * @brief The lowest recent success rate in percent to publish at; 0 for
+     * no minimum.
+     */
+    uint8_t _minPublishSuccessPercent;
+    /**
+     * @brief The number of logging cycles in a row publishing has been put
+     * off.
+     */
+    uint8_t _deferredPublishes;
+    /**
+     * @brief Connect to the internet to publish, unless the signal gate says
+     * to wait.
+     *
+     * @param rssi Set to the RSSI once registered, if there's a gate; else 0.
+     * @param deferred Set to true if publishing was put off.
+     * @return **bool** True if connected.
+     */
+    bool connectToPublish(int16_t& rssi, bool& deferred);
+    /**
+     * @brief Check the signal gate.
+     *
+     * @param rssi The RSSI in dBm
+     * @return **bool** True to put off publishing.
+     */
+    bool shouldDeferPublish(int16_t rssi);
+    /**
+     * @brief Check that an always-connected modem is still connected, if it's
+     * been #MS_LOGGER_LINK_CHECK_INTERVAL_S seconds since the last check, and
+     * reconnect if it isn't.
+     */
+    void checkModemLink(void);
+    /**
+     * @brief Step the attached modem along while the sensors are updated.
+     *
+     * @param logger The logger whose modem to poll
+     */
+    static void pollModem(void* logger);
+    /**
+     * @brief Check if another publisher is in the middle of using the same
+     * client as a publisher.
+     *
+     * @param publisher The publisher that wants to start
+     * @return **bool** True if the client is in use
      */
-    dataPublisher* dataPublishers[MAX_NUMBER_SENDERS];
+    bool isPublisherClientBusy(dataPublisher* publisher);
     /**@}*/
 
     // ===================================================================== //
@@ -8,6 +8,18 @@
  */
 
 #include "LoggerModem.h"
+#include "LoggerBase.h"
+
+// The version of the layout of the connection phase histograms in EEPROM
+#define MS_MODEM_TELEMETRY_VERSION 3
+// The version of the cached network in EEPROM
+#define MS_MODEM_NETWORK_VERSION 1
+// The version of the saved serial baud rate
+#define MS_MODEM_BAUD_VERSION 1
+// The fewest recent connections to work out an adaptive timeout from
+#define MODEM_TIMEOUT_MIN_HISTORY 4
+// The fewest attempts in a signal band to work out a success rate from
+#define MODEM_SIGNAL_MIN_ATTEMPTS 4
 
 // Initialize the static members
 int16_t loggerModem::_priorRSSI           = -9999;
@@ -16,6 +28,16 @@ float   loggerModem::_priorModemTemp      = -9999;
 float   loggerModem::_priorBatteryState   = -9999;
 float   loggerModem::_priorBatteryPercent = -9999;
 float   loggerModem::_priorBatteryVoltage = -9999;
+
+float loggerModem::_priorPhaseTime[MODEM_NUM_PHASES] = {-9999, -9999, -9999,
+                                                        -9999};
+
+float          loggerModem::_priorHardResets    = -9999;
+modemTelemetry loggerModem::_telemetry;
+bool           loggerModem::_telemetryLoaded    = false;
+bool           loggerModem::_telemetryChanged   = false;
+uint32_t       loggerModem::_telemetrySavedHour = 0;
+
 // float loggerModem::_priorActivationDuration = -9999;
 // float loggerModem::_priorPoweredDuration = -9999;
 
@@ -36,8 +58,19 @@ loggerModem::loggerModem(int8_t powerPin, int8_t statusPin, bool statusLevel,
       _disconnetTime_ms(max_disconnetTime_ms),
       _wakeDelayTime_ms(wakeDelayTime_ms),
       _max_atresponse_time_ms(max_atresponse_time_ms), _modemLEDPin(-1),
-      _millisPowerOn(0), _lastNISTrequest(0), _hasBeenSetup(false),
-      _pinModesSet(false), _modemName("unspecified modem") {}
+      _millisPowerOn(0), _pollModemMetaData(MODEM_ALL_ENABLE_BITMASK),
+      _metadataPollingSet(false), _lastNISTrequest(0), _sntpClient(NULL),
+      _telemetryStart(0), _recordTiming(false),
+      _hasBeenSetup(false), _pinModesSet(false), _modemState(MODEM_OFF),
+      _targetState(MODEM_OFF), _phaseStart(0), _lastModemPoll(0),
+      _maxConnectionTime(50000L), _adaptiveTimeout(false), _modemResets(0),
+      _requestedTAU_s(0), _requestedActiveTime_s(0), _requestedEDRX_ms(0),
+      _grantedTAU_s(0), _grantedActiveTime_s(0), _psmGranted(false),
+      _powerSavePending(false), _fastRegistration(false),
+      _networkTried(false), _networkSelected(false), _networkLoaded(false),
+      _networkSearching(false), _searchStart(0),
+      _modemSerial(NULL), _modemBaud(0), _targetBaud(0),
+      _modemName("unspecified modem") {}
 
 
 // Destructor
@@ -95,6 +128,12 @@ void loggerModem::modemPowerDown(void) {
         digitalWrite(_powerPin, LOW);
         // Unset the power-on time
         _millisPowerOn = 0;
+        _modemState    = MODEM_OFF;
+        // Any registration and PSM settings are lost along with the power
+        _psmGranted = false;
+        if (_requestedTAU_s > 0 || _requestedEDRX_ms > 0) {
+            _powerSavePending = true;
+        }
     } else {
         MS_DBG(F("Power to"), getModemName(),
                F("is not controlled by this library."));
@@ -121,13 +160,23 @@ bool loggerModem::modemSetup(void) {
     // Check if the modem was awake, wake it if not
     bool wasAwake = isModemAwake();
     if (!wasAwake) {
-        while (millis() - _millisPowerOn < _wakeDelayTime_ms) {}
         MS_DBG(F("Waking up the modem for setup ..."));
         success &= modemWake();
     } else {
         MS_DBG(F("Modem was already awake and should be ready for setup."));
     }
 
+    // If the modem didn't answer, it may be at a rate from before a reset
+    if (!success && _modemSerial != NULL && detectModemBaud()) {
+        finishModemWake();
+        success = _modemState == MODEM_AT_READY;
+    }
+
+    if (success && _modemSerial != NULL && _modemBaud != _targetBaud) {
+        // The modem works at the old rate, so carry on if it fails
+        negotiateModemBaud();
+    }
+
     if (success) {
         MS_DBG(F("Running modem's extra setup function ..."));
         success &= extraModemSetup();
@@ -189,6 +238,7 @@ bool loggerModem::modemSleep(void) {
         success &= modemSleepFxn();
         modemLEDOff();
     }
+    _modemState = MODEM_OFF;
     return success;
 }
 
@@ -201,7 +251,11 @@ bool loggerModem::modemSleepPowerDown(void) {
     modemSleep();
 
     // Now power down
-    if (_powerPin >= 0) {
+    if (_psmGranted) {
+        // Cutting the power would lose the registration PSM is keeping
+        MS_DBG(F("Leaving"), getModemName(),
+               F("powered so it can stay registered in PSM."));
+    } else if (_powerPin >= 0) {
         // If there's a status pin available, wait until modem shows it's ready
         // to be powered off This allows the modem to shut down gracefully.
         if (_statusPin >= 0) {
@@ -234,6 +288,10 @@ bool loggerModem::modemSleepPowerDown(void) {
         digitalWrite(_powerPin, LOW);
         // Unset the power-on time
         _millisPowerOn = 0;
+        // Any PSM settings are lost along with the power
+        if (_requestedTAU_s > 0 || _requestedEDRX_ms > 0) {
+            _powerSavePending = true;
+        }
     } else {
         // loggerModem::_priorPoweredDuration = static_cast<float>(-9999);
 
@@ -247,6 +305,7 @@ bool loggerModem::modemSleepPowerDown(void) {
         // _millisPowerOn = 0;
     }
 
+    saveModemTelemetry();
     return success;
 }
 
@@ -265,6 +324,583 @@ bool loggerModem::modemHardReset(void) {
         return false;
     }
 }
+
+
+void loggerModem::modemWakeBegin(void) {
+    _targetState = MODEM_AT_READY;
+    if (_modemState == MODEM_FAILED) {
+        _modemState = MODEM_OFF;
+    } else if (_modemState >= MODEM_AT_READY) {
+        // Make sure it's still responding, as a fresh wake would, but don't
+        // count it as a wake
+        _modemResets  = 0;
+        _phaseStart   = millis();
+        _recordTiming = false;
+        _modemState   = MODEM_WAKING;
+    }
+    // Otherwise carry on with the wake already in progress
+}
+
+
+void loggerModem::connectInternetBegin(uint32_t maxConnectionTime) {
+    _targetState       = MODEM_CONNECTED;
+    _maxConnectionTime = getConnectionTimeout(maxConnectionTime);
+    _networkTried      = false;
+    _networkSelected   = false;
+    if (_modemState == MODEM_FAILED) {
+        _modemState = MODEM_OFF;
+    } else if (_modemState >= MODEM_AT_READY) {
+        // Carry on with a connection in progress, but re-check a finished one
+        // without timing it again
+        if (_modemState == MODEM_CONNECTED) {
+            _modemState   = MODEM_AT_READY;
+            _recordTiming = false;
+        } else if (_modemState == MODEM_AT_READY) {
+            _recordTiming = true;
+        }
+        // Registration is timed from here, as it is after a wake
+        if (_modemState == MODEM_AT_READY) {
+            _phaseStart     = millis();
+            _telemetryStart = _phaseStart;
+            MS_DBG(F("\nWaiting up to"), _maxConnectionTime / 1000,
+                   F("seconds for network registration..."));
+        }
+    }
+}
+
+
+void loggerModem::setAdaptiveTimeout(bool adaptive) {
+    _adaptiveTimeout = adaptive;
+}
+uint32_t loggerModem::getConnectionTimeout(uint32_t maxConnectionTime) {
+    if (!_adaptiveTimeout) return maxConnectionTime;
+    loadModemTelemetry();
+
+    uint32_t timeout = maxConnectionTime;
+    uint8_t  count   = _telemetry.numRecentConnections;
+    if (count >= MODEM_TIMEOUT_MIN_HISTORY) {
+        // Sort a copy of the recent times to find the percentile
+        uint16_t sorted[MS_MODEM_RECENT_CONNECTIONS];
+        for (uint8_t i = 0; i < count; i++) {
+            uint16_t t = _telemetry.recentConnections[i];
+            uint8_t  j = i;
+            for (; j > 0 && sorted[j - 1] > t; j--) sorted[j] = sorted[j - 1];
+            sorted[j] = t;
+        }
+        uint16_t percentile =
+            sorted[(count - 1) * MS_MODEM_TIMEOUT_PERCENTILE / 100];
+        // Twice the percentile, in milliseconds
+        timeout = static_cast<uint32_t>(percentile) * 200;
+        if (timeout < MS_MODEM_MIN_TIMEOUT_MS) {
+            timeout = MS_MODEM_MIN_TIMEOUT_MS;
+        }
+    }
+
+    // Back off after failures in a row
+    for (uint8_t i = 0; i < _telemetry.connectFailures; i++) {
+        if (timeout >= MS_MODEM_MAX_TIMEOUT_MS) break;
+        timeout *= 2;
+    }
+    if (timeout > MS_MODEM_MAX_TIMEOUT_MS) timeout = MS_MODEM_MAX_TIMEOUT_MS;
+    MS_DBG(F("Connection timeout from"), count, F("recent connections and"),
+           _telemetry.connectFailures, F("failures in a row:"), timeout,
+           F("ms"));
+    return timeout;
+}
+
+
+bool loggerModem::poll(void) {
+    // The states are in order, with failure last
+    if (_modemState >= _targetState) return true;
+
+    // Don't pester the modem if the last check came up empty
+    if (_lastModemPoll != 0 &&
+        millis() - _lastModemPoll < MS_MODEM_POLL_INTERVAL_MS) {
+        return false;
+    }
+    _lastModemPoll = 0;
+
+    switch (_modemState) {
+        case MODEM_OFF:
+            if (_millisPowerOn == 0) modemPowerUp();
+            // Because the modem calls wake BEFORE the first setup, we must set
+            // the pin modes here.
+            setModemPinModes();
+            _telemetryStart = millis();
+            _recordTiming   = true;
+            _modemState     = MODEM_POWERING;
+            break;
+        case MODEM_POWERING:
+            if (millis() - _millisPowerOn < _wakeDelayTime_ms) {
+                _lastModemPoll = millis();
+                break;
+            }
+            if (isModemAwake()) {
+                MS_DBG(getModemName(),
+                       F("was already on! Will not run wake function."));
+            } else {
+                MS_DBG(F("Running wake function for"), getModemName());
+                if (!modemWakeFxn()) {
+                    MS_DBG(F("Wake function for"), getModemName(),
+                           F("did not run as expected!"));
+                }
+            }
+            MS_DBG(F("\nWaiting up to"), _max_atresponse_time_ms + 500,
+                   F("ms for"), getModemName(),
+                   F("to respond to AT commands..."));
+            _modemResets = 0;
+            _phaseStart  = millis();
+            _modemState  = MODEM_WAKING;
+            break;
+        case MODEM_WAKING:
+            if (modemTestAT(MS_MODEM_POLL_INTERVAL_MS)) {
+                MS_DBG(F("... AT OK after"), millis() - _phaseStart,
+                       F("milliseconds!"));
+                if (_recordTiming) {
+                    addToHistogram(_telemetry.wakeResets, 3, _modemResets);
+                    _priorHardResets = _modemResets;
+                }
+                recordPhase(MODEM_PHASE_WAKE);
+                finishModemWake();
+            } else if (millis() - _phaseStart < _max_atresponse_time_ms + 500) {
+                _lastModemPoll = millis();
+            } else if (_modemResets < 2 && modemHardReset()) {
+                // Hard reset if there's no AT response
+                _modemResets++;
+                MS_DBG(F("No response to AT commands!  Did hard reset"),
+                       _modemResets);
+                _phaseStart = millis();
+            } else {
+                MS_DBG(getModemName(), F("failed to wake!"));
+                if (_recordTiming) recordPhaseFailure(MODEM_PHASE_WAKE);
+                _modemState = MODEM_FAILED;
+            }
+            break;
+        case MODEM_AT_READY:
+            if (isNetworkRegistered()) {
+                recordPhase(MODEM_PHASE_REGISTRATION);
+                _modemState = MODEM_ATTACHED;
+            } else {
+                // Try the cached network once before searching for any
+                if (_fastRegistration && !_networkTried) selectCachedNetwork();
+                if (startNetworkAttach()) {
+                    _modemState = MODEM_REGISTERING;
+                } else {
+                    waitOrGiveUp(_maxConnectionTime);
+                }
+            }
+            break;
+        case MODEM_REGISTERING:
+            // Don't talk over a network selection that hasn't answered
+            if (_networkSearching && !finishNetworkSearch()) {
+                waitOrGiveUp(_maxConnectionTime);
+            } else if (isNetworkRegistered()) {
+                MS_DBG(F("... Registered after"), millis() - _phaseStart,
+                       F("milliseconds."));
+                recordPhase(MODEM_PHASE_REGISTRATION);
+                if (_fastRegistration && !_networkSelected) rememberNetwork();
+                _modemState = MODEM_ATTACHED;
+            } else {
+                waitOrGiveUp(_maxConnectionTime);
+            }
+            break;
+        case MODEM_ATTACHED:
+            // Check first, so an open connection isn't opened again
+            if (isInternetAvailable() || startDataConnection()) {
+                MS_DBG(F("... Connected after"), millis() - _phaseStart,
+                       F("milliseconds."));
+                recordPhase(MODEM_PHASE_ATTACH);
+                if (_recordTiming) recordConnectionTime(millis() - _phaseStart);
+                if (_requestedTAU_s > 0) readPowerSaveTimers();
+                _modemState = MODEM_CONNECTED;
+            } else {
+                waitOrGiveUp(_maxConnectionTime);
+            }
+            break;
+        default: break;
+    }
+    return _modemState >= _targetState;
+}
+
+
+void loggerModem::waitForPoll(void) {
+    if (_lastModemPoll == 0) return;
+    uint32_t sinceLast = millis() - _lastModemPoll;
+    if (sinceLast < MS_MODEM_POLL_INTERVAL_MS) {
+        delay(MS_MODEM_POLL_INTERVAL_MS - sinceLast);
+    }
+}
+
+
+modemState loggerModem::getModemState(void) {
+    return _modemState;
+}
+
+
+void loggerModem::finishModemWake(void) {
+    bool success;
+    if (!_hasBeenSetup) {
+        // Run the setup here rather than through modemSetup(), which would
+        // wake the modem again.  As there, set the flag first.  Clear out and
+        // initialize the modem as on any other wake, but let the setup decide
+        // if that worked; an XBee may not yet be in the mode the init expects.
+        _hasBeenSetup = true;
+        modemInit();
+        success = extraModemSetup();
+        if (!success) _hasBeenSetup = false;
+    } else {
+        success = modemInit();
+    }
+    if (success && _powerSavePending) {
+        // A modem that doesn't take the settings can still be used
+        if (modemPowerSaveSetup()) _powerSavePending = false;
+    }
+
+    if (success) {
+        modemLEDOn();
+        MS_DBG(getModemName(), F("should be awake and ready to go."));
+        _phaseStart = millis();
+        // Registration is timed from here
+        _telemetryStart   = _phaseStart;
+        _networkSearching = false;
+        _modemState     = MODEM_AT_READY;
+        if (_targetState > MODEM_AT_READY) {
+            MS_DBG(F("\nWaiting up to"), _maxConnectionTime / 1000,
+                   F("seconds for network registration..."));
+        }
+    } else {
+        MS_DBG(getModemName(), F("failed to wake!"));
+        _modemState = MODEM_FAILED;
+    }
+}
+
+
+void loggerModem::waitOrGiveUp(uint32_t maxWait_ms) {
+    if (millis() - _phaseStart < maxWait_ms) {
+        _lastModemPoll = millis();
+    } else {
+        MS_DBG(F("... Gave up on"), getModemName(), F("after"),
+               millis() - _phaseStart, F("milliseconds."));
+        if (_recordTiming) {
+            recordPhaseFailure(_modemState == MODEM_ATTACHED
+                                   ? MODEM_PHASE_ATTACH
+                                   : MODEM_PHASE_REGISTRATION);
+            if (_telemetry.connectFailures < 0xFF) {
+                _telemetry.connectFailures++;
+            }
+        }
+        _modemState = MODEM_FAILED;
+    }
+}
+
+
+void loggerModem::setPowerSaveMode(uint32_t periodicTAU_s,
+                                   uint32_t activeTime_s) {
+    _requestedTAU_s        = periodicTAU_s;
+    _requestedActiveTime_s = activeTime_s;
+    _powerSavePending      = true;
+}
+void loggerModem::setEDRX(uint32_t cycle_ms) {
+    _requestedEDRX_ms = cycle_ms;
+    _powerSavePending = true;
+}
+bool loggerModem::isPowerSaveGranted(void) {
+    return _psmGranted;
+}
+uint32_t loggerModem::getGrantedTAU(void) {
+    return _psmGranted ? _grantedTAU_s : 0;
+}
+uint32_t loggerModem::getGrantedActiveTime(void) {
+    return _grantedActiveTime_s;
+}
+
+
+// Modems without PSM have nothing to set up and never have PSM granted
+bool loggerModem::modemPowerSaveSetup(void) {
+    return true;
+}
+bool loggerModem::readPowerSaveTimers(void) {
+    _psmGranted = false;
+    return false;
+}
+
+
+void loggerModem::setFastRegistration(bool fastRegistration) {
+    _fastRegistration = fastRegistration;
+    if (!_fastRegistration || _networkLoaded) return;
+    _networkLoaded = true;
+#if defined(MS_MODEM_NETWORK_EEPROM_ADDRESS)
+    if (PersistentStore::load(MS_MODEM_NETWORK_EEPROM_ADDRESS, &_network,
+                              sizeof(_network), MS_MODEM_NETWORK_VERSION)) {
+        return;
+    }
+#endif
+    memset(&_network, 0, sizeof(_network));
+}
+
+
+void loggerModem::setBaudNegotiation(HardwareSerial* modemSerial,
+                                     uint32_t currentBaud,
+                                     uint32_t targetBaud) {
+    _modemSerial = modemSerial;
+    _modemBaud   = currentBaud;
+    _targetBaud  = targetBaud;
+    // Open the port at the rate the modem was last switched to
+    uint32_t savedBaud = 0;
+    if (PersistentStore::load(MS_MODEM_BAUD_EEPROM_ADDRESS, &savedBaud,
+                              sizeof(savedBaud), MS_MODEM_BAUD_VERSION) &&
+        savedBaud != 0 && savedBaud != _modemBaud) {
+        MS_DBG(F("Opening the modem's serial port at the saved rate of"),
+               savedBaud);
+        _modemSerial->begin(savedBaud);
+        _modemBaud = savedBaud;
+    }
+}
+uint32_t loggerModem::getModemBaud(void) {
+    return _modemSerial != NULL ? _modemBaud : 0;
+}
+
+
+// Modems that can't change their rate stay at the current one
+bool loggerModem::setModemBaud(uint32_t) {
+    return false;
+}
+
+
+bool loggerModem::negotiateModemBaud(void) {
+    uint32_t oldBaud = _modemBaud;
+    MS_DBG(F("Switching"), getModemName(), F("from"), oldBaud, F("to"),
+           _targetBaud, F("baud ..."));
+    if (!setModemBaud(_targetBaud)) {
+        MS_DBG(F("..."), getModemName(), F("did not take the new rate"));
+        return false;
+    }
+    // Let the modem's reply go out at the old rate before switching; the
+    // new rate is only kept once the modem answers at it
+    _modemSerial->flush();
+    _modemSerial->begin(_targetBaud);
+    delay(100);
+    if (modemTestAT(1000L)) {
+        MS_DBG(F("... AT OK at"), _targetBaud, F("baud"));
+        setSerialBaud(_targetBaud);
+        return true;
+    }
+
+    MS_DBG(F("... No response at"), _targetBaud,
+           F("baud; going back to"), oldBaud);
+    _modemSerial->begin(oldBaud);
+    delay(100);
+    if (modemTestAT(1000L)) return false;
+
+    // The modem switched, but the port isn't reliable at the new rate;
+    // switch the modem back at that rate
+    _modemSerial->begin(_targetBaud);
+    bool switchedBack = setModemBaud(oldBaud);
+    _modemSerial->flush();
+    _modemSerial->begin(oldBaud);
+    delay(100);
+    if (!switchedBack || !modemTestAT(1000L)) {
+        MS_DBG(F("... Lost"), getModemName(), F("switching it back"));
+        detectModemBaud();
+    }
+    return false;
+}
+
+
+bool loggerModem::detectModemBaud(void) {
+    static const uint32_t rates[] = {921600L, 460800L, 230400L, 115200L,
+                                     57600L,  38400L,  19200L,  9600L};
+    uint32_t maxBaud = _targetBaud > _modemBaud ? _targetBaud : _modemBaud;
+    MS_DBG(F("Looking for"), getModemName(), F("at each rate up to"),
+           maxBaud, F("baud ..."));
+    for (uint8_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        if (rates[i] > maxBaud || rates[i] == _modemBaud) continue;
+        _modemSerial->begin(rates[i]);
+        delay(20);
+        if (modemTestAT(500L)) {
+            MS_DBG(F("... Found it at"), rates[i], F("baud"));
+            setSerialBaud(rates[i]);
+            return true;
+        }
+    }
+    MS_DBG(F("... No response at any rate"));
+    _modemSerial->begin(_modemBaud);
+    return false;
+}
+
+
+void loggerModem::setSerialBaud(uint32_t baud) {
+    _modemSerial->begin(baud);
+    _modemBaud = baud;
+    // Only write the rate when it changes, to spare the EEPROM
+    uint32_t savedBaud = 0;
+    if (PersistentStore::load(MS_MODEM_BAUD_EEPROM_ADDRESS, &savedBaud,
+                              sizeof(savedBaud), MS_MODEM_BAUD_VERSION) &&
+        savedBaud == baud) {
+        return;
+    }
+    PersistentStore::save(MS_MODEM_BAUD_EEPROM_ADDRESS, &_modemBaud,
+                          sizeof(_modemBaud), MS_MODEM_BAUD_VERSION);
+}
+
+
+// Modems without fast registration can't select a network
+bool loggerModem::readNetworkSelection(modemNetwork&) {
+    return false;
+}
+bool loggerModem::selectNetwork(const modemNetwork&) {
+    return false;
+}
+bool loggerModem::selectAnyNetwork(void) {
+    return true;
+}
+int8_t loggerModem::checkNetworkSelection(void) {
+    return 1;
+}
+
+
+void loggerModem::selectCachedNetwork(void) {
+    _networkTried = true;
+    if (_network.operatorCode == 0) return;
+    MS_DBG(F("Registering on operator"), _network.operatorCode,
+           F("with access technology"), _network.accessTech, F("on band"),
+           _network.band);
+    if (selectNetwork(_network)) {
+        _networkSearching = true;
+        _searchStart      = millis();
+    } else {
+        searchAnyNetwork();
+    }
+}
+bool loggerModem::finishNetworkSearch(void) {
+    // The cached network is only forgotten once a targeted search fails
+    bool   targeted = _network.operatorCode != 0;
+    int8_t answer   = checkNetworkSelection();
+    if (answer == 0) {
+        if (!targeted ||
+            millis() - _searchStart < MS_MODEM_TARGETED_SEARCH_MS) {
+            return false;
+        }
+        MS_DBG(F("... No answer from the cached network after"),
+               millis() - _searchStart, F("milliseconds"));
+    } else {
+        _networkSearching = false;
+        if (answer == 1 && targeted) {
+            MS_DBG(F("... Registered on the cached network"));
+            _networkSelected = true;
+        }
+        if (answer == 1 || !targeted) return true;
+    }
+    searchAnyNetwork();
+    return false;
+}
+void loggerModem::searchAnyNetwork(void) {
+    MS_DBG(F("... Could not register on the cached network; searching for any"
+             " network"));
+    selectAnyNetwork();
+    // The answer to the automatic selection is read the same way
+    _networkSearching = true;
+    _searchStart      = millis();
+    // Forget it, so a failed search isn't repeated at every connection
+    memset(&_network, 0, sizeof(_network));
+#if defined(MS_MODEM_NETWORK_EEPROM_ADDRESS)
+    PersistentStore::save(MS_MODEM_NETWORK_EEPROM_ADDRESS, &_network,
+                          sizeof(_network), MS_MODEM_NETWORK_VERSION);
+#endif
+}
+void loggerModem::rememberNetwork(void) {
+    modemNetwork network;
+    memset(&network, 0, sizeof(network));
+    if (!readNetworkSelection(network)) return;
+    if (memcmp(&network, &_network, sizeof(network)) == 0) return;
+    MS_DBG(F("Caching operator"), network.operatorCode,
+           F("with access technology"), network.accessTech, F("on band"),
+           network.band);
+    _network = network;
+#if defined(MS_MODEM_NETWORK_EEPROM_ADDRESS)
+    PersistentStore::save(MS_MODEM_NETWORK_EEPROM_ADDRESS, &_network,
+                          sizeof(_network), MS_MODEM_NETWORK_VERSION);
+#endif
+}
+
+
+// The units of the GPRS timer 3 (T3412 extended) in seconds, indexed by the
+// top 3 bits of the timer; 0 is "deactivated"
+static const uint32_t T3412_UNITS_S[8] = {600,  3600, 36000,   2,
+                                          30,   60,   1152000, 0};
+// The units of the GPRS timer 2 (T3324) in seconds; any unlisted unit is
+// treated as a minute and 0 is "deactivated"
+static const uint32_t T3324_UNITS_S[8] = {2, 60, 360, 60, 60, 60, 60, 0};
+// The LTE-M (WB-S1) eDRX cycles in milliseconds, indexed by the 4 bit value
+static const uint32_t EDRX_CYCLES_MS[16] = {
+    5120,   10240,  20480,  40960,   61440,   81920,   102400,  122880,
+    143360, 163840, 327680, 655360, 1310720, 2621440, 5242880, 10485760};
+
+
+bool loggerModem::parsePowerSaveTimers(const char* status) {
+    // The status is "<n>,<stat>,[<tac>],[<ci>],[<AcT>],[<cause_type>],
+    // [<reject_cause>],[<Active-Time>],[<Periodic-TAU>]"; find the last two
+    const char* field = status;
+    for (uint8_t i = 0; i < 7 && field != NULL; i++) {
+        field = strchr(field, ',');
+        if (field != NULL) field++;
+    }
+    _psmGranted = false;
+    if (field == NULL || *field != '"') {
+        MS_DBG(F("The network did not grant PSM"));
+        return field != NULL;
+    }
+    const char* tauField = strchr(field, ',');
+    if (tauField == NULL || *(tauField + 1) != '"') return false;
+
+    uint8_t active = strtoul(field + 1, NULL, 2);
+    uint8_t tau    = strtoul(tauField + 2, NULL, 2);
+    // PSM is off if either timer is deactivated
+    if (T3324_UNITS_S[active >> 5] == 0 || T3412_UNITS_S[tau >> 5] == 0) {
+        MS_DBG(F("The network did not grant PSM"));
+        return true;
+    }
+    _grantedActiveTime_s = T3324_UNITS_S[active >> 5] * (active & 0x1F);
+    _grantedTAU_s        = T3412_UNITS_S[tau >> 5] * (tau & 0x1F);
+    _psmGranted          = true;
+    MS_DBG(F("The network granted PSM with an active time of"),
+           _grantedActiveTime_s, F("s and a periodic TAU of"), _grantedTAU_s,
+           F("s"));
+    return true;
+}
+
+
+uint8_t loggerModem::encodeT3412(uint32_t seconds) {
+    // The units, from shortest to longest
+    static const uint8_t units[7] = {3, 4, 5, 0, 1, 2, 6};
+    for (uint8_t i = 0; i < 7; i++) {
+        uint32_t unit  = T3412_UNITS_S[units[i]];
+        uint32_t value = (seconds + unit - 1) / unit;
+        if (value <= 0x1F) return units[i] << 5 | value;
+    }
+    return 6 << 5 | 0x1F;
+}
+uint8_t loggerModem::encodeT3324(uint32_t seconds) {
+    for (uint8_t unit = 0; unit < 3; unit++) {
+        uint32_t value = (seconds + T3324_UNITS_S[unit] - 1) /
+            T3324_UNITS_S[unit];
+        if (value <= 0x1F) return unit << 5 | value;
+    }
+    return 2 << 5 | 0x1F;
+}
+uint8_t loggerModem::encodeEDRX(uint32_t cycle_ms) {
+    uint8_t value = 0;
+    while (value < 15 && EDRX_CYCLES_MS[value + 1] <= cycle_ms) value++;
+    return value;
+}
+void loggerModem::timerToBits(uint8_t value, uint8_t nBits, char* bits) {
+    for (uint8_t i = 0; i < nBits; i++) {
+        bits[i] = (value >> (nBits - 1 - i)) & 1 ? '1' : '0';
+    }
+    bits[nBits] = '\0';
+}
+
+
 void loggerModem::setModemStatusLevel(bool level) {
     _statusLevel = level;
 }
@@ -320,7 +956,7 @@ bool loggerModem::updateModemMetadata(void) {
     loggerModem::_priorSignalPercent  = -9999;
     loggerModem::_priorBatteryState   = -9999;
     loggerModem::_priorBatteryPercent = -9999;
-    loggerModem::_priorBatteryPercent = -9999;
+    loggerModem::_priorBatteryVoltage = -9999;
     loggerModem::_priorModemTemp      = -9999;
 
     // Initialize variable
@@ -330,44 +966,88 @@ bool loggerModem::updateModemMetadata(void) {
     int8_t   bpercent = -99;
     uint16_t volt     = 9999;
 
-    // Try for up to 15 seconds to get a valid signal quality
-    uint32_t startMillis = millis();
-    do {
-        success &= getModemSignalQuality(rssi, percent);
-        loggerModem::_priorRSSI          = rssi;
+    bool wantSignal  = _pollModemMetaData & MODEM_SIGNAL_ENABLE_BITMASK;
+    bool wantBattery = _pollModemMetaData & MODEM_BATTERY_ENABLE_BITMASK;
+    MS_DBG(F("Modem metadata polling bitmask:"),
+           String(_pollModemMetaData, BIN));
+
+    if (wantSignal) {
+        // Try for up to 15 seconds to get a valid signal quality, along with
+        // the battery information if it's wanted too
+        uint32_t startMillis = millis();
+        do {
+            if (wantBattery) {
+                success &= getModemSignalAndBattery(rssi, percent, state,
+                                                    bpercent, volt);
+            } else {
+                success &= getModemSignalQuality(rssi, percent);
+            }
+            if (rssi != 0 && rssi != -9999) break;
+            delay(250);
+        } while ((rssi == 0 || rssi == -9999) &&
+                 millis() - startMillis < 15000L && success);
+        MS_DBG(F("CURRENT RSSI:"), rssi);
+        MS_DBG(F("CURRENT Percent signal strength:"), percent);
+    } else if (wantBattery) {
+        success &= getModemBatteryStats(state, bpercent, volt);
+    }
+
+    if (_pollModemMetaData & MODEM_RSSI_ENABLE_BITMASK) {
+        loggerModem::_priorRSSI = rssi;
+    }
+    if (_pollModemMetaData & MODEM_PERCENT_SIGNAL_ENABLE_BITMASK) {
         loggerModem::_priorSignalPercent = percent;
-        if (rssi != 0 && rssi != -9999) break;
-        delay(250);
-    } while ((rssi == 0 || rssi == -9999) && millis() - startMillis < 15000L &&
-             success);
-    MS_DBG(F("CURRENT RSSI:"), rssi);
-    MS_DBG(F("CURRENT Percent signal strength:"), percent);
-
-    success &= getModemBatteryStats(state, bpercent, volt);
-    MS_DBG(F("CURRENT Modem Battery Charge State:"), state);
-    MS_DBG(F("CURRENT Modem Battery Charge Percentage:"), bpercent);
-    MS_DBG(F("CURRENT Modem Battery Voltage:"), volt);
-    if (state != 99)
-        loggerModem::_priorBatteryState = static_cast<float>(state);
-    else
-        loggerModem::_priorBatteryState = static_cast<float>(-9999);
+    }
 
-    if (bpercent != -99)
+    if (wantBattery) {
+        MS_DBG(F("CURRENT Modem Battery Charge State:"), state);
+        MS_DBG(F("CURRENT Modem Battery Charge Percentage:"), bpercent);
+        MS_DBG(F("CURRENT Modem Battery Voltage:"), volt);
+    }
+    if ((_pollModemMetaData & MODEM_BATTERY_STATE_ENABLE_BITMASK) &&
+        state != 99) {
+        loggerModem::_priorBatteryState = static_cast<float>(state);
+    }
+    if ((_pollModemMetaData & MODEM_BATTERY_PERCENT_ENABLE_BITMASK) &&
+        bpercent != -99) {
         loggerModem::_priorBatteryPercent = static_cast<float>(bpercent);
-    else
-        loggerModem::_priorBatteryPercent = static_cast<float>(-9999);
-
-    if (volt != 9999)
+    }
+    if ((_pollModemMetaData & MODEM_BATTERY_VOLTAGE_ENABLE_BITMASK) &&
+        volt != 9999) {
         loggerModem::_priorBatteryVoltage = static_cast<float>(volt);
-    else
-        loggerModem::_priorBatteryVoltage = static_cast<float>(-9999);
+    }
 
-    loggerModem::_priorModemTemp = getModemChipTemperature();
-    MS_DBG(F("CURRENT Modem Chip Temperature:"), loggerModem::_priorModemTemp);
+    if (_pollModemMetaData & MODEM_TEMPERATURE_ENABLE_BITMASK) {
+        loggerModem::_priorModemTemp = getModemChipTemperature();
+        MS_DBG(F("CURRENT Modem Chip Temperature:"),
+               loggerModem::_priorModemTemp);
+    }
 
     return success;
 }
 
+
+bool loggerModem::getModemSignalAndBattery(int16_t& rssi, int16_t& percent,
+                                           uint8_t& chargeState,
+                                           int8_t& batteryPercent,
+                                           uint16_t& milliVolts) {
+    bool success = getModemSignalQuality(rssi, percent);
+    success &= getModemBatteryStats(chargeState, batteryPercent, milliVolts);
+    return success;
+}
+
+
+// Everything is polled until the first choice is made
+void loggerModem::enableMetadataPolling(uint8_t pollingBitmask) {
+    if (!_metadataPollingSet) _pollModemMetaData = 0;
+    _metadataPollingSet = true;
+    _pollModemMetaData |= pollingBitmask;
+}
+void loggerModem::disableMetadataPolling(uint8_t pollingBitmask) {
+    _metadataPollingSet = true;
+    _pollModemMetaData &= ~pollingBitmask;
+}
+
 float loggerModem::getModemRSSI() {
     float retVal = loggerModem::_priorRSSI;
     // MS_DBG(F("PRIOR RSSI:"), retVal);
@@ -398,6 +1078,33 @@ float loggerModem::getModemTemperature() {
     // MS_DBG(F("PRIOR Modem Chip Temperature:"), retVal);
     return retVal;
 }
+float loggerModem::getModemWakeTime() {
+    return loggerModem::_priorPhaseTime[MODEM_PHASE_WAKE];
+}
+float loggerModem::getModemWakeMedian() {
+    return getPhaseMedian(MODEM_PHASE_WAKE);
+}
+float loggerModem::getModemRegistrationTime() {
+    return loggerModem::_priorPhaseTime[MODEM_PHASE_REGISTRATION];
+}
+float loggerModem::getModemRegistrationMedian() {
+    return getPhaseMedian(MODEM_PHASE_REGISTRATION);
+}
+float loggerModem::getModemAttachTime() {
+    return loggerModem::_priorPhaseTime[MODEM_PHASE_ATTACH];
+}
+float loggerModem::getModemAttachMedian() {
+    return getPhaseMedian(MODEM_PHASE_ATTACH);
+}
+float loggerModem::getModemSocketTime() {
+    return loggerModem::_priorPhaseTime[MODEM_PHASE_SOCKET];
+}
+float loggerModem::getModemSocketMedian() {
+    return getPhaseMedian(MODEM_PHASE_SOCKET);
+}
+float loggerModem::getModemHardResets() {
+    return loggerModem::_priorHardResets;
+}
 // template <class Derived, typename modemType, typename modemClientType>
 // float loggerModem::getModemActivationDuration()
 // {
@@ -411,6 +1118,147 @@ float loggerModem::getModemTemperature() {
 //     return retVal;
 // }
 
+
+void loggerModem::recordPhase(modemPhase phase) {
+    uint32_t now = millis();
+    if (_recordTiming) recordPhaseTime(phase, now - _telemetryStart);
+    _telemetryStart = now;
+}
+void loggerModem::recordPhaseTime(modemPhase phase, uint32_t time_ms) {
+    addToHistogram(_telemetry.phaseCounts[phase], MODEM_HISTOGRAM_BUCKETS,
+                   getHistogramBucket(time_ms));
+    _priorPhaseTime[phase] = static_cast<float>(time_ms) / 1000;
+    MS_DBG(F("Connection phase"), phase, F("took"), time_ms, F("ms"));
+}
+void loggerModem::recordPhaseFailure(modemPhase phase) {
+    addToHistogram(_telemetry.phaseFailures, MODEM_NUM_PHASES, phase);
+    _priorPhaseTime[phase] = -9999;
+}
+
+
+modemTelemetry loggerModem::getModemTelemetry(void) {
+    loadModemTelemetry();
+    return _telemetry;
+}
+void loggerModem::resetModemTelemetry(void) {
+    memset(&_telemetry, 0, sizeof(_telemetry));
+    _telemetryLoaded  = true;
+    _telemetryChanged = true;
+    // Don't wait for the hour to turn over to clear the saved copy too
+    saveModemTelemetry(true);
+}
+
+
+float loggerModem::getPhaseMedian(modemPhase phase) {
+    loadModemTelemetry();
+    const uint16_t* counts = _telemetry.phaseCounts[phase];
+    uint32_t        total  = 0;
+    for (uint8_t i = 0; i < MODEM_HISTOGRAM_BUCKETS; i++) total += counts[i];
+    if (total == 0) return -9999;
+
+    uint8_t  bucket = 0;
+    uint32_t below  = counts[0];
+    while (below * 2 < total) below += counts[++bucket];
+    // The last bucket has no upper edge; give its lower edge instead
+    if (bucket == MODEM_HISTOGRAM_BUCKETS - 1) bucket--;
+
+    uint32_t edge = MODEM_HISTOGRAM_FIRST_MS;
+    edge <<= bucket;
+    return static_cast<float>(edge) / 1000;
+}
+
+
+uint8_t loggerModem::getHistogramBucket(uint32_t time_ms) {
+    uint8_t  bucket = 0;
+    uint32_t edge   = MODEM_HISTOGRAM_FIRST_MS;
+    while (bucket < MODEM_HISTOGRAM_BUCKETS - 1 && time_ms >= edge) {
+        bucket++;
+        edge *= 2;
+    }
+    return bucket;
+}
+void loggerModem::addToHistogram(uint16_t* counts, uint8_t numCounts,
+                                 uint8_t index) {
+    loadModemTelemetry();
+    if (counts[index] == 0xFFFF) {
+        for (uint8_t i = 0; i < numCounts; i++) counts[i] /= 2;
+    }
+    counts[index]++;
+    _telemetryChanged = true;
+}
+
+void loggerModem::recordConnectionTime(uint32_t time_ms) {
+    loadModemTelemetry();
+    uint32_t tenths = time_ms / 100;
+    _telemetry.recentConnections[_telemetry.nextRecentConnection] =
+        tenths > 0xFFFF ? 0xFFFF : tenths;
+    _telemetry.nextRecentConnection = (_telemetry.nextRecentConnection + 1) %
+        MS_MODEM_RECENT_CONNECTIONS;
+    if (_telemetry.numRecentConnections < MS_MODEM_RECENT_CONNECTIONS) {
+        _telemetry.numRecentConnections++;
+    }
+    _telemetry.connectFailures = 0;
+    _telemetryChanged          = true;
+}
+
+
+void loggerModem::recordSignalResult(int16_t rssi, bool success) {
+    loadModemTelemetry();
+    uint8_t band = getSignalBand(rssi);
+    if (_telemetry.signalBandAttempts[band] >= MS_MODEM_SIGNAL_STATS_WINDOW) {
+        // Forget the older attempts little by little
+        _telemetry.signalBandAttempts[band] /= 2;
+        _telemetry.signalBandSuccesses[band] /= 2;
+    }
+    _telemetry.signalBandAttempts[band]++;
+    if (success) _telemetry.signalBandSuccesses[band]++;
+    _telemetryChanged = true;
+    MS_DBG(F("Publishing at"), rssi, F("dBm"),
+           success ? F("worked;") : F("failed;"),
+           _telemetry.signalBandSuccesses[band], F("of"),
+           _telemetry.signalBandAttempts[band],
+           F("recent attempts in the band worked"));
+}
+int8_t loggerModem::getSignalSuccessPercent(int16_t rssi) {
+    loadModemTelemetry();
+    uint8_t  band     = getSignalBand(rssi);
+    uint16_t attempts = _telemetry.signalBandAttempts[band];
+    if (attempts < MODEM_SIGNAL_MIN_ATTEMPTS) return -1;
+    return static_cast<uint32_t>(_telemetry.signalBandSuccesses[band]) * 100 /
+        attempts;
+}
+uint8_t loggerModem::getSignalBand(int16_t rssi) {
+    // 0 is what the modems give for no signal at all
+    if (rssi == 0 || rssi < -105) return 0;
+    uint8_t band = (rssi + 115) / 10;
+    return band < MODEM_SIGNAL_BANDS ? band : MODEM_SIGNAL_BANDS - 1;
+}
+
+
+void loggerModem::loadModemTelemetry(void) {
+    if (_telemetryLoaded) return;
+    _telemetryLoaded = true;
+#if defined(MS_MODEM_TELEMETRY_EEPROM_ADDRESS)
+    if (PersistentStore::load(MS_MODEM_TELEMETRY_EEPROM_ADDRESS, &_telemetry,
+                              sizeof(_telemetry), MS_MODEM_TELEMETRY_VERSION)) {
+        return;
+    }
+#endif
+    memset(&_telemetry, 0, sizeof(_telemetry));
+}
+void loggerModem::saveModemTelemetry(bool force) {
+#if defined(MS_MODEM_TELEMETRY_EEPROM_ADDRESS)
+    // Save at most once an hour to spare the EEPROM
+    uint32_t hour = Logger::markedEpochTime / 3600;
+    if (!force && (!_telemetryChanged || hour == _telemetrySavedHour)) return;
+    PersistentStore::save(MS_MODEM_TELEMETRY_EEPROM_ADDRESS, &_telemetry,
+                          sizeof(_telemetry), MS_MODEM_TELEMETRY_VERSION);
+    _telemetryChanged   = false;
+    _telemetrySavedHour = hour;
+#endif
+}
+
+
 // Helper to get approximate RSSI from CSQ (assuming no noise)
 int16_t loggerModem::getRSSIFromCSQ(int16_t csq) {
     int16_t CSQs[33]  = {0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10,
@@ -449,6 +1297,22 @@ int16_t loggerModem::getPctFromRSSI(int16_t rssi) {
 }
 
 
+void loggerModem::setSNTPClient(SNTPClient* sntp) {
+    _sntpClient = sntp;
+}
+uint32_t loggerModem::getNetworkTime(void) {
+    if (_sntpClient != NULL && _sntpClient->sync()) {
+        // Round to the nearest second rather than wait for the next one
+        uint32_t now = _sntpClient->getUnixTime();
+        return _sntpClient->getMillis() >= 500 ? now + 1 : now;
+    }
+    if (_sntpClient != NULL) {
+        MS_DBG(F("No time server answered; asking NIST instead"));
+    }
+    return getNISTTime();
+}
+
+
 uint32_t loggerModem::parseNISTBytes(byte nistBytes[4]) {
     // Response is returned as 32-bit number as soon as connection is made
     // Connection is then immediately closed, so there is no need to close it
@@ -478,6 +1342,20 @@ uint32_t loggerModem::parseNISTBytes(byte nistBytes[4]) {
 }
 
 
+// NIST clearly specifies that its servers must not be contacted more than once
+// every 4 seconds:  https://tf.nist.gov/tf-cgi/servers.cgi
+bool loggerModem::startNISTRequest(void) {
+    uint32_t sinceLast = millis() - _lastNISTrequest;
+    if (_lastNISTrequest != 0 && sinceLast < 4000L) {
+        MS_DBG(F("NIST was contacted"), sinceLast,
+               F("ms ago; not contacting it again yet"));
+        return false;
+    }
+    _lastNISTrequest = millis();
+    return true;
+}
+
+
 /***
 NOTE:  These times are for raw cellular chips they do no necessarily
 apply to assembled break-out boards or modules
@@ -30,10 +30,206 @@
 #define MS_DEBUGGING_STD "LoggerModem"
 #endif
 
+/**
+ * @def MS_MODEM_POLL_INTERVAL_MS
+ * @brief The minimum time between repeated checks on the modem while
+ * waiting for it to respond, register, or connect.
+ *
+ * This keeps loggerModem::poll() from flooding the modem with AT commands
+ * when it is called in a tight loop.  This can be changed by setting the
+ * build flag MS_MODEM_POLL_INTERVAL_MS when compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_MODEM_POLL_INTERVAL_MS
+#define MS_MODEM_POLL_INTERVAL_MS 250
+#endif
+
+/**
+ * @def MS_MODEM_TELEMETRY_EEPROM_ADDRESS
+ * @brief The EEPROM address for the modem's connection timing histograms.
+ *
+ * The histograms are only saved to EEPROM, so they survive resets, if this is
+ * defined.  They take PersistentStore::getBlockSize(sizeof(modemTelemetry))
+ * bytes.
+ *
+ * This can be set by setting the build flag MS_MODEM_TELEMETRY_EEPROM_ADDRESS
+ * when compiling.
+ *
+ * @ingroup the_modems
+ */
+
+/**
+ * @def MS_MODEM_NETWORK_EEPROM_ADDRESS
+ * @brief The EEPROM address for the network the modem last registered on.
+ *
+ * The network is only saved to EEPROM, so it survives resets, if this is
+ * defined.  It takes PersistentStore::getBlockSize(sizeof(modemNetwork))
+ * bytes.  See loggerModem::setFastRegistration().
+ *
+ * This can be set by setting the build flag MS_MODEM_NETWORK_EEPROM_ADDRESS
+ * when compiling.
+ *
+ * @ingroup the_modems
+ */
+
+/**
+ * @def MS_MODEM_TARGETED_SEARCH_MS
+ * @brief The longest time in milliseconds to wait for a modem to register on
+ * the cached network before going back to automatic network selection.
+ *
+ * See loggerModem::setFastRegistration().  This can be changed by setting the
+ * build flag MS_MODEM_TARGETED_SEARCH_MS when compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_MODEM_TARGETED_SEARCH_MS
+#define MS_MODEM_TARGETED_SEARCH_MS 20000L
+#endif
+
+/**
+ * @def MS_MODEM_TARGET_BAUD
+ * @brief The serial baud rate to switch a modem to during setup.
+ *
+ * This is 115200, which every modem and nearly every board wiring handles,
+ * or 57600 on slower AVR boards like the Mayfly, which can't make 115200
+ * exactly.  Faster rates save time on long transfers, but depend on the
+ * board, the wiring, and the modem; a SAMD board can be set to 460800 if the
+ * modem keeps up.  See loggerModem::setBaudNegotiation().  This can be
+ * changed by setting the build flag MS_MODEM_TARGET_BAUD when compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_MODEM_TARGET_BAUD
+#if defined(ARDUINO_ARCH_AVR) && F_CPU < 16000000L
+#define MS_MODEM_TARGET_BAUD 57600L
+#else
+#define MS_MODEM_TARGET_BAUD 115200L
+#endif
+#endif
+
+/**
+ * @def MS_MODEM_BAUD_EEPROM_ADDRESS
+ * @brief The EEPROM address for the serial baud rate the modem was switched
+ * to.
+ *
+ * The rate is only saved to EEPROM if this is set to an address; the default
+ * of -1 doesn't save it.  With it saved, the serial port is opened at that
+ * rate after a reset, instead of looking for the modem at each rate.  It takes
+ * PersistentStore::getBlockSize(4) bytes, and is only written when the rate
+ * changes.
+ *
+ * This can be set by setting the build flag MS_MODEM_BAUD_EEPROM_ADDRESS when
+ * compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_MODEM_BAUD_EEPROM_ADDRESS
+#define MS_MODEM_BAUD_EEPROM_ADDRESS -1
+#endif
+
+/**
+ * @def MS_MODEM_RECENT_CONNECTIONS
+ * @brief The number of recent connection times kept to work out adaptive
+ * connection timeouts.
+ *
+ * See loggerModem::setAdaptiveTimeout().  This can be changed by setting the
+ * build flag MS_MODEM_RECENT_CONNECTIONS when compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_MODEM_RECENT_CONNECTIONS
+#define MS_MODEM_RECENT_CONNECTIONS 16
+#endif
+
+/**
+ * @def MS_MODEM_TIMEOUT_PERCENTILE
+ * @brief The percentile of the recent connection times that an adaptive
+ * connection timeout is based on.
+ *
+ * The timeout is twice this percentile.  This can be changed by setting the
+ * build flag MS_MODEM_TIMEOUT_PERCENTILE when compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_MODEM_TIMEOUT_PERCENTILE
+#define MS_MODEM_TIMEOUT_PERCENTILE 90
+#endif
+
+/**
+ * @def MS_MODEM_MIN_TIMEOUT_MS
+ * @brief The shortest adaptive connection timeout, in milliseconds.
+ *
+ * This can be changed by setting the build flag MS_MODEM_MIN_TIMEOUT_MS when
+ * compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_MODEM_MIN_TIMEOUT_MS
+#define MS_MODEM_MIN_TIMEOUT_MS 15000L
+#endif
+
+/**
+ * @def MS_MODEM_MAX_TIMEOUT_MS
+ * @brief The longest adaptive connection timeout, in milliseconds, after
+ * backing off from failed connections.
+ *
+ * This can be changed by setting the build flag MS_MODEM_MAX_TIMEOUT_MS when
+ * compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_MODEM_MAX_TIMEOUT_MS
+#define MS_MODEM_MAX_TIMEOUT_MS 180000L
+#endif
+
+/**
+ * @brief The number of buckets in each modem timing histogram.
+ *
+ * The first bucket holds times under #MODEM_HISTOGRAM_FIRST_MS, each bucket
+ * after it is twice as wide as the one before, and the last holds everything
+ * longer.
+ *
+ * @ingroup the_modems
+ */
+#define MODEM_HISTOGRAM_BUCKETS 10
+/**
+ * @brief The upper edge of the first bucket of each modem timing histogram,
+ * in milliseconds.
+ *
+ * @ingroup the_modems
+ */
+#define MODEM_HISTOGRAM_FIRST_MS 250
+
+/**
+ * @def MS_MODEM_SIGNAL_STATS_WINDOW
+ * @brief The number of publishing attempts in a signal band after which the
+ * band's counts are halved, so its success rate follows recent attempts.
+ *
+ * This can be changed by setting the build flag MS_MODEM_SIGNAL_STATS_WINDOW
+ * when compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_MODEM_SIGNAL_STATS_WINDOW
+#define MS_MODEM_SIGNAL_STATS_WINDOW 32
+#endif
+/**
+ * @brief The number of RSSI bands publishing success is counted in.
+ *
+ * The first band is everything under -105 dBm (and no signal at all), each
+ * band after it is 10 dBm wide, and the last is -65 dBm and up.
+ *
+ * @ingroup the_modems
+ */
+#define MODEM_SIGNAL_BANDS 6
+
 // Included Dependencies
 #include "ModSensorDebugger.h"
 #undef MS_DEBUGGING_STD
 #include "VariableBase.h"
+#include "PersistentStore.h"
+#include "SNTPClient.h"
 #include <Arduino.h>
 
 
@@ -271,9 +467,210 @@
 #define MODEM_POWERED_DEFAULT_CODE "modemPoweredSec"
 /**@}*/
 #endif
+
+/**
+ * @anchor modem_phase_time
+ * @name Modem Connection Phase Times
+ * The time a modem-like device took for each phase of its last connection,
+ * or the median time over all of the connections in its histograms.
+ *
+ * {{ @ref Modem_WakeTime::Modem_WakeTime }}
+ * {{ @ref Modem_RegistrationTime::Modem_RegistrationTime }}
+ * {{ @ref Modem_AttachTime::Modem_AttachTime }}
+ * {{ @ref Modem_SocketTime::Modem_SocketTime }}
+ */
+/**@{*/
+/// @brief Decimals places in string representation; phase times should have
+/// 3.
+#define MODEM_PHASE_TIME_RESOLUTION 3
+/// @brief Variable name in
+/// [ODM2 controlled vocabulary](http://vocabulary.odm2.org/variablename/);
+/// "timeElapsed"
+#define MODEM_PHASE_TIME_VAR_NAME "timeElapsed"
+/// @brief Variable unit name in
+/// [ODM2 controlled vocabulary](http://vocabulary.odm2.org/units/); "second"
+#define MODEM_PHASE_TIME_UNIT_NAME "second"
+/// @brief Default variable short code for the wake time; "modemWakeSec"
+#define MODEM_WAKE_TIME_DEFAULT_CODE "modemWakeSec"
+/// @brief Default variable short code for the median wake time;
+/// "modemWakeMedianSec"
+#define MODEM_WAKE_MEDIAN_DEFAULT_CODE "modemWakeMedianSec"
+/// @brief Default variable short code for the registration time;
+/// "modemRegisterSec"
+#define MODEM_REGISTRATION_TIME_DEFAULT_CODE "modemRegisterSec"
+/// @brief Default variable short code for the median registration time;
+/// "modemRegisterMedianSec"
+#define MODEM_REGISTRATION_MEDIAN_DEFAULT_CODE "modemRegisterMedianSec"
+/// @brief Default variable short code for the data attach time;
+/// "modemAttachSec"
+#define MODEM_ATTACH_TIME_DEFAULT_CODE "modemAttachSec"
+/// @brief Default variable short code for the median data attach time;
+/// "modemAttachMedianSec"
+#define MODEM_ATTACH_MEDIAN_DEFAULT_CODE "modemAttachMedianSec"
+/// @brief Default variable short code for the socket connect time;
+/// "modemSocketSec"
+#define MODEM_SOCKET_TIME_DEFAULT_CODE "modemSocketSec"
+/// @brief Default variable short code for the median socket connect time;
+/// "modemSocketMedianSec"
+#define MODEM_SOCKET_MEDIAN_DEFAULT_CODE "modemSocketMedianSec"
+/**@}*/
+
+/**
+ * @anchor modem_hard_resets
+ * @name Modem Hard Resets
+ * The number of hard resets a modem-like device needed before it responded
+ * on its last wake.
+ *
+ * {{ @ref Modem_HardResets::Modem_HardResets }}
+ */
+/**@{*/
+/// @brief Decimals places in string representation; resets should have 0.
+#define MODEM_HARD_RESETS_RESOLUTION 0
+/// @brief Variable name in
+/// [ODM2 controlled vocabulary](http://vocabulary.odm2.org/variablename/);
+/// "counter"
+#define MODEM_HARD_RESETS_VAR_NAME "counter"
+/// @brief Variable unit name in
+/// [ODM2 controlled vocabulary](http://vocabulary.odm2.org/units/); "count"
+#define MODEM_HARD_RESETS_UNIT_NAME "count"
+/// @brief Default variable short code; "modemResets"
+#define MODEM_HARD_RESETS_DEFAULT_CODE "modemResets"
+/**@}*/
+/**@}*/
+
+/**
+ * @anchor modem_metadata_bitmasks
+ * @name Modem Metadata Bitmasks
+ * The bits for each kind of metadata, for
+ * loggerModem::enableMetadataPolling().
+ *
+ * @ingroup the_modems
+ */
+/**@{*/
+/// @brief Bit for the received signal strength indication
+#define MODEM_RSSI_ENABLE_BITMASK 0b00000001
+/// @brief Bit for the signal strength in percent
+#define MODEM_PERCENT_SIGNAL_ENABLE_BITMASK 0b00000010
+/// @brief Bit for the battery charge state
+#define MODEM_BATTERY_STATE_ENABLE_BITMASK 0b00000100
+/// @brief Bit for the battery charge in percent
+#define MODEM_BATTERY_PERCENT_ENABLE_BITMASK 0b00001000
+/// @brief Bit for the battery voltage
+#define MODEM_BATTERY_VOLTAGE_ENABLE_BITMASK 0b00010000
+/// @brief Bit for the chip temperature
+#define MODEM_TEMPERATURE_ENABLE_BITMASK 0b00100000
+/// @brief Both of the signal quality bits
+#define MODEM_SIGNAL_ENABLE_BITMASK 0b00000011
+/// @brief All three of the battery bits
+#define MODEM_BATTERY_ENABLE_BITMASK 0b00011100
+/// @brief All of the metadata bits
+#define MODEM_ALL_ENABLE_BITMASK 0b00111111
 /**@}*/
 
 
+/**
+ * @brief The steps a modem goes through between off and connected to the
+ * internet, in order.
+ *
+ * @ingroup the_modems
+ */
+typedef enum modemState {
+    MODEM_OFF = 0,      ///< Not (known to be) awake
+    MODEM_POWERING,     ///< Powered, waiting out the warm-up time
+    MODEM_WAKING,       ///< Woken, waiting for a response to AT commands
+    MODEM_AT_READY,     ///< Responding to AT commands and initialized
+    MODEM_REGISTERING,  ///< Waiting for network registration
+    MODEM_ATTACHED,     ///< Registered, waiting for the data connection
+    MODEM_CONNECTED,    ///< Connected to the internet
+    MODEM_FAILED        ///< Gave up on the last wake or connection
+} modemState;
+
+/**
+ * @brief The timed phases of a modem connection.
+ *
+ * @ingroup the_modems
+ */
+typedef enum modemPhase {
+    MODEM_PHASE_WAKE = 0,      ///< From the start of a wake to AT-OK
+    MODEM_PHASE_REGISTRATION,  ///< From AT-OK to network registration
+    MODEM_PHASE_ATTACH,        ///< From registration to a data connection
+    MODEM_PHASE_SOCKET,        ///< Opening a socket to a publisher's server
+    MODEM_NUM_PHASES           ///< The number of phases
+} modemPhase;
+
+/**
+ * @brief The histograms of the modem connection phase times.
+ *
+ * @ingroup the_modems
+ */
+typedef struct modemTelemetry {
+    /**
+     * @brief The number of times each phase took a time in each bucket; see
+     * #MODEM_HISTOGRAM_BUCKETS.
+     */
+    uint16_t phaseCounts[MODEM_NUM_PHASES][MODEM_HISTOGRAM_BUCKETS];
+    /**
+     * @brief The number of times each phase was given up on.
+     */
+    uint16_t phaseFailures[MODEM_NUM_PHASES];
+    /**
+     * @brief The number of wakes that needed 0, 1, and 2 hard resets.
+     */
+    uint16_t wakeResets[3];
+    /**
+     * @brief The most recent times from AT-OK to a data connection, in
+     * tenths of a second, oldest first once full.
+     */
+    uint16_t recentConnections[MS_MODEM_RECENT_CONNECTIONS];
+    /**
+     * @brief The number of recent connection times kept so far.
+     */
+    uint8_t numRecentConnections;
+    /**
+     * @brief The index of the next recent connection time to replace.
+     */
+    uint8_t nextRecentConnection;
+    /**
+     * @brief The number of connections given up on since the last one that
+     * worked.
+     */
+    uint8_t connectFailures;
+    /**
+     * @brief The number of publishing attempts in each signal band; see
+     * #MODEM_SIGNAL_BANDS.
+     */
+    uint16_t signalBandAttempts[MODEM_SIGNAL_BANDS];
+    /**
+     * @brief The number of those attempts that every publisher got an answer
+     * to.
+     */
+    uint16_t signalBandSuccesses[MODEM_SIGNAL_BANDS];
+} modemTelemetry;
+
+/**
+ * @brief The network a cellular modem last registered on, for registering on
+ * it again without a full search.
+ *
+ * @ingroup the_modems
+ */
+typedef struct modemNetwork {
+    /**
+     * @brief The operator's numeric code (MCC and MNC), as `AT+COPS` gives
+     * it; 0 if there is no network cached.
+     */
+    uint32_t operatorCode;
+    /**
+     * @brief The access technology, as the modem's `AT+COPS` gives it; ie, 0
+     * for GSM, 7 or 8 for LTE-M, 9 for NB-IoT.
+     */
+    uint8_t accessTech;
+    /**
+     * @brief The LTE band the modem was on; 0 if unknown.
+     */
+    uint8_t band;
+} modemNetwork;
+
+
 /* ===========================================================================
  * Functions for the modem class
  * This is basically a wrapper for TinyGsm with power control added
@@ -375,7 +772,8 @@ class loggerModem {
      * commands, and then re-runs the TinyGSM init() if necessary.  If the modem
      * fails to respond, this attempts a "hard" pin reset if possible.
      *
-     * For most modules, this function is created by the #MS_MODEM_WAKE macro.
+     * For most modules, this function is created by the #MS_MODEM_WAKE macro,
+     * which runs modemWakeBegin() and then poll() until it is done.
      *
      * @return **bool** True if the modem is responsive and ready for action.
      */
@@ -438,6 +836,230 @@ class loggerModem {
      */
     virtual bool modemHardReset(void);
 
+    /**
+     * @anchor modem_state_functions
+     * @name Functions to step the modem along without waiting for it
+     *
+     * modemWake() and connectInternet() wait for the modem, but the same steps
+     * can be taken a bit at a time:  start with modemWakeBegin() or
+     * connectInternetBegin() and then call poll() whenever convenient until it
+     * returns true.  In between, the logger is free to do other work, like
+     * measuring sensors, while the modem warms up and registers.
+     *
+     * Every wait has a time limit, so the modem always ends up either where
+     * it was asked to be or at #MODEM_FAILED.
+     */
+    /**@{*/
+    /**
+     * @brief Start waking the modem, without waiting for it.
+     *
+     * A wake already in progress is carried on.  A modem that is already
+     * awake is checked again for a response to AT commands.
+     */
+    void modemWakeBegin(void);
+    /**
+     * @brief Start waking the modem, if necessary, and connecting to the
+     * internet, without waiting for it.
+     *
+     * A connection already in progress is carried on.  An existing connection
+     * is checked again.
+     *
+     * @param maxConnectionTime The maximum length of time in milliseconds to
+     * wait for network registration and data connection, once the modem is
+     * awake.  Defaults to 50,000ms (50s).
+     */
+    void connectInternetBegin(uint32_t maxConnectionTime = 50000L);
+    /**
+     * @brief Set whether to work out the connection timeout from the recent
+     * connections rather than use the time given to connectInternet().
+     *
+     * Once a few connections have been timed, the timeout is twice the
+     * #MS_MODEM_TIMEOUT_PERCENTILE of the last #MS_MODEM_RECENT_CONNECTIONS
+     * times from AT-OK to a data connection, but no less than
+     * #MS_MODEM_MIN_TIMEOUT_MS.  A site with good coverage gives up quickly
+     * when a connection isn't going to happen.  Each connection given up on in
+     * a row doubles the timeout, up to #MS_MODEM_MAX_TIMEOUT_MS, so a marginal
+     * site gets a longer window to connect.
+     *
+     * The connection times are kept with the connection phase histograms, and
+     * saved with them if #MS_MODEM_TELEMETRY_EEPROM_ADDRESS is defined.
+     *
+     * @param adaptive True to adapt the timeout; false to use the time given
+     * to connectInternet().
+     */
+    void setAdaptiveTimeout(bool adaptive);
+    /**
+     * @brief Get the connection timeout that will be used.
+     *
+     * @param maxConnectionTime The time given to connectInternet(), used
+     * until there are enough recent connections to go on, or always if the
+     * timeout isn't adaptive.
+     * @return **uint32_t** The timeout in milliseconds
+     */
+    uint32_t getConnectionTimeout(uint32_t maxConnectionTime = 50000L);
+    /**
+     * @brief Take the next step towards the state asked for with
+     * modemWakeBegin() or connectInternetBegin().
+     *
+     * This never waits for the modem longer than the time needed for a single
+     * command (and the reset pulse, if a reset is needed).
+     *
+     * @return **bool** True once the modem has reached the state asked for or
+     * given up trying.
+     */
+    bool poll(void);
+    /**
+     * @brief Wait until the modem is due to be checked again, if the last
+     * call to poll() found nothing new.
+     *
+     * Use this between calls to poll() when there's nothing else to do, so
+     * the processor isn't kept spinning.
+     */
+    void waitForPoll(void);
+    /**
+     * @brief Get the current step of the modem's wake and connection.
+     *
+     * @return **modemState** The current state
+     */
+    modemState getModemState(void);
+    /**@}*/
+
+    /**
+     * @anchor modem_power_save_functions
+     * @name Functions for LTE-M/NB-IoT power saving
+     *
+     * With power saving mode (PSM), the modem stays registered on the network
+     * while it sleeps, so it can send again as soon as it wakes, without a
+     * new attach.  The network decides whether to allow PSM and which timers
+     * to use; the requested timers are only a request.
+     *
+     * While PSM is granted, the modem is not powered off or disconnected
+     * between uses.  Once its active time (T3324) runs out without traffic,
+     * it drops into PSM on its own.  Waking it with its usual wake function
+     * brings it out of PSM.  If the network doesn't grant PSM, the modem is
+     * shut down between uses as usual.
+     *
+     * These are only used by the modems that support them:  the SIM7000,
+     * BG96, and u-blox R4 based modules and the Digi XBee3 LTE modules.
+     * Others ignore the settings.
+     */
+    /**@{*/
+    /**
+     * @brief Request power saving mode (PSM) with the given timers.
+     *
+     * The timers are rounded up to the nearest ones that can be requested.
+     * This must be called before the modem is set up or woken to take effect.
+     *
+     * @param periodicTAU_s The requested periodic tracking area update time
+     * (T3412) in seconds; how long the modem may stay in PSM before it must
+     * check in with the network.  Use 0 to turn PSM off.
+     * @param activeTime_s The requested active time (T3324) in seconds; how
+     * long the modem stays reachable after it last sent something before it
+     * drops into PSM.  Defaults to 60s.
+     */
+    void setPowerSaveMode(uint32_t periodicTAU_s, uint32_t activeTime_s = 60);
+    /**
+     * @brief Request extended discontinuous reception (eDRX) with the given
+     * paging cycle.
+     *
+     * The cycle is rounded down to the nearest LTE-M cycle, between 5.12s and
+     * 10485.76s.  This must be called before the modem is set up or woken to
+     * take effect.
+     *
+     * @param cycle_ms The requested eDRX cycle in milliseconds.  Use 0 to
+     * turn eDRX off.
+     */
+    void setEDRX(uint32_t cycle_ms);
+    /**
+     * @brief Check if the network granted PSM at the last connection.
+     *
+     * @return **bool** True if the modem is using PSM.
+     */
+    bool isPowerSaveGranted(void);
+    /**
+     * @brief Get the periodic TAU time (T3412) granted by the network.
+     *
+     * @return **uint32_t** The granted T3412 in seconds, or 0 if PSM wasn't
+     * granted.
+     */
+    uint32_t getGrantedTAU(void);
+    /**
+     * @brief Get the active time (T3324) granted by the network.
+     *
+     * @return **uint32_t** The granted T3324 in seconds
+     */
+    uint32_t getGrantedActiveTime(void);
+    /**@}*/
+
+    /**
+     * @anchor modem_fast_registration_functions
+     * @name Functions for faster network registration
+     *
+     * A cellular modem that doesn't know where it is searches every band of
+     * every access technology it supports for a network, which can take
+     * minutes.  With fast registration, the operator, access technology, and
+     * band of the last registration are kept, in EEPROM if
+     * #MS_MODEM_NETWORK_EEPROM_ADDRESS is defined.  At the next connection,
+     * the modem is locked to that band and asked for that operator and
+     * access technology first; the bands are put back as they were once it
+     * answers.  If it doesn't register on them within
+     * #MS_MODEM_TARGETED_SEARCH_MS, the cached network is forgotten and the
+     * modem goes back to searching on its own.  The search is checked on each
+     * poll rather than waited out.  The u-blox R4 modules only take a new band
+     * mask when they reboot, so they're only asked for the operator.
+     *
+     * This is only used by the modems that implement the network selection
+     * hooks:  the SIM7000, BG96, u-blox R4, and Sequans Monarch based
+     * modules.  Others ignore the setting.
+     */
+    /**@{*/
+    /**
+     * @brief Turn fast registration on or off.
+     *
+     * @param fastRegistration True to register on the last network first
+     */
+    void setFastRegistration(bool fastRegistration);
+    /**@}*/
+
+    /**
+     * @anchor modem_baud_functions
+     * @name Functions for the serial baud rate
+     *
+     * Most sketches open the modem's serial port at 9600 or 115200 baud and
+     * leave it there, so sending a large payload can take longer over the
+     * serial port than over the air.  With baud negotiation, modemSetup()
+     * switches the modem and the serial port to a faster rate, checks that
+     * the modem still answers, and has the modem save the rate.  If it
+     * doesn't answer at the new rate, both go back to the old one.  If the
+     * modem doesn't answer when it's woken for setup, ie, after a reset of
+     * the board but not the modem, it's looked for at each rate up to the
+     * target.
+     *
+     * This is only used by the modems that can change their rate:  the
+     * SIM7000, SIM800, BG96, ESP8266, and the XBee cellular (transparent
+     * mode) and WiFi modules.  Others stay at the rate the port was opened
+     * at.
+     */
+    /**@{*/
+    /**
+     * @brief Turn on baud negotiation during setup.
+     *
+     * @param modemSerial The hardware serial port the modem is on; it must
+     * be the port the modem's stream was constructed with
+     * @param currentBaud The rate the port was opened at
+     * @param targetBaud The rate to switch to; defaults to
+     * #MS_MODEM_TARGET_BAUD
+     */
+    void setBaudNegotiation(HardwareSerial* modemSerial, uint32_t currentBaud,
+                            uint32_t targetBaud = MS_MODEM_TARGET_BAUD);
+    /**
+     * @brief Get the rate the modem's serial port is at.
+     *
+     * @return **uint32_t** The rate in baud; 0 if baud negotiation is off
+     */
+    uint32_t getModemBaud(void);
+    /**@}*/
+
 
     /**
      * @anchor modem_pin_functions
@@ -499,6 +1121,10 @@ class loggerModem {
      * @return **bool** True if EPS or GPRS data connection has been
      * established.  False if the modem wasunresponsive, unable to register with
      * the cellular network, or unable to establish a EPS or GPRS connection.
+     *
+     * For most modules, this function is created by the
+     * #MS_MODEM_CONNECT_INTERNET macro, which runs connectInternetBegin() and
+     * then poll() until it is done.
      */
     virtual bool connectInternet(uint32_t maxConnectionTime = 50000L) = 0;
     /**
@@ -519,14 +1145,35 @@ class loggerModem {
      * @return **uint32_t** The number of seconds since Jan 1, 1970 IN UTC
      */
     virtual uint32_t getNISTTime(void) = 0;
-    /**@}*/
-
-
     /**
-     * @anchor modem_metadata_functions
-     * @name Modem metadata functions
-     * Functions to get metadata about modem functionality - using the modem
-     * like a sensor.
+     * @brief Attach an SNTP client to get the time with instead of NIST.
+     *
+     * @param sntp An SNTPClient, with a UDP instance that goes out over this
+     * modem's connection; NULL to go back to NIST.
+     */
+    void setSNTPClient(SNTPClient* sntp);
+    /**
+     * @brief Get the time with the attached SNTP client, falling back to NIST
+     * if there isn't one or no time server answers.
+     *
+     * SNTP gives the time to a fraction of a second, so this rounds it to the
+     * nearest whole second instead of cutting the fraction off.  That way the
+     * clock is set to within half a second, without waiting for the second to
+     * turn over.
+     *
+     * @note The return is the number of seconds since Jan 1, 1970 IN UTC
+     *
+     * @return **uint32_t** The number of seconds since Jan 1, 1970 IN UTC
+     */
+    uint32_t getNetworkTime(void);
+    /**@}*/
+
+
+    /**
+     * @anchor modem_metadata_functions
+     * @name Modem metadata functions
+     * Functions to get metadata about modem functionality - using the modem
+     * like a sensor.
      *
      * These functions will query the modem to get new values.
      *
@@ -570,16 +1217,67 @@ class loggerModem {
      * @return **float** The temperature in degrees Celsius
      */
     virtual float getModemChipTemperature(void) = 0;
+    /**
+     * @brief Query the modem for the signal quality and the battery
+     * information together and write the values to the supplied non-constant
+     * references.
+     *
+     * By default, this calls getModemSignalQuality() and
+     * getModemBatteryStats() one after the other.  Modems that can take
+     * several commands on one line override it to get both in a single
+     * exchange.
+     *
+     * @param rssi A reference to an int16_t which will be set with the received
+     * signal strength indicator
+     * @param percent A reference to an int16_t which will be set with the
+     * "percent" signal strength
+     * @param chargeState A reference to an uint8_t which will be set with the
+     * current charge state
+     * @param batteryPercent A reference to an int8_t which will be set with the
+     * current charge percent
+     * @param milliVolts A reference to an uint16_t which will be set with the
+     * current battery voltage in mV
+     * @return **bool** True indicates that the communication with the modem was
+     * successful and the values referenced by the pointers should be valid.
+     */
+    virtual bool getModemSignalAndBattery(int16_t& rssi, int16_t& percent,
+                                          uint8_t& chargeState,
+                                          int8_t& batteryPercent,
+                                          uint16_t& milliVolts);
 
     /**
      * @brief Query the modem for signal quality, battery, and temperature
      * information and store the values to the static internal variables.
      *
+     * Only the metadata enabled with enableMetadataPolling() is asked for.
+     * The values that aren't asked for are set to -9999.
+     *
      * @return **bool** True indicates that the communication with the modem was
      * successful and the values of the internal static variables should be
      * valid.
      */
     virtual bool updateModemMetadata(void);
+    /**
+     * @brief Add to the metadata to ask the modem for in
+     * updateModemMetadata().
+     *
+     * Each modem variable enables its own metadata when it's created, so
+     * nothing that isn't logged is ever asked for.  Until this or
+     * disableMetadataPolling() is first called, all of the metadata is asked
+     * for, so a program that reads the metadata without any modem variables
+     * still gets it.
+     *
+     * @param pollingBitmask The bits of the metadata to add; see
+     * @ref modem_metadata_bitmasks
+     */
+    void enableMetadataPolling(uint8_t pollingBitmask);
+    /**
+     * @brief Stop asking the modem for some of the metadata.
+     *
+     * @param pollingBitmask The bits of the metadata to remove; see
+     * @ref modem_metadata_bitmasks
+     */
+    void disableMetadataPolling(uint8_t pollingBitmask);
     /**@}*/
 
     /**
@@ -651,6 +1349,146 @@ class loggerModem {
     // static float getModemPoweredDuration();
     /**@}*/
 
+    /**
+     * @anchor modem_telemetry_functions
+     * @name Functions for the connection phase timing
+     *
+     * The time taken by each phase of every connection is counted in a
+     * histogram.  If #MS_MODEM_TELEMETRY_EEPROM_ADDRESS is defined, the
+     * histograms are saved to EEPROM, at most once an hour, when the modem is
+     * put to sleep, and carry on counting after a reset.
+     *
+     * The times from the last connection and the median times from the
+     * histograms can be logged with the Modem_WakeTime, Modem_RegistrationTime,
+     * Modem_AttachTime, Modem_SocketTime, and Modem_HardResets variables.
+     *
+     * @note Like the other modem metadata, these must be static so that the
+     * modem variables can call them.
+     */
+    /**@{*/
+    /**
+     * @brief Count a phase time in its histogram and keep it as the last time
+     * for that phase.
+     *
+     * The wake, registration, and attach phases are timed by the modem
+     * itself.  The socket phase is timed by the data publishers.
+     *
+     * @param phase The phase
+     * @param time_ms The time the phase took in milliseconds
+     */
+    static void recordPhaseTime(modemPhase phase, uint32_t time_ms);
+    /**
+     * @brief Count a phase that was given up on.
+     *
+     * @param phase The phase
+     */
+    static void recordPhaseFailure(modemPhase phase);
+    /**
+     * @brief Get a copy of the connection phase histograms.
+     *
+     * @return **modemTelemetry** The histograms
+     */
+    static modemTelemetry getModemTelemetry(void);
+    /**
+     * @brief Empty the connection phase histograms, in EEPROM as well.
+     */
+    static void resetModemTelemetry(void);
+    /**
+     * @brief Save the connection phase histograms to EEPROM, if they've
+     * changed and haven't been saved yet this hour.
+     *
+     * This is done whenever the modem is powered down.  A modem that stays
+     * connected is never powered down, so the logger also does this after
+     * each publishing cycle.
+     *
+     * @param force True to save them now even if they were already saved
+     * this hour.
+     */
+    static void saveModemTelemetry(bool force = false);
+    /**
+     * @brief Get the median time of a phase from its histogram.
+     *
+     * @param phase The phase
+     * @return **float** The upper edge of the histogram bucket that holds the
+     * median, in seconds, or the lower edge for the open-ended last bucket;
+     * -9999 if the phase has never been timed.
+     */
+    static float getPhaseMedian(modemPhase phase);
+    /**
+     * @brief Count a publishing attempt made at a given signal strength.
+     *
+     * @param rssi The RSSI in dBm when the attempt was made
+     * @param success True if the data got through
+     */
+    static void recordSignalResult(int16_t rssi, bool success);
+    /**
+     * @brief Get the recent publishing success rate for the signal band of a
+     * given signal strength.
+     *
+     * @param rssi The RSSI in dBm
+     * @return **int8_t** The percent of attempts in the band that got through;
+     * -1 if there have been too few attempts in the band to tell.
+     */
+    static int8_t getSignalSuccessPercent(int16_t rssi);
+
+    /**
+     * @brief Get the time from the start of the last wake to AT-OK.
+     *
+     * @return **float** The time in seconds
+     */
+    static float getModemWakeTime();
+    /**
+     * @brief Get the median time from the start of a wake to AT-OK.
+     *
+     * @return **float** The time in seconds
+     */
+    static float getModemWakeMedian();
+    /**
+     * @brief Get the time from AT-OK to network registration on the last
+     * connection.
+     *
+     * @return **float** The time in seconds
+     */
+    static float getModemRegistrationTime();
+    /**
+     * @brief Get the median time from AT-OK to network registration.
+     *
+     * @return **float** The time in seconds
+     */
+    static float getModemRegistrationMedian();
+    /**
+     * @brief Get the time from registration to the data connection (PDP
+     * context or APN attach) on the last connection.
+     *
+     * @return **float** The time in seconds
+     */
+    static float getModemAttachTime();
+    /**
+     * @brief Get the median time from registration to the data connection.
+     *
+     * @return **float** The time in seconds
+     */
+    static float getModemAttachMedian();
+    /**
+     * @brief Get the average time to open a socket in the last publish.
+     *
+     * @return **float** The time in seconds
+     */
+    static float getModemSocketTime();
+    /**
+     * @brief Get the median time to open a socket.
+     *
+     * @return **float** The time in seconds
+     */
+    static float getModemSocketMedian();
+    /**
+     * @brief Get the number of hard resets needed on the last wake.
+     *
+     * @return **float** The number of resets
+     */
+    static float getModemHardResets();
+    /**@}*/
+
  protected:
     /**
      * @anchor modem_signal_functions
@@ -703,6 +1541,18 @@ class loggerModem {
      * pullup) for all pins connected between the modem module and the mcu.
      */
     virtual void setModemPinModes(void);
+    /**
+     * @brief Finish waking the modem once it responds to AT commands, by
+     * running the setup or init.
+     */
+    void finishModemWake(void);
+    /**
+     * @brief After a check on the modem comes up empty, either space out the
+     * next check or give up if the wait has gone on too long.
+     *
+     * @param maxWait_ms The longest the current wait may take
+     */
+    void waitOrGiveUp(uint32_t maxWait_ms);
     /**@}*/
 
     /**
@@ -768,6 +1618,243 @@ class loggerModem {
      * @return **bool** True if the modem is already awake.
      */
     virtual bool isModemAwake(void) = 0;
+    /**
+     * @brief Check once whether the modem responds to AT commands.
+     *
+     * For most modules, this function is created by the #MS_MODEM_WAKE macro.
+     *
+     * @param timeout_ms The time to wait for a response
+     * @return **bool** True if the modem responded.
+     */
+    virtual bool modemTestAT(uint32_t timeout_ms) = 0;
+    /**
+     * @brief Clear out the modem buffer and re-run the TinyGSM init(),
+     * which turns off echo and checks the SIM card after a reset or power
+     * loss.
+     *
+     * For most modules, this function is created by the #MS_MODEM_WAKE macro.
+     *
+     * @return **bool** True if the init succeeded.
+     */
+    virtual bool modemInit(void) = 0;
+    /**
+     * @brief Check whether the modem is registered on the cellular network
+     * or joined to the WiFi network.
+     *
+     * For most modules, this function is created by the
+     * #MS_MODEM_CONNECT_INTERNET macro.
+     *
+     * @return **bool** True if the modem is on the network.
+     */
+    virtual bool isNetworkRegistered(void) = 0;
+    /**
+     * @brief Ask the modem to join the network, without waiting for it.
+     *
+     * For WiFi modems, this sends the network credentials.  Cellular modems
+     * register on their own, so this does nothing for them.
+     *
+     * For most modules, this function is created by the
+     * #MS_MODEM_CONNECT_INTERNET macro.
+     *
+     * @return **bool** True if the request was accepted.
+     */
+    virtual bool startNetworkAttach(void) = 0;
+    /**
+     * @brief Open the data connection once the modem is on the network.
+     *
+     * For cellular modems, this sets the APN and connects to GPRS (or EPS)
+     * using #MS_MODEM_SET_APN.  WiFi modems are connected as soon as they
+     * join the network, so this does nothing for them.
+     *
+     * For most modules, this function is created by the
+     * #MS_MODEM_CONNECT_INTERNET macro.
+     *
+     * @return **bool** True if the data connection was opened.
+     */
+    virtual bool startDataConnection(void) = 0;
+    /**@}*/
+
+    /**
+     * @anchor modem_power_save_helpers
+     * @name Helpers for power saving mode
+     */
+    /**@{*/
+    /**
+     * @brief Send the requested PSM and eDRX settings to the modem.
+     *
+     * This is run once the modem responds after any change to the settings
+     * or loss of power.  For the modems that support it, this function is
+     * created by the #MS_MODEM_POWER_SAVE macro.
+     *
+     * @return **bool** True if the modem accepted the settings; always true
+     * for modems without PSM.
+     */
+    virtual bool modemPowerSaveSetup(void);
+    /**
+     * @brief Ask the modem which PSM timers the network granted and store
+     * them.
+     *
+     * This is run after each network registration while PSM is requested.
+     * For the modems that support it, this function is created by the
+     * #MS_MODEM_POWER_SAVE macro.
+     *
+     * @return **bool** True if the timers could be read.
+     */
+    virtual bool readPowerSaveTimers(void);
+    /**
+     * @brief Parse the PSM timers out of the response to `AT+CEREG?` with
+     * result code 4 and store them.
+     *
+     * @param status The response, after the `+CEREG:`
+     * @return **bool** True if the response could be parsed
+     */
+    bool parsePowerSaveTimers(const char* status);
+    /**
+     * @brief Encode a time in seconds as a GPRS timer 3 (T3412 extended)
+     * value, rounding up.
+     *
+     * @param seconds The time in seconds
+     * @return **uint8_t** The timer value; 3 unit bits then 5 value bits
+     */
+    static uint8_t encodeT3412(uint32_t seconds);
+    /**
+     * @brief Encode a time in seconds as a GPRS timer 2 (T3324) value,
+     * rounding up.
+     *
+     * @param seconds The time in seconds
+     * @return **uint8_t** The timer value; 3 unit bits then 5 value bits
+     */
+    static uint8_t encodeT3324(uint32_t seconds);
+    /**
+     * @brief Encode an LTE-M eDRX cycle, rounding down.
+     *
+     * @param cycle_ms The cycle length in milliseconds
+     * @return **uint8_t** The 4 bit eDRX value
+     */
+    static uint8_t encodeEDRX(uint32_t cycle_ms);
+    /**
+     * @brief Write the lowest bits of a value as a string of '0's and '1's,
+     * as the PSM and eDRX commands take them.
+     *
+     * @param value The value to write
+     * @param nBits The number of bits to write
+     * @param bits A buffer of at least nBits + 1 characters for the result
+     */
+    static void timerToBits(uint8_t value, uint8_t nBits, char* bits);
+    /**@}*/
+
+    /**
+     * @anchor modem_network_selection_hooks
+     * @name Hooks for fast registration
+     *
+     * For the modems that support them, readNetworkSelection(),
+     * selectNetwork(), and selectAnyNetwork() are created by the
+     * #MS_MODEM_NETWORK_SELECTION macro, which uses `AT+COPS` for the
+     * operator and access technology and the modem's own band commands.
+     */
+    /**@{*/
+    /**
+     * @brief Ask the modem which operator, access technology, and band it's
+     * registered on.
+     *
+     * @param network The network to fill in
+     * @return **bool** True if the network could be read; always false for
+     * modems without fast registration.
+     */
+    virtual bool readNetworkSelection(modemNetwork& network);
+    /**
+     * @brief Lock the modem to a network's band, and start registering on
+     * its operator and access technology.
+     *
+     * This doesn't wait for the modem to register; the answer is read by
+     * checkNetworkSelection().
+     *
+     * @param network The network to register on
+     * @return **bool** True if the selection was started; always false for
+     * modems without fast registration.
+     */
+    virtual bool selectNetwork(const modemNetwork& network);
+    /**
+     * @brief Unlock the bands and start going back to automatic network
+     * selection, stopping a selection that hasn't answered.
+     *
+     * As with selectNetwork(), the answer is read by checkNetworkSelection().
+     *
+     * @return **bool** True if the modem took the settings; always true for
+     * modems without fast registration.
+     */
+    virtual bool selectAnyNetwork(void);
+    /**
+     * @brief Read the answer to a network selection, if there is one waiting.
+     *
+     * @return **int8_t** 0 if there's no answer yet, 1 if the modem
+     * registered, or anything else if it couldn't; always 1 for modems
+     * without fast registration.
+     */
+    virtual int8_t checkNetworkSelection(void);
+    /**
+     * @brief Start registering on the cached network, once per connection,
+     * falling back to automatic selection if it can't be started.
+     */
+    void selectCachedNetwork(void);
+    /**
+     * @brief Check on a network selection that's going, falling back to
+     * automatic selection if registering on the cached network failed or
+     * took longer than #MS_MODEM_TARGETED_SEARCH_MS.
+     *
+     * @return **bool** True if there's no selection still going.
+     */
+    bool finishNetworkSearch(void);
+    /**
+     * @brief Go back to automatic network selection and forget the cached
+     * network.
+     */
+    void searchAnyNetwork(void);
+    /**
+     * @brief Read the network the modem registered on and cache it, saving
+     * it to EEPROM if it changed.
+     */
+    void rememberNetwork(void);
+    /**@}*/
+
+    /**
+     * @anchor modem_baud_helpers
+     * @name Helpers for baud negotiation
+     */
+    /**@{*/
+    /**
+     * @brief Have the modem switch to a new serial baud rate and save it.
+     *
+     * The modem answers at the old rate, then switches.  For the modems that
+     * support it, this is created by the #MS_MODEM_SET_BAUD macro.
+     *
+     * @param baud The new rate
+     * @return **bool** True if the modem took the new rate; always false for
+     * modems that can't change their rate.
+     */
+    virtual bool setModemBaud(uint32_t baud);
+    /**
+     * @brief Switch the modem and the serial port to the target rate, going
+     * back to the old rate if the modem doesn't answer at the new one, and
+     * looking for it at each rate if that doesn't work either.
+     *
+     * @return **bool** True if the modem and port are at the target rate.
+     */
+    bool negotiateModemBaud(void);
+    /**
+     * @brief Look for the modem at each rate up to the target, fastest
+     * first, leaving the serial port at the rate it answers at.
+     *
+     * @return **bool** True if the modem answered at one of the rates.
+     */
+    bool detectModemBaud(void);
+    /**
+     * @brief Switch the serial port to a new rate, saving it to EEPROM if
+     * #MS_MODEM_BAUD_EEPROM_ADDRESS is set and the rate changed.
+     *
+     * @param baud The new rate
+     */
+    void setSerialBaud(uint32_t baud);
     /**@}*/
 
     /**
@@ -784,6 +1871,58 @@ class loggerModem {
      * UTC
      */
     static uint32_t parseNISTBytes(byte nistBytes[4]);
+    /**
+     * @brief Count the time since the last phase ended as the time of this
+     * phase, unless this connection isn't being timed.
+     *
+     * @param phase The phase that just ended
+     */
+    void recordPhase(modemPhase phase);
+    /**
+     * @brief Load the phase histograms from EEPROM, the first time they're
+     * used.
+     */
+    static void loadModemTelemetry(void);
+    /**
+     * @brief Get the histogram bucket for a phase time.
+     *
+     * @param time_ms The time in milliseconds
+     * @return **uint8_t** The bucket
+     */
+    static uint8_t getHistogramBucket(uint32_t time_ms);
+    /**
+     * @brief Add one to a count in a histogram.  If the count is full, all of
+     * the counts in the histogram are halved first, keeping its shape.
+     *
+     * @param counts The counts of the histogram
+     * @param numCounts The number of counts in the histogram
+     * @param index The count to add to
+     */
+    static void addToHistogram(uint16_t* counts, uint8_t numCounts,
+                               uint8_t index);
+    /**
+     * @brief Keep the time of a connection that worked with the recent
+     * connection times, and clear the count of failures in a row.
+     *
+     * @param time_ms The time from AT-OK to the data connection
+     */
+    static void recordConnectionTime(uint32_t time_ms);
+    /**
+     * @brief Get the band a signal strength falls in.
+     *
+     * @param rssi The RSSI in dBm; 0 for no signal
+     * @return **uint8_t** The band
+     */
+    static uint8_t getSignalBand(int16_t rssi);
+    /**
+     * @brief Check that the 4 seconds NIST requires between requests have
+     * passed and, if they have, mark the time of a new request.
+     *
+     * This doesn't wait; a request that would come too soon is left out.
+     *
+     * @return **bool** True if a request can be made now.
+     */
+    bool startNISTRequest(void);
 
     /**
      * @anchor modem_ctor_variables
@@ -906,6 +2045,16 @@ class loggerModem {
      * function.  It is un-set in the modemSleepPowerDown() function.
      */
     uint32_t _millisPowerOn;
+    /**
+     * @brief The metadata to ask the modem for in updateModemMetadata(); see
+     * @ref modem_metadata_bitmasks.
+     */
+    uint8_t _pollModemMetaData;
+    /**
+     * @brief True once the metadata to ask for has been chosen; until then,
+     * all of it is asked for.
+     */
+    bool _metadataPollingSet;
 
     /**
      * @brief The processor elapsed time when the a connection to the NIST time
@@ -915,6 +2064,20 @@ class loggerModem {
      * once every 4 seconds.
      */
     uint32_t _lastNISTrequest;
+    /**
+     * @brief The SNTP client to get the time with, if there is one.
+     */
+    SNTPClient* _sntpClient;
+    /**
+     * @brief The processor time the current connection phase started, for
+     * the phase histograms.
+     */
+    uint32_t _telemetryStart;
+    /**
+     * @brief Flag.  True if the phases of the current connection are being
+     * timed; false when a connection that's already up is only re-checked.
+     */
+    bool _recordTiming;
     /**
      * @brief Flag.  True indicates that the modem has already successfully
      * completed setup.
@@ -925,6 +2088,115 @@ class loggerModem {
      * modem are set to the correct mode (ie, input vs output).
      */
     bool _pinModesSet;
+    /**
+     * @brief The current step of the modem's wake and connection.
+     */
+    modemState _modemState;
+    /**
+     * @brief The state asked for with modemWakeBegin() or
+     * connectInternetBegin().
+     */
+    modemState _targetState;
+    /**
+     * @brief The processor elapsed time when the modem started waiting for an
+     * AT response or, once awake, for a connection.
+     */
+    uint32_t _phaseStart;
+    /**
+     * @brief The processor elapsed time of the last check on the modem that
+     * came up empty, for spacing the checks by #MS_MODEM_POLL_INTERVAL_MS.
+     */
+    uint32_t _lastModemPoll;
+    /**
+     * @brief The maximum time in milliseconds to wait for network registration
+     * and data connection.
+     */
+    uint32_t _maxConnectionTime;
+    /**
+     * @brief Flag.  True if the connection timeout is worked out from the
+     * recent connections.
+     */
+    bool _adaptiveTimeout;
+    /**
+     * @brief The number of hard resets tried during the current wake.
+     */
+    uint8_t _modemResets;
+    /**
+     * @brief The requested PSM periodic TAU time (T3412) in seconds; 0 if
+     * PSM is off.
+     */
+    uint32_t _requestedTAU_s;
+    /**
+     * @brief The requested PSM active time (T3324) in seconds.
+     */
+    uint32_t _requestedActiveTime_s;
+    /**
+     * @brief The requested eDRX cycle in milliseconds; 0 if eDRX is off.
+     */
+    uint32_t _requestedEDRX_ms;
+    /**
+     * @brief The PSM periodic TAU time (T3412) granted by the network, in
+     * seconds.
+     */
+    uint32_t _grantedTAU_s;
+    /**
+     * @brief The PSM active time (T3324) granted by the network, in seconds.
+     */
+    uint32_t _grantedActiveTime_s;
+    /**
+     * @brief Flag.  True if the network granted PSM at the last connection.
+     */
+    bool _psmGranted;
+    /**
+     * @brief Flag.  True if the PSM and eDRX settings still need to be sent
+     * to the modem.
+     */
+    bool _powerSavePending;
+    /**
+     * @brief Flag.  True to register on the cached network first.
+     */
+    bool _fastRegistration;
+    /**
+     * @brief Flag.  True once the cached network has been tried for this
+     * connection.
+     */
+    bool _networkTried;
+    /**
+     * @brief Flag.  True if the modem registered on the cached network for
+     * this connection.
+     */
+    bool _networkSelected;
+    /**
+     * @brief Flag.  True once the cached network has been loaded from EEPROM.
+     */
+    bool _networkLoaded;
+    /**
+     * @brief Flag.  True while waiting for the answer to a network selection;
+     * the modem can't be asked anything else until it answers.
+     */
+    bool _networkSearching;
+    /**
+     * @brief The processor elapsed time when the last network selection
+     * started.
+     */
+    uint32_t _searchStart;
+    /**
+     * @brief The network the modem last registered on.
+     */
+    modemNetwork _network;
+    /**
+     * @brief The hardware serial port the modem is on, for baud negotiation;
+     * NULL if baud negotiation is off.
+     */
+    HardwareSerial* _modemSerial;
+    /**
+     * @brief The rate the modem's serial port is at.
+     */
+    uint32_t _modemBaud;
+    /**
+     * @brief The rate to switch the modem to during setup.
+     */
+    uint32_t _targetBaud;
     /**@}*/
 
     // NOTE:  These must be static so that the modem variables can call the
@@ -977,6 +2249,35 @@ class loggerModem {
      * Returned by #getModemBatteryVoltage().
      */
     static float _priorBatteryVoltage;
+    /**
+     * @brief The last time of each connection phase in seconds
+     *
+     * Set by recordPhaseTime().
+     */
+    static float _priorPhaseTime[MODEM_NUM_PHASES];
+    /**
+     * @brief The number of hard resets needed on the last wake
+     *
+     * Returned by #getModemHardResets().
+     */
+    static float _priorHardResets;
+    /**
+     * @brief The connection phase histograms
+     */
+    static modemTelemetry _telemetry;
+    /**
+     * @brief Flag.  True once the histograms have been loaded from EEPROM.
+     */
+    static bool _telemetryLoaded;
+    /**
+     * @brief Flag.  True if the histograms have changed since they were last
+     * saved.
+     */
+    static bool _telemetryChanged;
+    /**
+     * @brief The hour (since 1970) the histograms were last saved.
+     */
+    static uint32_t _telemetrySavedHour;
     // static float _priorActivationDuration;
     // static float _priorPoweredDuration;
     /**@}*/
@@ -1019,7 +2320,9 @@ class Modem_RSSI : public Variable {
                         const char* varCode = MODEM_RSSI_DEFAULT_CODE)
         : Variable(&parentModem->getModemRSSI, (uint8_t)MODEM_RSSI_RESOLUTION,
                    &*MODEM_RSSI_VAR_NAME, &*MODEM_RSSI_UNIT_NAME, varCode,
-                   uuid) {}
+                   uuid) {
+        parentModem->enableMetadataPolling(MODEM_RSSI_ENABLE_BITMASK);
+    }
     /**
      * @brief Destroy the Modem_RSSI object - no action needed.
      */
@@ -1052,7 +2355,9 @@ class Modem_SignalPercent : public Variable {
         : Variable(&parentModem->getModemSignalPercent,
                    (uint8_t)MODEM_PERCENT_SIGNAL_RESOLUTION,
                    &*MODEM_PERCENT_SIGNAL_VAR_NAME,
-                   &*MODEM_PERCENT_SIGNAL_UNIT_NAME, varCode, uuid) {}
+                   &*MODEM_PERCENT_SIGNAL_UNIT_NAME, varCode, uuid) {
+        parentModem->enableMetadataPolling(MODEM_PERCENT_SIGNAL_ENABLE_BITMASK);
+    }
     /**
      * @brief Destroy the Modem_SignalPercent object - no action needed.
      */
@@ -1088,7 +2393,9 @@ class Modem_BatteryState : public Variable {
         : Variable(&parentModem->getModemBatteryChargeState,
                    (uint8_t)MODEM_BATTERY_STATE_RESOLUTION,
                    &*MODEM_BATTERY_STATE_VAR_NAME,
-                   &*MODEM_BATTERY_STATE_UNIT_NAME, varCode, uuid) {}
+                   &*MODEM_BATTERY_STATE_UNIT_NAME, varCode, uuid) {
+        parentModem->enableMetadataPolling(MODEM_BATTERY_STATE_ENABLE_BITMASK);
+    }
     /**
      * @brief Destroy the Modem_BatteryState object - no action needed.
      */
@@ -1124,7 +2431,10 @@ class Modem_BatteryPercent : public Variable {
         : Variable(&parentModem->getModemBatteryChargePercent,
                    (uint8_t)MODEM_BATTERY_PERCENT_RESOLUTION,
                    &*MODEM_BATTERY_PERCENT_VAR_NAME,
-                   &*MODEM_BATTERY_PERCENT_UNIT_NAME, varCode, uuid) {}
+                   &*MODEM_BATTERY_PERCENT_UNIT_NAME, varCode, uuid) {
+        parentModem->enableMetadataPolling(
+            MODEM_BATTERY_PERCENT_ENABLE_BITMASK);
+    }
     /**
      * @brief Destroy the Modem_BatteryPercent object - no action needed.
      */
@@ -1160,7 +2470,10 @@ class Modem_BatteryVoltage : public Variable {
         : Variable(&parentModem->getModemBatteryVoltage,
                    (uint8_t)MODEM_BATTERY_VOLTAGE_RESOLUTION,
                    &*MODEM_BATTERY_VOLTAGE_VAR_NAME,
-                   &*MODEM_BATTERY_VOLTAGE_UNIT_NAME, varCode, uuid) {}
+                   &*MODEM_BATTERY_VOLTAGE_UNIT_NAME, varCode, uuid) {
+        parentModem->enableMetadataPolling(
+            MODEM_BATTERY_VOLTAGE_ENABLE_BITMASK);
+    }
     /**
      * @brief Destroy the Modem_BatteryVoltage object - no action needed.
      */
@@ -1195,7 +2508,9 @@ class Modem_Temp : public Variable {
         : Variable(&parentModem->getModemTemperature,
                    (uint8_t)MODEM_TEMPERATURE_RESOLUTION,
                    &*MODEM_TEMPERATURE_VAR_NAME, &*MODEM_TEMPERATURE_UNIT_NAME,
-                   varCode, uuid) {}
+                   varCode, uuid) {
+        parentModem->enableMetadataPolling(MODEM_TEMPERATURE_ENABLE_BITMASK);
+    }
     /**
      * @brief Destroy the Modem_Temp object - no action needed.
      */
@@ -1203,6 +2518,307 @@ class Modem_Temp : public Variable {
 };
 
 
+/**
+ * @brief The Variable sub-class used for the time from the start of the last
+ * wake to AT-OK, from a [loggerModem](@ref loggerModem).
+ *
+ * The value has units of seconds and is rounded to the millisecond.
+ *
+ * @ingroup modem_measured_variables
+ */
+class Modem_WakeTime : public Variable {
+ public:
+    /**
+     * @brief Construct a new Modem_WakeTime object.
+     *
+     * @param parentModem The parent modem providing the result values.
+     * @param uuid A universally unique identifier (UUID or GUID) for the
+     * variable; optional with the default value of an empty string.
+     * @param varCode A short code to help identify the variable in files;
+     * optional with a default value of "modemWakeSec".
+     */
+    explicit Modem_WakeTime(loggerModem* parentModem, const char* uuid = "",
+                            const char* varCode = MODEM_WAKE_TIME_DEFAULT_CODE)
+        : Variable(&parentModem->getModemWakeTime,
+                   (uint8_t)MODEM_PHASE_TIME_RESOLUTION,
+                   &*MODEM_PHASE_TIME_VAR_NAME, &*MODEM_PHASE_TIME_UNIT_NAME,
+                   varCode, uuid) {}
+    /**
+     * @brief Destroy the Modem_WakeTime object - no action needed.
+     */
+    ~Modem_WakeTime() {}
+};
+
+
+/**
+ * @brief The Variable sub-class used for the median time from the start of a
+ * wake to AT-OK, from a [loggerModem](@ref loggerModem).
+ *
+ * The value has units of seconds.  It is the upper edge of the histogram bucket
+ * holding the median, so it has the resolution of that bucket.
+ *
+ * @ingroup modem_measured_variables
+ */
+class Modem_WakeTimeMedian : public Variable {
+ public:
+    /**
+     * @brief Construct a new Modem_WakeTimeMedian object.
+     *
+     * @param parentModem The parent modem providing the result values.
+     * @param uuid A universally unique identifier (UUID or GUID) for the
+     * variable; optional with the default value of an empty string.
+     * @param varCode A short code to help identify the variable in files;
+     * optional with a default value of "modemWakeMedianSec".
+     */
+    explicit Modem_WakeTimeMedian(
+        loggerModem* parentModem, const char* uuid = "",
+        const char* varCode = MODEM_WAKE_MEDIAN_DEFAULT_CODE)
+        : Variable(&parentModem->getModemWakeMedian,
+                   (uint8_t)MODEM_PHASE_TIME_RESOLUTION,
+                   &*MODEM_PHASE_TIME_VAR_NAME, &*MODEM_PHASE_TIME_UNIT_NAME,
+                   varCode, uuid) {}
+    /**
+     * @brief Destroy the Modem_WakeTimeMedian object - no action needed.
+     */
+    ~Modem_WakeTimeMedian() {}
+};
+
+
+/**
+ * @brief The Variable sub-class used for the time from AT-OK to network
+ * registration on the last connection, from a [loggerModem](@ref loggerModem).
+ *
+ * The value has units of seconds and is rounded to the millisecond.
+ *
+ * @ingroup modem_measured_variables
+ */
+class Modem_RegistrationTime : public Variable {
+ public:
+    /**
+     * @brief Construct a new Modem_RegistrationTime object.
+     *
+     * @param parentModem The parent modem providing the result values.
+     * @param uuid A universally unique identifier (UUID or GUID) for the
+     * variable; optional with the default value of an empty string.
+     * @param varCode A short code to help identify the variable in files;
+     * optional with a default value of "modemRegisterSec".
+     */
+    explicit Modem_RegistrationTime(
+        loggerModem* parentModem, const char* uuid = "",
+        const char* varCode = MODEM_REGISTRATION_TIME_DEFAULT_CODE)
+        : Variable(&parentModem->getModemRegistrationTime,
+                   (uint8_t)MODEM_PHASE_TIME_RESOLUTION,
+                   &*MODEM_PHASE_TIME_VAR_NAME, &*MODEM_PHASE_TIME_UNIT_NAME,
+                   varCode, uuid) {}
+    /**
+     * @brief Destroy the Modem_RegistrationTime object - no action needed.
+     */
+    ~Modem_RegistrationTime() {}
+};
+
+
+/**
+ * @brief The Variable sub-class used for the median time from AT-OK to network
+ * registration, from a [loggerModem](@ref loggerModem).
+ *
+ * The value has units of seconds.  It is the upper edge of the histogram bucket
+ * holding the median, so it has the resolution of that bucket.
+ *
+ * @ingroup modem_measured_variables
+ */
+class Modem_RegistrationTimeMedian : public Variable {
+ public:
+    /**
+     * @brief Construct a new Modem_RegistrationTimeMedian object.
+     *
+     * @param parentModem The parent modem providing the result values.
+     * @param uuid A universally unique identifier (UUID or GUID) for the
+     * variable; optional with the default value of an empty string.
+     * @param varCode A short code to help identify the variable in files;
+     * optional with a default value of "modemRegisterMedianSec".
+     */
+    explicit Modem_RegistrationTimeMedian(
+        loggerModem* parentModem, const char* uuid = "",
+        const char* varCode = MODEM_REGISTRATION_MEDIAN_DEFAULT_CODE)
+        : Variable(&parentModem->getModemRegistrationMedian,
+                   (uint8_t)MODEM_PHASE_TIME_RESOLUTION,
+                   &*MODEM_PHASE_TIME_VAR_NAME, &*MODEM_PHASE_TIME_UNIT_NAME,
+                   varCode, uuid) {}
+    /**
+     * @brief Destroy the Modem_RegistrationTimeMedian object - no action
+     * needed.
+     */
+    ~Modem_RegistrationTimeMedian() {}
+};
+
+
+/**
+ * @brief The Variable sub-class used for the time from registration to the data
+ * connection on the last connection, from a [loggerModem](@ref loggerModem).
+ *
+ * The value has units of seconds and is rounded to the millisecond.
+ *
+ * @ingroup modem_measured_variables
+ */
+class Modem_AttachTime : public Variable {
+ public:
+    /**
+     * @brief Construct a new Modem_AttachTime object.
+     *
+     * @param parentModem The parent modem providing the result values.
+     * @param uuid A universally unique identifier (UUID or GUID) for the
+     * variable; optional with the default value of an empty string.
+     * @param varCode A short code to help identify the variable in files;
+     * optional with a default value of "modemAttachSec".
+     */
+    explicit Modem_AttachTime(
+        loggerModem* parentModem, const char* uuid = "",
+        const char* varCode = MODEM_ATTACH_TIME_DEFAULT_CODE)
+        : Variable(&parentModem->getModemAttachTime,
+                   (uint8_t)MODEM_PHASE_TIME_RESOLUTION,
+                   &*MODEM_PHASE_TIME_VAR_NAME, &*MODEM_PHASE_TIME_UNIT_NAME,
+                   varCode, uuid) {}
+    /**
+     * @brief Destroy the Modem_AttachTime object - no action needed.
+     */
+    ~Modem_AttachTime() {}
+};
+
+
+/**
+ * @brief The Variable sub-class used for the median time from registration to
+ * the data connection, from a [loggerModem](@ref loggerModem).
+ *
+ * The value has units of seconds.  It is the upper edge of the histogram bucket
+ * holding the median, so it has the resolution of that bucket.
+ *
+ * @ingroup modem_measured_variables
+ */
+class Modem_AttachTimeMedian : public Variable {
+ public:
+    /**
+     * @brief Construct a new Modem_AttachTimeMedian object.
+     *
+     * @param parentModem The parent modem providing the result values.
+     * @param uuid A universally unique identifier (UUID or GUID) for the
+     * variable; optional with the default value of an empty string.
+     * @param varCode A short code to help identify the variable in files;
+     * optional with a default value of "modemAttachMedianSec".
+     */
+    explicit Modem_AttachTimeMedian(
+        loggerModem* parentModem, const char* uuid = "",
+        const char* varCode = MODEM_ATTACH_MEDIAN_DEFAULT_CODE)
+        : Variable(&parentModem->getModemAttachMedian,
+                   (uint8_t)MODEM_PHASE_TIME_RESOLUTION,
+                   &*MODEM_PHASE_TIME_VAR_NAME, &*MODEM_PHASE_TIME_UNIT_NAME,
+                   varCode, uuid) {}
+    /**
+     * @brief Destroy the Modem_AttachTimeMedian object - no action needed.
+     */
+    ~Modem_AttachTimeMedian() {}
+};
+
+
+/**
+ * @brief The Variable sub-class used for the average time to open a socket in
+ * the last publish, from a [loggerModem](@ref loggerModem).
+ *
+ * The value has units of seconds and is rounded to the millisecond.
+ *
+ * @ingroup modem_measured_variables
+ */
+class Modem_SocketTime : public Variable {
+ public:
+    /**
+     * @brief Construct a new Modem_SocketTime object.
+     *
+     * @param parentModem The parent modem providing the result values.
+     * @param uuid A universally unique identifier (UUID or GUID) for the
+     * variable; optional with the default value of an empty string.
+     * @param varCode A short code to help identify the variable in files;
+     * optional with a default value of "modemSocketSec".
+     */
+    explicit Modem_SocketTime(
+        loggerModem* parentModem, const char* uuid = "",
+        const char* varCode = MODEM_SOCKET_TIME_DEFAULT_CODE)
+        : Variable(&parentModem->getModemSocketTime,
+                   (uint8_t)MODEM_PHASE_TIME_RESOLUTION,
+                   &*MODEM_PHASE_TIME_VAR_NAME, &*MODEM_PHASE_TIME_UNIT_NAME,
+                   varCode, uuid) {}
+    /**
+     * @brief Destroy the Modem_SocketTime object - no action needed.
+     */
+    ~Modem_SocketTime() {}
+};
+
+
+/**
+ * @brief The Variable sub-class used for the median time to open a socket, from
+ * a [loggerModem](@ref loggerModem).
+ *
+ * The value has units of seconds.  It is the upper edge of the histogram bucket
+ * holding the median, so it has the resolution of that bucket.
+ *
+ * @ingroup modem_measured_variables
+ */
+class Modem_SocketTimeMedian : public Variable {
+ public:
+    /**
+     * @brief Construct a new Modem_SocketTimeMedian object.
+     *
+     * @param parentModem The parent modem providing the result values.
+     * @param uuid A universally unique identifier (UUID or GUID) for the
+     * variable; optional with the default value of an empty string.
+     * @param varCode A short code to help identify the variable in files;
+     * optional with a default value of "modemSocketMedianSec".
+     */
+    explicit Modem_SocketTimeMedian(
+        loggerModem* parentModem, const char* uuid = "",
+        const char* varCode = MODEM_SOCKET_MEDIAN_DEFAULT_CODE)
+        : Variable(&parentModem->getModemSocketMedian,
+                   (uint8_t)MODEM_PHASE_TIME_RESOLUTION,
+                   &*MODEM_PHASE_TIME_VAR_NAME, &*MODEM_PHASE_TIME_UNIT_NAME,
+                   varCode, uuid) {}
+    /**
+     * @brief Destroy the Modem_SocketTimeMedian object - no action needed.
+     */
+    ~Modem_SocketTimeMedian() {}
+};
+
+
+/**
+ * @brief The Variable sub-class used for the number of hard resets needed on
+ * the last wake, from a [loggerModem](@ref loggerModem).
+ *
+ * The value is a count with no decimal places.
+ *
+ * @ingroup modem_measured_variables
+ */
+class Modem_HardResets : public Variable {
+ public:
+    /**
+     * @brief Construct a new Modem_HardResets object.
+     *
+     * @param parentModem The parent modem providing the result values.
+     * @param uuid A universally unique identifier (UUID or GUID) for the
+     * variable; optional with the default value of an empty string.
+     * @param varCode A short code to help identify the variable in files;
+     * optional with a default value of "modemResets".
+     */
+    explicit Modem_HardResets(
+        loggerModem* parentModem, const char* uuid = "",
+        const char* varCode = MODEM_HARD_RESETS_DEFAULT_CODE)
+        : Variable(&parentModem->getModemHardResets,
+                   (uint8_t)MODEM_HARD_RESETS_RESOLUTION,
+                   &*MODEM_HARD_RESETS_VAR_NAME, &*MODEM_HARD_RESETS_UNIT_NAME,
+                   varCode, uuid) {}
+    /**
+     * @brief Destroy the Modem_HardResets object - no action needed.
+     */
+    ~Modem_HardResets() {}
+};
+
+
 #ifdef MS_CHECK_MODEM_TIMING
 // Defines a diagnostic variable for how long the modem was last active
 class Modem_ActivationDuration : public Variable {
@@ -0,0 +1,136 @@
+/**
+ * @file MeteredClient.cpp
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Implements the MeteredClient class.
+ */
+
+#include "MeteredClient.h"
+
+
+// Constructor
+MeteredClient::MeteredClient() {
+    begin(NULL);
+}
+// Destructor
+MeteredClient::~MeteredClient() {}
+
+
+void MeteredClient::begin(Client* inClient) {
+    _inClient         = inClient;
+    _bytesSent        = 0;
+    _bytesReceived    = 0;
+    _numConnections   = 0;
+    _connectTime_ms   = 0;
+    _numResponses     = 0;
+    _responseTime_ms  = 0;
+    _startTime        = millis();
+    _requestSentAt    = 0;
+    _awaitingResponse = false;
+}
+
+
+uint32_t MeteredClient::getBytesSent(void) {
+    return _bytesSent;
+}
+uint32_t MeteredClient::getBytesReceived(void) {
+    return _bytesReceived;
+}
+uint8_t MeteredClient::getNumConnections(void) {
+    return _numConnections;
+}
+uint32_t MeteredClient::getConnectTime(void) {
+    return _connectTime_ms;
+}
+uint8_t MeteredClient::getNumResponses(void) {
+    return _numResponses;
+}
+uint32_t MeteredClient::getResponseTime(void) {
+    return _responseTime_ms;
+}
+uint32_t MeteredClient::getElapsedTime(void) {
+    return millis() - _startTime;
+}
+
+
+int MeteredClient::connect(IPAddress ip, uint16_t port) {
+    if (_inClient == NULL) return 0;
+    uint32_t start   = millis();
+    int      success = _inClient->connect(ip, port);
+    _connectTime_ms += millis() - start;
+    _numConnections++;
+    return success;
+}
+int MeteredClient::connect(const char* host, uint16_t port) {
+    if (_inClient == NULL) return 0;
+    uint32_t start   = millis();
+    int      success = _inClient->connect(host, port);
+    _connectTime_ms += millis() - start;
+    _numConnections++;
+    return success;
+}
+
+
+size_t MeteredClient::write(uint8_t b) {
+    if (_inClient == NULL) return 0;
+    size_t written = _inClient->write(b);
+    countWrite(written);
+    return written;
+}
+size_t MeteredClient::write(const uint8_t* buf, size_t size) {
+    if (_inClient == NULL) return 0;
+    size_t written = _inClient->write(buf, size);
+    countWrite(written);
+    return written;
+}
+
+
+int MeteredClient::available() {
+    if (_inClient == NULL) return 0;
+    return _inClient->available();
+}
+int MeteredClient::read() {
+    if (_inClient == NULL) return -1;
+    int b = _inClient->read();
+    if (b >= 0) countRead(1);
+    return b;
+}
+int MeteredClient::read(uint8_t* buf, size_t size) {
+    if (_inClient == NULL) return 0;
+    int numRead = _inClient->read(buf, size);
+    if (numRead > 0) countRead(numRead);
+    return numRead;
+}
+int MeteredClient::peek() {
+    if (_inClient == NULL) return -1;
+    return _inClient->peek();
+}
+void MeteredClient::flush() {
+    if (_inClient != NULL) _inClient->flush();
+}
+void MeteredClient::stop() {
+    if (_inClient != NULL) _inClient->stop();
+}
+uint8_t MeteredClient::connected() {
+    if (_inClient == NULL) return 0;
+    return _inClient->connected();
+}
+
+
+void MeteredClient::countWrite(size_t numBytes) {
+    _bytesSent += numBytes;
+    if (numBytes > 0) {
+        _requestSentAt    = millis();
+        _awaitingResponse = true;
+    }
+}
+void MeteredClient::countRead(int numBytes) {
+    _bytesReceived += numBytes;
+    if (_awaitingResponse) {
+        _responseTime_ms += millis() - _requestSentAt;
+        _numResponses++;
+        _awaitingResponse = false;
+    }
+}
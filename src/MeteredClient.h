@@ -0,0 +1,150 @@
+/**
+ * @file MeteredClient.h
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the MeteredClient class - a wrapper around another client
+ * that counts the bytes and times the connection and responses.
+ */
+
+// Header Guards
+#ifndef SRC_METEREDCLIENT_H_
+#define SRC_METEREDCLIENT_H_
+
+// Debugging Statement
+// #define MS_METEREDCLIENT_DEBUG
+
+#ifdef MS_METEREDCLIENT_DEBUG
+#define MS_DEBUGGING_STD "MeteredClient"
+#endif
+
+// Included Dependencies
+#include "ModSensorDebugger.h"
+#undef MS_DEBUGGING_STD
+#include <Client.h>
+
+/**
+ * @brief The MeteredClient class passes everything through to another client
+ * while keeping track of how much it was used.
+ *
+ * It counts the bytes written and read, the time taken to open connections,
+ * and the time from the end of a request to the first byte of its response.
+ * The counts start over each time the metered client is pointed at a client
+ * with begin(Client*).
+ *
+ * @ingroup base_classes
+ */
+class MeteredClient : public Client {
+ public:
+    /**
+     * @brief Construct a new Metered Client object not wrapping any client.
+     */
+    MeteredClient();
+    /**
+     * @brief Destroy the Metered Client object - no action taken.
+     */
+    virtual ~MeteredClient();
+
+    /**
+     * @brief Wrap a client and reset all of the counts.
+     *
+     * @param inClient The client to pass everything through to
+     */
+    void begin(Client* inClient);
+
+    /**
+     * @brief Get the number of bytes written since begin(Client*).
+     *
+     * @return **uint32_t** The number of bytes written
+     */
+    uint32_t getBytesSent(void);
+    /**
+     * @brief Get the number of bytes read since begin(Client*).
+     *
+     * @return **uint32_t** The number of bytes read
+     */
+    uint32_t getBytesReceived(void);
+    /**
+     * @brief Get the number of connections opened since begin(Client*).
+     *
+     * @return **uint8_t** The number of calls to connect(...)
+     */
+    uint8_t getNumConnections(void);
+    /**
+     * @brief Get the total time taken by connect(...) since begin(Client*).
+     *
+     * @return **uint32_t** The time in milliseconds
+     */
+    uint32_t getConnectTime(void);
+    /**
+     * @brief Get the number of responses timed since begin(Client*).
+     *
+     * A response is timed when the first byte is read after anything has been
+     * written.
+     *
+     * @return **uint8_t** The number of responses
+     */
+    uint8_t getNumResponses(void);
+    /**
+     * @brief Get the total time from the end of each request to the first
+     * byte of its response since begin(Client*).
+     *
+     * @return **uint32_t** The time in milliseconds
+     */
+    uint32_t getResponseTime(void);
+    /**
+     * @brief Get the time since begin(Client*).
+     *
+     * @return **uint32_t** The time in milliseconds
+     */
+    uint32_t getElapsedTime(void);
+
+    /**
+     * @brief Count bytes that were written some other way, like a UDP
+     * datagram, as a request.
+     *
+     * @param numBytes The number of bytes written
+     */
+    void countWrite(size_t numBytes);
+    /**
+     * @brief Count bytes that were read some other way, timing the response
+     * if it's the first read since a write.
+     *
+     * @param numBytes The number of bytes read
+     */
+    void countRead(int numBytes);
+
+    // The Client interface
+    int     connect(IPAddress ip, uint16_t port) override;
+    int     connect(const char* host, uint16_t port) override;
+    size_t  write(uint8_t b) override;
+    size_t  write(const uint8_t* buf, size_t size) override;
+    int     available() override;
+    int     read() override;
+    int     read(uint8_t* buf, size_t size) override;
+    int     peek() override;
+    void    flush() override;
+    void    stop() override;
+    uint8_t connected() override;
+    operator bool() override {
+        return _inClient != NULL && static_cast<bool>(*_inClient);
+    }
+
+ protected:
+
+    Client*  _inClient;
+    uint32_t _bytesSent;
+    uint32_t _bytesReceived;
+    uint8_t  _numConnections;
+    uint32_t _connectTime_ms;
+    uint8_t  _numResponses;
+    uint32_t _responseTime_ms;
+    uint32_t _startTime;
+    // The time of the last write not yet answered
+    uint32_t _requestSentAt;
+    // True if a write hasn't been answered yet
+    bool     _awaitingResponse;
+};
+
+#endif  // SRC_METEREDCLIENT_H_
@@ -0,0 +1,103 @@
+/**
+ * @file PersistentStore.cpp
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Implements the PersistentStore class.
+ */
+
+#include "PersistentStore.h"
+
+#if defined(ARDUINO_ARCH_AVR) || defined(__AVR__)
+#include <EEPROM.h>
+#define MS_HAS_EEPROM
+#endif
+
+const uint8_t PersistentStore::blockMarker = 0xA5;
+
+
+bool PersistentStore::isAvailable(void) {
+#if defined(MS_HAS_EEPROM)
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+uint16_t PersistentStore::getBlockSize(uint16_t dataSize) {
+    // marker + version + data + checksum
+    return dataSize + 3;
+}
+
+
+bool PersistentStore::load(int16_t address, void* data, uint16_t dataSize,
+                           uint8_t version) {
+#if defined(MS_HAS_EEPROM)
+    if (address < 0 ||
+        static_cast<uint32_t>(address) + getBlockSize(dataSize) >
+            EEPROM.length()) {
+        return false;
+    }
+    if (EEPROM.read(address) != blockMarker ||
+        EEPROM.read(address + 1) != version) {
+        MS_DBG(F("No stored block of version"), version, F("at"), address);
+        return false;
+    }
+    // Check the block before touching the caller's copy
+    uint8_t sum = version;
+    for (uint16_t i = 0; i < dataSize; i++) {
+        sum = addToChecksum(sum, EEPROM.read(address + 2 + i));
+    }
+    if (sum != EEPROM.read(address + 2 + dataSize)) {
+        MS_DBG(F("Bad checksum on the stored block at"), address);
+        return false;
+    }
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    for (uint16_t i = 0; i < dataSize; i++) {
+        bytes[i] = EEPROM.read(address + 2 + i);
+    }
+    MS_DBG(F("Loaded"), dataSize, F("bytes from EEPROM at"), address);
+    return true;
+#else
+    (void)address;
+    (void)data;
+    (void)dataSize;
+    (void)version;
+    return false;
+#endif
+}
+
+
+void PersistentStore::save(int16_t address, const void* data,
+                           uint16_t dataSize, uint8_t version) {
+#if defined(MS_HAS_EEPROM)
+    if (address < 0 ||
+        static_cast<uint32_t>(address) + getBlockSize(dataSize) >
+            EEPROM.length()) {
+        return;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    EEPROM.update(address, blockMarker);
+    EEPROM.update(address + 1, version);
+    uint8_t sum = version;
+    for (uint16_t i = 0; i < dataSize; i++) {
+        EEPROM.update(address + 2 + i, bytes[i]);
+        sum = addToChecksum(sum, bytes[i]);
+    }
+    EEPROM.update(address + 2 + dataSize, sum);
+    MS_DBG(F("Saved"), dataSize, F("bytes to EEPROM at"), address);
+#else
+    (void)address;
+    (void)data;
+    (void)dataSize;
+    (void)version;
+#endif
+}
+
+
+uint8_t PersistentStore::addToChecksum(uint8_t sum, uint8_t b) {
+    // Rotate and XOR, so swapped bytes are caught too
+    return static_cast<uint8_t>((sum << 1) | (sum >> 7)) ^ b;
+}
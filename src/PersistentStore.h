@@ -0,0 +1,102 @@
+/**
+ * @file PersistentStore.h
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the PersistentStore class - a helper for keeping small
+ * blocks of data in EEPROM across resets.
+ */
+
+// Header Guards
+#ifndef SRC_PERSISTENTSTORE_H_
+#define SRC_PERSISTENTSTORE_H_
+
+// Debugging Statement
+// #define MS_PERSISTENTSTORE_DEBUG
+
+#ifdef MS_PERSISTENTSTORE_DEBUG
+#define MS_DEBUGGING_STD "PersistentStore"
+#endif
+
+// Included Dependencies
+#include "ModSensorDebugger.h"
+#undef MS_DEBUGGING_STD
+
+/**
+ * @brief The PersistentStore class reads and writes small blocks of data in
+ * the processor's EEPROM.
+ *
+ * Each block is stored with a marker, a version number, and a checksum, so a
+ * block that was never written, was written by a different version of the
+ * program, or was only partly written is rejected instead of being loaded as
+ * garbage.  Blocks are written with EEPROM.update(...), so unchanged bytes
+ * don't use up any of the EEPROM's write cycles.
+ *
+ * Boards without EEPROM (ie, SAMD boards) keep nothing; every load fails and
+ * every save is ignored.
+ *
+ * Nothing is ever stored unless the program gives an address for it, usually
+ * with a build flag.  Make sure the blocks don't overlap each other or
+ * anything else the program keeps in EEPROM.
+ *
+ * @ingroup base_classes
+ */
+class PersistentStore {
+ public:
+    /**
+     * @brief Check if the board has EEPROM to store data in.
+     *
+     * @return **bool** True if data can be stored
+     */
+    static bool isAvailable(void);
+    /**
+     * @brief Get the number of bytes of EEPROM a block takes up.
+     *
+     * @param dataSize The size of the data in the block
+     * @return **uint16_t** The size of the data plus the marker, version, and
+     * checksum
+     */
+    static uint16_t getBlockSize(uint16_t dataSize);
+    /**
+     * @brief Read a block of data from EEPROM.
+     *
+     * The data is left untouched if the block isn't valid.
+     *
+     * @param address The EEPROM address of the block; negative to not use
+     * EEPROM
+     * @param data The place to copy the data to
+     * @param dataSize The size of the data
+     * @param version The version of the data layout expected
+     * @return **bool** True if a valid block was read
+     */
+    static bool load(int16_t address, void* data, uint16_t dataSize,
+                     uint8_t version);
+    /**
+     * @brief Write a block of data to EEPROM.
+     *
+     * @param address The EEPROM address of the block; negative to not use
+     * EEPROM
+     * @param data The data to write
+     * @param dataSize The size of the data
+     * @param version The version of the data layout
+     */
+    static void save(int16_t address, const void* data, uint16_t dataSize,
+                     uint8_t version);
+
+ protected:
+    /**
+     * @brief The marker at the start of every block.
+     */
+    static const uint8_t blockMarker;
+    /**
+     * @brief Add one byte to a block's checksum.
+     *
+     * @param sum The checksum so far; start with the version
+     * @param b The next byte of data
+     * @return **uint8_t** The new checksum
+     */
+    static uint8_t addToChecksum(uint8_t sum, uint8_t b);
+};
+
+#endif  // SRC_PERSISTENTSTORE_H_
@@ -0,0 +1,173 @@
+/**
+ * @file SNTPClient.cpp
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Implements the SNTPClient class.
+ */
+
+#include "SNTPClient.h"
+
+// The size of an NTP packet without any extensions
+#define SNTP_PACKET_SIZE 48
+// The first byte of a request:  no leap second warning, version 4, client
+#define SNTP_CLIENT_REQUEST 0x23
+// The NTP port on the server
+#define SNTP_SERVER_PORT 123
+// The seconds between the NTP epoch (1900) and the Unix epoch (1970)
+#define SNTP_UNIX_OFFSET 2208988800UL
+
+// Constructors
+SNTPClient::SNTPClient() : SNTPClient(NULL) {}
+SNTPClient::SNTPClient(UDP* udp) {
+    _udp               = udp;
+    _numServers        = 0;
+    _requestNonce      = 0;
+    _syncSeconds       = 0;
+    _syncMillis        = 0;
+    _syncedAt          = 0;
+    _roundTripDelay_ms = 0;
+    _syncServer        = NULL;
+}
+// Destructor
+SNTPClient::~SNTPClient() {}
+
+
+void SNTPClient::setUDP(UDP* udp) {
+    _udp = udp;
+}
+bool SNTPClient::addServer(const char* host) {
+    if (_numServers >= MS_SNTP_MAX_SERVERS) return false;
+    _servers[_numServers++] = host;
+    return true;
+}
+void SNTPClient::clearServers(void) {
+    _numServers = 0;
+}
+
+
+bool SNTPClient::sync(void) {
+    if (_udp == NULL) {
+        PRINTOUT(F("A UDP instance must be set to get the time with SNTP!"));
+        return false;
+    }
+    if (_numServers == 0) return request(MS_SNTP_DEFAULT_SERVER);
+    for (uint8_t i = 0; i < _numServers; i++) {
+        if (request(_servers[i])) return true;
+    }
+    return false;
+}
+
+
+bool SNTPClient::isSynced(void) {
+    return _syncServer != NULL;
+}
+uint32_t SNTPClient::getUnixTime(void) {
+    if (!isSynced()) return 0;
+    return _syncSeconds + (_syncMillis + (millis() - _syncedAt)) / 1000;
+}
+uint16_t SNTPClient::getMillis(void) {
+    return (_syncMillis + (millis() - _syncedAt)) % 1000;
+}
+uint32_t SNTPClient::getRoundTripDelay(void) {
+    return _roundTripDelay_ms;
+}
+const char* SNTPClient::getServer(void) {
+    return _syncServer;
+}
+
+
+bool SNTPClient::request(const char* host) {
+    MS_DBG(F("Asking"), host, F("for the time"));
+    uint8_t packet[SNTP_PACKET_SIZE];
+    memset(packet, 0, SNTP_PACKET_SIZE);
+    packet[0] = SNTP_CLIENT_REQUEST;
+    // A client can put anything in its transmit timestamp; a random one makes
+    // sure the answer is to this request and not some earlier one
+    _requestNonce = random(0x7FFFFFFF);
+    for (uint8_t i = 0; i < 4; i++) {
+        packet[40 + i] = static_cast<uint8_t>(_requestNonce >> (24 - 8 * i));
+    }
+
+    _udp->begin(MS_SNTP_LOCAL_PORT);
+    // Throw away anything left over from before
+    while (_udp->parsePacket() > 0) {}
+    if (!_udp->beginPacket(host, SNTP_SERVER_PORT)) {
+        MS_DBG(F("Could not resolve"), host);
+        _udp->stop();
+        return false;
+    }
+    _udp->write(packet, SNTP_PACKET_SIZE);
+    uint32_t sentAt = millis();
+    _udp->endPacket();
+
+    bool answered = false;
+    while (!answered && millis() - sentAt < MS_SNTP_TIMEOUT_MS) {
+        answered = readAnswer(packet);
+    }
+    uint32_t receivedAt = millis();
+    _udp->stop();
+    if (!answered) {
+        MS_DBG(F("No answer from"), host, F("after"), MS_SNTP_TIMEOUT_MS,
+               F("ms"));
+        return false;
+    }
+
+    // The server's receive (T2) and transmit (T3) timestamps
+    uint32_t receiveSeconds  = readUInt32(packet + 32);
+    uint16_t receiveMillis   = fractionToMillis(readUInt32(packet + 36));
+    uint32_t transmitSeconds = readUInt32(packet + 40);
+    uint16_t transmitMillis  = fractionToMillis(readUInt32(packet + 44));
+
+    // The round trip, less the time the server held the request; with a
+    // millisecond clock this can come out a little under zero
+    int32_t serverHeld_ms = (transmitSeconds - receiveSeconds) * 1000L +
+        transmitMillis - receiveMillis;
+
+    int32_t roundTrip_ms = receivedAt - sentAt - serverHeld_ms;
+    _roundTripDelay_ms   = roundTrip_ms > 0 ? roundTrip_ms : 0;
+
+    // The answer spent about half the round trip getting here
+    uint32_t arrivalMillis = transmitMillis + _roundTripDelay_ms / 2;
+
+    _syncSeconds = transmitSeconds - SNTP_UNIX_OFFSET + arrivalMillis / 1000;
+    _syncMillis  = arrivalMillis % 1000;
+    _syncedAt    = receivedAt;
+    _syncServer  = host;
+    MS_DBG(F("Time from"), host, F("is"), _syncSeconds, '.', _syncMillis,
+           F("with a round trip delay of"), _roundTripDelay_ms, F("ms"));
+    return true;
+}
+
+
+bool SNTPClient::readAnswer(uint8_t* packet) {
+    if (_udp->parsePacket() < SNTP_PACKET_SIZE) return false;
+    _udp->read(packet, SNTP_PACKET_SIZE);
+
+    uint8_t leap    = packet[0] >> 6;
+    uint8_t mode    = packet[0] & 0x07;
+    uint8_t stratum = packet[1];
+    // The originate timestamp must be the transmit timestamp we sent
+    if (mode != 4 || readUInt32(packet + 24) != _requestNonce) {
+        MS_DBG(F("Ignoring a datagram that isn't an answer to the request"));
+        return false;
+    }
+    // Leap indicator 3 means the server's clock isn't set; stratum 0 is a
+    // "kiss-o'-death" telling us to go away
+    if (leap == 3 || stratum == 0 || stratum > 15) {
+        MS_DBG(F("The server isn't synchronized; stratum"), stratum);
+        return false;
+    }
+    return true;
+}
+
+
+uint32_t SNTPClient::readUInt32(const uint8_t* bytes) {
+    return static_cast<uint32_t>(bytes[0]) << 24 |
+        static_cast<uint32_t>(bytes[1]) << 16 |
+        static_cast<uint32_t>(bytes[2]) << 8 | bytes[3];
+}
+uint16_t SNTPClient::fractionToMillis(uint32_t fraction) {
+    return (static_cast<uint64_t>(fraction) * 1000) >> 32;
+}
@@ -0,0 +1,229 @@
+/**
+ * @file SNTPClient.h
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the SNTPClient class - a minimal SNTP (RFC 4330) client for
+ * setting the clock with a single UDP exchange.
+ */
+
+// Header Guards
+#ifndef SRC_SNTPCLIENT_H_
+#define SRC_SNTPCLIENT_H_
+
+// Debugging Statement
+// #define MS_SNTPCLIENT_DEBUG
+
+#ifdef MS_SNTPCLIENT_DEBUG
+#define MS_DEBUGGING_STD "SNTPClient"
+#endif
+
+/**
+ * @def MS_SNTP_MAX_SERVERS
+ * @brief The largest number of time servers that can be listed.
+ *
+ * This can be changed by setting the build flag MS_SNTP_MAX_SERVERS when
+ * compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_SNTP_MAX_SERVERS
+#define MS_SNTP_MAX_SERVERS 4
+#endif
+
+/**
+ * @def MS_SNTP_TIMEOUT_MS
+ * @brief The time to wait for each server to answer before moving on to the
+ * next.
+ *
+ * This can be changed by setting the build flag MS_SNTP_TIMEOUT_MS when
+ * compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_SNTP_TIMEOUT_MS
+#define MS_SNTP_TIMEOUT_MS 3000
+#endif
+
+/**
+ * @def MS_SNTP_DEFAULT_SERVER
+ * @brief The time server to ask if none have been added.
+ *
+ * This can be changed by setting the build flag MS_SNTP_DEFAULT_SERVER when
+ * compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_SNTP_DEFAULT_SERVER
+#define MS_SNTP_DEFAULT_SERVER "pool.ntp.org"
+#endif
+
+/**
+ * @def MS_SNTP_LOCAL_PORT
+ * @brief The local UDP port to listen for the answer on.
+ *
+ * This can be changed by setting the build flag MS_SNTP_LOCAL_PORT when
+ * compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_SNTP_LOCAL_PORT
+#define MS_SNTP_LOCAL_PORT 2390
+#endif
+
+// Included Dependencies
+#include "ModSensorDebugger.h"
+#undef MS_DEBUGGING_STD
+#include <Udp.h>
+
+/**
+ * @brief The SNTPClient class gets the time from an NTP server in a single
+ * request and response over UDP.
+ *
+ * Compared to the TIME protocol (rfc868) used with NIST, there's no TCP
+ * handshake, no required wait between requests, and the time comes back with
+ * a fraction of a second.  The round trip delay is measured and half of it is
+ * added to the server's time, so the time is usually good to a few tens of
+ * milliseconds, even over a cellular connection.
+ *
+ * The servers are tried in the order they were added until one answers.
+ * Answers that are not for the request sent, or that come from a server
+ * which isn't synchronized itself, are ignored.
+ *
+ * This needs an Arduino UDP instance, like a WiFiUDP or EthernetUDP.  Attach
+ * it to a modem with loggerModem::setSNTPClient() to have the logger use it
+ * for its clock syncs.
+ *
+ * @note The version of TinyGSM used by this library does not have UDP
+ * sockets, so the cellular modems still fall back to NIST.
+ *
+ * @ingroup the_modems
+ */
+class SNTPClient {
+ public:
+    /**
+     * @brief Construct a new SNTP Client object with no UDP instance.
+     */
+    SNTPClient();
+    /**
+     * @brief Construct a new SNTP Client object
+     *
+     * @param udp An Arduino UDP instance to send the requests with
+     */
+    explicit SNTPClient(UDP* udp);
+    /**
+     * @brief Destroy the SNTP Client object - no action taken.
+     */
+    virtual ~SNTPClient();
+
+    /**
+     * @brief Set the UDP instance to send the requests with.
+     *
+     * @param udp An Arduino UDP instance
+     */
+    void setUDP(UDP* udp);
+    /**
+     * @brief Add a time server to the end of the list.
+     *
+     * The host name is not copied; it must stay valid as long as the client
+     * is used.
+     *
+     * @param host The host name of the server
+     * @return **bool** True if the server was added; false if the list is
+     * already full.
+     */
+    bool addServer(const char* host);
+    /**
+     * @brief Remove all of the servers from the list.
+     */
+    void clearServers(void);
+
+    /**
+     * @brief Ask the servers for the time, in order, until one answers.
+     *
+     * @return **bool** True if a server answered.
+     */
+    bool sync(void);
+    /**
+     * @brief Check if any server has ever answered.
+     *
+     * @return **bool** True if the time is known.
+     */
+    bool isSynced(void);
+    /**
+     * @brief Get the current time, based on the last answer and the
+     * processor time since then.
+     *
+     * @return **uint32_t** The current whole seconds since January 1, 1970 in
+     * UTC; 0 if no server has answered.
+     */
+    uint32_t getUnixTime(void);
+    /**
+     * @brief Get the fraction of a second to go with getUnixTime().
+     *
+     * @return **uint16_t** The milliseconds past the current second.
+     */
+    uint16_t getMillis(void);
+    /**
+     * @brief Get the round trip delay of the last answer, less the time the
+     * server took to answer.
+     *
+     * @return **uint32_t** The delay in milliseconds
+     */
+    uint32_t getRoundTripDelay(void);
+    /**
+     * @brief Get the server that gave the last answer.
+     *
+     * @return **const char*** The host name, or NULL if none has answered.
+     */
+    const char* getServer(void);
+
+ protected:
+    /**
+     * @brief Send a request to one server and wait for the answer.
+     *
+     * @param host The host name of the server
+     * @return **bool** True if the server answered.
+     */
+    bool request(const char* host);
+    /**
+     * @brief Read the answer, if there is one, and check that it's a good
+     * answer to the request sent.
+     *
+     * @param packet A buffer of 48 bytes for the answer
+     * @return **bool** True if a good answer was read.
+     */
+    bool readAnswer(uint8_t* packet);
+    /**
+     * @brief Read a 4 byte big-endian number.
+     *
+     * @param bytes The first of the 4 bytes
+     * @return **uint32_t** The number
+     */
+    static uint32_t readUInt32(const uint8_t* bytes);
+    /**
+     * @brief Convert the fraction part of an NTP timestamp to milliseconds.
+     *
+     * @param fraction The fraction, in units of 2^-32 seconds
+     * @return **uint16_t** The milliseconds
+     */
+    static uint16_t fractionToMillis(uint32_t fraction);
+
+ private:
+    UDP*        _udp;
+    const char* _servers[MS_SNTP_MAX_SERVERS];
+    uint8_t     _numServers;
+
+    // The transmit timestamp of the request, echoed back in the answer
+    uint32_t _requestNonce;
+
+    // The server time when the last answer arrived, and when that was
+    uint32_t    _syncSeconds;
+    uint16_t    _syncMillis;
+    uint32_t    _syncedAt;
+    uint32_t    _roundTripDelay_ms;
+    const char* _syncServer;
+};
+
+#endif  // SRC_SNTPCLIENT_H_
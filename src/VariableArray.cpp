@@ -523,7 +523,7 @@ bool VariableArray::updateAllSensors(void) {
 
 // This function is an even more complete version of the updateAllSensors
 // function - it handles power up/down and wake/sleep.
-bool VariableArray::completeUpdate(void) {
+bool VariableArray::completeUpdate(void (*idleFxn)(void*), void* context) {
     bool    success           = true;
     uint8_t nSensorsCompleted = 0;
 
@@ -669,6 +669,7 @@ bool VariableArray::completeUpdate(void) {
     MS_DBG(F("   ... Complete. <<-----"));
 
     while (nSensorsCompleted < _sensorCount) {
+        if (idleFxn != NULL) idleFxn(context);
         for (uint8_t i = 0; i < _variableCount; i++) {
             /***
             // THIS IS PURELY FOR DEEP DEBUGGING OF THE TIMING!
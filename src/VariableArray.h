@@ -251,9 +251,13 @@ class VariableArray {
      * values.  Repeatedly checks each sensor's readiness state to optimize
      * timing.
      *
+     * @param idleFxn A function to call on every pass through the sensors
+     * while waiting on them, for example to step a modem along; optional.
+     * It must return quickly.
+     * @param context A pointer handed to the idle function; optional.
      * @return **bool** True if all steps of the update succeeded.
      */
-    bool completeUpdate(void);
+    bool completeUpdate(void (*idleFxn)(void*) = NULL, void* context = NULL);
 
     /**
      * @brief Print out the results for all connected sensors to a stream
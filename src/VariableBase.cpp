@@ -33,6 +33,8 @@ Variable::Variable(Sensor* parentSense, const uint8_t sensorVarNum,
     // When we create the variable, we also want to initialize it with a current
     // value of -9999 (ie, a bad result).
     _currentValue = -9999;
+    // Report every value until told otherwise
+    setReportByException(-1, 0);
 
     // MS_DBG(F("Measured Variable object created"));
 }
@@ -53,6 +55,8 @@ Variable::Variable(const uint8_t sensorVarNum, uint8_t decimalResolution,
     // When we create the variable, we also want to initialize it with a current
     // value of -9999 (ie, a bad result).
     _currentValue = -9999;
+    // Report every value until told otherwise
+    setReportByException(-1, 0);
 
     // MS_DBG(F("Measured Variable object created"));
 }
@@ -77,6 +81,8 @@ Variable::Variable(float (*calcFxn)(), uint8_t decimalResolution,
     // When we create the variable, we also want to initialize it with a current
     // value of -9999 (ie, a bad result).
     _currentValue = -9999;
+    // Report every value until told otherwise
+    setReportByException(-1, 0);
 
     // MS_DBG(F("Calculated Variable object created"));
 }
@@ -97,6 +103,8 @@ Variable::Variable(float (*calcFxn)(), uint8_t decimalResolution,
     // When we create the variable, we also want to initialize it with a current
     // value of -9999 (ie, a bad result).
     _currentValue = -9999;
+    // Report every value until told otherwise
+    setReportByException(-1, 0);
 
     // MS_DBG(F("Calculated Variable object created"));
 }
@@ -115,6 +123,8 @@ Variable::Variable() : _sensorVarNum(0), _decimalResolution(0) {
     // When we create the variable, we also want to initialize it with a current
     // value of -9999 (ie, a bad result).
     _currentValue = -9999;
+    // Report every value until told otherwise
+    setReportByException(-1, 0);
 
     // MS_DBG(F("Calculated Variable object created"));
 }
@@ -356,11 +366,62 @@ float Variable::getValue(bool updateValue) {
 // This returns the current value of the variable as a string
 // with the correct number of significant figures
 String Variable::getValueString(bool updateValue) {
+    return formatValueString(getValue(updateValue));
+}
+// This formats any value with the resolution of the variable
+String Variable::formatValueString(float value) {
     // Need this because otherwise get extra spaces in strings from int
     if (_decimalResolution == 0) {
-        int16_t val = static_cast<int16_t>(getValue(updateValue));
+        int16_t val = static_cast<int16_t>(value);
         return String(val);
     } else {
-        return String(getValue(updateValue), _decimalResolution);
+        return String(value, _decimalResolution);
+    }
+}
+
+
+// Sets up report by exception
+void Variable::setReportByException(float deadband, uint32_t maxSilence_s) {
+    _deadband          = deadband;
+    _maxSilence_s      = maxSilence_s;
+    _lastReportedValue = -9999;
+    _lastReportedTime  = 0;
+    _checkedValue      = -9999;
+    _checkedTime       = 0;
+    _hasReported       = false;
+    _valueReported     = true;
+}
+float Variable::getDeadband(void) {
+    return _deadband;
+}
+uint32_t Variable::getMaxSilence(void) {
+    return _maxSilence_s;
+}
+
+
+// Decides if the current value has changed enough to be reported
+bool Variable::checkValueReported(uint32_t timestamp) {
+    float value    = getValue();
+    _valueReported = true;
+    if (_deadband >= 0 && _hasReported) {
+        bool wasFailed = _lastReportedValue == -9999;
+        bool isFailed  = value == -9999;
+        bool overdue   = _maxSilence_s > 0 &&
+            timestamp - _lastReportedTime >= _maxSilence_s;
+        _valueReported = wasFailed != isFailed || overdue ||
+            fabs(value - _lastReportedValue) > _deadband;
     }
+    _checkedValue = value;
+    _checkedTime  = timestamp;
+    return _valueReported;
+}
+// Moves the deadband to the value that was just published
+void Variable::confirmValueReported(void) {
+    if (!_valueReported) return;
+    _lastReportedValue = _checkedValue;
+    _lastReportedTime  = _checkedTime;
+    _hasReported       = true;
+}
+bool Variable::isValueReported(void) {
+    return _valueReported;
 }
@@ -355,6 +355,72 @@ class Variable {
      * @return **String** The current value of the variable
      */
     String getValueString(bool updateValue = false);
+    /**
+     * @brief Format any value as a string with the decimal resolution of this
+     * variable.
+     *
+     * @param value The value to format
+     * @return **String** The formatted value
+     */
+    String formatValueString(float value);
+
+    /**
+     * @brief Only report values which have changed by more than a deadband
+     * since the last value reported, or which haven't been reported for too
+     * long.
+     *
+     * The publishers leave values which don't need to be reported out of
+     * what they send.  Every value is still logged to the SD card.  By
+     * default, every value is reported.
+     *
+     * A change to or from -9999 (a failed measurement) is always reported.
+     *
+     * @param deadband The smallest change from the last reported value that
+     * is reported; negative to report every value.
+     * @param maxSilence_s The longest time, in seconds, to go without reporting
+     * a value; 0 for no limit.  Optional with a default value of 86400 (one
+     * day).
+     */
+    void setReportByException(float deadband, uint32_t maxSilence_s = 86400);
+    /**
+     * @brief Get the deadband set by setReportByException(...).
+     *
+     * @return **float** The deadband; negative if every value is reported.
+     */
+    float getDeadband(void);
+    /**
+     * @brief Get the longest time to go without reporting a value.
+     *
+     * @return **uint32_t** The maximum silence in seconds; 0 for no limit.
+     */
+    uint32_t getMaxSilence(void);
+    /**
+     * @brief Decide if the current value needs to be reported.
+     *
+     * This is called by the logger once for every record.  The value is only
+     * remembered as the last value reported once it has been sent; see
+     * confirmValueReported().
+     *
+     * @param timestamp The time of the current value, in seconds
+     * @return **bool** True if the current value needs to be reported.
+     */
+    bool checkValueReported(uint32_t timestamp);
+    /**
+     * @brief Remember the value last checked by checkValueReported(uint32_t)
+     * as the last value reported, if it needed to be reported.
+     *
+     * This is called by the logger once the value has been published, so a
+     * value that failed to go out is compared against the last one that
+     * did.
+     */
+    void confirmValueReported(void);
+    /**
+     * @brief Check if the current value needs to be reported, as decided by
+     * the last call to checkValueReported(uint32_t).
+     *
+     * @return **bool** True if the current value needs to be reported.
+     */
+    bool isValueReported(void);
 
     /**
      * @brief Pointer to the parent sensor
@@ -381,6 +447,16 @@ class Variable {
     const char* _varUnit;
     const char* _varCode;
     const char* _uuid;
+
+    // Report by exception
+    float    _deadband;
+    uint32_t _maxSilence_s;
+    float    _lastReportedValue;
+    uint32_t _lastReportedTime;
+    float    _checkedValue;
+    uint32_t _checkedTime;
+    bool     _hasReported;
+    bool     _valueReported;
 };
 
 #endif  // SRC_VARIABLEBASE_H_
@@ -0,0 +1,121 @@
+/**
+ * @file WifiConnectionCache.cpp
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Implements the WifiConnectionCache class.
+ */
+
+#include "WifiConnectionCache.h"
+
+// The version of the connection kept in EEPROM
+#define WIFI_CACHE_VERSION 1
+// The EEPROM address of the connection; negative to not keep it
+#if defined(MS_WIFI_CACHE_EEPROM_ADDRESS)
+#define WIFI_CACHE_ADDRESS MS_WIFI_CACHE_EEPROM_ADDRESS
+#else
+#define WIFI_CACHE_ADDRESS -1
+#endif
+
+// Constructor
+WifiConnectionCache::WifiConnectionCache() {
+    memset(&_connection, 0, sizeof(_connection));
+    memset(&_static, 0, sizeof(_static));
+    _reuses        = 0;
+    _fastReconnect = false;
+    _hasStaticIP   = false;
+    _loaded        = false;
+}
+// Destructor
+WifiConnectionCache::~WifiConnectionCache() {}
+
+
+void WifiConnectionCache::setFastReconnect(bool fastReconnect) {
+    _fastReconnect = fastReconnect;
+}
+bool WifiConnectionCache::isFastReconnect(void) {
+    return _fastReconnect;
+}
+void WifiConnectionCache::setStaticIP(IPAddress ip, IPAddress gateway,
+                                      IPAddress mask, IPAddress dns) {
+    _static.ip      = ip;
+    _static.gateway = gateway;
+    _static.mask    = mask;
+    _static.dns     = dns;
+    _hasStaticIP    = true;
+}
+bool WifiConnectionCache::hasStaticIP(void) {
+    return _hasStaticIP;
+}
+
+
+bool WifiConnectionCache::isCached(void) {
+    if (!_fastReconnect) return false;
+    if (!_loaded) {
+        _loaded = true;
+        if (!PersistentStore::load(WIFI_CACHE_ADDRESS, &_connection,
+                                   sizeof(_connection), WIFI_CACHE_VERSION)) {
+            memset(&_connection, 0, sizeof(_connection));
+        }
+    }
+    return _connection.ip != 0 && _reuses < MS_WIFI_CACHE_MAX_REUSES;
+}
+bool WifiConnectionCache::countReuse(void) {
+    if (!isCached()) return false;
+    _reuses++;
+    if (_reuses < MS_WIFI_CACHE_MAX_REUSES) return false;
+    MS_DBG(F("Cached address used"), _reuses, F("times, renewing it"));
+    return true;
+}
+bool WifiConnectionCache::skipDHCP(void) {
+    return _hasStaticIP || isCached();
+}
+void WifiConnectionCache::cache(const wifiConnection& connection) {
+    _connection = connection;
+    _reuses     = 0;
+    _loaded     = true;
+    PersistentStore::save(WIFI_CACHE_ADDRESS, &_connection,
+                          sizeof(_connection), WIFI_CACHE_VERSION);
+}
+void WifiConnectionCache::clear(void) {
+    wifiConnection none;
+    memset(&none, 0, sizeof(none));
+    cache(none);
+}
+
+
+const wifiConnection& WifiConnectionCache::getConnection(void) {
+    return _connection;
+}
+IPAddress WifiConnectionCache::getIP(void) {
+    return IPAddress(_hasStaticIP ? _static.ip : _connection.ip);
+}
+IPAddress WifiConnectionCache::getGateway(void) {
+    return IPAddress(_hasStaticIP ? _static.gateway : _connection.gateway);
+}
+IPAddress WifiConnectionCache::getMask(void) {
+    return IPAddress(_hasStaticIP ? _static.mask : _connection.mask);
+}
+IPAddress WifiConnectionCache::getDNS(void) {
+    return IPAddress(_hasStaticIP ? _static.dns : _connection.dns);
+}
+
+
+void WifiConnectionCache::formatBSSID(const uint8_t* bssid, char* buffer) {
+    const char hex[] = "0123456789abcdef";
+    for (uint8_t i = 0; i < 6; i++) {
+        buffer[3 * i]     = hex[bssid[i] >> 4];
+        buffer[3 * i + 1] = hex[bssid[i] & 0x0F];
+        buffer[3 * i + 2] = i < 5 ? ':' : '\0';
+    }
+}
+bool WifiConnectionCache::parseBSSID(const char* text, uint8_t* bssid) {
+    for (uint8_t i = 0; i < 6; i++) {
+        char* end;
+        bssid[i] = strtoul(text, &end, 16);
+        if (end == text || (i < 5 && *end != ':')) return false;
+        text = end + 1;
+    }
+    return true;
+}
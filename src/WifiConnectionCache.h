@@ -0,0 +1,262 @@
+/**
+ * @file WifiConnectionCache.h
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the WifiConnectionCache class - remembers the access point
+ * and address of the last good WiFi connection so the next one can skip the
+ * scan and DHCP.
+ */
+
+// Header Guards
+#ifndef SRC_WIFICONNECTIONCACHE_H_
+#define SRC_WIFICONNECTIONCACHE_H_
+
+// Debugging Statement
+// #define MS_WIFICONNECTIONCACHE_DEBUG
+
+#ifdef MS_WIFICONNECTIONCACHE_DEBUG
+#define MS_DEBUGGING_STD "WifiConnectionCache"
+#endif
+
+/**
+ * @def MS_WIFI_CACHE_EEPROM_ADDRESS
+ * @brief The EEPROM address for the last good WiFi connection.
+ *
+ * If this is defined, the access point and address of the last good connection
+ * are kept through a reset, ie, a watchdog reset or a battery change, as well
+ * as between wakes.  It takes
+ * PersistentStore::getBlockSize(sizeof(wifiConnection)) bytes.
+ *
+ * This can be set by setting the build flag MS_WIFI_CACHE_EEPROM_ADDRESS when
+ * compiling.
+ *
+ * @ingroup the_modems
+ */
+
+/**
+ * @def MS_WIFI_FAST_JOIN_TIMEOUT_MS
+ * @brief The time to wait for a modem to join with the cached connection before
+ * forgetting it and joining the slow way.
+ *
+ * This is only used by modems that join on their own after waking, like the
+ * XBee.  Modems that are told to join find out right away if it didn't work.
+ *
+ * This can be changed by setting the build flag MS_WIFI_FAST_JOIN_TIMEOUT_MS
+ * when compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_WIFI_FAST_JOIN_TIMEOUT_MS
+#define MS_WIFI_FAST_JOIN_TIMEOUT_MS 5000L
+#endif
+
+/**
+ * @def MS_WIFI_CACHE_MAX_REUSES
+ * @brief The number of connections that can reuse a cached address before
+ * the modem asks DHCP for one again.
+ *
+ * Neither modem reports how long the DHCP lease is, so the lease is renewed
+ * after this many connections instead.  The default is half a day of
+ * connections every 15 minutes, well within the 24 hour lease most routers
+ * give.  A static address is never renewed.
+ *
+ * This can be changed by setting the build flag MS_WIFI_CACHE_MAX_REUSES when
+ * compiling.
+ *
+ * @ingroup the_modems
+ */
+#ifndef MS_WIFI_CACHE_MAX_REUSES
+#define MS_WIFI_CACHE_MAX_REUSES 48
+#endif
+
+// Included Dependencies
+#include "ModSensorDebugger.h"
+#undef MS_DEBUGGING_STD
+#include <IPAddress.h>
+#include "PersistentStore.h"
+
+/**
+ * @brief The details of a WiFi connection that are kept for the next one.
+ *
+ * The addresses are kept as the 4 bytes of an IPAddress.
+ *
+ * @ingroup the_modems
+ */
+typedef struct wifiConnection {
+    uint8_t  bssid[6];  ///< The MAC address of the access point
+    uint8_t  channel;   ///< The channel the access point was on
+    uint32_t ip;        ///< The modem's address
+    uint32_t gateway;   ///< The gateway's address
+    uint32_t mask;      ///< The subnet mask
+    uint32_t dns;       ///< The DNS server's address
+} wifiConnection;
+
+/**
+ * @brief The WifiConnectionCache class keeps the access point and address of
+ * the last good WiFi connection, or a static address, for a WiFi modem.
+ *
+ * A WiFi modem normally scans every channel for its network, associates, and
+ * then waits for an address from DHCP every time it wakes.  With fast
+ * reconnect turned on, the modem remembers where it found the network and the
+ * address it was given.  The next time, it can go straight to that access
+ * point and use the same address without asking for it, falling back to a full
+ * scan and DHCP if that doesn't work.  So the lease isn't outlived, the
+ * address is only reused #MS_WIFI_CACHE_MAX_REUSES times before it's asked for
+ * again.
+ *
+ * With a static address, DHCP is never used and the address is never
+ * forgotten.  Fast reconnect can still be used to remember the access point.
+ *
+ * @ingroup the_modems
+ */
+class WifiConnectionCache {
+ public:
+    /**
+     * @brief Construct a new WiFi Connection Cache object, with nothing cached
+     * and fast reconnect off.
+     */
+    WifiConnectionCache();
+    /**
+     * @brief Destroy the WiFi Connection Cache object - no action taken.
+     */
+    ~WifiConnectionCache();
+
+    /**
+     * @brief Turn fast reconnect on or off.
+     *
+     * @param fastReconnect True to keep the last good connection for the next
+     * one.
+     */
+    void setFastReconnect(bool fastReconnect);
+    /**
+     * @brief Check if fast reconnect is on.
+     *
+     * @return **bool** True if fast reconnect is on.
+     */
+    bool isFastReconnect(void);
+    /**
+     * @brief Use a static address instead of DHCP.
+     *
+     * @param ip The modem's address
+     * @param gateway The gateway's address
+     * @param mask The subnet mask
+     * @param dns The DNS server's address
+     */
+    void setStaticIP(IPAddress ip, IPAddress gateway, IPAddress mask,
+                     IPAddress dns);
+    /**
+     * @brief Check if a static address has been set.
+     *
+     * @return **bool** True if there is a static address.
+     */
+    bool hasStaticIP(void);
+
+    /**
+     * @brief Check if there is a good connection to try, loading it from
+     * EEPROM the first time.
+     *
+     * @return **bool** True if fast reconnect is on and there is a cached
+     * connection that hasn't been used up.
+     */
+    bool isCached(void);
+    /**
+     * @brief Count a connection made with the cached address.
+     *
+     * Once the cached address has been used #MS_WIFI_CACHE_MAX_REUSES times,
+     * it's no longer offered so the next connection goes back to DHCP.
+     *
+     * @return **bool** True if this use used up the cached address.
+     */
+    bool countReuse(void);
+    /**
+     * @brief Check if the modem should be given an address instead of asking
+     * for one - that is, if there's a static or cached address.
+     *
+     * @return **bool** True if DHCP should be skipped.
+     */
+    bool skipDHCP(void);
+    /**
+     * @brief Keep the details of a good connection, saving them to EEPROM if
+     * #MS_WIFI_CACHE_EEPROM_ADDRESS is defined.
+     *
+     * @param connection The connection to keep
+     */
+    void cache(const wifiConnection& connection);
+    /**
+     * @brief Forget the cached connection.  The static address, if any, is
+     * kept.
+     */
+    void clear(void);
+
+    /**
+     * @brief Get the cached connection.
+     *
+     * @return **const wifiConnection&** The cached connection
+     */
+    const wifiConnection& getConnection(void);
+    /**
+     * @brief Get the address to use - the static one if there is one, or else
+     * the cached one.
+     *
+     * @return **IPAddress** The modem's address
+     */
+    IPAddress getIP(void);
+    /**
+     * @brief Get the gateway to use.
+     *
+     * @return **IPAddress** The gateway's address
+     */
+    IPAddress getGateway(void);
+    /**
+     * @brief Get the subnet mask to use.
+     *
+     * @return **IPAddress** The subnet mask
+     */
+    IPAddress getMask(void);
+    /**
+     * @brief Get the DNS server to use.
+     *
+     * @return **IPAddress** The DNS server's address
+     */
+    IPAddress getDNS(void);
+
+    /**
+     * @brief Print a BSSID as six hex bytes separated by colons, the way the
+     * modems take it.
+     *
+     * @param bssid The six bytes of the BSSID
+     * @param buffer A buffer of at least 18 characters
+     */
+    static void formatBSSID(const uint8_t* bssid, char* buffer);
+    /**
+     * @brief Read a BSSID printed as six hex bytes separated by colons.
+     *
+     * @param text The text of the BSSID
+     * @param bssid The six bytes to fill in
+     * @return **bool** True if the text was a BSSID.
+     */
+    static bool parseBSSID(const char* text, uint8_t* bssid);
+
+ protected:
+    /**
+     * @brief The last good connection; the address is 0 if there is none.
+     */
+    wifiConnection _connection;
+    /**
+     * @brief The static address, if any, in the same form as a connection.
+     */
+    wifiConnection _static;
+    /**
+     * @brief The number of connections that have reused the cached address.
+     *
+     * This isn't kept in EEPROM, so a reset gives the address a fresh count.
+     */
+    uint16_t       _reuses;
+    bool           _fastReconnect;
+    bool           _hasStaticIP;
+    bool           _loaded;
+};
+
+#endif  // SRC_WIFICONNECTIONCACHE_H_
@@ -12,6 +12,9 @@
 
 char dataPublisher::txBuffer[MS_SEND_BUFFER_SIZE] = {'\0'};
 
+// The version of the layout of the saved daily totals
+#define MS_PUBLISHER_STATS_VERSION 2
+
 // Basic chunks of HTTP
 const char* dataPublisher::getHeader  = "GET ";
 const char* dataPublisher::postHeader = "POST ";
@@ -20,28 +23,64 @@ const char* dataPublisher::hostHeader = "\r\nHost: ";
 
 // Constructors
 dataPublisher::dataPublisher() {
+    initRegistry();
     _baseLogger = NULL;
     _inClient   = NULL;
     _sendEveryX = 1;
     _sendOffset = 0;
+
+    _publishState     = PUBLISHER_IDLE;
+    _publishClient    = NULL;
+    _publishResult    = 0;
+    _publishStart     = 0;
+    _nextRecordToSend = 0;
+    _retryCount       = 0;
+    _retryStart       = 0;
+    _retryDelay       = 0;
+    _retryWaitStart   = 0;
+    initStats();
     // MS_DBG(F("dataPublisher object created"));
 }
 dataPublisher::dataPublisher(Logger& baseLogger, uint8_t sendEveryX,
                              uint8_t sendOffset) {
+    initRegistry();
     _baseLogger = &baseLogger;
     _baseLogger->registerDataPublisher(this);  // register self with logger
     _sendEveryX = sendEveryX;
     _sendOffset = sendOffset;
     _inClient   = NULL;
+
+    _publishState     = PUBLISHER_IDLE;
+    _publishClient    = NULL;
+    _publishResult    = 0;
+    _publishStart     = 0;
+    _nextRecordToSend = 0;
+    _retryCount       = 0;
+    _retryStart       = 0;
+    _retryDelay       = 0;
+    _retryWaitStart   = 0;
+    initStats();
     // MS_DBG(F("dataPublisher object created"));
 }
 dataPublisher::dataPublisher(Logger& baseLogger, Client* inClient,
                              uint8_t sendEveryX, uint8_t sendOffset) {
+    initRegistry();
     _baseLogger = &baseLogger;
     _baseLogger->registerDataPublisher(this);  // register self with logger
     _sendEveryX = sendEveryX;
     _sendOffset = sendOffset;
     _inClient   = inClient;
+
+    _publishState     = PUBLISHER_IDLE;
+    _publishClient    = NULL;
+    _publishResult    = 0;
+    _publishStart     = 0;
+    _nextRecordToSend = 0;
+    _retryCount       = 0;
+    _retryStart       = 0;
+    _retryDelay       = 0;
+    _retryWaitStart   = 0;
+    initStats();
     // MS_DBG(F("dataPublisher object created"));
 }
 // Destructor
@@ -116,7 +155,10 @@ int16_t dataPublisher::publishData() {
         PRINTOUT(F("ERROR! No web client assigned to publish data!"));
         return 0;
     } else {
-        return publishData(_inClient);
+        startMetering(_inClient);
+        int16_t result = publishData(&_meter);
+        stopMetering(result);
+        return result;
     }
 }
 // Duplicates for backwards compatibility
@@ -128,6 +170,324 @@ int16_t dataPublisher::sendData() {
 }
 
 
+// Starts publishing data.  Publishers which don't have a non-blocking
+// implementation do all their work here and are immediately complete.
+bool dataPublisher::publishDataBegin(Client* outClient) {
+    if (_publishState != PUBLISHER_IDLE) {
+        MS_DBG(F("Publisher is already busy!"));
+        return false;
+    }
+    _publishClient = outClient;
+    _publishResult = publishData(outClient);
+    _publishState  = PUBLISHER_COMPLETE;
+    return true;
+}
+bool dataPublisher::publishDataBegin(void) {
+    if (_inClient == NULL) {
+        PRINTOUT(F("ERROR! No web client assigned to publish data!"));
+        if (_publishState != PUBLISHER_IDLE) return false;
+        _publishResult = 0;
+        _publishState  = PUBLISHER_COMPLETE;
+        return true;
+    } else {
+        // Count everything sent on the linked client
+        if (_publishState == PUBLISHER_IDLE) startMetering(_inClient);
+        return publishDataBegin(&_meter);
+    }
+}
+
+
+// Checks for a response without waiting for it
+bool dataPublisher::publishDataPoll(void) {
+    if (_publishState == PUBLISHER_RETRY_WAIT) { return retryPublish(); }
+    if (_publishState != PUBLISHER_AWAITING_RESPONSE) { return true; }
+
+    // Read whatever has arrived so far; keep waiting until the whole response
+    // is in, the server hangs up, or we give up on it
+    if (!_response.parse(_publishClient) &&
+        (_publishClient->connected() || _publishClient->available() > 0) &&
+        millis() - _publishStart < MS_PUBLISHER_RESPONSE_TIMEOUT_MS) {
+        return false;
+    }
+    MS_DBG(F("Response received after"), millis() - _publishStart, F("ms"));
+
+    // Close the TCP/IP connection
+    MS_DBG(F("Stopping client"));
+    MS_START_DEBUG_TIMER;
+    _publishClient->stop();
+    MS_DBG(F("Client stopped after"), MS_PRINT_DEBUG_TIMER, F("ms"));
+
+    // Anything without at least a status line counts as a timeout
+    int16_t responseCode = _response.getStatusCode();
+    if (responseCode == 0) { responseCode = 504; }
+    completePublish(responseCode);
+    return _publishState == PUBLISHER_COMPLETE;
+}
+
+
+// Waits for the request to finish and resets the state machine
+int16_t dataPublisher::publishDataFinish(void) {
+    while (!publishDataPoll()) { delay(10); }
+    int16_t result = _publishResult;
+    stopMetering(result);
+    _publishState  = PUBLISHER_IDLE;
+    _publishClient = NULL;
+    _retryCount    = 0;
+    _response.reset();
+    return result;
+}
+
+
+publisherState dataPublisher::getPublishState(void) {
+    return _publishState;
+}
+Client* dataPublisher::getClient(void) {
+    return _inClient;
+}
+
+
+// Gives up on the publish in progress
+void dataPublisher::publishDataAbort(void) {
+    if (_publishState == PUBLISHER_IDLE ||
+        _publishState == PUBLISHER_COMPLETE) {
+        return;
+    }
+    if (_publishState == PUBLISHER_AWAITING_RESPONSE &&
+        _publishClient != NULL) {
+        _publishClient->stop();
+    }
+    _publishResult = 504;
+    _publishState  = PUBLISHER_COMPLETE;
+    PRINTOUT(F("Gave up on publishing to"), getEndpoint());
+}
+
+
+// Sets the order the logger publishes in
+void dataPublisher::setPriority(uint8_t priority) {
+    _priority = priority;
+    // Move to the right place in the logger's list
+    if (_baseLogger != NULL) _baseLogger->registerDataPublisher(this);
+}
+uint8_t dataPublisher::getPriority(void) {
+    return _priority;
+}
+void dataPublisher::setTimeBudget(uint32_t budget_ms) {
+    _timeBudget_ms = budget_ms;
+}
+uint32_t dataPublisher::getTimeBudget(void) {
+    return _timeBudget_ms;
+}
+bool dataPublisher::isOverTimeBudget(void) {
+    return _timeBudget_ms > 0 && millis() - _budgetStart >= _timeBudget_ms;
+}
+dataPublisher* dataPublisher::getNextPublisher(void) {
+    return _nextPublisher;
+}
+void dataPublisher::initRegistry(void) {
+    _nextPublisher  = NULL;
+    _priority       = MS_PUBLISHER_DEFAULT_PRIORITY;
+    _timeBudget_ms  = 0;
+    _budgetStart    = 0;
+    _publishPending = false;
+}
+
+
+void dataPublisher::awaitHTTPResponse(Client* outClient) {
+    _publishClient = outClient;
+    _publishStart  = millis();
+    _publishState  = PUBLISHER_AWAITING_RESPONSE;
+    _response.reset();
+}
+void dataPublisher::completePublish(int16_t result) {
+    _publishResult = result;
+    _publishState  = PUBLISHER_COMPLETE;
+
+    PRINTOUT(F("-- Response Code --"));
+    PRINTOUT(result);
+
+    // A publish started on the linked client can always be retried on it
+    Client* retryClient = _metering ? &_meter : _publishClient;
+    if (!isTransientFailure(result) || retryClient == NULL ||
+        _retryCount >= MS_PUBLISHER_MAX_RETRIES) {
+        return;
+    }
+    if (_retryCount == 0) {
+        _retryStart = millis();
+        _retryDelay = MS_PUBLISHER_RETRY_DELAY_MS;
+    }
+    // Wait longer if the server asked us to
+    uint32_t retryAfter_s = _response.getRetryAfter();
+    if (retryAfter_s > MS_PUBLISHER_RETRY_BUDGET_MS / 1000L) {
+        PRINTOUT(F("Server asked to wait"), retryAfter_s,
+                 F("s before trying again; giving up"));
+        return;
+    }
+    if (retryAfter_s * 1000L > _retryDelay) _retryDelay = retryAfter_s * 1000L;
+    if (millis() - _retryStart + _retryDelay > MS_PUBLISHER_RETRY_BUDGET_MS) {
+        MS_DBG(F("No time left to try again"));
+        return;
+    }
+
+    PRINTOUT(F("Trying again in"), _retryDelay, F("ms"));
+    _publishClient  = retryClient;
+    _retryWaitStart = millis();
+    _publishState   = PUBLISHER_RETRY_WAIT;
+}
+
+
+// Only timeouts and errors that say the server is busy or down for the
+// moment are worth trying again
+bool dataPublisher::isTransientFailure(int16_t result) {
+    switch (result) {
+        case 408:
+        case 429:
+        case 500:
+        case 502:
+        case 503:
+        case 504: return true;
+        default: return false;
+    }
+}
+
+
+bool dataPublisher::retryPublish(void) {
+    if (millis() - _retryWaitStart < _retryDelay) return false;
+
+    _retryCount++;
+    _retryDelay *= 2;
+    PRINTOUT(F("Retry"), _retryCount, F("of"), MS_PUBLISHER_MAX_RETRIES,
+             F("to"), getEndpoint());
+    // Each retry is bounded by the budget, so it's safe to hold off the
+    // watch-dog for it
+    if (_baseLogger != NULL) _baseLogger->watchDogTimer.resetWatchDog();
+
+    Client* outClient = _publishClient;
+    _publishState     = PUBLISHER_IDLE;
+    _response.reset();
+    publishDataBegin(outClient);
+    return _publishState == PUBLISHER_COMPLETE;
+}
+
+
+// Keeps track of which records from the log buffer have been sent
+uint32_t dataPublisher::getFirstUnsentRecord(void) {
+    LogBuffer* logBuffer = _baseLogger->getLogBuffer();
+    if (logBuffer == NULL) return _nextRecordToSend;
+    // Skip any records that were dropped before we got to them
+    if (_nextRecordToSend < logBuffer->getFirstRecordNumber()) {
+        MS_DBG(logBuffer->getFirstRecordNumber() - _nextRecordToSend,
+               F("records were dropped from the log buffer before they could "
+                 "be sent to"),
+               getEndpoint());
+        _nextRecordToSend = logBuffer->getFirstRecordNumber();
+    }
+    return _nextRecordToSend;
+}
+uint16_t dataPublisher::getNumUnsentRecords(void) {
+    LogBuffer* logBuffer = _baseLogger->getLogBuffer();
+    if (logBuffer == NULL) return 0;
+    return logBuffer->getNextRecordNumber() - getFirstUnsentRecord();
+}
+void dataPublisher::markRecordsSent(uint32_t nextRecord) {
+    if (nextRecord > _nextRecordToSend) _nextRecordToSend = nextRecord;
+}
+
+
+// Keeps track of how much each publisher uses the connection
+publisherStats dataPublisher::getDailyStats(void) {
+    updateStatsDay();
+    return _stats[0];
+}
+publisherStats dataPublisher::getPreviousDayStats(void) {
+    updateStatsDay();
+    return _stats[1];
+}
+void dataPublisher::setStatsAddress(int16_t address) {
+    _statsAddress = address;
+    _statsLoaded  = false;
+}
+
+
+void dataPublisher::initStats(void) {
+    memset(_stats, 0, sizeof(_stats));
+    _metering       = false;
+    _statsLoaded    = false;
+    _statsSavedHour = 0;
+    _statsAddress   = -1;
+}
+
+
+void dataPublisher::startMetering(Client* outClient) {
+    _meter.begin(outClient);
+    _metering = true;
+}
+
+
+void dataPublisher::stopMetering(int16_t result) {
+    if (!_metering) return;
+    _metering = false;
+    updateStatsDay();
+
+    publisherStats& today = _stats[0];
+    today.bytesSent += _meter.getBytesSent();
+    today.bytesReceived += _meter.getBytesReceived();
+    today.connectTime_ms += _meter.getConnectTime();
+    today.responseTime_ms += _meter.getResponseTime();
+    today.publishTime_ms += _meter.getElapsedTime();
+    today.numConnections += _meter.getNumConnections();
+    today.numResponses += _meter.getNumResponses();
+    today.numPublishes++;
+    // Time the socket connections along with the modem's connection phases
+    if (_meter.getNumConnections() > 0) {
+        loggerModem::recordPhaseTime(
+            MODEM_PHASE_SOCKET,
+            _meter.getConnectTime() / _meter.getNumConnections());
+    }
+    // Count a timeout once, not also as the 504 it's reported as
+    if (_meter.getBytesReceived() == 0) {
+        today.numTimeouts++;
+    } else {
+        uint8_t resultClass = (result >= 100 && result < 600) ? result / 100
+                                                              : 0;
+        today.resultCounts[resultClass]++;
+    }
+
+    MS_DBG(getEndpoint(), F("sent"), _meter.getBytesSent(), F("bytes and got"),
+           _meter.getBytesReceived(), F("back in"), _meter.getElapsedTime(),
+           F("ms; connecting took"), _meter.getConnectTime(),
+           F("ms and the first response"), _meter.getResponseTime(), F("ms"));
+
+    // Save at most once an hour to spare the EEPROM
+    uint32_t hour = Logger::markedEpochTime / 3600;
+    if (hour != _statsSavedHour) {
+        PersistentStore::save(_statsAddress, _stats, sizeof(_stats),
+                              MS_PUBLISHER_STATS_VERSION);
+        _statsSavedHour = hour;
+    }
+}
+
+
+void dataPublisher::updateStatsDay(void) {
+    if (!_statsLoaded) {
+        PersistentStore::load(_statsAddress, _stats, sizeof(_stats),
+                              MS_PUBLISHER_STATS_VERSION);
+        _statsLoaded = true;
+    }
+    uint32_t day = Logger::markedEpochTime / 86400L;
+    if (day == _stats[0].day) return;
+
+    // Roll today's totals back to yesterday, if they really are yesterday's
+    if (day == _stats[0].day + 1) {
+        _stats[1] = _stats[0];
+    } else {
+        memset(&_stats[1], 0, sizeof(publisherStats));
+        _stats[1].day = day - 1;
+    }
+    memset(&_stats[0], 0, sizeof(publisherStats));
+    _stats[0].day = day;
+}
+
+
 // This spits out a string description of the PubSubClient codes
 String dataPublisher::parseMQTTState(int state) {
     // // Possible values for client.state()
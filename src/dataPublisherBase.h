@@ -51,8 +51,145 @@
 #include "ModSensorDebugger.h"
 #undef MS_DEBUGGING_STD
 #include "LoggerBase.h"
+#include "HTTPResponseParser.h"
+#include "MeteredClient.h"
+#include "PersistentStore.h"
 #include "Client.h"
 
+/**
+ * @def MS_PUBLISHER_RESPONSE_TIMEOUT_MS
+ * @brief Response Timeout
+ *
+ * The maximum time in milliseconds to wait for a remote to respond to a
+ * request before giving up on it.
+ *
+ * This can be changed by setting the build flag
+ * MS_PUBLISHER_RESPONSE_TIMEOUT_MS when compiling.
+ *
+ * @ingroup the_publishers
+ */
+#ifndef MS_PUBLISHER_RESPONSE_TIMEOUT_MS
+#define MS_PUBLISHER_RESPONSE_TIMEOUT_MS 10000L
+#endif
+
+/**
+ * @def MS_PUBLISHER_MAX_RETRIES
+ * @brief The number of times a publisher tries again after a transient
+ * failure.
+ *
+ * Failures to connect, timeouts, 408 (Request Timeout), 429 (Too Many
+ * Requests), 500, 502, 503 and 504 responses are tried again, within the same
+ * modem session.  Set this to 0 to never try again.
+ *
+ * This can be changed by setting the build flag MS_PUBLISHER_MAX_RETRIES when
+ * compiling.
+ *
+ * @ingroup the_publishers
+ */
+#ifndef MS_PUBLISHER_MAX_RETRIES
+#define MS_PUBLISHER_MAX_RETRIES 3
+#endif
+
+/**
+ * @def MS_PUBLISHER_RETRY_DELAY_MS
+ * @brief The time in milliseconds to wait before the first retry.
+ *
+ * The wait doubles with each retry after that.  If the server asks for a
+ * longer wait with a `Retry-After` header, that wait is used instead.
+ *
+ * This can be changed by setting the build flag MS_PUBLISHER_RETRY_DELAY_MS
+ * when compiling.
+ *
+ * @ingroup the_publishers
+ */
+#ifndef MS_PUBLISHER_RETRY_DELAY_MS
+#define MS_PUBLISHER_RETRY_DELAY_MS 2000L
+#endif
+
+/**
+ * @def MS_PUBLISHER_RETRY_BUDGET_MS
+ * @brief The longest time in milliseconds a publisher may spend retrying in
+ * one publishing cycle, counted from the first failure.
+ *
+ * A retry which would not start within the budget is not made.  The
+ * watch-dog is reset before each retry, so this should be well under the
+ * watch-dog timeout.
+ *
+ * This can be changed by setting the build flag MS_PUBLISHER_RETRY_BUDGET_MS
+ * when compiling.
+ *
+ * @ingroup the_publishers
+ */
+#ifndef MS_PUBLISHER_RETRY_BUDGET_MS
+#define MS_PUBLISHER_RETRY_BUDGET_MS 60000L
+#endif
+
+/**
+ * @def MS_PUBLISHER_DEFAULT_PRIORITY
+ * @brief The priority given to publishers that aren't given one with
+ * dataPublisher::setPriority(uint8_t).
+ *
+ * Publishers with a lower number are started first.
+ *
+ * This can be changed by setting the build flag MS_PUBLISHER_DEFAULT_PRIORITY
+ * when compiling.
+ *
+ * @ingroup the_publishers
+ */
+#ifndef MS_PUBLISHER_DEFAULT_PRIORITY
+#define MS_PUBLISHER_DEFAULT_PRIORITY 128
+#endif
+
+/**
+ * @def MS_PUBLISHER_STATS_BLOCK_SIZE
+ * @brief The number of bytes of EEPROM used for each publisher's daily totals.
+ *
+ * Each publisher's totals are only saved if it's given an address with
+ * dataPublisher::setStatsAddress(int16_t); space the addresses by at least
+ * this much.
+ *
+ * @ingroup the_publishers
+ */
+#define MS_PUBLISHER_STATS_BLOCK_SIZE \
+    PersistentStore::getBlockSize(2 * sizeof(publisherStats))
+
+/**
+ * @brief Running totals of a publisher's use of the connection over one day.
+ *
+ * @ingroup the_publishers
+ */
+typedef struct publisherStats {
+    uint32_t day;              ///< Days since the epoch these totals are for
+    uint32_t bytesSent;        ///< Bytes written to the client
+    uint32_t bytesReceived;    ///< Bytes read from the client
+    uint32_t connectTime_ms;   ///< Total time spent opening connections
+    uint32_t responseTime_ms;  ///< Total time from requests to responses
+    uint32_t publishTime_ms;   ///< Total time from start to finish
+    uint16_t numPublishes;     ///< Number of times data was published
+    uint16_t numConnections;   ///< Number of connections opened
+    uint16_t numResponses;     ///< Number of responses timed
+    uint16_t numTimeouts;      ///< Publishes that got no response at all
+    /**
+     * @brief The number of responses of each class: [0] results that aren't
+     * HTTP status codes (ie, MQTT states), [1]-[5] 1xx-5xx status codes.
+     * Timeouts are only counted in numTimeouts.
+     */
+    uint16_t resultCounts[6];
+} publisherStats;
+
+/**
+ * @brief The possible states of the non-blocking publishing state machine of a
+ * dataPublisher.
+ *
+ * @ingroup the_publishers
+ */
+typedef enum publisherState {
+    PUBLISHER_IDLE = 0,  ///< Nothing is in progress
+    PUBLISHER_AWAITING_RESPONSE,  ///< The request is out; waiting for a reply
+    PUBLISHER_RETRY_WAIT,  ///< Failed; waiting to try again
+    PUBLISHER_COMPLETE  ///< Done; the result can be collected with finish
+} publisherState;
+
 /**
  * @brief The dataPublisher class is a virtual class used by other publishers to
  * distribute data online.
@@ -64,6 +201,12 @@
  * @ingroup base_classes
  */
 class dataPublisher {
+    /**
+     * @brief The logger keeps its registered publishers in a list through the
+     * publishers themselves.
+     */
+    friend class Logger;
+
  public:
     /**
      * @brief Construct a new data Publisher object untied to any logger or
@@ -206,6 +349,28 @@ class dataPublisher {
      * @return **String** The URL or HOST to receive published data
      */
     virtual String getEndpoint(void) = 0;
+    /**
+     * @brief Check if the publisher sends its unsent records from the
+     * logger's LogBuffer.
+     *
+     * If it does, a record it skips is kept and sent later.  Publishers that
+     * only send the current values return false; a record they skip is lost.
+     *
+     * @return **bool** True if the publisher sends from the LogBuffer.
+     */
+    virtual bool usesLogBuffer(void) {
+        return false;
+    }
+    /**
+     * @brief Check if a result returned by publishData(Client*) means the
+     * data was accepted.
+     *
+     * @param result The result code of the request.
+     * @return **bool** True for a 2xx HTTP or CoAP response.
+     */
+    virtual bool isPublishSuccess(int16_t result) {
+        return result >= 200 && result < 300;
+    }
 
 
     /**
@@ -257,6 +422,144 @@ class dataPublisher {
      */
     virtual int16_t sendData();
 
+    /**
+     * @anchor publisher_async
+     * @name Non-blocking publishing
+     *
+     * Functions to publish data without blocking while waiting on the remote.
+     *
+     * Publishing is split into three steps:  publishDataBegin(...) opens the
+     * connection and sends out the request, publishDataPoll() checks for a
+     * response without waiting, and publishDataFinish() returns the result and
+     * resets the publisher so it can be used again.  This allows several
+     * publishers using different clients (ie, different sockets on a
+     * multi-socket modem) to wait on their remotes at the same time and allows
+     * the logger to do other work while waiting.
+     *
+     * Publishers that do not implement their own begin function fall back to
+     * the blocking publishData(Client* outClient) and are complete as soon as
+     * begin returns.
+     *
+     * Transient failures are tried again by publishDataPoll(), with the wait
+     * doubling each time, up to #MS_PUBLISHER_MAX_RETRIES times and within
+     * #MS_PUBLISHER_RETRY_BUDGET_MS.  A retry needs to know the client, so
+     * only publishes started on the linked client or that reached the point
+     * of waiting for a response are retried.
+     */
+    /**@{*/
+    /**
+     * @brief Open a socket to the correct receiver and send out the formatted
+     * data, without waiting for the response.
+     *
+     * @param outClient An Arduino client instance to use to print data to.
+     * Allows the use of any type of client and multiple clients tied to a
+     * single TinyGSM modem instance
+     * @return **bool** True if the request was started; false if the publisher
+     * was already busy.
+     */
+    virtual bool publishDataBegin(Client* outClient);
+    /**
+     * @brief Start publishing data on the client linked to the publisher,
+     * without waiting for the response.
+     *
+     * @return **bool** True if the request was started; false if the publisher
+     * was already busy.
+     */
+    virtual bool publishDataBegin(void);
+    /**
+     * @brief Check for a response from the remote and advance the publishing
+     * state machine.  This never waits.
+     *
+     * @return **bool** True if the publisher is done (or was never started).
+     */
+    virtual bool publishDataPoll(void);
+    /**
+     * @brief Wait for the publisher to be done, return the result, and reset
+     * the publisher to idle.
+     *
+     * @return **int16_t** The result of publishing data.  May be an http
+     * response code or a result code from PubSubClient.
+     */
+    int16_t publishDataFinish(void);
+    /**
+     * @brief Get the current state of the publishing state machine.
+     *
+     * @return **publisherState** The current state
+     */
+    publisherState getPublishState(void);
+    /**
+     * @brief Get the client linked to the publisher.
+     *
+     * @return **Client*** The client, or NULL if none has been set
+     */
+    Client* getClient(void);
+    /**
+     * @brief Give up on the publish in progress, if there is one.
+     *
+     * Any open connection is closed and the result is set to 504.  No retry
+     * is made.  Call publishDataFinish() afterwards to reset the publisher.
+     */
+    virtual void publishDataAbort(void);
+    /**@}*/
+
+    /**
+     * @anchor publisher_priority
+     * @name Priorities and time budgets
+     *
+     * Functions to choose which publishers go first and how long each may
+     * take.
+     *
+     * The logger starts its publishers in order of priority, so when the
+     * connection is slow or the logger's publishing budget runs out (see
+     * Logger::setPublishingBudget(uint32_t)), the most important remote gets
+     * the data first and the least important ones wait until the next cycle.
+     */
+    /**@{*/
+    /**
+     * @brief Set the priority of the publisher.
+     *
+     * Publishers with a lower number go first; publishers with the same
+     * priority go in the order they were created.  The default is
+     * #MS_PUBLISHER_DEFAULT_PRIORITY.
+     *
+     * @param priority The priority, 0 being the most important
+     */
+    void setPriority(uint8_t priority);
+    /**
+     * @brief Get the priority of the publisher.
+     *
+     * @return **uint8_t** The priority, 0 being the most important
+     */
+    uint8_t getPriority(void);
+    /**
+     * @brief Set the longest time the logger will let one publish (including
+     * any retries) take before giving up on it.
+     *
+     * @param budget_ms The time in milliseconds; 0 for no limit.
+     */
+    void setTimeBudget(uint32_t budget_ms);
+    /**
+     * @brief Get the longest time the logger will let one publish take.
+     *
+     * @return **uint32_t** The time in milliseconds; 0 for no limit.
+     */
+    uint32_t getTimeBudget(void);
+    /**
+     * @brief Check if the publish started by the logger has gone on longer
+     * than the publisher's time budget.
+     *
+     * @return **bool** True if the time is up
+     */
+    bool isOverTimeBudget(void);
+    /**
+     * @brief Get the next publisher registered with the same logger.
+     *
+     * @return **dataPublisher*** The publisher with the next lower priority,
+     * or NULL if this is the last.
+     */
+    dataPublisher* getNextPublisher(void);
+    /**@}*/
+
     /**
      * @brief Translate a PubSubClient code into a String with the code
      * explanation.
@@ -266,6 +569,47 @@ class dataPublisher {
      */
     String parseMQTTState(int state);
 
+    /**
+     * @anchor publisher_stats
+     * @name Usage accounting
+     *
+     * Functions to see how much each publisher uses the connection.
+     *
+     * When a publisher publishes on its own linked client (ie, with
+     * publishData() or publishDataBegin(), as the logger does), everything it
+     * writes and reads is counted.  The totals are kept for the current day and
+     * the day before.  If the publisher has been given an EEPROM address with
+     * setStatsAddress(int16_t), the totals are saved to EEPROM at most once an
+     * hour and survive a restart.
+     *
+     * Use a PublisherStats sensor to log the totals as variables.
+     */
+    /**@{*/
+    /**
+     * @brief Get the running totals for the current day.
+     *
+     * @return **publisherStats** The totals
+     */
+    publisherStats getDailyStats(void);
+    /**
+     * @brief Get the totals for the day before the current one.
+     *
+     * @return **publisherStats** The totals
+     */
+    publisherStats getPreviousDayStats(void);
+    /**
+     * @brief Set the EEPROM address to save the daily totals at.
+     *
+     * The totals aren't saved unless this is called.  The address belongs to
+     * this publisher, so it must not change if publishers are added or
+     * removed; each publisher takes #MS_PUBLISHER_STATS_BLOCK_SIZE bytes.
+     * Call this before the logger starts publishing.
+     *
+     * @param address The EEPROM address; negative to not save the totals.
+     */
+    void setStatsAddress(int16_t address);
+    /**@}*/
+
 
  protected:
     /**
@@ -279,6 +623,11 @@ class dataPublisher {
 
     /**
      * @brief A buffer for outgoing data.
+     *
+     * The buffer is shared by all publishers.  The HTTP publishers build
+     * their requests in it with strcat() and expect it to start out empty,
+     * so a publisher that writes binary data into it must leave it emptied
+     * with emptyTxBuffer() when it's done.
      */
     static char txBuffer[MS_SEND_BUFFER_SIZE];
     /**
@@ -302,6 +651,175 @@ class dataPublisher {
      */
     static void printTxBuffer(Stream* stream, bool addNewLine = false);
 
+    /**
+     * @brief The current state of the publishing state machine.
+     */
+    publisherState _publishState;
+    /**
+     * @brief The client in use by the request in progress.
+     */
+    Client* _publishClient;
+    /**
+     * @brief The result of the last finished request.
+     */
+    int16_t _publishResult;
+    /**
+     * @brief The processor time when the request in progress was sent.
+     */
+    uint32_t _publishStart;
+    /**
+     * @brief The parser for the HTTP response to the request in progress.
+     */
+    HTTPResponseParser _response;
+    /**
+     * @brief The number of retries made of the publish in progress.
+     */
+    uint8_t _retryCount;
+    /**
+     * @brief The processor time of the first failure of the publish in
+     * progress.
+     */
+    uint32_t _retryStart;
+    /**
+     * @brief The time in milliseconds to wait before the next retry.
+     */
+    uint32_t _retryDelay;
+    /**
+     * @brief The processor time the current wait before a retry started.
+     */
+    uint32_t _retryWaitStart;
+    /**
+     * @brief Mark an HTTP request as sent so publishDataPoll() will wait for
+     * and parse the response.
+     *
+     * @param outClient The client the request was sent on.
+     */
+    void awaitHTTPResponse(Client* outClient);
+    /**
+     * @brief Mark the request in progress as finished, or set up a retry if
+     * it failed in a way that might not happen again.
+     *
+     * @param result The result code of the request.
+     */
+    void completePublish(int16_t result);
+    /**
+     * @brief Check if a result is a failure worth trying again.
+     *
+     * @param result The result code of the request.
+     * @return **bool** True for a timeout or a transient error response.
+     */
+    static bool isTransientFailure(int16_t result);
+    /**
+     * @brief Start the retry that is due.
+     *
+     * @return **bool** True if the publisher is done.
+     */
+    bool retryPublish(void);
+
+    /**
+     * @brief The record number of the next record in the logger's LogBuffer
+     * this publisher needs to send.
+     */
+    uint32_t _nextRecordToSend;
+    /**
+     * @brief Get the record number of the oldest record in the logger's
+     * LogBuffer this publisher has not yet sent.
+     *
+     * @return **uint32_t** The first unsent record number
+     */
+    uint32_t getFirstUnsentRecord(void);
+    /**
+     * @brief Get the number of records in the logger's LogBuffer this
+     * publisher has not yet sent.
+     *
+     * @return **uint16_t** The number of unsent records; 0 if the logger has
+     * no LogBuffer.
+     */
+    uint16_t getNumUnsentRecords(void);
+    /**
+     * @brief Mark all records before the given record number as sent.
+     *
+     * @param nextRecord The record number of the first record still unsent
+     */
+    void markRecordsSent(uint32_t nextRecord);
+
+    /**
+     * @brief The wrapper that counts what the publisher sends and receives on
+     * its linked client.
+     */
+    MeteredClient _meter;
+    /**
+     * @brief True if a publish on the metered client hasn't been counted yet.
+     */
+    bool _metering;
+    /**
+     * @brief The totals for the current day ([0]) and the day before ([1]).
+     */
+    publisherStats _stats[2];
+    /**
+     * @brief The EEPROM address of the saved totals; negative if they aren't
+     * saved.
+     */
+    int16_t _statsAddress;
+    /**
+     * @brief True once any saved totals have been read from EEPROM.
+     */
+    bool _statsLoaded;
+    /**
+     * @brief The hour (since the epoch) the totals were last saved.
+     */
+    uint32_t _statsSavedHour;
+    /**
+     * @brief Zero the daily totals.
+     */
+    void initStats(void);
+    /**
+     * @brief Start counting a publish on a client.
+     *
+     * @param outClient The client to count
+     */
+    void startMetering(Client* outClient);
+    /**
+     * @brief Add a finished publish to the daily totals.
+     *
+     * Nothing is added if metering wasn't started or the publish was already
+     * counted.
+     *
+     * @param result The result of the publish
+     */
+    void stopMetering(int16_t result);
+    /**
+     * @brief Read the saved totals if they haven't been read yet and move the
+     * totals along to the current day.
+     */
+    void updateStatsDay(void);
+
+    /**
+     * @brief The next publisher registered with the same logger.
+     */
+    dataPublisher* _nextPublisher;
+    /**
+     * @brief The priority of the publisher; 0 is the most important.
+     */
+    uint8_t _priority;
+    /**
+     * @brief The longest time in milliseconds for one publish; 0 for no limit.
+     */
+    uint32_t _timeBudget_ms;
+    /**
+     * @brief The processor time the logger started the current publish.
+     */
+    uint32_t _budgetStart;
+    /**
+     * @brief True while the logger is waiting for this publisher to finish.
+     */
+    bool _publishPending;
+    /**
+     * @brief Set the defaults for the priority and time budget, before the
+     * publisher is registered with a logger.
+     */
+    void initRegistry(void);
+
     /**
      * @brief Unimplemented; intended for future use to enable caching and bulk
      * publishing.
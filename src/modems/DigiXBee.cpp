@@ -9,6 +9,14 @@
 
 // Included Dependencies
 #include "DigiXBee.h"
+#include "DigiXBeeAPI.h"
+
+// The version of the settings hash kept in EEPROM
+#define XBEE_CONFIG_VERSION 1
+// The most settings that can be checked at once; one bit each of a uint32_t
+#define XBEE_MAX_SETTINGS 32
+// The time to wait for each line of an answer in command mode
+#define XBEE_COMMAND_TIMEOUT_MS 1000L
 
 
 // Constructor
@@ -53,3 +61,147 @@ bool DigiXBee::modemSleepFxn(void) {
         return true;
     }
 }
+
+
+bool DigiXBee::applyXBeeSettings(Stream& stream, const xbeeSetting* settings,
+                                 uint8_t numSettings, bool& changed) {
+    changed = false;
+    if (numSettings > XBEE_MAX_SETTINGS) numSettings = XBEE_MAX_SETTINGS;
+    stream.setTimeout(XBEE_COMMAND_TIMEOUT_MS);
+
+    // Ask for all of the settings at once; the XBee answers each command of a
+    // comma separated line with its own line
+    stream.print(F("AT"));
+    for (uint8_t i = 0; i < numSettings; i++) {
+        if (i > 0) stream.print(',');
+        stream.print(settings[i].command);
+    }
+    stream.print('\r');
+    uint32_t differs = 0;
+    for (uint8_t i = 0; i < numSettings; i++) {
+        String current = stream.readStringUntil('\r');
+        current.trim();
+        if (!current.equalsIgnoreCase(settings[i].value)) {
+            differs |= 1UL << i;
+            MS_DBG(F("XBee"), settings[i].command, F("is"), current,
+                   F("instead of"), settings[i].value);
+            changed = true;
+        }
+    }
+    if (!changed) {
+        MS_DBG(F("All"), numSettings, F("XBee settings are already correct"));
+        return true;
+    }
+
+    // Write only the ones that differ, then save them to flash
+    uint8_t numChanges = 1;
+    stream.print(F("AT"));
+    for (uint8_t i = 0; i < numSettings; i++) {
+        if (!(differs & (1UL << i))) continue;
+        stream.print(settings[i].command);
+        stream.print(settings[i].value);
+        stream.print(',');
+        numChanges++;
+    }
+    stream.print(F("WR\r"));
+    bool success = true;
+    for (uint8_t i = 0; i < numChanges; i++) {
+        String response = stream.readStringUntil('\r');
+        response.trim();
+        success &= response == F("OK");
+    }
+    MS_DBG(F("Wrote"), numChanges - 1, F("XBee settings"),
+           success ? F("successfully") : F("but not all were taken"));
+    return success;
+}
+
+
+bool DigiXBee::applyXBeeSettings(DigiXBeeAPI& api, const xbeeSetting* settings,
+                                 uint8_t numSettings, bool& changed) {
+    changed      = false;
+    bool success = true;
+    for (uint8_t i = 0; i < numSettings; i++) {
+        const xbeeSetting& setting = settings[i];
+        // Numbers come back as big-endian bytes, and text as it is
+        uint8_t        length;
+        const uint8_t* current = NULL;
+        if (api.atCommand(setting.command)) current = api.getResponse(length);
+        bool matches = false;
+        if (current != NULL && setting.isText) {
+            matches = length == strlen(setting.value) &&
+                memcmp(current, setting.value, length) == 0;
+        } else if (current != NULL) {
+            uint32_t value = 0;
+            for (uint8_t j = 0; j < length && j < 4; j++) {
+                value = (value << 8) | current[j];
+            }
+            matches = value == strtoul(setting.value, NULL, 16);
+        }
+        if (matches) continue;
+
+        MS_DBG(F("XBee"), setting.command, F("differs from"), setting.value);
+        changed = true;
+        if (setting.isText) {
+            const uint8_t* text =
+                reinterpret_cast<const uint8_t*>(setting.value);
+            success &= api.atCommand(setting.command, text,
+                                     strlen(setting.value));
+        } else {
+            success &= api.setNumber(setting.command,
+                                     strtoul(setting.value, NULL, 16));
+        }
+    }
+    if (!changed) {
+        MS_DBG(F("All"), numSettings, F("XBee settings are already correct"));
+        return true;
+    }
+    success &= api.atCommand("WR");
+    MS_DBG(F("Wrote the XBee settings"),
+           success ? F("successfully") : F("but not all were taken"));
+    return success;
+}
+
+
+uint32_t DigiXBee::getXBeeConfigHash(const xbeeSetting* settings,
+                                     uint8_t numSettings) {
+    uint32_t hash = 2166136261UL;
+    for (uint8_t i = 0; i < numSettings; i++) {
+        // Hash the terminating nulls too, so the split between each command
+        // and value counts
+        const char* parts[2] = {settings[i].command, settings[i].value};
+        for (uint8_t j = 0; j < 2; j++) {
+            const char* c = parts[j];
+            do {
+                hash ^= static_cast<uint8_t>(*c);
+                hash *= 16777619UL;
+            } while (*c++ != '\0');
+        }
+    }
+    return hash;
+}
+
+
+bool DigiXBee::isXBeeConfigCached(uint32_t configHash) {
+    uint32_t savedHash;
+    return PersistentStore::load(MS_XBEE_CONFIG_EEPROM_ADDRESS, &savedHash,
+                                 sizeof(savedHash), XBEE_CONFIG_VERSION) &&
+        savedHash == configHash;
+}
+
+
+void DigiXBee::cacheXBeeConfig(uint32_t configHash) {
+    PersistentStore::save(MS_XBEE_CONFIG_EEPROM_ADDRESS, &configHash,
+                          sizeof(configHash), XBEE_CONFIG_VERSION);
+}
+
+
+int8_t DigiXBee::getXBeeBaudCode(uint32_t baud) {
+    // The standard rates, in order of their codes
+    static const uint32_t rates[] = {1200L,   2400L,   4800L,   9600L,
+                                     19200L,  38400L,  57600L,  115200L,
+                                     230400L, 460800L, 921600L};
+    for (uint8_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        if (rates[i] == baud) return i;
+    }
+    return -1;
+}
@@ -152,11 +152,45 @@
  */
 #define XBEE_DISCONNECT_TIME_MS 15000L
 
+/**
+ * @def MS_XBEE_CONFIG_EEPROM_ADDRESS
+ * @brief The EEPROM address for a hash of the settings last written to the
+ * XBee.
+ *
+ * If this is set to an address, the hash of the settings is saved once they
+ * have all been checked and written.  When the settings are the same at the
+ * next setup, ie, after a watchdog reset, the XBee isn't asked for them at all.
+ * It takes PersistentStore::getBlockSize(4) bytes.  If the XBee is swapped out
+ * or reset to its defaults, clear this block or change the address so the
+ * settings are checked again.
+ *
+ * This can be set by setting the build flag MS_XBEE_CONFIG_EEPROM_ADDRESS when
+ * compiling.  It defaults to -1, so the hash isn't kept.
+ */
+#ifndef MS_XBEE_CONFIG_EEPROM_ADDRESS
+#define MS_XBEE_CONFIG_EEPROM_ADDRESS -1
+#endif
+
 // Included Dependencies
 #include "ModSensorDebugger.h"
 #undef MS_DEBUGGING_STD
 #include "LoggerModem.h"
 
+class DigiXBeeAPI;
+
+/**
+ * @brief A setting for an XBee:  a two letter AT command and its value.
+ *
+ * The value must be written the way the XBee reads it back - numbers in upper
+ * case hex without leading zeros.  Values that are text rather than numbers
+ * must be marked as text, so they're sent as they are in API mode.
+ */
+typedef struct xbeeSetting {
+    const char* command;  ///< The two letter command, like "D8"
+    const char* value;    ///< The value to set, like "1"
+    bool        isText;   ///< True for a text value, like an APN
+} xbeeSetting;
+
 
 /**
  * @brief The parent class for all [Digi XBee and XBee3](@ref modem_digi) wifi
@@ -198,6 +232,74 @@ class DigiXBee : public loggerModem {
  protected:
     bool modemSleepFxn(void) override;
     bool modemWakeFxn(void) override;
+
+    /**
+     * @brief Bring the XBee's settings into line with a list, writing only
+     * the ones that differ.
+     *
+     * The XBee must already be in command mode.  All of the settings are read
+     * back with a single command line.  Any that differ are then written in a
+     * second line, ending with `WR` to save them to flash.  Nothing is written
+     * if all of them already match.
+     *
+     * @param stream The stream connected to the XBee
+     * @param settings The settings to make
+     * @param numSettings The number of settings in the list; at most 32
+     * @param changed Set to true if any settings were written
+     * @return **bool** True if the XBee took all of the changes.
+     */
+    bool applyXBeeSettings(Stream& stream, const xbeeSetting* settings,
+                           uint8_t numSettings, bool& changed);
+    /**
+     * @brief Bring the XBee's settings into line with a list, writing only
+     * the ones that differ, using API frames.
+     *
+     * This does the same as applyXBeeSettings(Stream&, const xbeeSetting*,
+     * uint8_t, bool&) for an XBee in API mode, where command mode can't be
+     * entered.  Each setting is read and written with its own AT command
+     * frame, and `WR` is sent to save them to flash.
+     *
+     * @param api The API connection to the XBee
+     * @param settings The settings to make
+     * @param numSettings The number of settings in the list
+     * @param changed Set to true if any settings were written
+     * @return **bool** True if the XBee took all of the changes.
+     */
+    bool applyXBeeSettings(DigiXBeeAPI& api, const xbeeSetting* settings,
+                           uint8_t numSettings, bool& changed);
+    /**
+     * @brief Get a hash of a list of settings, to tell if they've changed.
+     *
+     * @param settings The settings
+     * @param numSettings The number of settings in the list
+     * @return **uint32_t** A 32-bit FNV-1a hash of the commands and values
+     */
+    static uint32_t getXBeeConfigHash(const xbeeSetting* settings,
+                                      uint8_t numSettings);
+    /**
+     * @brief Check if the settings with this hash were the last ones written
+     * to the XBee.
+     *
+     * This is always false unless #MS_XBEE_CONFIG_EEPROM_ADDRESS is set.
+     *
+     * @param configHash The hash from getXBeeConfigHash()
+     * @return **bool** True if the same hash was saved to EEPROM.
+     */
+    bool isXBeeConfigCached(uint32_t configHash);
+    /**
+     * @brief Save the hash of the settings written to the XBee to EEPROM, if
+     * #MS_XBEE_CONFIG_EEPROM_ADDRESS is set.
+     *
+     * @param configHash The hash from getXBeeConfigHash()
+     */
+    void cacheXBeeConfig(uint32_t configHash);
+    /**
+     * @brief Get the XBee's `BD` code for a serial baud rate.
+     *
+     * @param baud The rate
+     * @return **int8_t** The code, or -1 if the XBee can't use the rate
+     */
+    static int8_t getXBeeBaudCode(uint32_t baud);
 };
 /**@}*/
 #endif  // SRC_MODEMS_DIGIXBEE_H_
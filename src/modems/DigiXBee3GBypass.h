@@ -166,6 +166,11 @@ class DigiXBee3GBypass : public DigiXBee {
      */
     bool extraModemSetup(void) override;
     bool isModemAwake(void) override;
+    bool modemTestAT(uint32_t timeout_ms) override;
+    bool modemInit(void) override;
+    bool isNetworkRegistered(void) override;
+    bool startNetworkAttach(void) override;
+    bool startDataConnection(void) override;
 
  private:
     const char* _apn;
@@ -0,0 +1,450 @@
+/**
+ * @file DigiXBeeAPI.cpp
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Implements the DigiXBeeAPI and DigiXBeeAPIClient classes.
+ */
+
+#include "DigiXBeeAPI.h"
+
+// The byte that starts every frame
+#define XBEE_API_START 0x7E
+// The frame types used
+#define XBEE_API_AT_COMMAND 0x08
+#define XBEE_API_AT_RESPONSE 0x88
+#define XBEE_API_TX_IPV4 0x20
+#define XBEE_API_TX_STATUS 0x89
+#define XBEE_API_RX_IPV4 0xB0
+// The protocols for an IPv4 transmit frame
+#define XBEE_API_PROTOCOL_TCP 1
+#define XBEE_API_PROTOCOL_TLS 4
+// The transmit option to close the socket once the data is sent
+#define XBEE_API_OPTION_CLOSE 0x02
+// The most data to send in one frame
+#define XBEE_API_MAX_DATA 1024
+// The seconds between the XBee's epoch (2000) and the Unix epoch (1970)
+#define XBEE_API_UNIX_OFFSET 946684800UL
+// The time to give the XBee to go down after being told to reset
+#define XBEE_API_RESTART_DELAY_MS 500
+
+// The states of the frame being read
+#define XBEE_FRAME_WAITING 0
+#define XBEE_FRAME_LENGTH_HIGH 1
+#define XBEE_FRAME_LENGTH_LOW 2
+#define XBEE_FRAME_DATA 3
+#define XBEE_FRAME_CHECKSUM 4
+
+
+// Constructor
+DigiXBeeAPI::DigiXBeeAPI(Stream* stream, bool isWifi)
+    : _stream(stream), _isWifi(isWifi), _frameId(0),
+      _frameState(XBEE_FRAME_WAITING), _frameLength(0), _framePosition(0),
+      _frameChecksum(0), _frameClient(NULL), _answerFrameId(0),
+      _answerStatus(0), _responseLength(0) {
+    for (uint8_t i = 0; i < MS_XBEE_API_MAX_SOCKETS; i++) _clients[i] = NULL;
+}
+// Destructor
+DigiXBeeAPI::~DigiXBeeAPI() {}
+
+
+bool DigiXBeeAPI::init(void) {
+    while (_stream->available()) _stream->read();
+    _frameState = XBEE_FRAME_WAITING;
+    for (uint8_t i = 0; i < MS_XBEE_API_MAX_SOCKETS; i++) {
+        if (_clients[i] == NULL) continue;
+        _clients[i]->_connected = false;
+        _clients[i]->_txLength  = 0;
+        _clients[i]->_rxTail    = _clients[i]->_rxHead;
+        _clients[i]             = NULL;
+    }
+    return true;
+}
+bool DigiXBeeAPI::testAT(uint32_t timeout_ms) {
+    return atCommand("AI", NULL, 0, timeout_ms);
+}
+
+
+bool DigiXBeeAPI::atCommand(const char* command, const uint8_t* param,
+                            uint8_t paramLength, uint32_t timeout_ms) {
+    uint8_t frameId   = nextFrameId();
+    uint8_t header[4] = {XBEE_API_AT_COMMAND, frameId,
+                         static_cast<uint8_t>(command[0]),
+                         static_cast<uint8_t>(command[1])};
+    sendFrame(header, 4, param, paramLength);
+    bool success = waitForAnswer(frameId, timeout_ms);
+    if (!success) { MS_DBG(F("XBee did not take"), command); }
+    return success;
+}
+const uint8_t* DigiXBeeAPI::getResponse(uint8_t& length) {
+    length = _responseLength;
+    return _response;
+}
+int32_t DigiXBeeAPI::getNumber(const char* command) {
+    if (!atCommand(command) || _responseLength == 0) return -9999;
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < _responseLength && i < 4; i++) {
+        value = (value << 8) | _response[i];
+    }
+    return value;
+}
+bool DigiXBeeAPI::setNumber(const char* command, uint32_t value) {
+    // Send the value big-endian, with no more bytes than it needs
+    uint8_t length = 1;
+    while (length < 4 && (value >> (8 * length)) != 0) length++;
+    uint8_t param[4];
+    for (uint8_t i = 0; i < length; i++) {
+        param[i] = static_cast<uint8_t>(value >> (8 * (length - 1 - i)));
+    }
+    return atCommand(command, param, length);
+}
+bool DigiXBeeAPI::restart(uint32_t timeout_ms) {
+    if (!atCommand("FR")) return false;
+    init();
+    delay(XBEE_API_RESTART_DELAY_MS);
+    uint32_t start = millis();
+    while (millis() - start < timeout_ms) {
+        if (testAT()) return true;
+    }
+    return false;
+}
+
+
+bool DigiXBeeAPI::isNetworkConnected(void) {
+    return getNumber("AI") == 0;
+}
+int16_t DigiXBeeAPI::getSignalQuality(void) {
+    int32_t value = getNumber(_isWifi ? "LM" : "DB");
+    if (value == -9999) return -9999;
+    // The S6B gives the link margin above its -93 dBm sensitivity; the
+    // cellular XBee's give the magnitude of the RSSI
+    return _isWifi ? -93 + value : -value;
+}
+float DigiXBeeAPI::getTemperature(void) {
+    int32_t value = getNumber("TP");
+    if (value == -9999) return -9999;
+    return static_cast<int16_t>(value);
+}
+uint16_t DigiXBeeAPI::getBattVoltage(void) {
+    int32_t value = getNumber("%V");
+    if (value == -9999) return 9999;
+    return value;
+}
+bool DigiXBeeAPI::getBattStats(uint8_t& chargeState, int8_t& percent,
+                               uint16_t& milliVolts) {
+    chargeState = 99;
+    percent     = -99;
+    milliVolts  = getBattVoltage();
+    return milliVolts != 9999;
+}
+uint32_t DigiXBeeAPI::getUnixTime(void) {
+    int32_t value = getNumber("DT");
+    if (value <= 0) return 0;
+    return value + XBEE_API_UNIX_OFFSET;
+}
+bool DigiXBeeAPI::closeSockets(void) {
+    for (uint8_t i = 0; i < MS_XBEE_API_MAX_SOCKETS; i++) {
+        if (_clients[i] != NULL) _clients[i]->stop();
+    }
+    return true;
+}
+
+
+void DigiXBeeAPI::loop(void) {
+    while (_stream->available()) readByte(_stream->read());
+}
+
+
+bool DigiXBeeAPI::lookup(const char* host, IPAddress& ip) {
+    uint8_t length = strlen(host);
+    if (!atCommand("LA", reinterpret_cast<const uint8_t*>(host), length,
+                   MS_XBEE_API_SEND_TIMEOUT_MS) ||
+        _responseLength != 4) {
+        MS_DBG(F("Could not look up"), host);
+        return false;
+    }
+    ip = IPAddress(_response[0], _response[1], _response[2], _response[3]);
+    return true;
+}
+bool DigiXBeeAPI::attach(DigiXBeeAPIClient* client) {
+    int8_t open = -1;
+    for (uint8_t i = 0; i < MS_XBEE_API_MAX_SOCKETS; i++) {
+        if (_clients[i] == client) return true;
+        if (_clients[i] == NULL && open < 0) open = i;
+    }
+    if (open < 0) {
+        MS_DBG(F("All"), MS_XBEE_API_MAX_SOCKETS, F("XBee sockets are in use"));
+        return false;
+    }
+    _clients[open] = client;
+    return true;
+}
+void DigiXBeeAPI::detach(DigiXBeeAPIClient* client) {
+    for (uint8_t i = 0; i < MS_XBEE_API_MAX_SOCKETS; i++) {
+        if (_clients[i] == client) _clients[i] = NULL;
+    }
+    if (_frameClient == client) _frameClient = NULL;
+}
+
+
+bool DigiXBeeAPI::sendData(DigiXBeeAPIClient* client, const uint8_t* data,
+                           uint16_t length, bool close) {
+    uint8_t frameId    = nextFrameId();
+    uint8_t header[12] = {
+        XBEE_API_TX_IPV4,
+        frameId,
+        client->_remoteIP[0],
+        client->_remoteIP[1],
+        client->_remoteIP[2],
+        client->_remoteIP[3],
+        static_cast<uint8_t>(client->_remotePort >> 8),
+        static_cast<uint8_t>(client->_remotePort),
+        // Let the XBee pick the local port
+        0,
+        0,
+        client->_useTLS ? XBEE_API_PROTOCOL_TLS : XBEE_API_PROTOCOL_TCP,
+        close ? XBEE_API_OPTION_CLOSE : 0};
+    client->_txFrameId = frameId;
+    sendFrame(header, 12, data, length);
+    bool success = waitForAnswer(frameId, MS_XBEE_API_SEND_TIMEOUT_MS);
+    if (success) {
+        client->_lastActivity = millis();
+    } else {
+        MS_DBG(F("XBee could not send to"), client->_remoteIP, ':',
+               client->_remotePort, F("status"), _answerStatus);
+    }
+    return success;
+}
+void DigiXBeeAPI::sendFrame(const uint8_t* header, uint8_t headerLength,
+                            const uint8_t* data, uint16_t dataLength) {
+    uint16_t length   = headerLength + dataLength;
+    uint8_t  start[3] = {XBEE_API_START, static_cast<uint8_t>(length >> 8),
+                        static_cast<uint8_t>(length)};
+    uint8_t  checksum = 0;
+    for (uint8_t i = 0; i < headerLength; i++) checksum += header[i];
+    for (uint16_t i = 0; i < dataLength; i++) checksum += data[i];
+    _stream->write(start, 3);
+    _stream->write(header, headerLength);
+    if (dataLength > 0) _stream->write(data, dataLength);
+    _stream->write(static_cast<uint8_t>(0xFF - checksum));
+}
+uint8_t DigiXBeeAPI::nextFrameId(void) {
+    if (++_frameId == 0) _frameId = 1;
+    _answerFrameId = 0;
+    return _frameId;
+}
+bool DigiXBeeAPI::waitForAnswer(uint8_t frameId, uint32_t timeout_ms) {
+    uint32_t start = millis();
+    while (millis() - start < timeout_ms) {
+        loop();
+        if (_answerFrameId == frameId) return _answerStatus == 0;
+    }
+    return false;
+}
+
+
+void DigiXBeeAPI::closeClient(uint8_t frameId) {
+    for (uint8_t i = 0; i < MS_XBEE_API_MAX_SOCKETS; i++) {
+        DigiXBeeAPIClient* client = _clients[i];
+        if (client != NULL && client->_txFrameId == frameId) {
+            MS_DBG(F("Client for"), client->_remoteIP, ':',
+                   client->_remotePort, F("is no longer connected"));
+            client->_connected = false;
+        }
+    }
+}
+
+
+void DigiXBeeAPI::readByte(uint8_t b) {
+    switch (_frameState) {
+        case XBEE_FRAME_WAITING:
+            if (b == XBEE_API_START) _frameState = XBEE_FRAME_LENGTH_HIGH;
+            return;
+        case XBEE_FRAME_LENGTH_HIGH:
+            _frameLength = static_cast<uint16_t>(b) << 8;
+            _frameState  = XBEE_FRAME_LENGTH_LOW;
+            return;
+        case XBEE_FRAME_LENGTH_LOW:
+            _frameLength |= b;
+            _framePosition = 0;
+            _frameChecksum = 0;
+            _frameClient   = NULL;
+            _frameState    = _frameLength > 0 ? XBEE_FRAME_DATA
+                                              : XBEE_FRAME_WAITING;
+            return;
+        case XBEE_FRAME_CHECKSUM:
+            _frameState = XBEE_FRAME_WAITING;
+            if (static_cast<uint8_t>(_frameChecksum + b) != 0xFF) {
+                MS_DBG(F("Bad checksum on XBee frame type"), _frameHeader[0]);
+                return;
+            }
+            // Answers are only taken once the whole frame is good
+            if (_frameHeader[0] == XBEE_API_AT_RESPONSE &&
+                _frameLength >= 5) {
+                _answerStatus  = _frameHeader[4];
+                _answerFrameId = _frameHeader[1];
+            } else if (_frameHeader[0] == XBEE_API_TX_STATUS &&
+                       _frameLength >= 3) {
+                _answerStatus  = _frameHeader[2];
+                _answerFrameId = _frameHeader[1];
+                // A failure may come after the wait for it was given up on
+                if (_answerStatus != 0) closeClient(_answerFrameId);
+            }
+            return;
+        default: break;
+    }
+
+    // The frame type, then the fixed fields for the type, then any data
+    _frameChecksum += b;
+    uint16_t position = _framePosition++;
+    if (_framePosition >= _frameLength) _frameState = XBEE_FRAME_CHECKSUM;
+    if (position < sizeof(_frameHeader)) _frameHeader[position] = b;
+
+    switch (_frameHeader[0]) {
+        case XBEE_API_AT_RESPONSE:
+            // Type, frame ID, two letter command, and status, then the value
+            if (position == 4) {
+                _responseLength = 0;
+            } else if (position > 4 && _responseLength < sizeof(_response)) {
+                _response[_responseLength++] = b;
+            }
+            break;
+        case XBEE_API_RX_IPV4:
+            // Type, source address, local port, source port, protocol, and
+            // status, then the data
+            if (position == 10) {
+                IPAddress source(_frameHeader[1], _frameHeader[2],
+                                 _frameHeader[3], _frameHeader[4]);
+                uint16_t  port = (static_cast<uint16_t>(_frameHeader[7]) << 8) |
+                    _frameHeader[8];
+                for (uint8_t i = 0; i < MS_XBEE_API_MAX_SOCKETS; i++) {
+                    DigiXBeeAPIClient* client = _clients[i];
+                    if (client != NULL && client->_remoteIP == source &&
+                        client->_remotePort == port) {
+                        _frameClient = client;
+                    }
+                }
+                if (_frameClient == NULL) {
+                    MS_DBG(F("Dropping data from"), source, ':', port,
+                           F("with no client"));
+                }
+            } else if (position > 10 && _frameClient != NULL) {
+                _frameClient->receive(b);
+            }
+            break;
+        default: break;
+    }
+}
+
+
+// Constructor
+DigiXBeeAPIClient::DigiXBeeAPIClient(DigiXBeeAPI& api, bool useTLS)
+    : _api(&api), _useTLS(useTLS), _remotePort(0), _connected(false),
+      _txFrameId(0), _lastActivity(0), _txLength(0), _rxHead(0), _rxTail(0) {}
+// Destructor
+DigiXBeeAPIClient::~DigiXBeeAPIClient() {}
+
+
+int DigiXBeeAPIClient::connect(IPAddress ip, uint16_t port) {
+    if (_connected) stop();
+    _remoteIP   = ip;
+    _remotePort = port;
+    _txLength   = 0;
+    _rxTail     = _rxHead;
+    if (!_api->attach(this)) return 0;
+    // The XBee opens the socket when the first data is sent
+    _connected    = true;
+    _txFrameId    = 0;
+    _lastActivity = millis();
+    return 1;
+}
+int DigiXBeeAPIClient::connect(const char* host, uint16_t port) {
+    IPAddress ip;
+    if (!_api->lookup(host, ip)) return 0;
+    return connect(ip, port);
+}
+
+
+size_t DigiXBeeAPIClient::write(uint8_t b) {
+    return write(&b, 1);
+}
+size_t DigiXBeeAPIClient::write(const uint8_t* buf, size_t size) {
+    if (!_connected) return 0;
+    size_t written = 0;
+    while (written < size) {
+        size_t left = size - written;
+        if (_txLength == 0 && left >= MS_XBEE_API_TX_BUFFER) {
+            // Big writes go straight out without being copied
+            uint16_t length = left > XBEE_API_MAX_DATA ? XBEE_API_MAX_DATA
+                                                       : left;
+            if (!_api->sendData(this, buf + written, length, false)) {
+                _connected = false;
+                break;
+            }
+            written += length;
+            continue;
+        }
+        _txBuffer[_txLength++] = buf[written++];
+        if (_txLength >= MS_XBEE_API_TX_BUFFER && !sendBuffer(false)) break;
+    }
+    return written;
+}
+
+
+int DigiXBeeAPIClient::available() {
+    if (_connected && _txLength > 0) sendBuffer(false);
+    _api->loop();
+    return (_rxHead + MS_XBEE_API_RX_BUFFER - _rxTail) % MS_XBEE_API_RX_BUFFER;
+}
+int DigiXBeeAPIClient::read() {
+    if (available() == 0) return -1;
+    uint8_t b = _rxBuffer[_rxTail];
+    _rxTail   = (_rxTail + 1) % MS_XBEE_API_RX_BUFFER;
+    return b;
+}
+int DigiXBeeAPIClient::read(uint8_t* buf, size_t size) {
+    size_t numRead = 0;
+    while (numRead < size && available() > 0) buf[numRead++] = read();
+    return numRead;
+}
+int DigiXBeeAPIClient::peek() {
+    if (available() == 0) return -1;
+    return _rxBuffer[_rxTail];
+}
+void DigiXBeeAPIClient::flush() {
+    if (_connected) sendBuffer(false);
+}
+void DigiXBeeAPIClient::stop() {
+    // Send anything left with the option to close, even if there's nothing
+    if (_connected) sendBuffer(true);
+    _connected = false;
+    _rxTail    = _rxHead;
+    _api->detach(this);
+}
+uint8_t DigiXBeeAPIClient::connected() {
+    // The XBee closes an idle socket without saying so
+    if (_connected &&
+        millis() - _lastActivity >= MS_XBEE_API_SOCKET_TIMEOUT_MS) {
+        MS_DBG(F("No traffic with"), _remoteIP, ':', _remotePort, F("for"),
+               MS_XBEE_API_SOCKET_TIMEOUT_MS, F("ms; counting it as closed"));
+        _connected = false;
+    }
+    return _connected || available() > 0;
+}
+
+
+void DigiXBeeAPIClient::receive(uint8_t b) {
+    _lastActivity = millis();
+    uint16_t next = (_rxHead + 1) % MS_XBEE_API_RX_BUFFER;
+    if (next == _rxTail) return;
+    _rxBuffer[_rxHead] = b;
+    _rxHead            = next;
+}
+bool DigiXBeeAPIClient::sendBuffer(bool close) {
+    if (_txLength == 0 && !close) return true;
+    bool success = _api->sendData(this, _txBuffer, _txLength, close);
+    _txLength    = 0;
+    if (!success) _connected = false;
+    return success;
+}
@@ -0,0 +1,470 @@
+/**
+ * @file DigiXBeeAPI.h
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the DigiXBeeAPI class - a transport for talking to a Digi
+ * XBee in API mode with frames instead of command mode - and the
+ * DigiXBeeAPIClient class for each socket opened over it.
+ */
+
+// Header Guards
+#ifndef SRC_MODEMS_DIGIXBEEAPI_H_
+#define SRC_MODEMS_DIGIXBEEAPI_H_
+
+// Debugging Statement
+// #define MS_DIGIXBEEAPI_DEBUG
+
+#ifdef MS_DIGIXBEEAPI_DEBUG
+#define MS_DEBUGGING_STD "DigiXBeeAPI"
+#endif
+
+/**
+ * @def MS_XBEE_API_MAX_SOCKETS
+ * @brief The largest number of DigiXBeeAPIClient's that can be connected over
+ * one XBee at the same time.
+ *
+ * This can be changed by setting the build flag MS_XBEE_API_MAX_SOCKETS when
+ * compiling.
+ *
+ * @ingroup modem_digi
+ */
+#ifndef MS_XBEE_API_MAX_SOCKETS
+#define MS_XBEE_API_MAX_SOCKETS 4
+#endif
+
+/**
+ * @def MS_XBEE_API_RX_BUFFER
+ * @brief The bytes each DigiXBeeAPIClient keeps of received data that hasn't
+ * been read yet.
+ *
+ * The XBee sends received data as soon as it has it, so anything past this
+ * that isn't read in time is lost.  This can be changed by setting the build
+ * flag MS_XBEE_API_RX_BUFFER when compiling.
+ *
+ * @ingroup modem_digi
+ */
+#ifndef MS_XBEE_API_RX_BUFFER
+#define MS_XBEE_API_RX_BUFFER 128
+#endif
+
+/**
+ * @def MS_XBEE_API_TX_BUFFER
+ * @brief The bytes each DigiXBeeAPIClient collects before sending them to the
+ * XBee in a frame.
+ *
+ * Writes are collected so each byte printed doesn't go out in a frame of its
+ * own.  This can be changed by setting the build flag MS_XBEE_API_TX_BUFFER
+ * when compiling.
+ *
+ * @ingroup modem_digi
+ */
+#ifndef MS_XBEE_API_TX_BUFFER
+#define MS_XBEE_API_TX_BUFFER 64
+#endif
+
+/**
+ * @def MS_XBEE_API_TIMEOUT_MS
+ * @brief The time to wait for the XBee to answer a local AT command frame.
+ *
+ * This can be changed by setting the build flag MS_XBEE_API_TIMEOUT_MS when
+ * compiling.
+ *
+ * @ingroup modem_digi
+ */
+#ifndef MS_XBEE_API_TIMEOUT_MS
+#define MS_XBEE_API_TIMEOUT_MS 1000L
+#endif
+
+/**
+ * @def MS_XBEE_API_SEND_TIMEOUT_MS
+ * @brief The time to wait for the XBee to report that data was sent, or for
+ * it to look up a host name.
+ *
+ * The first data sent to a server also opens the socket, so this must allow
+ * for the connection.  This can be changed by setting the build flag
+ * MS_XBEE_API_SEND_TIMEOUT_MS when compiling.
+ *
+ * @ingroup modem_digi
+ */
+#ifndef MS_XBEE_API_SEND_TIMEOUT_MS
+#define MS_XBEE_API_SEND_TIMEOUT_MS 15000L
+#endif
+
+/**
+ * @def MS_XBEE_API_SOCKET_TIMEOUT_MS
+ * @brief The time after which a client with no traffic counts as closed.
+ *
+ * The XBee closes an idle socket after its `TM` time, without any frame to say
+ * so.  This should match `TM`, which the XBee setup sets to 10 seconds.  This
+ * can be changed by setting the build flag MS_XBEE_API_SOCKET_TIMEOUT_MS when
+ * compiling.
+ *
+ * @ingroup modem_digi
+ */
+#ifndef MS_XBEE_API_SOCKET_TIMEOUT_MS
+#define MS_XBEE_API_SOCKET_TIMEOUT_MS 10000L
+#endif
+
+// Included Dependencies
+#include "ModSensorDebugger.h"
+#undef MS_DEBUGGING_STD
+#include <Client.h>
+#include <IPAddress.h>
+
+class DigiXBeeAPIClient;
+
+/**
+ * @brief The DigiXBeeAPI class talks to a Digi XBee in API mode (`AP1`) using
+ * API frames instead of command mode.
+ *
+ * In transparent mode, an XBee has a single socket and every setting or
+ * status read needs a trip into command mode, with a guard time of silence
+ * before and after it.  In API mode, everything to and from the XBee is
+ * wrapped in frames:  local AT commands are answered right away without
+ * command mode, and data for several sockets can be sent and received at the
+ * same time, each frame marked with the address and port of the server it's
+ * for or from.
+ *
+ * The sockets are DigiXBeeAPIClient's attached to this transport.  They use the
+ * IPv4 transmit (0x20) and receive (0xB0) frames, so the XBee opens each
+ * socket the first time data is sent to a server.  Because received data is
+ * matched to a client by the server's address and port, only one client can be
+ * connected to each server and port at a time.
+ *
+ * Incoming frames are only read when something is asked of the transport or
+ * one of its clients; call loop() to read them otherwise.
+ *
+ * This works with both the cellular XBee3's and the S6B wifi XBee.
+ *
+ * @ingroup modem_digi
+ */
+class DigiXBeeAPI {
+ public:
+    /**
+     * @brief Construct a new Digi XBee API object
+     *
+     * @param stream The stream connected to the XBee
+     * @param isWifi True if this is an S6B wifi XBee; false for cellular.
+     * They report their signal strength differently.
+     */
+    DigiXBeeAPI(Stream* stream, bool isWifi);
+    /**
+     * @brief Destroy the Digi XBee API object - no action taken
+     */
+    virtual ~DigiXBeeAPI();
+
+    /**
+     * @brief Throw away anything half read from the XBee and disconnect all of
+     * the clients.
+     *
+     * Call this each time the XBee wakes; its sockets don't survive sleep.
+     *
+     * @return **bool** True - there's nothing to fail.
+     */
+    bool init(void);
+    /**
+     * @brief Check that the XBee answers an API frame.
+     *
+     * @param timeout_ms The time to wait for an answer
+     * @return **bool** True if the XBee answered.
+     */
+    bool testAT(uint32_t timeout_ms = MS_XBEE_API_TIMEOUT_MS);
+    /**
+     * @brief Send a local AT command frame and wait for the answer.
+     *
+     * The value of the answer, if any, can be read with getResponse().
+     *
+     * @param command The two letter command, like "DB"
+     * @param param The parameter bytes, if any.  Numbers are sent big-endian,
+     * not as text.
+     * @param paramLength The number of parameter bytes
+     * @param timeout_ms The time to wait for an answer
+     * @return **bool** True if the XBee answered with an OK status.
+     */
+    bool atCommand(const char* command, const uint8_t* param = NULL,
+                   uint8_t paramLength = 0,
+                   uint32_t timeout_ms = MS_XBEE_API_TIMEOUT_MS);
+    /**
+     * @brief Get the value the XBee answered the last AT command with.
+     *
+     * @param length Set to the number of bytes in the value
+     * @return **const uint8_t*** The bytes of the value
+     */
+    const uint8_t* getResponse(uint8_t& length);
+    /**
+     * @brief Read a numeric setting or status from the XBee.
+     *
+     * @param command The two letter command, like "AI"
+     * @return **int32_t** The value, or -9999 if the XBee didn't answer
+     */
+    int32_t getNumber(const char* command);
+    /**
+     * @brief Set a numeric setting.
+     *
+     * This doesn't write the change to flash or apply it; send `WR` and `AC`
+     * for that.
+     *
+     * @param command The two letter command, like "AM"
+     * @param value The value to set
+     * @return **bool** True if the XBee took the value.
+     */
+    bool setNumber(const char* command, uint32_t value);
+    /**
+     * @brief Reset the XBee with `FR` and wait for it to come back.
+     *
+     * @param timeout_ms The time to wait for the XBee to answer again
+     * @return **bool** True if the XBee answered after the reset.
+     */
+    bool restart(uint32_t timeout_ms);
+
+    /**
+     * @brief Check if the XBee is connected, from its association indication
+     * (`AI`).
+     *
+     * @return **bool** True if the association indication is 0 - connected to
+     * the internet for cellular, or joined to the access point for wifi.
+     */
+    bool isNetworkConnected(void);
+    /**
+     * @brief Get the signal strength.
+     *
+     * Cellular XBee's give the RSSI of the last received packet (`DB`); the
+     * S6B wifi gives its link margin (`LM`) from the last transmission, which
+     * is converted to RSSI.
+     *
+     * @return **int16_t** The RSSI in dBm, or -9999 if the XBee didn't answer
+     */
+    int16_t getSignalQuality(void);
+    /**
+     * @brief Get the temperature of the XBee (`TP`).
+     *
+     * @return **float** The temperature in degrees Celsius, or -9999 if the
+     * XBee didn't answer
+     */
+    float getTemperature(void);
+    /**
+     * @brief Get the supply voltage of the XBee (`%V`).
+     *
+     * @return **uint16_t** The voltage in millivolts, or 9999 if the XBee
+     * didn't answer
+     */
+    uint16_t getBattVoltage(void);
+    /**
+     * @brief Get the battery data the XBee can give - only the voltage.
+     *
+     * @param chargeState Always set to 99; the XBee doesn't know
+     * @param percent Always set to -99; the XBee doesn't know
+     * @param milliVolts Set to the supply voltage in millivolts
+     * @return **bool** True if the XBee gave the voltage.
+     */
+    bool getBattStats(uint8_t& chargeState, int8_t& percent,
+                      uint16_t& milliVolts);
+    /**
+     * @brief Get the time the cellular network gave the XBee (`DT`).
+     *
+     * @return **uint32_t** The seconds since January 1, 1970 in UTC, or 0 if
+     * the XBee doesn't know the time.
+     */
+    uint32_t getUnixTime(void);
+    /**
+     * @brief Stop all of the attached clients, closing their sockets.
+     *
+     * @return **bool** True - there's nothing to fail.
+     */
+    bool closeSockets(void);
+
+    /**
+     * @brief Read and handle any frames the XBee has sent.
+     *
+     * Received data is handed to the matching client.
+     */
+    void loop(void);
+
+ protected:
+    friend class DigiXBeeAPIClient;
+
+    /**
+     * @brief Look up the address of a host name on the XBee (`LA`).
+     *
+     * @param host The host name
+     * @param ip Set to the address, if found
+     * @return **bool** True if the address was found.
+     */
+    bool lookup(const char* host, IPAddress& ip);
+    /**
+     * @brief Attach a client so it gets the data from its server.
+     *
+     * @param client The client
+     * @return **bool** True if the client was attached; false if there are
+     * already #MS_XBEE_API_MAX_SOCKETS clients.
+     */
+    bool attach(DigiXBeeAPIClient* client);
+    /**
+     * @brief Detach a client.
+     *
+     * @param client The client
+     */
+    void detach(DigiXBeeAPIClient* client);
+    /**
+     * @brief Send data to a client's server in an IPv4 transmit frame and wait
+     * for the XBee to report it sent.
+     *
+     * @param client The client
+     * @param data The data
+     * @param length The number of bytes of data
+     * @param close True to have the XBee close the socket after the data is
+     * sent
+     * @return **bool** True if the XBee sent the data.
+     */
+    bool sendData(DigiXBeeAPIClient* client, const uint8_t* data,
+                  uint16_t length, bool close);
+    /**
+     * @brief Send a frame to the XBee.
+     *
+     * @param header The frame type and the fixed fields after it
+     * @param headerLength The number of bytes in the header
+     * @param data Any data to follow the header
+     * @param dataLength The number of bytes of data
+     */
+    void sendFrame(const uint8_t* header, uint8_t headerLength,
+                   const uint8_t* data, uint16_t dataLength);
+    /**
+     * @brief Get the next frame ID to ask for an answer with; never 0.
+     *
+     * @return **uint8_t** The frame ID
+     */
+    uint8_t nextFrameId(void);
+    /**
+     * @brief Read frames until the XBee answers a frame.
+     *
+     * @param frameId The ID of the frame to wait for the answer to
+     * @param timeout_ms The time to wait
+     * @return **bool** True if the answer came with an OK status.
+     */
+    bool waitForAnswer(uint8_t frameId, uint32_t timeout_ms);
+    /**
+     * @brief Add one byte read from the XBee to the frame being read.
+     *
+     * @param b The byte
+     */
+    void readByte(uint8_t b);
+    /**
+     * @brief Mark the client that sent a frame as no longer connected.
+     *
+     * @param frameId The ID of the transmit frame that failed
+     */
+    void closeClient(uint8_t frameId);
+
+    Stream* _stream;
+    bool    _isWifi;
+    uint8_t _frameId;
+
+    DigiXBeeAPIClient* _clients[MS_XBEE_API_MAX_SOCKETS];
+
+    // The frame being read; the position counts from the frame type
+    uint8_t            _frameState;
+    uint16_t           _frameLength;
+    uint16_t           _framePosition;
+    uint8_t            _frameChecksum;
+    uint8_t            _frameHeader[11];
+    DigiXBeeAPIClient* _frameClient;
+
+    // The last answer to a frame with an ID
+    uint8_t _answerFrameId;
+    uint8_t _answerStatus;
+    uint8_t _response[8];
+    uint8_t _responseLength;
+};
+
+
+/**
+ * @brief The DigiXBeeAPIClient class is an Arduino client for one socket over
+ * a DigiXBeeAPI transport.
+ *
+ * Several of these can be connected at once over one XBee, ie, to let
+ * publishers upload at the same time without each waiting for the others to
+ * open and close their connections.
+ *
+ * Connecting only attaches the client and looks up the server's address; the
+ * XBee opens the socket when the first data is sent.  Data written is
+ * collected and sent when #MS_XBEE_API_TX_BUFFER bytes have been collected, or
+ * when flushed, read from, or stopped.
+ *
+ * A client stops counting as connected when the XBee reports that its data
+ * couldn't be sent, even after giving up on waiting for that report, or once
+ * nothing has been sent or received for #MS_XBEE_API_SOCKET_TIMEOUT_MS.
+ *
+ * @ingroup modem_digi
+ */
+class DigiXBeeAPIClient : public Client {
+ public:
+    /**
+     * @brief Construct a new Digi XBee API Client object
+     *
+     * @param api The transport to the XBee
+     * @param useTLS True to have the XBee use TLS for the connection
+     */
+    explicit DigiXBeeAPIClient(DigiXBeeAPI& api, bool useTLS = false);
+    /**
+     * @brief Destroy the Digi XBee API Client object - no action taken
+     */
+    virtual ~DigiXBeeAPIClient();
+
+    // The Client interface
+    int     connect(IPAddress ip, uint16_t port) override;
+    int     connect(const char* host, uint16_t port) override;
+    size_t  write(uint8_t b) override;
+    size_t  write(const uint8_t* buf, size_t size) override;
+    int     available() override;
+    int     read() override;
+    int     read(uint8_t* buf, size_t size) override;
+    int     peek() override;
+    void    flush() override;
+    void    stop() override;
+    uint8_t connected() override;
+    operator bool() override {
+        return connected();
+    }
+
+ protected:
+    friend class DigiXBeeAPI;
+
+    /**
+     * @brief Add a received byte to the buffer; dropped if the buffer is full.
+     *
+     * @param b The byte
+     */
+    void receive(uint8_t b);
+    /**
+     * @brief Send anything collected to the server.
+     *
+     * @param close True to have the XBee close the socket afterward
+     * @return **bool** True if the XBee sent it.
+     */
+    bool sendBuffer(bool close);
+
+    DigiXBeeAPI* _api;
+    bool         _useTLS;
+    IPAddress    _remoteIP;
+    uint16_t     _remotePort;
+    bool         _connected;
+    /**
+     * @brief The frame ID of the last data sent, to match a late failure
+     * status to this client.
+     */
+    uint8_t _txFrameId;
+    /**
+     * @brief The processor time data was last sent or received.
+     */
+    uint32_t _lastActivity;
+
+    uint8_t  _txBuffer[MS_XBEE_API_TX_BUFFER];
+    uint16_t _txLength;
+    uint8_t  _rxBuffer[MS_XBEE_API_RX_BUFFER];
+    uint16_t _rxHead;
+    uint16_t _rxTail;
+};
+
+#endif  // SRC_MODEMS_DIGIXBEEAPI_H_
@@ -22,18 +22,28 @@ DigiXBeeCellularTransparent::DigiXBeeCellularTransparent(
 #ifdef MS_DIGIXBEECELLULARTRANSPARENT_DEBUG_DEEP
       _modemATDebugger(*modemStream, DEEP_DEBUGGING_SERIAL_OUTPUT),
       gsmModem(_modemATDebugger, modemResetPin),
+      gsmClient(gsmModem),
+      api(&_modemATDebugger, false),
 #else
       gsmModem(*modemStream, modemResetPin),
+      gsmClient(gsmModem),
+      api(modemStream, false),
 #endif
-      gsmClient(gsmModem) {
+      apiClient(api) {
     _apn = apn;
     _user = user;
     _pwd = pwd;
+    _apiMode = false;
 }
 
 // Destructor
 DigiXBeeCellularTransparent::~DigiXBeeCellularTransparent() {}
 
+
+void DigiXBeeCellularTransparent::setAPIMode(bool useAPI) {
+    _apiMode = useAPI;
+}
+
 MS_IS_MODEM_AWAKE(DigiXBeeCellularTransparent);
 MS_MODEM_WAKE(DigiXBeeCellularTransparent);
 
@@ -53,7 +63,12 @@ bool DigiXBeeCellularTransparent::modemWakeFxn(void) {
                _wakeLevel ? F("HIGH") : F("LOW"), F("to wake"), _modemName);
         digitalWrite(_modemSleepRqPin, _wakeLevel);
         MS_DBG(F("Turning off airplane mode..."));
-        if (gsmModem.commandMode()) {
+        if (_apiMode) {
+            // Only apply it; airplane mode is set at every wake and sleep,
+            // so there's no need to wear out the flash saving it
+            api.setNumber("AM", 0);
+            api.atCommand("AC");
+        } else if (gsmModem.commandMode()) {
             gsmModem.sendAT(GF("AM"), 0);
             gsmModem.waitResponse();
             // Write changes to flash and apply them
@@ -72,7 +87,10 @@ bool DigiXBeeCellularTransparent::modemWakeFxn(void) {
 bool DigiXBeeCellularTransparent::modemSleepFxn(void) {
     if (_modemSleepRqPin >= 0) {
         MS_DBG(F("Turning on airplane mode..."));
-        if (gsmModem.commandMode()) {
+        if (_apiMode) {
+            api.setNumber("AM", 1);
+            api.atCommand("AC");
+        } else if (gsmModem.commandMode()) {
             gsmModem.sendAT(GF("AM"), 0);
             gsmModem.waitResponse();
             // Write changes to flash and apply them
@@ -91,35 +109,53 @@ bool DigiXBeeCellularTransparent::modemSleepFxn(void) {
 }
 
 
+// The XBee answers at the old rate, then switches once the change is applied.
+// Only save it with WR; the AC of writeChanges() would switch before the
+// exit from command mode, which then wouldn't be understood.
+bool DigiXBeeCellularTransparent::setModemBaud(uint32_t baud) {
+    int8_t code = getXBeeBaudCode(baud);
+    if (code < 0) return false;
+    if (_apiMode) {
+        return api.setNumber("BD", code) && api.atCommand("WR") &&
+            api.atCommand("AC");
+    }
+    if (!gsmModem.commandMode()) return false;
+    gsmModem.sendAT(GF("BD"), String(code, HEX));
+    bool success = gsmModem.waitResponse() == 1;
+    gsmModem.sendAT(GF("WR"));
+    success &= gsmModem.waitResponse() == 1;
+    gsmModem.exitCommand();
+    return success;
+}
+
+
 bool DigiXBeeCellularTransparent::extraModemSetup(void) {
     bool success = true;
-    /** First run the TinyGSM init() function for the XBee. */
-    MS_DBG(F("Initializing the XBee..."));
-    success &= gsmModem.init();
-    gsmClient.init(&gsmModem);
-    _modemName = gsmModem.getModemName();
-    /** Then enter command mode to set pin outputs. */
-    MS_DBG(F("Putting XBee into command mode..."));
-    if (gsmModem.commandMode()) {
-        MS_DBG(F("Setting I/O Pins..."));
+    /** First run the TinyGSM init() function for the XBee.  Skip it in API
+     * mode; it would put the XBee back in transparent mode. */
+    if (!_apiMode) {
+        MS_DBG(F("Initializing the XBee..."));
+        success &= gsmModem.init();
+        gsmClient.init(&gsmModem);
+        _modemName = gsmModem.getModemName();
+    }
+    /** Then list the settings we need. */
+    const xbeeSetting settings[] = {
         /** Enable pin sleep functionality on `DIO9`.
          * NOTE: Only the `DTR_N/SLEEP_RQ/DIO8` pin (9 on the bee socket) can be
          * used for this pin sleep/wake. */
-        gsmModem.sendAT(GF("D8"), 1);
-        success &= gsmModem.waitResponse() == 1;
+        {"D8", "1"},
         /** Enable status indication on `DIO9` - it will be HIGH when the XBee
          * is awake.
          * NOTE: Only the `ON/SLEEP_N/DIO9` pin (13 on the bee socket) can be
          * used for direct status indication. */
-        gsmModem.sendAT(GF("D9"), 1);
-        success &= gsmModem.waitResponse() == 1;
+        {"D9", "1"},
         /** Enable CTS on `DIO7` - it will be `LOW` when it is clear to send
          * data to the XBee.  This can be used as proxy for status indication if
          * that pin is not readable.
          * NOTE: Only the `CTS_N/DIO7` pin (12 on the bee socket) can be used
          * for CTS. */
-        gsmModem.sendAT(GF("D7"), 1);
-        success &= gsmModem.waitResponse() == 1;
+        {"D7", "1"},
         /** Enable association indication on `DIO5` - this is should be directly
          * attached to an LED if possible.
          * - Solid light indicates no connection
@@ -129,63 +165,75 @@ bool DigiXBeeCellularTransparent::extraModemSetup(void) {
          *
          * NOTE: Only the `Associate/DIO5` pin (15 on the bee socket) can be
          * used for this function. */
-        gsmModem.sendAT(GF("D5"), 1);
-        success &= gsmModem.waitResponse() == 1;
+        {"D5", "1"},
         /** Enable RSSI PWM output on `DIO10` - this should be directly attached
          * to an LED if possible.  A higher PWM duty cycle (and thus brighter
          * LED) indicates better signal quality.
          * NOTE: Only the `DIO10/PWM0` pin (6 on the bee socket) can be used for
          * this function. */
-        gsmModem.sendAT(GF("P0"), 1);
-        success &= gsmModem.waitResponse() == 1;
+        {"P0", "1"},
         /** Enable pin sleep on the XBee. */
-        MS_DBG(F("Setting Sleep Options..."));
-        gsmModem.sendAT(GF("SM"), 1);
-        success &= gsmModem.waitResponse() == 1;
-        /** Disassociate from the network for the lowest power deep sleep. */
-        gsmModem.sendAT(GF("SO"), 0);
-        success &= gsmModem.waitResponse() == 1;
-        MS_DBG(F("Setting Other Options..."));
-        /** Disable remote manager, USB Direct, and LTE PSM
-         * NOTE:  LTE-M's PSM (Power Save Mode) sounds good, but there's no easy
-         * way on the LTE-M Bee to wake the cell chip itself from PSM, so we'll
-         * use the Digi pin sleep instead. */
-        gsmModem.sendAT(GF("DO"), 0);
-        success &= gsmModem.waitResponse() == 1;
+        {"SM", "1"},
+        /** Disassociate from the network for the lowest power deep sleep,
+         * unless PSM was requested; then stay associated (bit 6) so the
+         * network can keep the registration while the XBee sleeps. */
+        {"SO", _requestedTAU_s > 0 ? "40" : "0"},
+        /** Disable remote manager and USB Direct.  Only allow LTE PSM (bit 3)
+         * if it was requested.  The XBee firmware negotiates the timers
+         * itself and still wakes with the Digi pin sleep.  It can't say what
+         * the network granted, so the XBee is still put to sleep and powered
+         * down between uses; PSM only helps while it's pin sleeping. */
+        {"DO", _requestedTAU_s > 0 ? "8" : "0"},
         /** Ask data to be "packetized" and sent out with every new line (0x0A)
          * character. */
-        gsmModem.sendAT(GF("TD0A"));
-        success &= gsmModem.waitResponse() == 1;
+        {"TD", "A"},
         /* Make sure USB direct is NOT enabled on the XBee3 units. */
-        gsmModem.sendAT(GF("P1"), 0);
-        success &= gsmModem.waitResponse() == 1;
+        {"P1", "0"},
         /** Set the socket timeout to 10s (this is default). */
-        gsmModem.sendAT(GF("TM"), 64);
-        success &= gsmModem.waitResponse() == 1;
-        // MS_DBG(F("Setting Cellular Carrier Options..."));
-        // // Carrier Profile - 1 = No profile/SIM ICCID selected
-        // gsmModem.sendAT(GF("CP"),0);
-        // gsmModem.waitResponse();  // Don't check for success - only works on
-        // LTE
-        // // Cellular network technology - LTE-M/NB IoT
-        // gsmModem.sendAT(GF("N#"),0);
-        // gsmModem.waitResponse();  // Don't check for success - only works on
-        // LTE
-        MS_DBG(F("Setting the APN..."));
-        /** Save the network connection parameters. */
-        success &= gsmModem.gprsConnect(_apn,_user,_pwd);
-        MS_DBG(F("Ensuring XBee is in transparent mode..."));
-        /* Make sure we're really in transparent mode. */
-        gsmModem.sendAT(GF("AP0"));
-        success &= gsmModem.waitResponse() == 1;
-        /** Write all changes to flash and apply them. */
-        MS_DBG(F("Applying changes..."));
-        gsmModem.writeChanges();
-        /** Finally, exit command mode. */
+        {"TM", "64"},
+        // Carrier Profile (CP) and network technology (N#) are left alone;
+        // they only work on LTE
+        /** Save the network connection parameters.  The XBee doesn't use the
+         * user name or password. */
+        {"AN", _apn != NULL ? _apn : "", true},
+        /* Make sure we're really in transparent mode, or in API mode without
+         * escapes if it was asked for. */
+        {"AP", _apiMode ? "1" : "0"}};
+    const uint8_t numSettings = sizeof(settings) / sizeof(settings[0]);
+    uint32_t      configHash  = getXBeeConfigHash(settings, numSettings);
+
+    /** Skip checking the settings entirely if they're the same as the last
+     * ones written; ie, after a watchdog reset. */
+    if (isXBeeConfigCached(configHash)) {
+        MS_DBG(F("XBee settings are unchanged since they were last written"));
+    } else if (_apiMode && api.testAT()) {
+        /** An XBee already in API mode can't enter command mode, so check and
+         * write the settings with API frames. */
+        MS_DBG(F("Checking XBee settings with API frames..."));
+        bool changed = false;
+        success &= applyXBeeSettings(api, settings, numSettings, changed);
+        if (changed) {
+            MS_DBG(F("Restarting XBee..."));
+            success &= api.restart(XBEE_ATRESPONSE_TIME_MS);
+        }
+        if (success) cacheXBeeConfig(configHash);
+    } else if (gsmModem.commandMode()) {
+        /** Otherwise, enter command mode, read back the current settings, and
+         * write and save to flash only the ones that differ. */
+        MS_DBG(F("Checking XBee settings..."));
+        bool changed = false;
+        success &= applyXBeeSettings(gsmModem.stream, settings, numSettings,
+                                     changed);
+        /** Exit command mode. */
         gsmModem.exitCommand();
-        /** Force restart the modem to make sure all settings take. */
-        MS_DBG(F("Restarting XBee..."));
-        success &= gsmModem.restart();
+        /** Only restart the modem to make sure the settings take if any of
+         * them changed. */
+        if (changed) {
+            MS_DBG(F("Restarting XBee..."));
+            success &= _apiMode ? api.restart(XBEE_ATRESPONSE_TIME_MS)
+                                : gsmModem.restart();
+        }
+        if (success) cacheXBeeConfig(configHash);
     } else {
         success = false;
     }
@@ -248,13 +296,22 @@ uint32_t DigiXBeeCellularTransparent::getNISTTime(void) {
         return 0;
     }
 
+    /* In API mode, the XBee can give the network time without command mode */
+    if (_apiMode) {
+        uint32_t networkTime = api.getUnixTime();
+        MS_DBG(F("Network time from XBee:"), networkTime);
+        if (networkTime != 0) return networkTime;
+    }
+    Client& client = _apiMode ? static_cast<Client&>(apiClient) : gsmClient;
+
     /* Try up to 12 times to get a timestamp from NIST */
     for (uint8_t i = 0; i < 12; i++) {
         // Must ensure that we do not ping the daylight more than once every 4
         // seconds.  NIST clearly specifies here that this is a requirement for
         // all software that accesses its servers:
         // https://tf.nist.gov/tf-cgi/servers.cgi
-        while (millis() < _lastNISTrequest + 4000) {}
+        // Give up rather than wait if the last attempt failed too quickly.
+        if (!startNISTRequest()) return 0;
 
         /* Make TCP connection */
         MS_DBG(F("\nConnecting to NIST daytime Server"));
@@ -263,27 +320,28 @@ uint32_t DigiXBeeCellularTransparent::getNISTTime(void) {
         /* This is the IP address of time-e-wwv.nist.gov  */
         /* XBee's address lookup falters on time.nist.gov */
         IPAddress ip(132, 163, 97, 6);
-        connectionMade = gsmClient.connect(ip, 37, 15);
+        connectionMade = _apiMode ? apiClient.connect(ip, 37)
+                                  : gsmClient.connect(ip, 37, 15);
         /* Wait again so NIST doesn't refuse us! */
         delay(4000L);
         /* Try sending something to ensure connection */
-        gsmClient.println('!');
+        client.println('!');
 
         /* Wait up to 5 seconds for a response */
         if (connectionMade) {
             uint32_t start = millis();
-            while (gsmClient && gsmClient.available() < 4 &&
+            while (client && client.available() < 4 &&
                    millis() - start < 5000L) {}
 
-            if (gsmClient.available() >= 4) {
+            if (client.available() >= 4) {
                 MS_DBG(F("NIST responded after"), millis() - start, F("ms"));
                 byte response[4] = {0};
-                gsmClient.read(response, 4);
-                gsmClient.stop();
+                client.read(response, 4);
+                client.stop();
                 return parseNISTBytes(response);
             } else {
                 MS_DBG(F("NIST Time server did not respond!"));
-                gsmClient.stop();
+                client.stop();
             }
         } else {
             MS_DBG(F("Unable to open TCP to NIST!"));
@@ -307,38 +365,54 @@ bool DigiXBeeCellularTransparent::updateModemMetadata(void) {
     // Initialize variable
     int16_t signalQual = -9999;
 
-    // Enter command mode only once
-    MS_DBG(F("Entering Command Mode:"));
-    gsmModem.commandMode();
+    // Don't even enter command mode if there's nothing to ask for
+    if (!(_pollModemMetaData &
+          (MODEM_SIGNAL_ENABLE_BITMASK | MODEM_TEMPERATURE_ENABLE_BITMASK))) {
+        return success;
+    }
+
+    // Enter command mode only once; API mode doesn't need it
+    if (!_apiMode) {
+        MS_DBG(F("Entering Command Mode:"));
+        gsmModem.commandMode();
+    }
 
-    // Try for up to 15 seconds to get a valid signal quality
-    // NOTE:  We can't actually distinguish between a bad modem response, no
-    // modem response, and a real response from the modem of no service/signal.
-    // The TinyGSM getSignalQuality function returns the same "no signal"
-    // value (99 CSQ or 0 RSSI) in all 3 cases.
-    uint32_t startMillis = millis();
-    do {
-        MS_DBG(F("Getting signal quality:"));
-        signalQual = gsmModem.getSignalQuality();
-        MS_DBG(F("Raw signal quality:"), signalQual);
-        if (signalQual != 0 && signalQual != -9999) break;
-        delay(250);
-    } while ((signalQual == 0 || signalQual == -9999) &&
-             millis() - startMillis < 15000L && success);
-
-    // Convert signal quality to RSSI
-    loggerModem::_priorRSSI = signalQual;
-    MS_DBG(F("CURRENT RSSI:"), signalQual);
-    loggerModem::_priorSignalPercent = getPctFromRSSI(signalQual);
-    MS_DBG(F("CURRENT Percent signal strength:"), getPctFromRSSI(signalQual));
-
-    MS_DBG(F("Getting chip temperature:"));
-    loggerModem::_priorModemTemp = getModemChipTemperature();
-    MS_DBG(F("CURRENT Modem temperature:"), loggerModem::_priorModemTemp);
+    if (_pollModemMetaData & MODEM_SIGNAL_ENABLE_BITMASK) {
+        // Try for up to 15 seconds to get a valid signal quality
+        // NOTE:  We can't actually distinguish between a bad modem response,
+        // no modem response, and a real response from the modem of no
+        // service/signal.  The TinyGSM getSignalQuality function returns the
+        // same "no signal" value (99 CSQ or 0 RSSI) in all 3 cases.
+        uint32_t startMillis = millis();
+        do {
+            MS_DBG(F("Getting signal quality:"));
+            signalQual = _apiMode ? api.getSignalQuality()
+                                  : gsmModem.getSignalQuality();
+            MS_DBG(F("Raw signal quality:"), signalQual);
+            if (signalQual != 0 && signalQual != -9999) break;
+            delay(250);
+        } while ((signalQual == 0 || signalQual == -9999) &&
+                 millis() - startMillis < 15000L && success);
+
+        // Convert signal quality to RSSI
+        loggerModem::_priorRSSI = signalQual;
+        MS_DBG(F("CURRENT RSSI:"), signalQual);
+        loggerModem::_priorSignalPercent = getPctFromRSSI(signalQual);
+        MS_DBG(F("CURRENT Percent signal strength:"),
+               getPctFromRSSI(signalQual));
+    }
+
+    if (_pollModemMetaData & MODEM_TEMPERATURE_ENABLE_BITMASK) {
+        MS_DBG(F("Getting chip temperature:"));
+        loggerModem::_priorModemTemp = getModemChipTemperature();
+        MS_DBG(F("CURRENT Modem temperature:"), loggerModem::_priorModemTemp);
+    }
 
     // Exit command modem
-    MS_DBG(F("Leaving Command Mode:"));
-    gsmModem.exitCommand();
+    if (!_apiMode) {
+        MS_DBG(F("Leaving Command Mode:"));
+        gsmModem.exitCommand();
+    }
 
     return success;
 }
@@ -100,6 +100,7 @@
 #include "TinyGsmClient.h"
 #undef TINY_GSM_MODEM_HAS_WIFI
 #include "DigiXBee.h"
+#include "DigiXBeeAPI.h"
 
 #ifdef MS_DIGIXBEECELLULARTRANSPARENT_DEBUG_DEEP
 #include <StreamDebugger.h>
@@ -173,6 +174,24 @@ class DigiXBeeCellularTransparent : public DigiXBee {
 
     bool updateModemMetadata(void) override;
 
+    /**
+     * @brief Set whether to run the XBee in API mode instead of transparent
+     * mode.
+     *
+     * In API mode, the XBee is talked to through #api with frames instead of
+     * through TinyGSM and command mode, so there are no command mode guard
+     * times when checking the connection or reading the signal strength,
+     * temperature, and network time.  Several DigiXBeeAPIClient's, like
+     * #apiClient, can be connected at once.  #gsmClient can't be used in API
+     * mode.
+     *
+     * This must be set before the modem is set up; the XBee is switched to
+     * the mode during setup.
+     *
+     * @param useAPI True to use API mode
+     */
+    void setAPIMode(bool useAPI);
+
 #ifdef MS_DIGIXBEECELLULARTRANSPARENT_DEBUG_DEEP
     StreamDebugger _modemATDebugger;
 #endif
@@ -185,6 +204,16 @@ class DigiXBeeCellularTransparent : public DigiXBee {
      * @brief Public reference to the TinyGSM Client.
      */
     TinyGsmClient gsmClient;
+    /**
+     * @brief Public reference to the API frame transport, for use in API
+     * mode.
+     */
+    DigiXBeeAPI api;
+    /**
+     * @brief Public reference to a client over the API frame transport, for
+     * use in API mode.
+     */
+    DigiXBeeAPIClient apiClient;
 
  protected:
     bool isInternetAvailable(void) override;
@@ -195,17 +224,28 @@ class DigiXBeeCellularTransparent : public DigiXBee {
      *
      * For XBees, this sets the appropriate operating mode (transparent or
      * bypass), enables pin sleep, sets the DIO pins to the expected functions,
-     * and reboots the modem to ensure all settings are applied.
+     * and reboots the modem to ensure all settings are applied.  Only the
+     * settings that differ are written, and the modem is only rebooted if any
+     * did.  If #MS_XBEE_CONFIG_EEPROM_ADDRESS is defined and nothing has
+     * changed since the settings were last written, they aren't checked at
+     * all.
      *
      * @return **bool** True if the extra setup succeeded.
      */
     bool extraModemSetup(void) override;
     bool isModemAwake(void) override;
+    bool modemTestAT(uint32_t timeout_ms) override;
+    bool modemInit(void) override;
+    bool isNetworkRegistered(void) override;
+    bool startNetworkAttach(void) override;
+    bool startDataConnection(void) override;
+    bool setModemBaud(uint32_t baud) override;
 
  private:
     const char* _apn;
     const char* _user;
     const char* _pwd;
+    bool        _apiMode;
 };
 /**@}*/
 #endif  // SRC_MODEMS_DIGIXBEECELLULARTRANSPARENT_H_
@@ -37,6 +37,7 @@ MS_MODEM_WAKE(DigiXBeeLTEBypass);
 MS_MODEM_CONNECT_INTERNET(DigiXBeeLTEBypass);
 MS_MODEM_DISCONNECT_INTERNET(DigiXBeeLTEBypass);
 MS_MODEM_IS_INTERNET_AVAILABLE(DigiXBeeLTEBypass);
+MS_MODEM_POWER_SAVE(DigiXBeeLTEBypass);
 
 MS_MODEM_GET_NIST_TIME(DigiXBeeLTEBypass);
 
@@ -98,11 +99,10 @@ bool DigiXBeeLTEBypass::extraModemSetup(void) {
         gsmModem.sendAT(GF("SM"), 1);
         success &= gsmModem.waitResponse(GF("OK\r")) == 1;
         MS_DBG(F("Setting Other Options..."));
-        /** Disable remote manager, USB Direct, and LTE PSM.
-         * NOTE:  LTE-M's PSM (Power Save Mode) sounds good, but there's no easy
-         * way on the LTE-M Bee to wake the cell chip itself from PSM, so we'll
-         * use the Digi pin sleep instead. */
-        gsmModem.sendAT(GF("DO"), 0);
+        /** Disable remote manager and USB Direct.  Only allow LTE PSM (bit 3)
+         * if it was requested; the timers themselves are set on the u-blox
+         * chip with `AT+CPSMS` after setup. */
+        gsmModem.sendAT(GF("DO"), _requestedTAU_s > 0 ? 8 : 0);
         success &= gsmModem.waitResponse(GF("OK\r")) == 1;
         /* Make sure USB direct is NOT enabled on the XBee3 units. */
         gsmModem.sendAT(GF("P1"), 0);
@@ -180,6 +180,13 @@ class DigiXBeeLTEBypass : public DigiXBee {
      */
     bool extraModemSetup(void) override;
     bool isModemAwake(void) override;
+    bool modemTestAT(uint32_t timeout_ms) override;
+    bool modemInit(void) override;
+    bool isNetworkRegistered(void) override;
+    bool startNetworkAttach(void) override;
+    bool startDataConnection(void) override;
+    bool modemPowerSaveSetup(void) override;
+    bool readPowerSaveTimers(void) override;
 
  private:
     const char* _apn;
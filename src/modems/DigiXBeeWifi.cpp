@@ -11,6 +11,13 @@
 #include "DigiXBeeWifi.h"
 #include "LoggerModemMacros.h"
 
+// Addresses are big-endian numbers in API frames
+static uint32_t toXBeeNumber(IPAddress address) {
+    return static_cast<uint32_t>(address[0]) << 24 |
+        static_cast<uint32_t>(address[1]) << 16 |
+        static_cast<uint32_t>(address[2]) << 8 | address[3];
+}
+
 // Constructor/Destructor
 DigiXBeeWifi::DigiXBeeWifi(Stream* modemStream, int8_t powerPin,
                            int8_t statusPin, bool useCTSStatus,
@@ -21,17 +28,34 @@ DigiXBeeWifi::DigiXBeeWifi(Stream* modemStream, int8_t powerPin,
 #ifdef MS_DIGIXBEEWIFI_DEBUG_DEEP
       _modemATDebugger(*modemStream, DEEP_DEBUGGING_SERIAL_OUTPUT),
       gsmModem(_modemATDebugger, modemResetPin),
+      gsmClient(gsmModem),
+      api(&_modemATDebugger, true),
 #else
       gsmModem(*modemStream, modemResetPin),
+      gsmClient(gsmModem),
+      api(modemStream, true),
 #endif
-      gsmClient(gsmModem) {
-    _ssid = ssid;
-    _pwd  = pwd;
+      apiClient(api) {
+    _ssid    = ssid;
+    _pwd     = pwd;
+    _apiMode = false;
 }
 
 // Destructor
 DigiXBeeWifi::~DigiXBeeWifi() {}
 
+
+void DigiXBeeWifi::setAPIMode(bool useAPI) {
+    _apiMode = useAPI;
+}
+void DigiXBeeWifi::setFastReconnect(bool fastReconnect) {
+    _wifiCache.setFastReconnect(fastReconnect);
+}
+void DigiXBeeWifi::setStaticIP(IPAddress ip, IPAddress gateway,
+                               IPAddress mask, IPAddress dns) {
+    _wifiCache.setStaticIP(ip, gateway, mask, dns);
+}
+
 MS_IS_MODEM_AWAKE(DigiXBeeWifi);
 MS_MODEM_WAKE(DigiXBeeWifi);
 
@@ -99,11 +123,14 @@ bool DigiXBeeWifi::extraModemSetup(void) {
         /** Set the socket timeout to 10s (this is default). */
         gsmModem.sendAT(GF("TM"), 64);
         success &= gsmModem.waitResponse() == 1;
+        /** Use the static or cached address, if there is one, or DHCP. */
+        success &= sendAddress();
         /** Save the network connection parameters. */
         success &= gsmModem.networkConnect(_ssid, _pwd);
         MS_DBG(F("Ensuring XBee is in transparent mode..."));
-        /* Make sure we're really in transparent mode. */
-        gsmModem.sendAT(GF("AP0"));
+        /* Make sure we're really in transparent mode, or in API mode without
+         * escapes if it was asked for. */
+        gsmModem.sendAT(GF("AP"), _apiMode ? 1 : 0);
         success &= gsmModem.waitResponse() == 1;
         /** Write all changes to flash and apply them. */
         MS_DBG(F("Applying changes..."));
@@ -112,7 +139,8 @@ bool DigiXBeeWifi::extraModemSetup(void) {
         gsmModem.exitCommand();
         /** Force restart the modem to make sure all settings take. */
         MS_DBG(F("Restarting XBee..."));
-        success &= gsmModem.restart();
+        success &= _apiMode ? api.restart(XBEE_ATRESPONSE_TIME_MS)
+                            : gsmModem.restart();
     } else {
         success = false;
     }
@@ -130,6 +158,132 @@ void DigiXBeeWifi::disconnectInternet(void) {
     // Wifi XBee doesn't like to disconnect AT ALL, so we're doing nothing
     // If you do disconnect, you must power cycle before you can reconnect
     // to the same access point.
+    // In API mode, just close any sockets left open.
+    if (_apiMode) api.closeSockets();
+    // Keep the address the XBee was given so it can skip DHCP next time, or
+    // once the cached one has been used enough, go back to DHCP to renew it
+    if (!_wifiCache.isFastReconnect()) return;
+    if (!_wifiCache.skipDHCP()) {
+        cacheConnection();
+    } else if (_wifiCache.countReuse()) {
+        setAddress();
+    }
+}
+
+
+bool DigiXBeeWifi::joinNetwork(void) {
+    if (_wifiCache.isCached()) {
+        // The XBee joins on its own; give it a moment with the cached address
+        if (millis() - _phaseStart < MS_WIFI_FAST_JOIN_TIMEOUT_MS) {
+            return false;
+        }
+        MS_DBG(F("Couldn't join with the cached address, going back to"),
+               _wifiCache.hasStaticIP() ? F("the static address")
+                                        : F("DHCP"));
+        _wifiCache.clear();
+        setAddress();
+    }
+    /** In API mode, the credentials were saved during setup. */
+    if (_apiMode) return true;
+    MS_DBG(F("Sending credentials..."));
+    return gsmModem.networkConnect(_ssid, _pwd);
+}
+bool DigiXBeeWifi::joinFinished(void) {
+    return true;
+}
+
+
+bool DigiXBeeWifi::sendAddress(void) {
+    bool useAddress = _wifiCache.skipDHCP();
+    // MA 1 is a static address; 0 is DHCP
+    if (_apiMode) {
+        bool success = api.setNumber("MA", useAddress ? 1 : 0);
+        if (useAddress) {
+            success &= api.setNumber("MY", toXBeeNumber(_wifiCache.getIP()));
+            success &= api.setNumber("MK", toXBeeNumber(_wifiCache.getMask()));
+            success &= api.setNumber("GW",
+                                     toXBeeNumber(_wifiCache.getGateway()));
+            success &= api.setNumber("NS", toXBeeNumber(_wifiCache.getDNS()));
+        }
+        return success;
+    }
+    gsmModem.sendAT(GF("MA"), useAddress ? 1 : 0);
+    bool success = gsmModem.waitResponse() == 1;
+    if (useAddress) {
+        MS_DBG(F("Using address"), _wifiCache.getIP(), F("without DHCP"));
+        gsmModem.sendAT(GF("MY"), _wifiCache.getIP());
+        success &= gsmModem.waitResponse() == 1;
+        gsmModem.sendAT(GF("MK"), _wifiCache.getMask());
+        success &= gsmModem.waitResponse() == 1;
+        gsmModem.sendAT(GF("GW"), _wifiCache.getGateway());
+        success &= gsmModem.waitResponse() == 1;
+        gsmModem.sendAT(GF("NS"), _wifiCache.getDNS());
+        success &= gsmModem.waitResponse() == 1;
+    }
+    return success;
+}
+
+
+bool DigiXBeeWifi::setAddress(void) {
+    if (_apiMode) {
+        return sendAddress() && api.atCommand("WR") && api.atCommand("AC");
+    }
+    if (!gsmModem.commandMode()) return false;
+    bool success = sendAddress();
+    gsmModem.writeChanges();
+    gsmModem.exitCommand();
+    return success;
+}
+
+
+// The XBee answers at the old rate, then switches once the change is applied.
+// Only save it with WR; the AC of writeChanges() would switch before the
+// exit from command mode, which then wouldn't be understood.
+bool DigiXBeeWifi::setModemBaud(uint32_t baud) {
+    int8_t code = getXBeeBaudCode(baud);
+    if (code < 0) return false;
+    if (_apiMode) {
+        return api.setNumber("BD", code) && api.atCommand("WR") &&
+            api.atCommand("AC");
+    }
+    if (!gsmModem.commandMode()) return false;
+    gsmModem.sendAT(GF("BD"), String(code, HEX));
+    bool success = gsmModem.waitResponse() == 1;
+    gsmModem.sendAT(GF("WR"));
+    success &= gsmModem.waitResponse() == 1;
+    gsmModem.exitCommand();
+    return success;
+}
+
+
+uint32_t DigiXBeeWifi::readAddress(const char* command) {
+    if (_apiMode) {
+        int32_t value = api.getNumber(command);
+        if (value == -9999) return 0;
+        return IPAddress(value >> 24, value >> 16, value >> 8, value);
+    }
+    // In command mode, the XBee answers with the dotted address alone
+    IPAddress address;
+    gsmModem.sendAT(command);
+    address.fromString(gsmModem.stream.readStringUntil('\r').c_str());
+    return address;
+}
+
+
+bool DigiXBeeWifi::cacheConnection(void) {
+    if (!_apiMode && !gsmModem.commandMode()) return false;
+    wifiConnection connection;
+    memset(&connection, 0, sizeof(connection));
+    connection.ip      = readAddress("MY");
+    connection.mask    = readAddress("MK");
+    connection.gateway = readAddress("GW");
+    connection.dns     = readAddress("NS");
+    if (!_apiMode) gsmModem.exitCommand();
+    if (connection.ip == 0) return false;
+
+    MS_DBG(F("Keeping address"), IPAddress(connection.ip), F("for next time"));
+    _wifiCache.cache(connection);
+    return setAddress();
 }
 
 
@@ -141,7 +295,8 @@ uint32_t DigiXBeeWifi::getNISTTime(void) {
         return 0;
     }
 
-    gsmClient.stop();
+    Client& client = _apiMode ? static_cast<Client&>(apiClient) : gsmClient;
+    client.stop();
 
     // Try up to 12 times to get a timestamp from NIST
     for (uint8_t i = 0; i < 12; i++) {
@@ -149,7 +304,8 @@ uint32_t DigiXBeeWifi::getNISTTime(void) {
         // seconds.  NIST clearly specifies here that this is a requirement for
         // all software that accesses its servers:
         // https://tf.nist.gov/tf-cgi/servers.cgi
-        while (millis() < _lastNISTrequest + 4000) {}
+        // Give up rather than wait if the last attempt failed too quickly.
+        if (!startNISTRequest()) return 0;
 
         // Make TCP connection
         MS_DBG(F("\nConnecting to NIST daytime Server"));
@@ -160,27 +316,27 @@ uint32_t DigiXBeeWifi::getNISTTime(void) {
         // NOTE:  This "connect" only sets up the connection parameters, the TCP
         // socket isn't actually opened until we first send data (the '!' below)
         IPAddress ip(132, 163, 97, 6);
-        connectionMade = gsmClient.connect(ip, 37);
+        connectionMade = client.connect(ip, 37);
         // Need to send something before connection is made
-        gsmClient.println('!');
+        client.println('!');
         // Need this delay!  Can get away with 50, but 100 is safer.
         // delay(100);
 
         // Wait up to 5 seconds for a response
         if (connectionMade) {
             uint32_t start = millis();
-            while (gsmClient && gsmClient.available() < 4 &&
+            while (client && client.available() < 4 &&
                    millis() - start < 5000L) {}
 
-            if (gsmClient.available() >= 4) {
+            if (client.available() >= 4) {
                 MS_DBG(F("NIST responded after"), millis() - start, F("ms"));
                 byte response[4] = {0};
-                gsmClient.read(response, 4);
-                gsmClient.stop();
+                client.read(response, 4);
+                client.stop();
                 return parseNISTBytes(response);
             } else {
                 MS_DBG(F("NIST Time server did not respond!"));
-                gsmClient.stop();
+                client.stop();
             }
         } else {
             MS_DBG(F("Unable to open TCP to NIST!"));
@@ -198,21 +354,34 @@ bool DigiXBeeWifi::getModemSignalQuality(int16_t& rssi, int16_t& percent) {
     percent            = -9999;
     rssi               = -9999;
 
+    // In API mode, just ask for the link margin of the last transmission
+    if (_apiMode) {
+        rssi    = api.getSignalQuality();
+        percent = rssi != -9999 ? getPctFromRSSI(rssi) : -9999;
+        MS_DBG(F("RSSI:"), rssi);
+        MS_DBG(F("Percent signal strength:"), percent);
+        return rssi != -9999;
+    }
+
     // NOTE:  using Google doesn't work because there's no reply
-    MS_DBG(F("Opening connection to NIST to check connection strength..."));
-    // This is the IP address of time-c-g.nist.gov
-    // XBee's address lookup falters on time.nist.gov
-    // NOTE:  This "connect" only sets up the connection parameters, the TCP
-    // socket isn't actually opened until we first send data (the '!' below)
-    IPAddress ip(132, 163, 97, 6);
-    gsmClient.connect(ip, 37);
-    // Wait so NIST doesn't refuse us!
-    while (millis() < _lastNISTrequest + 4000) {}
-    // Need to send something before connection is made
-    gsmClient.println('!');
-    uint32_t start = millis();
-    delay(100);  // Need this delay!  Can get away with 50, but 100 is safer.
-    while (gsmClient && gsmClient.available() < 4 && millis() - start < 5000L) {
+    // Skip the connection if NIST was contacted too recently to ask again;
+    // the signal quality is then from the last transmission
+    if (startNISTRequest()) {
+        MS_DBG(F("Opening connection to NIST to check connection strength..."));
+        // This is the IP address of time-c-g.nist.gov
+        // XBee's address lookup falters on time.nist.gov
+        // NOTE:  This "connect" only sets up the connection parameters, the
+        // TCP socket isn't actually opened until we first send data (the '!'
+        // below)
+        IPAddress ip(132, 163, 97, 6);
+        gsmClient.connect(ip, 37);
+        // Need to send something before connection is made
+        gsmClient.println('!');
+        uint32_t start = millis();
+        // Need this delay!  Can get away with 50, but 100 is safer.
+        delay(100);
+        while (gsmClient && gsmClient.available() < 4 &&
+               millis() - start < 5000L) {}
     }
 
     // Get signal quality
@@ -253,40 +422,56 @@ bool DigiXBeeWifi::updateModemMetadata(void) {
     int16_t  percent = -9999;
     uint16_t volt    = 9999;
 
-    // Try up to 5 times to get a signal quality - that is, ping NIST 5 times
-    // and see if the value updates
-    int8_t num_pings_remaining = 5;
-    do {
-        getModemSignalQuality(rssi, percent);
-        MS_DBG(F("Raw signal quality:"), rssi);
-        if (percent != 0 && percent != -9999) break;
-        num_pings_remaining--;
-    } while ((percent == 0 || percent == -9999) && num_pings_remaining);
-
-    // Convert signal quality to RSSI
-    loggerModem::_priorRSSI          = rssi;
-    loggerModem::_priorSignalPercent = percent;
+    if (_pollModemMetaData & MODEM_SIGNAL_ENABLE_BITMASK) {
+        // Try up to 5 times to get a signal quality - that is, ping NIST 5
+        // times and see if the value updates
+        int8_t num_pings_remaining = 5;
+        do {
+            getModemSignalQuality(rssi, percent);
+            MS_DBG(F("Raw signal quality:"), rssi);
+            if (percent != 0 && percent != -9999) break;
+            num_pings_remaining--;
+        } while ((percent == 0 || percent == -9999) && num_pings_remaining);
+
+        // Convert signal quality to RSSI
+        loggerModem::_priorRSSI          = rssi;
+        loggerModem::_priorSignalPercent = percent;
+    }
 
+    // Don't enter command mode if there's nothing else to ask for
+    if (!(_pollModemMetaData & (MODEM_BATTERY_VOLTAGE_ENABLE_BITMASK |
+                                MODEM_TEMPERATURE_ENABLE_BITMASK))) {
+        return success;
+    }
 
-    // Enter command mode only once for temp and battery
-    MS_DBG(F("Entering Command Mode:"));
-    success &= gsmModem.commandMode();
+    // Enter command mode only once for temp and battery; API mode doesn't
+    // need it
+    if (!_apiMode) {
+        MS_DBG(F("Entering Command Mode:"));
+        success &= gsmModem.commandMode();
+    }
 
-    MS_DBG(F("Getting input voltage:"));
-    volt = gsmModem.getBattVoltage();
-    MS_DBG(F("CURRENT Modem input battery voltage:"), volt);
-    if (volt != 9999)
-        loggerModem::_priorBatteryVoltage = static_cast<float>(volt);
-    else
-        loggerModem::_priorBatteryVoltage = static_cast<float>(-9999);
+    if (_pollModemMetaData & MODEM_BATTERY_VOLTAGE_ENABLE_BITMASK) {
+        MS_DBG(F("Getting input voltage:"));
+        volt = _apiMode ? api.getBattVoltage() : gsmModem.getBattVoltage();
+        MS_DBG(F("CURRENT Modem input battery voltage:"), volt);
+        if (volt != 9999)
+            loggerModem::_priorBatteryVoltage = static_cast<float>(volt);
+        else
+            loggerModem::_priorBatteryVoltage = static_cast<float>(-9999);
+    }
 
-    MS_DBG(F("Getting chip temperature:"));
-    loggerModem::_priorModemTemp = getModemChipTemperature();
-    MS_DBG(F("CURRENT Modem temperature:"), loggerModem::_priorModemTemp);
+    if (_pollModemMetaData & MODEM_TEMPERATURE_ENABLE_BITMASK) {
+        MS_DBG(F("Getting chip temperature:"));
+        loggerModem::_priorModemTemp = getModemChipTemperature();
+        MS_DBG(F("CURRENT Modem temperature:"), loggerModem::_priorModemTemp);
+    }
 
     // Exit command modem
-    MS_DBG(F("Leaving Command Mode:"));
-    gsmModem.exitCommand();
+    if (!_apiMode) {
+        MS_DBG(F("Leaving Command Mode:"));
+        gsmModem.exitCommand();
+    }
 
     return success;
 }
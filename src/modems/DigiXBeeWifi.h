@@ -70,6 +70,8 @@
 #include "TinyGsmClient.h"
 #undef TINY_GSM_MODEM_HAS_GPRS
 #include "DigiXBee.h"
+#include "DigiXBeeAPI.h"
+#include "WifiConnectionCache.h"
 
 #ifdef MS_DIGIXBEEWIFI_DEBUG_DEEP
 #include <StreamDebugger.h>
@@ -128,6 +130,50 @@ class DigiXBeeWifi : public DigiXBee {
 
     bool updateModemMetadata(void) override;
 
+    /**
+     * @brief Set whether to run the XBee in API mode instead of transparent
+     * mode.
+     *
+     * In API mode, the XBee is talked to through #api with frames instead of
+     * through TinyGSM and command mode, so there are no command mode guard
+     * times when checking the connection or reading the signal strength,
+     * voltage, and temperature.  Several DigiXBeeAPIClient's, like
+     * #apiClient, can be connected at once.  #gsmClient can't be used in API
+     * mode.
+     *
+     * This must be set before the modem is set up; the XBee is switched to
+     * the mode during setup, and the network credentials are only sent then.
+     *
+     * @param useAPI True to use API mode
+     */
+    void setAPIMode(bool useAPI);
+    /**
+     * @brief Turn fast reconnect on or off.
+     *
+     * With fast reconnect, the address the XBee is given by DHCP is kept, in
+     * EEPROM if #MS_WIFI_CACHE_EEPROM_ADDRESS is defined, and written to the
+     * XBee as a static address so it doesn't ask for one after the next wake.
+     * If the XBee doesn't join within #MS_WIFI_FAST_JOIN_TIMEOUT_MS with that
+     * address, it's forgotten and the XBee goes back to DHCP.  The XBee finds
+     * the access point on its own; it can't be sent to a particular one.
+     *
+     * @param fastReconnect True to keep the last good address for the next
+     * connection.
+     */
+    void setFastReconnect(bool fastReconnect);
+    /**
+     * @brief Use a static address instead of DHCP.
+     *
+     * This must be set before the modem is set up.
+     *
+     * @param ip The XBee's address
+     * @param gateway The gateway's address
+     * @param mask The subnet mask
+     * @param dns The DNS server's address
+     */
+    void setStaticIP(IPAddress ip, IPAddress gateway, IPAddress mask,
+                     IPAddress dns);
+
 #ifdef MS_DIGIXBEEWIFI_DEBUG_DEEP
     StreamDebugger _modemATDebugger;
 #endif
@@ -140,6 +186,16 @@ class DigiXBeeWifi : public DigiXBee {
      * @brief Public reference to the TinyGSM Client.
      */
     TinyGsmClient gsmClient;
+    /**
+     * @brief Public reference to the API frame transport, for use in API
+     * mode.
+     */
+    DigiXBeeAPI api;
+    /**
+     * @brief Public reference to a client over the API frame transport, for
+     * use in API mode.
+     */
+    DigiXBeeAPIClient apiClient;
 
  protected:
     bool isInternetAvailable(void) override;
@@ -154,10 +210,62 @@ class DigiXBeeWifi : public DigiXBee {
      */
     bool extraModemSetup(void) override;
     bool isModemAwake(void) override;
+    bool modemTestAT(uint32_t timeout_ms) override;
+    bool modemInit(void) override;
+    bool isNetworkRegistered(void) override;
+    bool startNetworkAttach(void) override;
+    bool startDataConnection(void) override;
+    bool setModemBaud(uint32_t baud) override;
+
+    /**
+     * @brief Send the credentials, unless the XBee is waiting to join with a
+     * cached address, or has waited too long and should go back to DHCP.
+     *
+     * @return **bool** True if the XBee has what it needs to join.
+     */
+    bool joinNetwork(void);
+    /**
+     * @brief Check that a join isn't still going - the XBee joins on its
+     * own, so there's never one to wait out.
+     *
+     * @return **bool** Always true.
+     */
+    bool joinFinished(void);
+    /**
+     * @brief Set the addressing mode, and the static or cached address if
+     * there is one, while in command mode.
+     *
+     * @return **bool** True if the XBee took the settings.
+     */
+    bool sendAddress(void);
+    /**
+     * @brief Set the addressing mode and address and write them to flash.
+     *
+     * @return **bool** True if the XBee took the settings.
+     */
+    bool setAddress(void);
+    /**
+     * @brief Read one of the XBee's addresses; in transparent mode, the XBee
+     * must be in command mode.
+     *
+     * @param command The two letter command, like "MY"
+     * @return **uint32_t** The address, or 0 if the XBee didn't answer
+     */
+    uint32_t readAddress(const char* command);
+    /**
+     * @brief Keep the address the XBee was given and switch it to using that
+     * address instead of DHCP.
+     *
+     * @return **bool** True if the address was kept.
+     */
+    bool cacheConnection(void);
 
  private:
     const char* _ssid;
     const char* _pwd;
+    bool        _apiMode;
+
+    WifiConnectionCache _wifiCache;
 };
 /**@}*/
 #endif  // SRC_MODEMS_DIGIXBEEWIFI_H_
@@ -34,6 +34,8 @@ EspressifESP8266::EspressifESP8266(Stream* modemStream, int8_t powerPin,
 
     _espSleepRqPin = espSleepRqPin;
     _espStatusPin  = espStatusPin;
+    _joinPending   = false;
+    _joinCached    = false;
 
     _modemStream = modemStream;
 }
@@ -213,17 +215,147 @@ bool EspressifESP8266::extraModemSetup(void) {
         1) {
         return false;
     }
-    // Slow down the baud rate for slow processors - and save the change to
-    // the ESP's non-volatile memory so we don't have to do it every time
-    // #if F_CPU == 8000000L
-    // if (modemBaud > 57600)
-    // {
-    //     _modemSerial->begin(modemBaud);
-    //     gsmModem.sendAT(GF("+UART_DEF=9600,8,1,0,0"));
-    //     gsmModem.waitResponse();
-    //     _modemSerial->end();
-    //     _modemSerial->begin(9600);
-    // }
-    // #endif
+    // With fast reconnect, don't let the ESP start its own scan on boot; it
+    // will be sent straight to the cached access point instead
+    if (_wifiCache.isFastReconnect()) {
+        gsmModem.sendAT(GF("+CWAUTOCONN=0"));
+        gsmModem.waitResponse();
+    }
+    return true;
+}
+
+
+// The ESP answers at the old rate, then switches; UART_DEF saves the rate to
+// its flash so it comes back up at it after a reset
+bool EspressifESP8266::setModemBaud(uint32_t baud) {
+    gsmModem.sendAT(GF("+UART_DEF="), baud, GF(",8,1,0,0"));
+    return gsmModem.waitResponse() == 1;
+}
+
+
+void EspressifESP8266::setFastReconnect(bool fastReconnect) {
+    _wifiCache.setFastReconnect(fastReconnect);
+}
+void EspressifESP8266::setStaticIP(IPAddress ip, IPAddress gateway,
+                                   IPAddress mask, IPAddress dns) {
+    _wifiCache.setStaticIP(ip, gateway, mask, dns);
+}
+
+
+bool EspressifESP8266::joinNetwork(void) {
+    // Always set the address; a static one is kept while the ESP sleeps
+    setAddress();
+    _joinCached = _wifiCache.isCached();
+    if (_joinCached) {
+        const wifiConnection& cached = _wifiCache.getConnection();
+        char                  bssid[18];
+        WifiConnectionCache::formatBSSID(cached.bssid, bssid);
+        MS_DBG(F("Joining"), bssid, F("on channel"), cached.channel, F("..."));
+        // The BSSID sends the ESP straight to the access point; the AT
+        // commands have no way to give it the channel
+        gsmModem.sendAT(GF("+CWJAP_CUR=\""), _ssid, GF("\",\""), _pwd,
+                        GF("\",\""), bssid, '"');
+    } else {
+        MS_DBG(F("Sending credentials..."));
+        gsmModem.sendAT(GF("+CWJAP_CUR=\""), _ssid, GF("\",\""), _pwd, '"');
+    }
+    _joinPending = true;
+    return true;
+}
+
+
+bool EspressifESP8266::joinFinished(void) {
+    if (!_joinPending) return true;
+    // Nothing to read yet; don't hold up the poll waiting for it
+    if (!gsmModem.stream.available()) return false;
+    // The "WIFI CONNECTED" and "WIFI GOT IP" lines come before the answer
+    int8_t res = gsmModem.waitResponse(1000L, GFP(GSM_OK),
+                                       GF(GSM_NL "FAIL" GSM_NL));
+    if (res == 0) return false;
+    _joinPending = false;
+    if (res == 1) {
+        if (_joinCached) {
+            _wifiCache.countReuse();
+        } else if (_wifiCache.isFastReconnect()) {
+            cacheConnection();
+        }
+        return true;
+    }
+    if (_joinCached) {
+        MS_DBG(F("Couldn't join the cached access point, scanning for it..."));
+        _wifiCache.clear();
+    } else {
+        MS_DBG(F("Couldn't join"), _ssid, F("trying again..."));
+    }
+    joinNetwork();
+    return false;
+}
+
+
+void EspressifESP8266::setAddress(void) {
+    if (!_wifiCache.skipDHCP()) {
+        // Station mode (1) with DHCP on (1)
+        gsmModem.sendAT(GF("+CWDHCP_CUR=1,1"));
+        gsmModem.waitResponse();
+        return;
+    }
+    MS_DBG(F("Using address"), _wifiCache.getIP(), F("without DHCP"));
+    // Giving the station an address turns off its DHCP
+    gsmModem.sendAT(GF("+CIPSTA_CUR=\""), _wifiCache.getIP(), GF("\",\""),
+                    _wifiCache.getGateway(), GF("\",\""), _wifiCache.getMask(),
+                    '"');
+    gsmModem.waitResponse();
+    // Older firmware can't set the DNS server; it will use the gateway
+    gsmModem.sendAT(GF("+CIPDNS_CUR=1,\""), _wifiCache.getDNS(), '"');
+    gsmModem.waitResponse();
+}
+
+
+bool EspressifESP8266::cacheConnection(void) {
+    wifiConnection connection;
+    IPAddress      address;
+    memset(&connection, 0, sizeof(connection));
+
+    // The answer is +CWJAP_CUR:"<ssid>","<bssid>",<channel>,<rssi>
+    gsmModem.sendAT(GF("+CWJAP_CUR?"));
+    if (gsmModem.waitResponse(GF("+CWJAP_CUR:")) != 1) return false;
+    gsmModem.stream.readStringUntil(',');
+    String bssid       = gsmModem.stream.readStringUntil(',');
+    connection.channel = gsmModem.stream.readStringUntil(',').toInt();
+    gsmModem.waitResponse();
+    // Skip the opening quote
+    if (!WifiConnectionCache::parseBSSID(bssid.c_str() + 1,
+                                         connection.bssid)) {
+        return false;
+    }
+
+    // The answer is +CIPSTA_CUR:ip:"<ip>" and the same for the gateway and
+    // netmask, each on its own line
+    gsmModem.sendAT(GF("+CIPSTA_CUR?"));
+    bool success = gsmModem.waitResponse(GF("ip:\"")) == 1;
+    address.fromString(gsmModem.stream.readStringUntil('"').c_str());
+    connection.ip = address;
+    success &= gsmModem.waitResponse(GF("gateway:\"")) == 1;
+    address.fromString(gsmModem.stream.readStringUntil('"').c_str());
+    connection.gateway = address;
+    success &= gsmModem.waitResponse(GF("netmask:\"")) == 1;
+    address.fromString(gsmModem.stream.readStringUntil('"').c_str());
+    connection.mask = address;
+    gsmModem.waitResponse();
+    if (!success || connection.ip == 0) return false;
+
+    // The answer is +CIPDNS_CUR:<dns>, one line per server; fall back to the
+    // gateway if the firmware is too old to say
+    connection.dns = connection.gateway;
+    gsmModem.sendAT(GF("+CIPDNS_CUR?"));
+    if (gsmModem.waitResponse(GF("+CIPDNS_CUR:")) == 1) {
+        address.fromString(gsmModem.stream.readStringUntil('\r').c_str());
+        connection.dns = address;
+        gsmModem.waitResponse();
+    }
+
+    MS_DBG(F("Keeping"), bssid, F("on channel"), connection.channel,
+           F("and address"), IPAddress(connection.ip), F("for next time"));
+    _wifiCache.cache(connection);
     return true;
 }
@@ -175,6 +175,7 @@
 #undef MS_DEBUGGING_STD
 #include "TinyGsmClient.h"
 #include "LoggerModem.h"
+#include "WifiConnectionCache.h"
 
 #ifdef MS_ESPRESSIFESP8266_DEBUG_DEEP
 #include <StreamDebugger.h>
@@ -237,6 +238,32 @@ class EspressifESP8266 : public loggerModem {
                                uint16_t& milliVolts) override;
     float getModemChipTemperature(void) override;
 
+    /**
+     * @brief Turn fast reconnect on or off.
+     *
+     * With fast reconnect, the access point, channel, and address of the last
+     * good connection are kept, in EEPROM if #MS_WIFI_CACHE_EEPROM_ADDRESS is
+     * defined.  The next time, the ESP8266 is sent straight to that access
+     * point by its BSSID and given the same address, skipping DHCP.  If it
+     * can't join that way, the connection is forgotten and it scans for the
+     * network and asks for an address as usual.  Turn this on before the
+     * modem is set up so the ESP8266 doesn't also start joining on its own.
+     *
+     * @param fastReconnect True to keep the last good connection for the next
+     * one.
+     */
+    void setFastReconnect(bool fastReconnect);
+    /**
+     * @brief Use a static address instead of DHCP.
+     *
+     * @param ip The ESP8266's address
+     * @param gateway The gateway's address
+     * @param mask The subnet mask
+     * @param dns The DNS server's address
+     */
+    void setStaticIP(IPAddress ip, IPAddress gateway, IPAddress mask,
+                     IPAddress dns);
+
 #ifdef MS_ESPRESSIFESP8266_DEBUG_DEEP
     StreamDebugger _modemATDebugger;
 #endif
@@ -264,6 +291,46 @@ class EspressifESP8266 : public loggerModem {
     bool modemWakeFxn(void) override;
     bool extraModemSetup(void) override;
     bool isModemAwake(void) override;
+    bool modemTestAT(uint32_t timeout_ms) override;
+    bool modemInit(void) override;
+    bool isNetworkRegistered(void) override;
+    bool startNetworkAttach(void) override;
+    bool startDataConnection(void) override;
+    bool setModemBaud(uint32_t baud) override;
+
+    /**
+     * @brief Start joining the network - at the cached access point and
+     * address if fast reconnect is on and there is one, or else by scanning
+     * for it.
+     *
+     * This only sends the request; the answer is read by joinFinished().
+     *
+     * @return **bool** True once the request has been sent.
+     */
+    bool joinNetwork(void);
+    /**
+     * @brief Read the answer to a join, if there is one waiting.
+     *
+     * A join can take the ESP8266 up to 15 seconds, and it can't answer
+     * anything else until it's done.  Rather than wait, this is checked on
+     * each poll.  If joining the cached access point failed, the cache is
+     * forgotten and a scan is started; if the scan failed, it's started again.
+     *
+     * @return **bool** True if there's no join still going.
+     */
+    bool joinFinished(void);
+    /**
+     * @brief Give the ESP8266 the static or cached address and turn off DHCP,
+     * or turn DHCP back on if there's no address to give it.
+     */
+    void setAddress(void);
+    /**
+     * @brief Ask the ESP8266 for the access point and address it's using and
+     * keep them for the next connection.
+     *
+     * @return **bool** True if the connection details were read.
+     */
+    bool cacheConnection(void);
 
  private:
     bool        ESPwaitForBoot(void);
@@ -272,6 +339,17 @@ class EspressifESP8266 : public loggerModem {
 
     int8_t _espSleepRqPin;
     int8_t _espStatusPin;
+
+    WifiConnectionCache _wifiCache;
+    /**
+     * @brief True while the answer to a join hasn't been read.
+     */
+    bool _joinPending;
+    /**
+     * @brief True if the join that was last started was to the cached access
+     * point.
+     */
+    bool _joinCached;
 };
 /**@}*/
 #endif  // SRC_MODEMS_ESPRESSIFESP8266_H_
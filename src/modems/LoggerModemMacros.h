@@ -14,6 +14,41 @@
 #ifndef SRC_MODEMS_LOGGERMODEMMACROS_H_
 #define SRC_MODEMS_LOGGERMODEMMACROS_H_
 
+#if defined TINY_GSM_MODEM_XBEE
+/**
+ * @brief Creates a text string to pick between a call on the XBee's API frame
+ * transport and a call on TinyGSM.
+ *
+ * The XBee's in transparent mode (DigiXBeeCellularTransparent and
+ * DigiXBeeWifi) can be put into API mode, where everything goes through their
+ * DigiXBeeAPI transport instead of TinyGSM.  For every other modem, this is
+ * always the TinyGSM call.
+ *
+ * @param apiCall The call to make on the DigiXBeeAPI in API mode
+ * @param tinyGsmCall The call to make on TinyGSM otherwise
+ *
+ * @return Text string picking the call for the mode the modem is in
+ */
+#define MS_MODEM_XBEE_API_OR(apiCall, tinyGsmCall) \
+    (_apiMode ? (apiCall) : (tinyGsmCall))
+#else  // #if defined TINY_GSM_MODEM_XBEE
+/**
+ * @brief Creates a text string to pick between a call on the XBee's API frame
+ * transport and a call on TinyGSM.
+ *
+ * The XBee's in transparent mode (DigiXBeeCellularTransparent and
+ * DigiXBeeWifi) can be put into API mode, where everything goes through their
+ * DigiXBeeAPI transport instead of TinyGSM.  For every other modem, this is
+ * always the TinyGSM call.
+ *
+ * @param apiCall The call to make on the DigiXBeeAPI in API mode
+ * @param tinyGsmCall The call to make on TinyGSM otherwise
+ *
+ * @return Text string picking the call for the mode the modem is in
+ */
+#define MS_MODEM_XBEE_API_OR(apiCall, tinyGsmCall) (tinyGsmCall)
+#endif  // #if defined TINY_GSM_MODEM_XBEE
+
 
 /**
  * @brief Creates an extraModemSetup() function for a specific modem subclass.
@@ -94,87 +129,39 @@
 
 
 /**
- * @brief Creates a modemWake() function for a specific modem subclass.
+ * @brief Creates modemWake(), modemTestAT(uint32_t timeout_ms), and
+ * modemInit() functions for a specific modem subclass.
+ *
+ * The modemWake() function starts the wake with loggerModem::modemWakeBegin()
+ * and then runs loggerModem::poll() until the modem responds or the wake
+ * fails.  The other two are passthroughs to the TinyGSM testAT() and init()
+ * used by loggerModem::poll().
  *
  * @param specificModem The modem subclass
  *
- * @return The text of a modemWake() function specific to a single modem
- * subclass.
+ * @return The text of modemWake(), modemTestAT(uint32_t timeout_ms), and
+ * modemInit() functions specific to a single modem subclass.
  */
-#define MS_MODEM_WAKE(specificModem)                                           \
-    bool specificModem::modemWake(void) {                                      \
-        /* Power up */                                                         \
-        if (_millisPowerOn == 0) { modemPowerUp(); }                           \
-                                                                               \
-        /** Set-up pin modes.                                                  \
-          Because the modem calls wake BEFORE the first setup, we must set     \
-          the pin modes in the wake function. */                               \
-        setModemPinModes();                                                    \
-                                                                               \
-        MS_DBG(F("Wait"), _wakeDelayTime_ms - (millis() - _millisPowerOn),     \
-               F("ms longer for warm-up"));                                    \
-        while (millis() - _millisPowerOn < _wakeDelayTime_ms) {}               \
-                                                                               \
-        if (isModemAwake()) {                                                  \
-            MS_DBG(getModemName(),                                             \
-                   F("was already on! Will not run wake function."));          \
-        } else {                                                               \
-            /** Run the specific modemWakeFxn(). */                            \
-            MS_DBG(F("Running wake function for"), getModemName());            \
-            if (!modemWakeFxn()) {                                             \
-                MS_DBG(F("Wake function for"), getModemName(),                 \
-                       F("did not run as expected!"));                         \
-            }                                                                  \
-        }                                                                      \
-                                                                               \
-        uint8_t resets  = 0;                                                   \
-        bool    success = false;                                               \
-        while (!success && resets < 2) {                                       \
-            /** Check that the modem is responding to AT commands. */          \
-            MS_START_DEBUG_TIMER;                                              \
-            MS_DBG(F("\nWaiting up to"), _max_atresponse_time_ms, F("ms for"), \
-                   getModemName(), F("to respond to AT commands..."));         \
-            success = gsmModem.testAT(_max_atresponse_time_ms + 500);          \
-            if (success) {                                                     \
-                MS_DBG(F("... AT OK after"), MS_PRINT_DEBUG_TIMER,             \
-                       F("milliseconds!"));                                    \
-            } else {                                                           \
-                /** Hard reset is there's no AT response. */                   \
-                MS_DBG(F("No response to AT commands!"));                      \
-                MS_DBG(F("Attempting a hard reset on the modem! "),            \
-                       resets + 1);                                            \
-                if (!modemHardReset()) {                                       \
-                    /** Exit if we can't hard reset. */                        \
-                    break;                                                     \
-                } else {                                                       \
-                    resets++;                                                  \
-                }                                                              \
-            }                                                                  \
-        }                                                                      \
-                                                                               \
-        /** Clean any junk out of the modem buffer. */                         \
-        gsmModem.streamClear();                                                \
-                                                                               \
-        /** Re-run the modem init, or setup if necessary.                      \
-            This will turn off echo, which often turns itself back on after    \
-            a reset/power loss.                                                \
-            This also checks the SIM card state. */                            \
-        if (!_hasBeenSetup) {                                                  \
-            /** If we run setup, take success value entirely from that. */     \
-            success = modemSetup();                                            \
-        } else {                                                               \
-            success &= gsmModem.init();                                        \
-        }                                                                      \
-        gsmClient.init(&gsmModem);                                             \
-                                                                               \
-        if (success) {                                                         \
-            modemLEDOn();                                                      \
-            MS_DBG(getModemName(), F("should be awake and ready to go."));     \
-        } else {                                                               \
-            MS_DBG(getModemName(), F("failed to wake!"));                      \
-        }                                                                      \
-                                                                               \
-        return success;                                                        \
+#define MS_MODEM_WAKE(specificModem)                                        \
+    bool specificModem::modemWake(void) {                                   \
+        modemWakeBegin();                                                   \
+        while (!poll()) { waitForPoll(); }                                  \
+        return getModemState() != MODEM_FAILED;                             \
+    }                                                                       \
+    bool specificModem::modemTestAT(uint32_t timeout_ms) {                  \
+        return MS_MODEM_XBEE_API_OR(api.testAT(timeout_ms),                 \
+                                    gsmModem.testAT(timeout_ms));           \
+    }                                                                       \
+    bool specificModem::modemInit(void) {                                   \
+        /** Clean any junk out of the modem buffer. */                      \
+        gsmModem.streamClear();                                             \
+        /** Re-run the modem init.                                          \
+            This will turn off echo, which often turns itself back on after \
+            a reset/power loss.                                             \
+            This also checks the SIM card state. */                         \
+        bool success = MS_MODEM_XBEE_API_OR(api.init(), gsmModem.init());   \
+        gsmClient.init(&gsmModem);                                          \
+        return success;                                                     \
     }
 
 #if defined TINY_GSM_MODEM_HAS_GPRS
@@ -193,50 +180,56 @@
  * @return The text of an isInternetAvailable() function specific to a single
  * modem subclass.
  */
-#define MS_MODEM_IS_INTERNET_AVAILABLE(specificModem) \
-    bool specificModem::isInternetAvailable(void) {   \
-        return gsmModem.isGprsConnected();            \
+#define MS_MODEM_IS_INTERNET_AVAILABLE(specificModem)            \
+    bool specificModem::isInternetAvailable(void) {              \
+        return MS_MODEM_XBEE_API_OR(api.isNetworkConnected(),    \
+                                    gsmModem.isGprsConnected()); \
     }
 
 #ifndef TINY_GSM_MODEM_XBEE
 /**
- * @brief Creates a text string of the functions to call for a specific modem to
+ * @brief Creates a text string of the function to call for a specific modem to
  * set the APN and connect to GPRS during the internet connection sequence.
  *
  * For most cellular modems, this is a passthrough to gprsConnect() for the
- * specific TinyGSM modem type.  For the XBee, this is an empty string.
+ * specific TinyGSM modem type.  For the XBee, the APN is set during setup, so
+ * this is simply `true`.
  *
- * @return Text string containing the functions to set the APN and connect to
- * GPRS.
+ * @return Text string containing the function to set the APN and connect to
+ * GPRS, which returns true if the connection was made.
  */
-#define MS_MODEM_SET_APN                                    \
-    MS_DBG(F("... Registered after"), MS_PRINT_DEBUG_TIMER, \
-           F("milliseconds.  Connecting to GPRS..."));      \
-    gsmModem.gprsConnect(_apn, "", "");
+#define MS_MODEM_SET_APN gsmModem.gprsConnect(_apn, "", "")
 #else  // #ifndef TINY_GSM_MODEM_XBEE
 /**
- * @brief Creates a text string of the functions to call for a specific modem to
+ * @brief Creates a text string of the function to call for a specific modem to
  * set the APN and connect to GPRS during the internet connection sequence.
  *
  * For most cellular modems, this is a passthrough to gprsConnect() for the
- * specific TinyGSM modem type.  For the XBee, this is an empty string.
+ * specific TinyGSM modem type.  For the XBee, the APN is set during setup, so
+ * this is simply `true`.
  *
- * @return Text string containing the functions to set the APN and connect to
- * GPRS.
+ * @return Text string containing the function to set the APN and connect to
+ * GPRS, which returns true if the connection was made.
  */
-#define MS_MODEM_SET_APN
+#define MS_MODEM_SET_APN true
 #endif  // #ifndef TINY_GSM_MODEM_XBEE
 
 /**
- * @brief Creates a connectInternet(uint32_t maxConnectionTime) function for a
- * specific modem subclass.
+ * @brief Creates a connectInternet(uint32_t maxConnectionTime) function and the
+ * isNetworkRegistered(), startNetworkAttach(), and startDataConnection()
+ * functions it relies on for a specific modem subclass.
  *
- * For cellular modems, this uses the TinyGSM waitForNetwork() function for the
- * specific modem and then connects to GPRS using #MS_MODEM_SET_APN.
+ * The connectInternet(uint32_t maxConnectionTime) function starts the
+ * connection with loggerModem::connectInternetBegin() and then runs
+ * loggerModem::poll() until the modem is connected or gives up.
  *
- * For WiFi modems, this first checks for pre-existing internet connection and
- * if that isn't present uses the specific modem's networkConnect(ssid, pwd)
- * function followed by waitForNetwork(uint32_t maxConnectionTime).
+ * For cellular modems, the modem registers on its own and then connects to
+ * GPRS using #MS_MODEM_SET_APN.
+ *
+ * For WiFi modems, if the modem isn't already connected, it's asked to join
+ * with the specific modem's joinNetwork() function, which sends the
+ * credentials or tries the cached access point.  If the modem doesn't join,
+ * it's asked again until maxConnectionTime runs out.
  *
  * @note The order of credentials and waiting is reversed between cellular and
  * WiFi modems.  WiFi modems must send first credentials and then wait for the
@@ -247,58 +240,33 @@
  * @param specificModem The modem subclass
  *
  * @return The text of a connectInternet(uint32_t maxConnectionTime) function
- * specific to a single modem subclass.
+ * and its helpers specific to a single modem subclass.
  */
-#define MS_MODEM_CONNECT_INTERNET(specificModem)                             \
-    bool specificModem::connectInternet(uint32_t maxConnectionTime) {        \
-        bool success = true;                                                 \
-                                                                             \
-        /** Power up, if necessary */                                        \
-        bool wasPowered = true;                                              \
-        if (_millisPowerOn == 0) {                                           \
-            modemPowerUp();                                                  \
-            wasPowered = false;                                              \
-        }                                                                    \
-                                                                             \
-        /** Check if the modem was awake, wake it if not */                  \
-        bool wasAwake = isModemAwake();                                      \
-        if (!wasAwake) {                                                     \
-            while (millis() - _millisPowerOn < _wakeDelayTime_ms) {}         \
-            MS_DBG(F("Waking up the modem to connect to the internet ...")); \
-            success &= modemWake();                                          \
-        } else {                                                             \
-            MS_DBG(F("Modem was already awake and should be ready."));       \
-        }                                                                    \
-                                                                             \
-        if (success) {                                                       \
-            MS_START_DEBUG_TIMER                                             \
-            MS_DBG(F("\nWaiting up to"), maxConnectionTime / 1000,           \
-                   F("seconds for cellular network registration..."));       \
-            if (gsmModem.waitForNetwork(maxConnectionTime)) {                \
-                MS_MODEM_SET_APN                                             \
-                MS_DBG(F("... Connected after"), MS_PRINT_DEBUG_TIMER,       \
-                       F("milliseconds."));                                  \
-                success = true;                                              \
-            } else {                                                         \
-                MS_DBG(F("...GPRS connection failed."));                     \
-                success = false;                                             \
-            }                                                                \
-        }                                                                    \
-        if (!wasPowered) {                                                   \
-            MS_DBG(F("Modem was powered to connect to the internet!  "       \
-                     "Remember to turn it off when you're done."));          \
-        } else if (!wasAwake) {                                              \
-            MS_DBG(F("Modem was woken up to connect to the internet!   "     \
-                     "Remember to put it to sleep when you're done."));      \
-        }                                                                    \
-        return success;                                                      \
+#define MS_MODEM_CONNECT_INTERNET(specificModem)                      \
+    bool specificModem::connectInternet(uint32_t maxConnectionTime) { \
+        connectInternetBegin(maxConnectionTime);                      \
+        while (!poll()) { waitForPoll(); }                            \
+        return getModemState() == MODEM_CONNECTED;                    \
+    }                                                                 \
+    bool specificModem::isNetworkRegistered(void) {                   \
+        return MS_MODEM_XBEE_API_OR(api.isNetworkConnected(),         \
+                                    gsmModem.isNetworkConnected());   \
+    }                                                                 \
+    bool specificModem::startNetworkAttach(void) {                    \
+        /** The modem registers on its own once awake. */             \
+        return true;                                                  \
+    }                                                                 \
+    bool specificModem::startDataConnection(void) {                   \
+        MS_DBG(F("Connecting to GPRS..."));                           \
+        return MS_MODEM_SET_APN;                                      \
     }
 
 /**
  * @brief Creates a disconnectInternet() function for a specific modem subclass.
  *
  * For cellular modems, this is a passthrough to gprsDisconnect() for the
- * specific TinyGSM modem type.
+ * specific TinyGSM modem type.  If the network granted power saving mode, the
+ * connection is left up so the modem can drop into PSM still attached.
  *
  * For Wifi modems, this is a passthrough to networkDisconnect() for the
  * specific TinyGSM modem type
@@ -308,12 +276,16 @@
  * @return The text of a disconnectInternet() function specific to a single
  * modem subclass.
  */
-#define MS_MODEM_DISCONNECT_INTERNET(specificModem)           \
-    void specificModem::disconnectInternet(void) {            \
-        MS_START_DEBUG_TIMER;                                 \
-        gsmModem.gprsDisconnect();                            \
-        MS_DBG(F("Disconnected from cellular network after"), \
-               MS_PRINT_DEBUG_TIMER, F("milliseconds."));     \
+#define MS_MODEM_DISCONNECT_INTERNET(specificModem)                          \
+    void specificModem::disconnectInternet(void) {                           \
+        if (_psmGranted) {                                                   \
+            MS_DBG(F("Staying attached so the modem can use PSM"));          \
+            return;                                                          \
+        }                                                                    \
+        MS_START_DEBUG_TIMER;                                                \
+        MS_MODEM_XBEE_API_OR(api.closeSockets(), gsmModem.gprsDisconnect()); \
+        MS_DBG(F("Disconnected from cellular network after"),                \
+               MS_PRINT_DEBUG_TIMER, F("milliseconds."));                    \
     }
 
 #else  // from #if defined TINY_GSM_MODEM_HAS_GPRS (ie, this is wifi)
@@ -333,21 +305,30 @@
  * @return The text of an isInternetAvailable() function specific to a single
  * modem subclass.
  */
-#define MS_MODEM_IS_INTERNET_AVAILABLE(specificModem) \
-    bool specificModem::isInternetAvailable(void) {   \
-        return gsmModem.isNetworkConnected();         \
+#define MS_MODEM_IS_INTERNET_AVAILABLE(specificModem)               \
+    bool specificModem::isInternetAvailable(void) {                 \
+        return MS_MODEM_XBEE_API_OR(api.isNetworkConnected(),       \
+                                    gsmModem.isNetworkConnected()); \
     }
 
 /**
- * @brief Creates a connectInternet(uint32_t maxConnectionTime) function for a
- * specific modem subclass.
+ * @brief Creates a connectInternet(uint32_t maxConnectionTime) function and the
+ * isNetworkRegistered(), startNetworkAttach(), and startDataConnection()
+ * functions it relies on for a specific modem subclass.
+ *
+ * The connectInternet(uint32_t maxConnectionTime) function starts the
+ * connection with loggerModem::connectInternetBegin() and then runs
+ * loggerModem::poll() until the modem is connected or gives up.
  *
- * For cellular modems, this uses the TinyGSM waitForNetwork() function for the
- * specific modem and then connects to GPRS using #MS_MODEM_SET_APN.
+ * For cellular modems, the modem registers on its own and then connects to
+ * GPRS using #MS_MODEM_SET_APN.
  *
- * For WiFi modems, this first checks for pre-existing internet connection and
- * if that isn't present uses the specific modem's networkConnect(ssid, pwd)
- * function followed by waitForNetwork(uint32_t maxConnectionTime).
+ * For WiFi modems, if the modem isn't already connected, it's asked to join
+ * with the specific modem's joinNetwork() function, which sends the
+ * credentials or tries the cached access point.  If the modem doesn't join,
+ * it's asked again until maxConnectionTime runs out.  The specific modem's
+ * joinFinished() function reads the answer to a join that's still going, so
+ * the modem isn't asked anything else before it's done.
  *
  * @note The order of credentials and waiting is reversed between cellular and
  * WiFi modems.  WiFi modems must send first credentials and then wait for the
@@ -358,25 +339,25 @@
  * @param specificModem The modem subclass
  *
  * @return The text of a connectInternet(uint32_t maxConnectionTime) function
- * specific to a single modem subclass.
+ * and its helpers specific to a single modem subclass.
  */
-#define MS_MODEM_CONNECT_INTERNET(specificModem)                      \
-    bool specificModem::connectInternet(uint32_t maxConnectionTime) { \
-        MS_START_DEBUG_TIMER                                          \
-        MS_DBG(F("\nAttempting to connect to WiFi network..."));      \
-        if (!(gsmModem.isNetworkConnected())) {                       \
-            MS_DBG(F("Sending credentials..."));                      \
-            while (!gsmModem.networkConnect(_ssid, _pwd)) {}          \
-            MS_DBG(F("Waiting up to"), maxConnectionTime / 1000,      \
-                   F("seconds for connection"));                      \
-            if (!gsmModem.waitForNetwork(maxConnectionTime)) {        \
-                MS_DBG(F("... WiFi connection failed"));              \
-                return false;                                         \
-            }                                                         \
-        }                                                             \
-        MS_DBG(F("... WiFi connected after"), MS_PRINT_DEBUG_TIMER,   \
-               F("milliseconds!"));                                   \
-        return true;                                                  \
+#define MS_MODEM_CONNECT_INTERNET(specificModem)                       \
+    bool specificModem::connectInternet(uint32_t maxConnectionTime) {  \
+        connectInternetBegin(maxConnectionTime);                       \
+        while (!poll()) { waitForPoll(); }                             \
+        return getModemState() == MODEM_CONNECTED;                     \
+    }                                                                  \
+    bool specificModem::isNetworkRegistered(void) {                    \
+        if (!joinFinished()) return false;                             \
+        return MS_MODEM_XBEE_API_OR(api.isNetworkConnected(),          \
+                                    gsmModem.isNetworkConnected());    \
+    }                                                                  \
+    bool specificModem::startNetworkAttach(void) {                     \
+        return joinNetwork();                                          \
+    }                                                                  \
+    bool specificModem::startDataConnection(void) {                    \
+        /** The modem is connected as soon as it joins the network. */ \
+        return true;                                                   \
     }
 
 /**
@@ -411,10 +392,13 @@
  * This would be much more efficient if done over UDP, but I'm doing it over TCP
  * because I don't have a UDP library for all the modems.
  *
- * @note We eust ensure that we do not ping the daylight server more than once
+ * @note We must ensure that we do not ping the daylight server more than once
  * every 4 seconds.  NIST clearly specifies here that this is a requirement for
  * all software that accesses its servers:
  * https://tf.nist.gov/tf-cgi/servers.cgi
+ * The spacing is checked by loggerModem::startNISTRequest().  Rather than
+ * wait, this gives up once another attempt would come too soon, which only
+ * happens after an attempt that failed in under 4 seconds.
  *
  * @param specificModem The modem subclass
  *
@@ -432,7 +416,7 @@
                                                                               \
         /** Try up to 12 times to get a timestamp from NIST. */               \
         for (uint8_t i = 0; i < 12; i++) {                                    \
-            while (millis() < _lastNISTrequest + 4000) {}                     \
+            if (!startNISTRequest()) return 0;                                \
                                                                               \
             /** Make TCP connection. */                                       \
             MS_DBG(F("\nConnecting to NIST daytime Server"));                 \
@@ -527,7 +511,8 @@
                                               int16_t& percent) { \
         /* Get signal quality */                                  \
         MS_DBG(F("Getting signal quality:"));                     \
-        int16_t signalQual = gsmModem.getSignalQuality();         \
+        int16_t signalQual = MS_MODEM_XBEE_API_OR(                \
+            api.getSignalQuality(), gsmModem.getSignalQuality()); \
         MS_DBG(F("Raw signal quality:"), signalQual);             \
                                                                   \
         /* Convert signal quality to RSSI, if necessary */        \
@@ -536,6 +521,61 @@
         return true;                                              \
     }
 
+/**
+ * @brief Creates a getModemSignalAndBattery(int16_t& rssi, int16_t& percent,
+ * uint8_t& chargeState, int8_t& batteryPercent, uint16_t& milliVolts)
+ * function for a specific modem subclass.
+ *
+ * This is for the modems that answer the standard `AT+CSQ` and `AT+CBC`
+ * (charge state, percent, and millivolts) commands.  Both are sent on a single
+ * line, `AT+CSQ;+CBC`, so the signal quality and battery data come back in
+ * one exchange with the modem instead of two.  If the modem won't take the
+ * combined line, the separate functions are used instead.
+ *
+ * @param specificModem The modem subclass
+ *
+ * @return The text of a getModemSignalAndBattery(int16_t& rssi, int16_t&
+ * percent, uint8_t& chargeState, int8_t& batteryPercent, uint16_t&
+ * milliVolts) function specific to a single modem subclass.
+ */
+#define MS_MODEM_GET_MODEM_SIGNAL_AND_BATTERY(specificModem)                \
+    bool specificModem::getModemSignalAndBattery(                           \
+        int16_t& rssi, int16_t& percent, uint8_t& chargeState,              \
+        int8_t& batteryPercent, uint16_t& milliVolts) {                     \
+        MS_DBG(F("Getting signal quality and battery data together:"));     \
+        int16_t signalQual = 99;                                            \
+        chargeState        = 99;                                            \
+        batteryPercent     = -99;                                           \
+        milliVolts         = 9999;                                          \
+                                                                            \
+        /* Both queries on one line get both answers before the OK */       \
+        gsmModem.sendAT(GF("+CSQ;+CBC"));                                   \
+        bool success = gsmModem.waitResponse(GF("+CSQ:")) == 1;             \
+        if (success) {                                                      \
+            signalQual = gsmModem.stream.readStringUntil(',').toInt();      \
+            success    = gsmModem.waitResponse(GF("+CBC:")) == 1;           \
+        }                                                                   \
+        if (success) {                                                      \
+            chargeState    = gsmModem.stream.readStringUntil(',').toInt();  \
+            batteryPercent = gsmModem.stream.readStringUntil(',').toInt();  \
+            milliVolts     = gsmModem.stream.readStringUntil('\n').toInt(); \
+            success        = gsmModem.waitResponse() == 1;                  \
+        }                                                                   \
+        MS_DBG(F("Raw signal quality:"), signalQual);                       \
+                                                                            \
+        /* Convert signal quality to RSSI, if necessary */                  \
+        MS_MODEM_CALC_SIGNAL_QUALITY                                        \
+                                                                            \
+        if (!success) {                                                     \
+            /* Not every firmware takes more than one command per line */   \
+            MS_DBG(F("Combined query failed; asking separately"));          \
+            success = getModemSignalQuality(rssi, percent);                 \
+            success &= getModemBatteryStats(chargeState, batteryPercent,    \
+                                            milliVolts);                    \
+        }                                                                   \
+        return success;                                                     \
+    }
+
 #ifdef TINY_GSM_MODEM_HAS_BATTERY
 /**
  * @brief Creates a getModemBatteryStats(uint8_t& chargeState, int8_t& percent,
@@ -554,11 +594,13 @@
  * percent, uint16_t& milliVolts) function specific to a single modem subclass.
  *
  */
-#define MS_MODEM_GET_MODEM_BATTERY_DATA(specificModem)                  \
-    bool specificModem::getModemBatteryStats(                           \
-        uint8_t& chargeState, int8_t& percent, uint16_t& milliVolts) {  \
-        MS_DBG(F("Getting modem battery data:"));                       \
-        return gsmModem.getBattStats(chargeState, percent, milliVolts); \
+#define MS_MODEM_GET_MODEM_BATTERY_DATA(specificModem)                 \
+    bool specificModem::getModemBatteryStats(                          \
+        uint8_t& chargeState, int8_t& percent, uint16_t& milliVolts) { \
+        MS_DBG(F("Getting modem battery data:"));                      \
+        return MS_MODEM_XBEE_API_OR(                                   \
+            api.getBattStats(chargeState, percent, milliVolts),        \
+            gsmModem.getBattStats(chargeState, percent, milliVolts));  \
     }
 
 #else
@@ -606,13 +648,14 @@
  * modem subclass.
  *
  */
-#define MS_MODEM_GET_MODEM_TEMPERATURE_DATA(specificModem) \
-    float specificModem::getModemChipTemperature(void) {   \
-        MS_DBG(F("Getting temperature:"));                 \
-        float temp = gsmModem.getTemperature();            \
-        MS_DBG(F("Temperature:"), temp);                   \
-                                                           \
-        return temp;                                       \
+#define MS_MODEM_GET_MODEM_TEMPERATURE_DATA(specificModem)            \
+    float specificModem::getModemChipTemperature(void) {              \
+        MS_DBG(F("Getting temperature:"));                            \
+        float temp = MS_MODEM_XBEE_API_OR(api.getTemperature(),       \
+                                          gsmModem.getTemperature()); \
+        MS_DBG(F("Temperature:"), temp);                              \
+                                                                      \
+        return temp;                                                  \
     }
 
 #else
@@ -638,4 +681,143 @@
     }
 #endif
 
+/**
+ * @brief Creates the modemPowerSaveSetup() and readPowerSaveTimers()
+ * functions for a specific modem subclass.
+ *
+ * This is only for the LTE-M/NB-IoT modems that use the standard 3GPP power
+ * saving commands.  The requested PSM timers are sent with `AT+CPSMS` and the
+ * requested eDRX cycle with `AT+CEDRXS` for LTE-M (WB-S1).  The timers granted
+ * by the network are read back from `AT+CEREG?` with result code 4.
+ *
+ * @param specificModem The modem subclass
+ *
+ * @return The text of modemPowerSaveSetup() and readPowerSaveTimers()
+ * functions specific to a single modem subclass.
+ */
+#define MS_MODEM_POWER_SAVE(specificModem)                                  \
+    bool specificModem::modemPowerSaveSetup(void) {                         \
+        bool success = true;                                                \
+        char tau[9];                                                        \
+        char active[9];                                                     \
+        char cycle[5];                                                      \
+        if (_requestedTAU_s > 0) {                                          \
+            timerToBits(encodeT3412(_requestedTAU_s), 8, tau);              \
+            timerToBits(encodeT3324(_requestedActiveTime_s), 8, active);    \
+            MS_DBG(F("Requesting PSM with TAU"), tau, F("and active time"), \
+                   active);                                                 \
+            gsmModem.sendAT(GF("+CPSMS=1,,,\""), tau, GF("\",\""), active,  \
+                            GF("\""));                                      \
+        } else {                                                            \
+            gsmModem.sendAT(GF("+CPSMS=0"));                                \
+        }                                                                   \
+        success &= gsmModem.waitResponse() == 1;                            \
+        if (_requestedEDRX_ms > 0) {                                        \
+            timerToBits(encodeEDRX(_requestedEDRX_ms), 4, cycle);           \
+            MS_DBG(F("Requesting eDRX cycle"), cycle);                      \
+            gsmModem.sendAT(GF("+CEDRXS=1,4,\""), cycle, GF("\""));         \
+        } else {                                                            \
+            gsmModem.sendAT(GF("+CEDRXS=0"));                               \
+        }                                                                   \
+        success &= gsmModem.waitResponse() == 1;                            \
+        return success;                                                     \
+    }                                                                       \
+    bool specificModem::readPowerSaveTimers(void) {                         \
+        _psmGranted = false;                                                \
+        gsmModem.sendAT(GF("+CEREG=4"));                                    \
+        if (gsmModem.waitResponse() != 1) return false;                     \
+        gsmModem.sendAT(GF("+CEREG?"));                                     \
+        bool success = gsmModem.waitResponse(GF("+CEREG:")) == 1;           \
+        if (success) {                                                      \
+            String status = gsmModem.stream.readStringUntil('\n');          \
+            gsmModem.waitResponse();                                        \
+            success = parsePowerSaveTimers(status.c_str());                 \
+        }                                                                   \
+        gsmModem.sendAT(GF("+CEREG=0"));                                    \
+        gsmModem.waitResponse();                                            \
+        return success;                                                     \
+    }
+
+/**
+ * @brief Creates the readNetworkSelection(), selectNetwork(),
+ * selectAnyNetwork(), and checkNetworkSelection() functions for a specific
+ * modem subclass.
+ *
+ * The operator and access technology are read and selected with the standard
+ * `AT+COPS` command.  The cached network is selected with `AT+COPS=4`, so the
+ * modem goes back to automatic selection on its own if it can't register on
+ * it.  Selection doesn't answer until the modem has registered or given up,
+ * and any other command would stop it, so the answer is read on each poll
+ * once there's something to read.  The band is only locked for the search;
+ * the bands that were set are put back once it answers or is stopped.  The
+ * band commands differ between modules, so each modem subclass using this
+ * must have its own getServingBand(), setBandLock(uint8_t accessTech, uint8_t
+ * band), and clearBandLock() functions.
+ *
+ * @param specificModem The modem subclass
+ *
+ * @return The text of readNetworkSelection(), selectNetwork(),
+ * selectAnyNetwork(), and checkNetworkSelection() functions specific to a
+ * single modem subclass.
+ */
+#define MS_MODEM_NETWORK_SELECTION(specificModem)                            \
+    bool specificModem::readNetworkSelection(modemNetwork& network) {        \
+        /** Ask for the operator as its numeric code. */                     \
+        gsmModem.sendAT(GF("+COPS=3,2"));                                    \
+        gsmModem.waitResponse();                                             \
+        gsmModem.sendAT(GF("+COPS?"));                                       \
+        if (gsmModem.waitResponse(GF("+COPS:")) != 1) return false;          \
+        /** The answer is <mode>,<format>,"<oper>",<AcT> */                  \
+        gsmModem.stream.readStringUntil('"');                                \
+        network.operatorCode = gsmModem.stream.readStringUntil('"').toInt(); \
+        gsmModem.stream.readStringUntil(',');                                \
+        network.accessTech = gsmModem.stream.readStringUntil('\n').toInt();  \
+        gsmModem.waitResponse();                                             \
+        network.band = getServingBand();                                     \
+        return network.operatorCode != 0;                                    \
+    }                                                                        \
+    bool specificModem::selectNetwork(const modemNetwork& network) {         \
+        if (!setBandLock(network.accessTech, network.band)) return false;    \
+        /** Manual, falling back to automatic; answers once registered. */   \
+        gsmModem.sendAT(GF("+COPS=4,2,\""), network.operatorCode, GF("\","), \
+                        static_cast<int>(network.accessTech));               \
+        return true;                                                         \
+    }                                                                        \
+    bool specificModem::selectAnyNetwork(void) {                             \
+        /** Any command stops a selection still going; clear its answer. */  \
+        gsmModem.sendAT();                                                   \
+        gsmModem.waitResponse(1000L);                                        \
+        gsmModem.waitResponse(100L);                                         \
+        bool success = clearBandLock();                                      \
+        gsmModem.sendAT(GF("+COPS=0"));                                      \
+        return success;                                                      \
+    }                                                                        \
+    int8_t specificModem::checkNetworkSelection(void) {                      \
+        /** Nothing to read yet; don't hold up the poll waiting for it. */   \
+        if (!gsmModem.stream.available()) return 0;                          \
+        int8_t answer = gsmModem.waitResponse(1000L);                        \
+        /** Widening the bands again doesn't drop the registration. */       \
+        if (answer != 0) clearBandLock();                                    \
+        return answer;                                                       \
+    }
+
+/**
+ * @brief Creates a setModemBaud() function for a specific modem subclass.
+ *
+ * The rate is set with `AT+IPR` and saved with `AT&W` in the same command, so
+ * the modem comes back up at it after a power cycle.  This works for the
+ * SIMCom and Quectel modules.
+ *
+ * @param specificModem The modem subclass
+ *
+ * @return The text of a setModemBaud() function specific to a single modem
+ * subclass.
+ */
+#define MS_MODEM_SET_BAUD(specificModem)                         \
+    bool specificModem::setModemBaud(uint32_t baud) {            \
+        /** The modem answers at the old rate, then switches. */ \
+        gsmModem.sendAT(GF("+IPR="), baud, GF(";&W"));           \
+        return gsmModem.waitResponse() == 1;                     \
+    }
+
 #endif  // SRC_MODEMS_LOGGERMODEMMACROS_H_
@@ -27,7 +27,8 @@ QuectelBG96::QuectelBG96(Stream* modemStream, int8_t powerPin, int8_t statusPin,
       gsmModem(*modemStream),
 #endif
       gsmClient(gsmModem) {
-    _apn = apn;
+    _apn              = apn;
+    _lockedAccessTech = 0;
 }
 
 // Destructor
@@ -40,11 +41,15 @@ MS_MODEM_WAKE(QuectelBG96);
 MS_MODEM_CONNECT_INTERNET(QuectelBG96);
 MS_MODEM_DISCONNECT_INTERNET(QuectelBG96);
 MS_MODEM_IS_INTERNET_AVAILABLE(QuectelBG96);
+MS_MODEM_POWER_SAVE(QuectelBG96);
+MS_MODEM_NETWORK_SELECTION(QuectelBG96);
+MS_MODEM_SET_BAUD(QuectelBG96);
 
 MS_MODEM_GET_NIST_TIME(QuectelBG96);
 
 MS_MODEM_GET_MODEM_SIGNAL_QUALITY(QuectelBG96);
 MS_MODEM_GET_MODEM_BATTERY_DATA(QuectelBG96);
+MS_MODEM_GET_MODEM_SIGNAL_AND_BATTERY(QuectelBG96);
 MS_MODEM_GET_MODEM_TEMPERATURE_DATA(QuectelBG96);
 
 // Create the wake and sleep methods for the modem
@@ -65,6 +70,11 @@ bool QuectelBG96::modemWakeFxn(void) {
 
 
 bool QuectelBG96::modemSleepFxn(void) {
+    if (_psmGranted) {
+        // Leave it on to drop into PSM by itself, still registered
+        MS_DBG(F("Leaving BG96 on to enter PSM"));
+        return true;
+    }
     if (_modemSleepRqPin >= 0) {
         // BG96 must have access to `PWRKEY` pin to sleep
         // Easiest to just go to sleep with the AT command rather than using
@@ -80,3 +90,49 @@ bool QuectelBG96::modemHardReset(void) {
     if (success) { return gsmModem.waitResponse(10000L, GF("RDY")) == 1; }
     return false;
 }
+
+
+uint8_t QuectelBG96::getServingBand(void) {
+    // The answer is +QNWINFO: "<act>","<oper>","LTE BAND <band>",<channel>
+    gsmModem.sendAT(GF("+QNWINFO"));
+    if (gsmModem.waitResponse(GF("BAND ")) != 1) return 0;
+    uint8_t band = gsmModem.stream.parseInt();
+    gsmModem.waitResponse();
+    return band;
+}
+bool QuectelBG96::setBandLock(uint8_t accessTech, uint8_t band) {
+    // Only the LTE-M (8) and NB-IoT (9) bands can be locked
+    if (band == 0 || band > 88 || (accessTech != 8 && accessTech != 9)) {
+        return true;
+    }
+    // The answer is +QCFG: "band",<GSM mask>,<LTE-M mask>,<NB-IoT mask>,
+    // each in hex with a leading 0x, which setting them doesn't take
+    gsmModem.sendAT(GF("+QCFG=\"band\""));
+    if (gsmModem.waitResponse(GF("\"band\",")) != 1) return true;
+    String masks = gsmModem.stream.readStringUntil('\n');
+    masks.trim();
+    masks.replace("0x", "");
+    gsmModem.waitResponse();
+    if (masks.length() == 0) return true;
+
+    // The mask is in hex, with bit (band - 1) set for each band
+    char    mask[24];
+    uint8_t zeros = (band - 1) / 4;
+    mask[0]       = '0' + (1 << ((band - 1) % 4));
+    memset(mask + 1, '0', zeros);
+    mask[zeros + 1] = '\0';
+    // A 0 mask is left as it is; the last 1 applies the change right away
+    gsmModem.sendAT(GF("+QCFG=\"band\",0,"), accessTech == 8 ? mask : "0", ',',
+                    accessTech == 9 ? mask : "0", GF(",1"));
+    if (gsmModem.waitResponse() != 1) return false;
+    _savedBands       = masks;
+    _lockedAccessTech = accessTech;
+    return true;
+}
+bool QuectelBG96::clearBandLock(void) {
+    if (_lockedAccessTech == 0) return true;
+    gsmModem.sendAT(GF("+QCFG=\"band\","), _savedBands, GF(",1"));
+    if (gsmModem.waitResponse() != 1) return false;
+    _lockedAccessTech = 0;
+    return true;
+}
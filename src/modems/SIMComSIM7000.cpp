@@ -27,7 +27,8 @@ SIMComSIM7000::SIMComSIM7000(Stream* modemStream, int8_t powerPin,
       gsmModem(*modemStream),
 #endif
       gsmClient(gsmModem) {
-    _apn = apn;
+    _apn              = apn;
+    _lockedAccessTech = 0;
 }
 
 // Destructor
@@ -40,11 +41,15 @@ MS_MODEM_WAKE(SIMComSIM7000);
 MS_MODEM_CONNECT_INTERNET(SIMComSIM7000);
 MS_MODEM_DISCONNECT_INTERNET(SIMComSIM7000);
 MS_MODEM_IS_INTERNET_AVAILABLE(SIMComSIM7000);
+MS_MODEM_POWER_SAVE(SIMComSIM7000);
+MS_MODEM_NETWORK_SELECTION(SIMComSIM7000);
+MS_MODEM_SET_BAUD(SIMComSIM7000);
 
 MS_MODEM_GET_NIST_TIME(SIMComSIM7000);
 
 MS_MODEM_GET_MODEM_SIGNAL_QUALITY(SIMComSIM7000);
 MS_MODEM_GET_MODEM_BATTERY_DATA(SIMComSIM7000);
+MS_MODEM_GET_MODEM_SIGNAL_AND_BATTERY(SIMComSIM7000);
 MS_MODEM_GET_MODEM_TEMPERATURE_DATA(SIMComSIM7000);
 
 // Create the wake and sleep methods for the modem
@@ -64,6 +69,11 @@ bool SIMComSIM7000::modemWakeFxn(void) {
 
 
 bool SIMComSIM7000::modemSleepFxn(void) {
+    if (_psmGranted) {
+        // Leave it on to drop into PSM by itself, still registered
+        MS_DBG(F("Leaving SIM7000 on to enter PSM"));
+        return true;
+    }
     if (_modemSleepRqPin >= 0) {
         // Must have access to `PWRKEY` pin to sleep
         // Easiest to just go to sleep with the AT command rather than using
@@ -74,3 +84,44 @@ bool SIMComSIM7000::modemSleepFxn(void) {
         return true;
     }
 }
+
+
+uint8_t SIMComSIM7000::getServingBand(void) {
+    // The answer is +CPSI: <system mode>,...,EUTRAN-BAND<band>,...
+    gsmModem.sendAT(GF("+CPSI?"));
+    if (gsmModem.waitResponse(GF("BAND")) != 1) return 0;
+    uint8_t band = gsmModem.stream.parseInt();
+    gsmModem.waitResponse();
+    return band;
+}
+bool SIMComSIM7000::setBandLock(uint8_t accessTech, uint8_t band) {
+    // Only the LTE-M (7) and NB-IoT (9) bands can be locked
+    if (band == 0 || (accessTech != 7 && accessTech != 9)) return true;
+    // The answer is a +CBANDCFG: "<mode>",<bands> line for each mode
+    gsmModem.sendAT(GF("+CBANDCFG?"));
+    if (gsmModem.waitResponse(accessTech == 9 ? GF("\"NB-IOT\",")
+                                              : GF("\"CAT-M\",")) != 1) {
+        return true;
+    }
+    String bands = gsmModem.stream.readStringUntil('\n');
+    bands.trim();
+    gsmModem.waitResponse();
+    if (bands.length() == 0) return true;
+
+    gsmModem.sendAT(GF("+CBANDCFG=\""),
+                    accessTech == 9 ? GF("NB-IOT") : GF("CAT-M"), GF("\","),
+                    band);
+    if (gsmModem.waitResponse() != 1) return false;
+    _savedBands       = bands;
+    _lockedAccessTech = accessTech;
+    return true;
+}
+bool SIMComSIM7000::clearBandLock(void) {
+    if (_lockedAccessTech == 0) return true;
+    gsmModem.sendAT(GF("+CBANDCFG=\""),
+                    _lockedAccessTech == 9 ? GF("NB-IOT") : GF("CAT-M"),
+                    GF("\","), _savedBands);
+    if (gsmModem.waitResponse() != 1) return false;
+    _lockedAccessTech = 0;
+    return true;
+}
@@ -194,6 +194,9 @@ class SIMComSIM7000 : public loggerModem {
     bool  getModemBatteryStats(uint8_t& chargeState, int8_t& percent,
                                uint16_t& milliVolts) override;
     float getModemChipTemperature(void) override;
+    bool  getModemSignalAndBattery(int16_t& rssi, int16_t& percent,
+                                   uint8_t& chargeState, int8_t& batteryPercent,
+                                   uint16_t& milliVolts) override;
 
 #ifdef MS_SIMCOMSIM7000_DEBUG_DEEP
     StreamDebugger _modemATDebugger;
@@ -214,9 +217,56 @@ class SIMComSIM7000 : public loggerModem {
     bool modemWakeFxn(void) override;
     bool extraModemSetup(void) override;
     bool isModemAwake(void) override;
+    bool modemTestAT(uint32_t timeout_ms) override;
+    bool modemInit(void) override;
+    bool isNetworkRegistered(void) override;
+    bool startNetworkAttach(void) override;
+    bool startDataConnection(void) override;
+    bool modemPowerSaveSetup(void) override;
+    bool readPowerSaveTimers(void) override;
+    bool setModemBaud(uint32_t baud) override;
+
+    bool   readNetworkSelection(modemNetwork& network) override;
+    bool   selectNetwork(const modemNetwork& network) override;
+    bool   selectAnyNetwork(void) override;
+    int8_t checkNetworkSelection(void) override;
+    /**
+     * @brief Ask the SIM7000 which LTE band it's on, with `AT+CPSI?`.
+     *
+     * @return **uint8_t** The band, or 0 if it isn't known
+     */
+    uint8_t getServingBand(void);
+    /**
+     * @brief Lock the SIM7000 to a single band of an access technology, with
+     * `AT+CBANDCFG`.
+     *
+     * @param accessTech The access technology, as `AT+COPS` gives it
+     * The bands that were set are read and kept first; if they can't be
+     * read, nothing is locked.
+     *
+     * @param band The band; 0 to leave the bands as they are
+     * @return **bool** True if the SIM7000 took the setting
+     */
+    bool setBandLock(uint8_t accessTech, uint8_t band);
+    /**
+     * @brief Put back the bands that were set before setBandLock() locked
+     * one, with `AT+CBANDCFG`.  Nothing is sent if no band was locked.
+     *
+     * @return **bool** True if the SIM7000 took the setting
+     */
+    bool clearBandLock(void);
 
  private:
     const char* _apn;
+    /**
+     * @brief The bands that were set before setBandLock() locked one, to put
+     * back with clearBandLock().
+     */
+    String _savedBands;
+    /**
+     * @brief The access technology whose bands are locked; 0 if none are.
+     */
+    uint8_t _lockedAccessTech;
 };
 /**@}*/
 #endif  // SRC_MODEMS_SIMCOMSIM7000_H_
@@ -40,11 +40,13 @@ MS_MODEM_WAKE(SIMComSIM800);
 MS_MODEM_CONNECT_INTERNET(SIMComSIM800);
 MS_MODEM_DISCONNECT_INTERNET(SIMComSIM800);
 MS_MODEM_IS_INTERNET_AVAILABLE(SIMComSIM800);
+MS_MODEM_SET_BAUD(SIMComSIM800);
 
 MS_MODEM_GET_NIST_TIME(SIMComSIM800);
 
 MS_MODEM_GET_MODEM_SIGNAL_QUALITY(SIMComSIM800);
 MS_MODEM_GET_MODEM_BATTERY_DATA(SIMComSIM800);
+MS_MODEM_GET_MODEM_SIGNAL_AND_BATTERY(SIMComSIM800);
 MS_MODEM_GET_MODEM_TEMPERATURE_DATA(SIMComSIM800);
 
 // Create the wake and sleep methods for the modem
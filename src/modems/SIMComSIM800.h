@@ -196,6 +196,9 @@ class SIMComSIM800 : public loggerModem {
     bool  getModemBatteryStats(uint8_t& chargeState, int8_t& percent,
                                uint16_t& milliVolts) override;
     float getModemChipTemperature(void) override;
+    bool  getModemSignalAndBattery(int16_t& rssi, int16_t& percent,
+                                   uint8_t& chargeState, int8_t& batteryPercent,
+                                   uint16_t& milliVolts) override;
 
 #ifdef MS_SIMCOMSIM800_DEBUG_DEEP
     StreamDebugger _modemATDebugger;
@@ -216,6 +219,12 @@ class SIMComSIM800 : public loggerModem {
     bool modemWakeFxn(void) override;
     bool extraModemSetup(void) override;
     bool isModemAwake(void) override;
+    bool modemTestAT(uint32_t timeout_ms) override;
+    bool modemInit(void) override;
+    bool isNetworkRegistered(void) override;
+    bool startNetworkAttach(void) override;
+    bool startDataConnection(void) override;
+    bool setModemBaud(uint32_t baud) override;
 
  private:
     const char* _apn;
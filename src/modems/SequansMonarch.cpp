@@ -27,7 +27,8 @@ SequansMonarch::SequansMonarch(Stream* modemStream, int8_t powerPin,
       gsmModem(*modemStream),
 #endif
       gsmClient(gsmModem) {
-    _apn = apn;
+    _apn              = apn;
+    _lockedAccessTech = 0;
 }
 
 // Destructor
@@ -39,6 +40,7 @@ MS_MODEM_WAKE(SequansMonarch);
 MS_MODEM_CONNECT_INTERNET(SequansMonarch);
 MS_MODEM_DISCONNECT_INTERNET(SequansMonarch);
 MS_MODEM_IS_INTERNET_AVAILABLE(SequansMonarch);
+MS_MODEM_NETWORK_SELECTION(SequansMonarch);
 
 MS_MODEM_GET_NIST_TIME(SequansMonarch);
 
@@ -148,3 +150,55 @@ bool SequansMonarch::extraModemSetup(void) {
 
     return success;
 }
+
+
+// The first downlink EARFCN of each LTE band the Monarch supports, in order
+static const uint32_t MONARCH_BAND_EARFCNS[] = {
+    0,    600,  1200, 1950, 2400, 3450, 5010, 5180, 5280,
+    5730, 5850, 6000, 6150, 8040, 8690, 9210, 66436};
+static const uint8_t MONARCH_BANDS[] = {1,  2,  3,  4,  5,  8,  12, 13, 14,
+                                        17, 18, 19, 20, 25, 26, 28, 66};
+
+uint8_t SequansMonarch::getServingBand(void) {
+    // The answer is +SQNMONI: <oper> Cc:<mcc> Nc:<mnc> ... EARFCN:<earfcn>
+    // ...; the band is worked out from the channel
+    gsmModem.sendAT(GF("+SQNMONI=9"));
+    if (gsmModem.waitResponse(GF("EARFCN:")) != 1) return 0;
+    uint32_t earfcn = gsmModem.stream.parseInt();
+    gsmModem.waitResponse();
+    uint8_t band = 0;
+    for (uint8_t i = 0; i < sizeof(MONARCH_BANDS); i++) {
+        if (earfcn >= MONARCH_BAND_EARFCNS[i]) band = MONARCH_BANDS[i];
+    }
+    return band;
+}
+bool SequansMonarch::setBandLock(uint8_t accessTech, uint8_t band) {
+    // Only the LTE-M (7) and NB-IoT (9) bands can be locked
+    if (band == 0 || (accessTech != 7 && accessTech != 9)) return true;
+    // The answer is a +SQNBANDSEL: <mode>,"<operator>","<bands>" line for
+    // LTE-M (0) and NB-IoT (1)
+    gsmModem.sendAT(GF("+SQNBANDSEL?"));
+    if (gsmModem.waitResponse(accessTech == 9 ? GF("+SQNBANDSEL: 1,")
+                                              : GF("+SQNBANDSEL: 0,")) != 1) {
+        return true;
+    }
+    String bands = gsmModem.stream.readStringUntil('\n');
+    bands.trim();
+    gsmModem.waitResponse();
+    if (bands.length() == 0) return true;
+
+    gsmModem.sendAT(GF("+SQNBANDSEL="), accessTech == 9 ? 1 : 0,
+                    GF(",\"standard\",\""), band, '"');
+    if (gsmModem.waitResponse() != 1) return false;
+    _savedBands       = bands;
+    _lockedAccessTech = accessTech;
+    return true;
+}
+bool SequansMonarch::clearBandLock(void) {
+    if (_lockedAccessTech == 0) return true;
+    gsmModem.sendAT(GF("+SQNBANDSEL="), _lockedAccessTech == 9 ? 1 : 0, ',',
+                    _savedBands);
+    if (gsmModem.waitResponse() != 1) return false;
+    _lockedAccessTech = 0;
+    return true;
+}
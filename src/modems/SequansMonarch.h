@@ -247,9 +247,53 @@ class SequansMonarch : public loggerModem {
     bool modemWakeFxn(void) override;
     bool extraModemSetup(void) override;
     bool isModemAwake(void) override;
+    bool modemTestAT(uint32_t timeout_ms) override;
+    bool modemInit(void) override;
+    bool isNetworkRegistered(void) override;
+    bool startNetworkAttach(void) override;
+    bool startDataConnection(void) override;
+
+    bool   readNetworkSelection(modemNetwork& network) override;
+    bool   selectNetwork(const modemNetwork& network) override;
+    bool   selectAnyNetwork(void) override;
+    int8_t checkNetworkSelection(void) override;
+    /**
+     * @brief Ask the Monarch which LTE band it's on, with `AT+SQNMONI=9`.
+     *
+     * @return **uint8_t** The band, or 0 if it isn't known
+     */
+    uint8_t getServingBand(void);
+    /**
+     * @brief Lock the Monarch to a single band of an access technology, with
+     * `AT+SQNBANDSEL`.
+     *
+     * @param accessTech The access technology, as `AT+COPS` gives it
+     * The bands that were set are read and kept first; if they can't be
+     * read, nothing is locked.
+     *
+     * @param band The band; 0 to leave the bands as they are
+     * @return **bool** True if the Monarch took the setting
+     */
+    bool setBandLock(uint8_t accessTech, uint8_t band);
+    /**
+     * @brief Put back the bands that were set before setBandLock() locked
+     * one, with `AT+SQNBANDSEL`.  Nothing is sent if no band was locked.
+     *
+     * @return **bool** True if the Monarch took the setting
+     */
+    bool clearBandLock(void);
 
  private:
     const char* _apn;
+    /**
+     * @brief The bands that were set before setBandLock() locked one, to put
+     * back with clearBandLock().
+     */
+    String _savedBands;
+    /**
+     * @brief The access technology whose bands are locked; 0 if none are.
+     */
+    uint8_t _lockedAccessTech;
 };
 /**@}*/
 #endif  // SRC_MODEMS_SEQUANSMONARCH_H_
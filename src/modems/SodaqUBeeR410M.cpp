@@ -60,6 +60,8 @@ MS_MODEM_WAKE(SodaqUBeeR410M);
 MS_MODEM_CONNECT_INTERNET(SodaqUBeeR410M);
 MS_MODEM_DISCONNECT_INTERNET(SodaqUBeeR410M);
 MS_MODEM_IS_INTERNET_AVAILABLE(SodaqUBeeR410M);
+MS_MODEM_POWER_SAVE(SodaqUBeeR410M);
+MS_MODEM_NETWORK_SELECTION(SodaqUBeeR410M);
 
 MS_MODEM_GET_NIST_TIME(SodaqUBeeR410M);
 
@@ -130,6 +132,11 @@ bool SodaqUBeeR410M::modemWakeFxn(void) {
 
 
 bool SodaqUBeeR410M::modemSleepFxn(void) {
+    if (_psmGranted) {
+        // Leave it on to drop into PSM by itself, still registered
+        MS_DBG(F("Leaving u-blox R410M on to enter PSM"));
+        return true;
+    }
     if (_modemSleepRqPin >= 0) {
         // R410 must have access to `PWR_ON` pin to sleep
         // Easiest to just go to sleep with the AT command rather than using
@@ -180,3 +187,28 @@ bool SodaqUBeeR410M::extraModemSetup(void) {
     gsmModem.waitResponse();
     return success;
 }
+
+
+uint8_t SodaqUBeeR410M::getServingBand(void) {
+    gsmModem.sendAT(GF("+UCGED=2"));
+    gsmModem.waitResponse();
+    // The answer is +UCGED: 2, then <rat>,<svc>,<MCC>,<MNC> on the next
+    // line, then <earfcn>,<Lband>,... on the line after that
+    gsmModem.sendAT(GF("+UCGED?"));
+    if (gsmModem.waitResponse(GF("+UCGED:")) != 1) return 0;
+    gsmModem.stream.readStringUntil('\n');
+    gsmModem.stream.readStringUntil('\n');
+    gsmModem.stream.readStringUntil(',');
+    uint8_t band = gsmModem.stream.parseInt();
+    gsmModem.waitResponse();
+    return band;
+}
+bool SodaqUBeeR410M::setBandLock(uint8_t, uint8_t) {
+    // The R410M only uses a new band mask after it reboots, which would undo
+    // the wake, so it's only sent to the cached operator
+    return true;
+}
+// No band was locked, so there's nothing to put back
+bool SodaqUBeeR410M::clearBandLock(void) {
+    return true;
+}
@@ -335,6 +335,41 @@ class SodaqUBeeR410M : public loggerModem {
     bool modemWakeFxn(void) override;
     bool extraModemSetup(void) override;
     bool isModemAwake(void) override;
+    bool modemTestAT(uint32_t timeout_ms) override;
+    bool modemInit(void) override;
+    bool isNetworkRegistered(void) override;
+    bool startNetworkAttach(void) override;
+    bool startDataConnection(void) override;
+    bool modemPowerSaveSetup(void) override;
+    bool readPowerSaveTimers(void) override;
+
+    bool   readNetworkSelection(modemNetwork& network) override;
+    bool   selectNetwork(const modemNetwork& network) override;
+    bool   selectAnyNetwork(void) override;
+    int8_t checkNetworkSelection(void) override;
+    /**
+     * @brief Ask the R410M which LTE band it's on, with `AT+UCGED?`.
+     *
+     * @return **uint8_t** The band, or 0 if it isn't known
+     */
+    uint8_t getServingBand(void);
+    /**
+     * @brief Leave the bands as they are.
+     *
+     * The R410M only takes a new `AT+UBANDMASK` when it reboots, with
+     * `AT+CFUN=15` or a power cycle, so a lock couldn't help the connection
+     * it's set for.  The R410M is only sent to the cached operator and
+     * access technology.
+     *
+     * @return **bool** Always true
+     */
+    bool setBandLock(uint8_t accessTech, uint8_t band);
+    /**
+     * @brief Leave the bands as they are; setBandLock() never locks one.
+     *
+     * @return **bool** Always true
+     */
+    bool clearBandLock(void);
 
  private:
     const char* _apn;
@@ -0,0 +1,471 @@
+/**
+ * @file CBORPublisher.cpp
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Implements the CBORPublisher class.
+ */
+
+#include "CBORPublisher.h"
+
+// The version of the layout of the saved schema ID
+#define MS_CBOR_SCHEMA_VERSION 1
+
+// CBOR major types, already shifted into the top 3 bits of the initial byte
+#define CBOR_UNSIGNED 0x00
+#define CBOR_NEGATIVE 0x20
+#define CBOR_BYTES 0x40
+#define CBOR_TEXT 0x60
+#define CBOR_ARRAY 0x80
+#define CBOR_MAP 0xA0
+// The simple values and floats used
+#define CBOR_NULL 0xF6
+#define CBOR_UNDEFINED 0xF7
+#define CBOR_FLOAT32 0xFA
+
+// The map keys
+#define CBOR_KEY_SCHEMA 0
+#define CBOR_KEY_FEATURE 1
+#define CBOR_KEY_VARIABLES 2
+#define CBOR_KEY_TIMESTAMP 3
+#define CBOR_KEY_RECORDS 4
+
+
+// ============================================================================
+//  Functions for a receiver of compact binary (CBOR) messages.
+// ============================================================================
+
+// Constant values for post requests
+// I want to refer to these more than once while ensuring there is only one copy
+// in memory
+const char* CBORPublisher::tokenHeader         = "\r\nTOKEN: ";
+const char* CBORPublisher::contentLengthHeader = "\r\nContent-Length: ";
+const char* CBORPublisher::contentTypeHeader =
+    "\r\nContent-Type: application/cbor\r\n\r\n";
+
+
+// Constructors
+CBORPublisher::CBORPublisher() : dataPublisher() {
+    setEndpoint(NULL, 80, "/");
+    init();
+}
+CBORPublisher::CBORPublisher(Logger& baseLogger, uint8_t sendEveryX,
+                             uint8_t sendOffset)
+    : dataPublisher(baseLogger, sendEveryX, sendOffset) {
+    setEndpoint(NULL, 80, "/");
+    init();
+}
+CBORPublisher::CBORPublisher(Logger& baseLogger, Client* inClient,
+                             uint8_t sendEveryX, uint8_t sendOffset)
+    : dataPublisher(baseLogger, inClient, sendEveryX, sendOffset) {
+    setEndpoint(NULL, 80, "/");
+    init();
+}
+CBORPublisher::CBORPublisher(Logger& baseLogger, const char* host,
+                             uint16_t port, const char* path,
+                             uint8_t sendEveryX, uint8_t sendOffset)
+    : dataPublisher(baseLogger, sendEveryX, sendOffset) {
+    setEndpoint(host, port, path);
+    init();
+}
+CBORPublisher::CBORPublisher(Logger& baseLogger, Client* inClient,
+                             const char* host, uint16_t port, const char* path,
+                             uint8_t sendEveryX, uint8_t sendOffset)
+    : dataPublisher(baseLogger, inClient, sendEveryX, sendOffset) {
+    setEndpoint(host, port, path);
+    init();
+}
+// Destructor
+CBORPublisher::~CBORPublisher() {}
+
+
+void CBORPublisher::init(void) {
+    _token              = NULL;
+    _txLength           = 0;
+    _acceptedSchema     = 0;
+    _schemaLoaded       = false;
+    _pendingSchema      = 0;
+    _pendingFirstRecord = 0;
+    _pendingEndRecord   = 0;
+#if defined(MS_CBOR_SCHEMA_EEPROM_ADDRESS)
+    _schemaAddress = MS_CBOR_SCHEMA_EEPROM_ADDRESS;
+#else
+    _schemaAddress = -1;
+#endif
+}
+
+
+void CBORPublisher::setEndpoint(const char* host, uint16_t port,
+                                const char* path) {
+    _host = host;
+    _port = port;
+    _path = path;
+    // MS_DBG(F("Endpoint set!"));
+}
+
+
+void CBORPublisher::setToken(const char* token) {
+    _token = token;
+    // MS_DBG(F("Token set!"));
+}
+
+
+void CBORPublisher::setSchemaAddress(int16_t address) {
+    _schemaAddress = address;
+    _schemaLoaded  = false;
+}
+
+
+// The schema ID is a CRC-16 (CCITT) of the UUIDs, in order
+uint16_t CBORPublisher::getSchemaID(void) {
+    uint16_t crc = 0xFFFF;
+    for (int16_t i = -1; i < _baseLogger->getArrayVarCount(); i++) {
+        String uuid = (i < 0) ? String(_baseLogger->getSamplingFeatureUUID())
+                              : _baseLogger->getVarUUIDAtI(i);
+        // Separate the UUIDs so shifting a character across doesn't collide
+        uuid += ',';
+        for (uint16_t c = 0; c < uuid.length(); c++) {
+            crc ^= static_cast<uint16_t>(uuid[c]) << 8;
+            for (uint8_t b = 0; b < 8; b++) {
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+            }
+        }
+    }
+    // 0 means no schema has been accepted
+    return crc == 0 ? 1 : crc;
+}
+
+
+void CBORPublisher::forgetSchema(void) {
+    _acceptedSchema = 0;
+    _schemaLoaded   = true;
+    PersistentStore::save(_schemaAddress, &_acceptedSchema,
+                          sizeof(_acceptedSchema), MS_CBOR_SCHEMA_VERSION);
+}
+
+
+// A way to begin with everything already set
+void CBORPublisher::begin(Logger& baseLogger, Client* inClient,
+                          const char* host, uint16_t port, const char* path) {
+    setEndpoint(host, port, path);
+    dataPublisher::begin(baseLogger, inClient);
+}
+void CBORPublisher::begin(Logger& baseLogger, const char* host, uint16_t port,
+                          const char* path) {
+    setEndpoint(host, port, path);
+    dataPublisher::begin(baseLogger);
+}
+
+
+// This utilizes an attached modem to make a TCP connection to the receiver
+// and then streams out a post request over that connection.
+// The return is the http status code of the response.
+int16_t CBORPublisher::publishData(Client* outClient) {
+    if (!publishDataBegin(outClient)) return 0;
+    return publishDataFinish();
+}
+// This sends out the request but doesn't wait for the response
+bool CBORPublisher::publishDataBegin(Client* outClient) {
+    if (_publishState != PUBLISHER_IDLE) {
+        MS_DBG(F("Publisher is already busy!"));
+        return false;
+    }
+    if (_host == NULL) {
+        PRINTOUT(F("The CBOR receiver host must be set!"));
+        completePublish(0);
+        return true;
+    }
+
+    // Create a buffer for the portions of the request
+    char tempBuffer[12] = "";
+
+    // Count the message first so the content length is known before streaming
+    planMessage(MS_CBOR_MAX_RECORDS);
+    uint32_t messageLength = writeMessage(NULL, _pendingSchema != 0,
+                                          _pendingFirstRecord,
+                                          _pendingEndRecord);
+    MS_DBG(F("Outgoing CBOR size:"), messageLength);
+
+    // Make sure any previous TCP connections are closed
+    if (outClient->connected()) { outClient->stop(); }
+
+    MS_DBG(F("Connecting client"));
+    MS_START_DEBUG_TIMER;
+    if (outClient->connect(_host, _port)) {
+        MS_DBG(F("Client connected after"), MS_PRINT_DEBUG_TIMER, F("ms\n"));
+
+        emptyTxBuffer();
+        strcat(txBuffer, postHeader);
+        strcat(txBuffer, _path);
+        strcat(txBuffer, HTTPtag);
+        strcat(txBuffer, hostHeader);
+        strcat(txBuffer, _host);
+        if (_token != NULL) {
+            strcat(txBuffer, tokenHeader);
+            strcat(txBuffer, _token);
+        }
+        strcat(txBuffer, contentLengthHeader);
+        ltoa(messageLength, tempBuffer, 10);  // BASE 10
+        strcat(txBuffer, tempBuffer);
+        strcat(txBuffer, contentTypeHeader);
+        printTxBuffer(outClient);
+
+        writeMessage(outClient, _pendingSchema != 0, _pendingFirstRecord,
+                     _pendingEndRecord);
+        outClient->flush();
+
+        // Don't wait for the response here, publishDataPoll() will pick it up
+        awaitHTTPResponse(outClient);
+    } else {
+        PRINTOUT(F("\n -- Unable to Establish Connection to"), _host, F("--"));
+        completePublish(504);
+    }
+
+    return true;
+}
+
+
+// Marks the records as sent and the schema as known once the receiver has
+// accepted the message
+bool CBORPublisher::publishDataPoll(void) {
+    if (!dataPublisher::publishDataPoll()) return false;
+    if (_publishResult >= 200 && _publishResult < 300) {
+        if (_pendingSchema != 0) {
+            MS_DBG(F("Receiver accepted schema"), _pendingSchema);
+            _acceptedSchema = _pendingSchema;
+            PersistentStore::save(_schemaAddress, &_acceptedSchema,
+                                  sizeof(_acceptedSchema),
+                                  MS_CBOR_SCHEMA_VERSION);
+        }
+        if (_pendingEndRecord > _pendingFirstRecord) {
+            markRecordsSent(_pendingEndRecord);
+        }
+    } else if (_publishResult == 409) {
+        MS_DBG(F("Receiver doesn't know the schema; it will be sent again"));
+        forgetSchema();
+    }
+    _pendingSchema      = 0;
+    _pendingFirstRecord = 0;
+    _pendingEndRecord   = 0;
+    return true;
+}
+
+
+void CBORPublisher::planMessage(uint32_t maxRecords) {
+    // Send the UUIDs only if the receiver doesn't already have them
+    if (!_schemaLoaded) {
+        PersistentStore::load(_schemaAddress, &_acceptedSchema,
+                              sizeof(_acceptedSchema), MS_CBOR_SCHEMA_VERSION);
+        _schemaLoaded = true;
+    }
+    uint16_t schemaID = getSchemaID();
+    _pendingSchema    = (schemaID != _acceptedSchema) ? schemaID : 0;
+
+    // Without a log buffer, no records are pending and the current values are
+    // sent
+    _pendingFirstRecord  = 0;
+    _pendingEndRecord    = 0;
+    LogBuffer* logBuffer = _baseLogger->getLogBuffer();
+    if (logBuffer != NULL) {
+        _pendingFirstRecord = getFirstUnsentRecord();
+        _pendingEndRecord   = logBuffer->getNextRecordNumber();
+        if (_pendingEndRecord - _pendingFirstRecord > maxRecords) {
+            _pendingEndRecord = _pendingFirstRecord + maxRecords;
+        }
+    }
+    MS_DBG(_pendingEndRecord - _pendingFirstRecord,
+           F("buffered records will be sent with"),
+           _pendingSchema != 0 ? F("the schema") : F("schema ID"), schemaID);
+}
+
+
+uint32_t CBORPublisher::writeMessage(Stream* stream, bool withSchema,
+                                     uint32_t firstRecord,
+                                     uint32_t endRecord) {
+    LogBuffer* logBuffer    = _baseLogger->getLogBuffer();
+    bool       buffered     = endRecord > firstRecord;
+    uint8_t    numVariables = buffered ? logBuffer->getNumVariables()
+                                       : _baseLogger->getArrayVarCount();
+    uint32_t   byteCount    = 0;
+
+    // The buffered timestamps are in the logger's time zone; shift them the
+    // same way the current marked time is shifted to UTC
+    uint32_t firstTimestamp = Logger::markedEpochTimeUTC;
+    if (buffered) {
+        firstTimestamp = logBuffer->getRecordTimestamp(firstRecord) -
+            (Logger::markedEpochTime - Logger::markedEpochTimeUTC);
+    }
+
+    _txLength = 0;
+    writeHead(stream, CBOR_MAP, withSchema ? 5 : 3, byteCount);
+    writeHead(stream, CBOR_UNSIGNED, CBOR_KEY_SCHEMA, byteCount);
+    writeHead(stream, CBOR_UNSIGNED, getSchemaID(), byteCount);
+
+    if (withSchema) {
+        writeHead(stream, CBOR_UNSIGNED, CBOR_KEY_FEATURE, byteCount);
+        writeUUID(stream, _baseLogger->getSamplingFeatureUUID(), byteCount);
+        writeHead(stream, CBOR_UNSIGNED, CBOR_KEY_VARIABLES, byteCount);
+        writeHead(stream, CBOR_ARRAY, _baseLogger->getArrayVarCount(),
+                  byteCount);
+        for (uint8_t i = 0; i < _baseLogger->getArrayVarCount(); i++) {
+            writeUUID(stream, _baseLogger->getVarUUIDAtI(i).c_str(), byteCount);
+        }
+    }
+
+    writeHead(stream, CBOR_UNSIGNED, CBOR_KEY_TIMESTAMP, byteCount);
+    writeHead(stream, CBOR_UNSIGNED, firstTimestamp, byteCount);
+
+    writeHead(stream, CBOR_UNSIGNED, CBOR_KEY_RECORDS, byteCount);
+    if (buffered) {
+        writeHead(stream, CBOR_ARRAY, endRecord - firstRecord, byteCount);
+        uint32_t lastTimestamp = logBuffer->getRecordTimestamp(firstRecord);
+        for (uint32_t r = firstRecord; r < endRecord; r++) {
+            uint32_t timestamp = logBuffer->getRecordTimestamp(r);
+            writeHead(stream, CBOR_ARRAY, numVariables + 1, byteCount);
+            writeHead(stream, CBOR_UNSIGNED, timestamp - lastTimestamp,
+                      byteCount);
+            lastTimestamp = timestamp;
+            for (uint8_t i = 0; i < numVariables; i++) {
+                float value = logBuffer->getRecordValue(r, i);
+                if (!logBuffer->isRecordValueReported(r, i)) {
+                    writeByte(stream, CBOR_UNDEFINED, byteCount);
+                } else if (value == -9999) {
+                    writeByte(stream, CBOR_NULL, byteCount);
+                } else {
+                    writeValue(stream,
+                               _baseLogger->formatValueStringAtI(i, value),
+                               byteCount);
+                }
+            }
+        }
+    } else {
+        writeHead(stream, CBOR_ARRAY, 1, byteCount);
+        writeHead(stream, CBOR_ARRAY, numVariables + 1, byteCount);
+        writeHead(stream, CBOR_UNSIGNED, 0, byteCount);
+        for (uint8_t i = 0; i < numVariables; i++) {
+            if (!_baseLogger->isValueReportedAtI(i)) {
+                writeByte(stream, CBOR_UNDEFINED, byteCount);
+            } else {
+                writeValue(stream, _baseLogger->getValueStringAtI(i),
+                           byteCount);
+            }
+        }
+    }
+
+    flushBuffer(stream);
+    // Leave the shared buffer empty; see dataPublisher::txBuffer
+    emptyTxBuffer();
+    return byteCount;
+}
+
+
+void CBORPublisher::writeValue(Stream* stream, const String& value,
+                               uint32_t& byteCount) {
+    if (value.toFloat() == -9999) {
+        writeByte(stream, CBOR_NULL, byteCount);
+    } else if (value.indexOf('.') < 0) {
+        // Whole numbers take 1-5 bytes as integers
+        int32_t wholeValue = value.toInt();
+        if (wholeValue < 0) {
+            writeHead(stream, CBOR_NEGATIVE,
+                      static_cast<uint32_t>(-1 - wholeValue), byteCount);
+        } else {
+            writeHead(stream, CBOR_UNSIGNED, wholeValue, byteCount);
+        }
+    } else {
+        // Everything else as a 32-bit float, most significant byte first
+        float    floatValue = value.toFloat();
+        uint32_t bits;
+        memcpy(&bits, &floatValue, sizeof(bits));
+        writeByte(stream, CBOR_FLOAT32, byteCount);
+        for (int8_t shift = 24; shift >= 0; shift -= 8) {
+            writeByte(stream, (bits >> shift) & 0xFF, byteCount);
+        }
+    }
+}
+
+
+void CBORPublisher::writeUUID(Stream* stream, const char* uuid,
+                              uint32_t& byteCount) {
+    // Pack the 32 hex digits into 16 bytes, skipping the dashes
+    uint8_t  packed[16];
+    uint8_t  numDigits = 0;
+    uint16_t len       = strlen(uuid);
+    for (uint16_t c = 0; c < len && numDigits <= 32; c++) {
+        char    ch = uuid[c];
+        uint8_t nibble;
+        if (ch == '-') {
+            continue;
+        } else if (ch >= '0' && ch <= '9') {
+            nibble = ch - '0';
+        } else if (ch >= 'a' && ch <= 'f') {
+            nibble = ch - 'a' + 10;
+        } else if (ch >= 'A' && ch <= 'F') {
+            nibble = ch - 'A' + 10;
+        } else {
+            numDigits = 0xFF;
+            break;
+        }
+        if (numDigits < 32) {
+            if (numDigits % 2 == 0) {
+                packed[numDigits / 2] = nibble << 4;
+            } else {
+                packed[numDigits / 2] |= nibble;
+            }
+        }
+        numDigits++;
+    }
+
+    if (numDigits == 32) {
+        writeHead(stream, CBOR_BYTES, 16, byteCount);
+        for (uint8_t i = 0; i < 16; i++) {
+            writeByte(stream, packed[i], byteCount);
+        }
+    } else {
+        // Anything that isn't a UUID goes as it is
+        writeHead(stream, CBOR_TEXT, len, byteCount);
+        for (uint16_t c = 0; c < len; c++) {
+            writeByte(stream, uuid[c], byteCount);
+        }
+    }
+}
+
+
+void CBORPublisher::writeHead(Stream* stream, uint8_t majorType,
+                              uint32_t argument, uint32_t& byteCount) {
+    // Small arguments fit in the initial byte; larger ones follow it in the
+    // fewest bytes that will hold them
+    if (argument < 24) {
+        writeByte(stream, majorType | argument, byteCount);
+    } else if (argument <= 0xFF) {
+        writeByte(stream, majorType | 24, byteCount);
+        writeByte(stream, argument, byteCount);
+    } else if (argument <= 0xFFFF) {
+        writeByte(stream, majorType | 25, byteCount);
+        writeByte(stream, argument >> 8, byteCount);
+        writeByte(stream, argument & 0xFF, byteCount);
+    } else {
+        writeByte(stream, majorType | 26, byteCount);
+        for (int8_t shift = 24; shift >= 0; shift -= 8) {
+            writeByte(stream, (argument >> shift) & 0xFF, byteCount);
+        }
+    }
+}
+
+
+void CBORPublisher::writeByte(Stream* stream, uint8_t b,
+                              uint32_t& byteCount) {
+    if (_txLength >= MS_SEND_BUFFER_SIZE) flushBuffer(stream);
+    txBuffer[_txLength++] = b;
+    byteCount++;
+}
+
+
+void CBORPublisher::flushBuffer(Stream* stream) {
+    if (stream != NULL && _txLength > 0) {
+        MS_DBG(F("Sending"), _txLength, F("bytes of CBOR"));
+        stream->write(reinterpret_cast<const uint8_t*>(txBuffer), _txLength);
+    }
+    _txLength = 0;
+}
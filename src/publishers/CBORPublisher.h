@@ -0,0 +1,380 @@
+/**
+ * @file CBORPublisher.h
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the CBORPublisher subclass of dataPublisher for publishing
+ * data as compact binary CBOR messages over HTTP.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_CBORPUBLISHER_H_
+#define SRC_PUBLISHERS_CBORPUBLISHER_H_
+
+// Debugging Statement
+// #define MS_CBORPUBLISHER_DEBUG
+
+#ifdef MS_CBORPUBLISHER_DEBUG
+#define MS_DEBUGGING_STD "CBORPublisher"
+#endif
+
+/**
+ * @def MS_CBOR_MAX_RECORDS
+ * @brief The maximum number of records sent in a single CBOR message.
+ *
+ * This can be changed by setting the build flag MS_CBOR_MAX_RECORDS when
+ * compiling.
+ *
+ * @ingroup the_publishers
+ */
+#ifndef MS_CBOR_MAX_RECORDS
+#define MS_CBOR_MAX_RECORDS 96
+#endif
+
+/**
+ * @def MS_CBOR_SCHEMA_EEPROM_ADDRESS
+ * @brief The EEPROM address for the ID of the last schema the receiver
+ * accepted.
+ *
+ * The schema ID is only saved to EEPROM if this is defined.  Without it, the
+ * variable UUIDs are sent again with the first message after every restart.
+ * The ID takes PersistentStore::getBlockSize(2) bytes.
+ *
+ * This can be set by setting the build flag MS_CBOR_SCHEMA_EEPROM_ADDRESS
+ * when compiling.
+ *
+ * @ingroup the_publishers
+ */
+
+// Included Dependencies
+#include "ModSensorDebugger.h"
+#undef MS_DEBUGGING_STD
+#include "dataPublisherBase.h"
+
+
+// ============================================================================
+//  Functions for a receiver of compact binary (CBOR) messages.
+// ============================================================================
+/**
+ * @brief The CBORPublisher subclass of dataPublisher for publishing data to
+ * your own receiver as compact binary [CBOR](https://cbor.io) messages over
+ * HTTP.
+ *
+ * The JSON sent to the EnviroDIY data portal repeats the 36 character UUID of
+ * every variable with every value.  Here, instead, the variables are only
+ * referred to by their position in the variable array.  The UUIDs of the
+ * sampling feature and the variables (the "schema") are sent once and the
+ * receiver is expected to remember them.  Each message carries a 16-bit schema
+ * ID, a checksum of the UUIDs, so the receiver can look up the variable list
+ * the message was sent with.
+ *
+ * Each message is a CBOR map with small integer keys:
+ *
+ * | Key | Value                                                  |
+ * | --- | ------------------------------------------------------ |
+ * | 0   | The schema ID                                          |
+ * | 1   | The sampling feature UUID (with the schema only)       |
+ * | 2   | The variable UUIDs, in an array (with the schema only) |
+ * | 3   | The UTC Unix timestamp of the first record             |
+ * | 4   | An array of records                                    |
+ *
+ * UUIDs are sent as 16 byte strings.
+ *
+ * Each record is an array of the seconds since the record before it (0 for
+ * the first) followed by the value of every variable, in the order of the
+ * variable array.  Values are rounded to the variable's resolution and sent
+ * as integers when they are whole numbers, as 32-bit floats otherwise, and as
+ * null when they are -9999.  Values which have not changed by more than the
+ * variable's deadband (see Variable::setReportByException(float, uint32_t))
+ * are sent as undefined, to keep the positions of the rest.
+ *
+ * Keys 1 and 2 are only included until the receiver has accepted a message
+ * with them, and again whenever the variable list changes.  If the receiver
+ * loses track of a schema, it should respond with 409 (Conflict); the schema
+ * will be sent again with the next message.
+ *
+ * If a LogBuffer is attached to the logger, every record not yet accepted is
+ * sent (up to #MS_CBOR_MAX_RECORDS per message).
+ *
+ * The message is POSTed with the content type `application/cbor`.  Any 2xx
+ * response is taken as success.
+ *
+ * @ingroup the_publishers
+ */
+class CBORPublisher : public dataPublisher {
+ public:
+    // Constructors
+    /**
+     * @brief Construct a new CBOR Publisher object with no members set.
+     */
+    CBORPublisher();
+    /**
+     * @brief Construct a new CBOR Publisher object
+     *
+     * @note If a client is never specified, the publisher will attempt to
+     * create and use a client on a LoggerModem instance tied to the attached
+     * logger.
+     *
+     * @param baseLogger The logger supplying the data to be published
+     * @param sendEveryX Currently unimplemented, intended for future use to
+     * enable caching and bulk publishing
+     * @param sendOffset Currently unimplemented, intended for future use to
+     * enable publishing data at a time slightly delayed from when it is
+     * collected
+     */
+    explicit CBORPublisher(Logger& baseLogger, uint8_t sendEveryX = 1,
+                           uint8_t sendOffset = 0);
+    /**
+     * @brief Construct a new CBOR Publisher object
+     *
+     * @param baseLogger The logger supplying the data to be published
+     * @param inClient An Arduino client instance to use to print data to.
+     * Allows the use of any type of client and multiple clients tied to a
+     * single TinyGSM modem instance
+     * @param sendEveryX Currently unimplemented, intended for future use to
+     * enable caching and bulk publishing
+     * @param sendOffset Currently unimplemented, intended for future use to
+     * enable publishing data at a time slightly delayed from when it is
+     * collected
+     */
+    CBORPublisher(Logger& baseLogger, Client* inClient, uint8_t sendEveryX = 1,
+                  uint8_t sendOffset = 0);
+    /**
+     * @brief Construct a new CBOR Publisher object
+     *
+     * @param baseLogger The logger supplying the data to be published
+     * @param host The host name of the receiver
+     * @param port The port of the receiver
+     * @param path The path on the receiver to POST to
+     * @param sendEveryX Currently unimplemented, intended for future use to
+     * enable caching and bulk publishing
+     * @param sendOffset Currently unimplemented, intended for future use to
+     * enable publishing data at a time slightly delayed from when it is
+     * collected
+     */
+    CBORPublisher(Logger& baseLogger, const char* host, uint16_t port,
+                  const char* path, uint8_t sendEveryX = 1,
+                  uint8_t sendOffset = 0);
+    /**
+     * @brief Construct a new CBOR Publisher object
+     *
+     * @param baseLogger The logger supplying the data to be published
+     * @param inClient An Arduino client instance to use to print data to.
+     * Allows the use of any type of client and multiple clients tied to a
+     * single TinyGSM modem instance
+     * @param host The host name of the receiver
+     * @param port The port of the receiver
+     * @param path The path on the receiver to POST to
+     * @param sendEveryX Currently unimplemented, intended for future use to
+     * enable caching and bulk publishing
+     * @param sendOffset Currently unimplemented, intended for future use to
+     * enable publishing data at a time slightly delayed from when it is
+     * collected
+     */
+    CBORPublisher(Logger& baseLogger, Client* inClient, const char* host,
+                  uint16_t port, const char* path, uint8_t sendEveryX = 1,
+                  uint8_t sendOffset = 0);
+    /**
+     * @brief Destroy the CBOR Publisher object
+     */
+    virtual ~CBORPublisher();
+
+    // Returns the data destination
+    String getEndpoint(void) override {
+        return String(_host);
+    }
+    // Sends the records in the logger's LogBuffer that it hasn't yet sent
+    bool usesLogBuffer(void) override {
+        return true;
+    }
+
+    /**
+     * @brief Set the receiver.
+     *
+     * @param host The host name of the receiver
+     * @param port The port of the receiver; optional with a default value of
+     * 80.
+     * @param path The path on the receiver to POST to; optional with a default
+     * value of "/".
+     */
+    void setEndpoint(const char* host, uint16_t port = 80,
+                     const char* path = "/");
+    /**
+     * @brief Set a token to send in a `TOKEN` header, if the receiver needs
+     * one.
+     *
+     * @param token The token; NULL to not send one.
+     */
+    void setToken(const char* token);
+    /**
+     * @brief Set the EEPROM address to save the accepted schema ID at,
+     * instead of #MS_CBOR_SCHEMA_EEPROM_ADDRESS.
+     *
+     * @param address The EEPROM address; negative to not save the schema ID.
+     */
+    void setSchemaAddress(int16_t address);
+
+    /**
+     * @brief Get the ID of the current schema - a CRC-16 of the sampling
+     * feature and variable UUIDs.
+     *
+     * @return **uint16_t** The schema ID; never 0.
+     */
+    uint16_t getSchemaID(void);
+    /**
+     * @brief Forget that the receiver has accepted the schema, so it is sent
+     * again with the next message.
+     */
+    void forgetSchema(void);
+
+    // A way to begin with everything already set
+    /**
+     * @copydoc dataPublisher::begin(Logger& baseLogger, Client* inClient)
+     * @param host The host name of the receiver
+     * @param port The port of the receiver
+     * @param path The path on the receiver to POST to
+     */
+    void begin(Logger& baseLogger, Client* inClient, const char* host,
+               uint16_t port, const char* path);
+    /**
+     * @copydoc dataPublisher::begin(Logger& baseLogger)
+     * @param host The host name of the receiver
+     * @param port The port of the receiver
+     * @param path The path on the receiver to POST to
+     */
+    void begin(Logger& baseLogger, const char* host, uint16_t port,
+               const char* path);
+
+    /**
+     * @brief Utilize an attached modem to open a TCP connection to the
+     * receiver and POST a CBOR message of all unsent records.
+     *
+     * This depends on an internet connection already having been made and a
+     * client being available.
+     *
+     * @param outClient An Arduino client instance to use to print data to.
+     * Allows the use of any type of client and multiple clients tied to a
+     * single TinyGSM modem instance
+     * @return **int16_t** The http status code of the response.
+     */
+    int16_t publishData(Client* outClient) override;
+    /**
+     * @brief Open a TCP connection and send out the request, without waiting
+     * for the response.
+     *
+     * @param outClient An Arduino client instance to use to print data to.
+     * Allows the use of any type of client and multiple clients tied to a
+     * single TinyGSM modem instance
+     * @return **bool** True if the request was started.
+     */
+    bool publishDataBegin(Client* outClient) override;
+    /**
+     * @brief Check for the response and, if it was accepted, mark the records
+     * as sent and the schema as known to the receiver.
+     *
+     * @return **bool** True once the publish is complete
+     */
+    bool publishDataPoll(void) override;
+
+ protected:
+    /**
+     * @anchor cbor_post_vars
+     * @name Portions of the POST request
+     *
+     * @{
+     */
+    static const char* tokenHeader;          ///< The token header text
+    static const char* contentLengthHeader;  ///< The content length header text
+    static const char* contentTypeHeader;    ///< The content type header text
+    /**@}*/
+
+    /**
+     * @brief Decide what goes in the next message - whether the schema is
+     * included and which records from the log buffer - and set the pending
+     * members to match.
+     *
+     * @param maxRecords The most records to include
+     */
+    void planMessage(uint32_t maxRecords);
+    /**
+     * @brief Write the CBOR message, or just count its bytes.
+     *
+     * @param stream The stream to write to; NULL to only count
+     * @param withSchema True to include the UUIDs
+     * @param firstRecord The first record to send from the log buffer
+     * @param endRecord One more than the last record to send; the same as
+     * firstRecord to send the current values instead of buffered records
+     * @return **uint32_t** The number of bytes in the message
+     */
+    uint32_t writeMessage(Stream* stream, bool withSchema,
+                          uint32_t firstRecord, uint32_t endRecord);
+    /**
+     * @brief Write one value - as null for -9999, as an integer if it has no
+     * decimal places, or as a 32-bit float.
+     *
+     * @param stream The stream to write to; NULL to only count
+     * @param value The value, already formatted to the variable's resolution
+     * @param byteCount The running count of bytes in the message
+     */
+    void writeValue(Stream* stream, const String& value, uint32_t& byteCount);
+    /**
+     * @brief Write a UUID as a 16 byte string, or as a text string if it
+     * isn't a UUID.
+     *
+     * @param stream The stream to write to; NULL to only count
+     * @param uuid The UUID
+     * @param byteCount The running count of bytes in the message
+     */
+    void writeUUID(Stream* stream, const char* uuid, uint32_t& byteCount);
+    /**
+     * @brief Write the initial byte (and argument) of a CBOR data item.
+     *
+     * @param stream The stream to write to; NULL to only count
+     * @param majorType The major type, already shifted into the top 3 bits
+     * @param argument The argument - the value, length, or number of items
+     * @param byteCount The running count of bytes in the message
+     */
+    void writeHead(Stream* stream, uint8_t majorType, uint32_t argument,
+                   uint32_t& byteCount);
+    /**
+     * @brief Add a byte to the send buffer, sending the buffer first if it's
+     * full.
+     *
+     * @param stream The stream to write to; NULL to only count
+     * @param b The byte
+     * @param byteCount The running count of bytes in the message
+     */
+    void writeByte(Stream* stream, uint8_t b, uint32_t& byteCount);
+    /**
+     * @brief Write out (or drop, when counting) the bytes in the send buffer.
+     *
+     * @param stream The stream to write to; NULL to only count
+     */
+    void flushBuffer(Stream* stream);
+
+    /**
+     * @brief Set the members shared by all of the constructors to their
+     * defaults.
+     */
+    void init(void);
+
+    const char* _host;
+    uint16_t    _port;
+    const char* _path;
+    const char* _token;
+
+    // The number of bytes of binary data in the send buffer
+    uint16_t _txLength;
+    // The schema the receiver last accepted; 0 if none
+    uint16_t _acceptedSchema;
+    int16_t  _schemaAddress;
+    bool     _schemaLoaded;
+    // The schema sent with the request in progress; 0 if it wasn't sent
+    uint16_t _pendingSchema;
+    // The records in the request in progress; the same number if none
+    uint32_t _pendingFirstRecord;
+    uint32_t _pendingEndRecord;
+};
+
+#endif  // SRC_PUBLISHERS_CBORPUBLISHER_H_
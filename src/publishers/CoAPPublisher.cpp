@@ -0,0 +1,297 @@
+/**
+ * @file CoAPPublisher.cpp
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Implements the CoAPPublisher class.
+ */
+
+#include "CoAPPublisher.h"
+
+// The message types, already shifted into place in the first header byte
+// along with the version (1)
+#define COAP_CONFIRMABLE 0x40
+#define COAP_NON_CONFIRMABLE 0x50
+#define COAP_ACKNOWLEDGEMENT 0x60
+#define COAP_RESET 0x70
+// The request and option codes used
+#define COAP_POST 0x02
+#define COAP_OPTION_URI_PATH 11
+#define COAP_OPTION_CONTENT_FORMAT 12
+#define COAP_FORMAT_CBOR 60
+#define COAP_PAYLOAD_MARKER 0xFF
+// The length of the token sent with each message
+#define COAP_TOKEN_LENGTH 2
+
+
+// ============================================================================
+//  Functions for a CoAP server.
+// ============================================================================
+
+// Constructors
+CoAPPublisher::CoAPPublisher() : CBORPublisher() {
+    setEndpoint(NULL, 5683, "/");
+    setUDP(NULL);
+}
+CoAPPublisher::CoAPPublisher(Logger& baseLogger, uint8_t sendEveryX,
+                             uint8_t sendOffset)
+    : CBORPublisher(baseLogger, sendEveryX, sendOffset) {
+    setEndpoint(NULL, 5683, "/");
+    setUDP(NULL);
+}
+CoAPPublisher::CoAPPublisher(Logger& baseLogger, UDP* udp, const char* host,
+                             uint16_t port, const char* path,
+                             uint8_t sendEveryX, uint8_t sendOffset)
+    : CBORPublisher(baseLogger, host, port, path, sendEveryX, sendOffset) {
+    setUDP(udp);
+}
+// Destructor
+CoAPPublisher::~CoAPPublisher() {}
+
+
+void CoAPPublisher::setUDP(UDP* udp) {
+    _udp            = udp;
+    _messageID      = random(0x10000);
+    _messageToken   = 0;
+    _transmissions  = 0;
+    _ackTimeout_ms  = MS_COAP_ACK_TIMEOUT_MS;
+    _lastSent       = 0;
+    _acknowledged   = false;
+    _acknowledgedAt = 0;
+}
+
+
+// A way to begin with everything already set
+void CoAPPublisher::begin(Logger& baseLogger, UDP* udp, const char* host,
+                          uint16_t port, const char* path) {
+    setUDP(udp);
+    setEndpoint(host, port, path);
+    dataPublisher::begin(baseLogger);
+}
+
+
+// CoAP goes out on the UDP instance, never on a client
+int16_t CoAPPublisher::publishData() {
+    if (!publishDataBegin()) return 0;
+    return publishDataFinish();
+}
+// CoAP goes out on the UDP instance, never a client
+int16_t CoAPPublisher::publishData(Client* outClient) {
+    if (outClient != NULL) {
+        MS_DBG(F("Ignoring the client given; CoAP is sent over UDP"));
+    }
+    return publishData();
+}
+bool CoAPPublisher::publishDataBegin(Client* outClient) {
+    if (outClient != NULL) {
+        MS_DBG(F("Ignoring the client given; CoAP is sent over UDP"));
+    }
+    return publishDataBegin();
+}
+
+
+// This sends out the message but doesn't wait for the response
+bool CoAPPublisher::publishDataBegin(void) {
+    if (_publishState != PUBLISHER_IDLE) {
+        MS_DBG(F("Publisher is already busy!"));
+        return false;
+    }
+    if (_udp == NULL || _host == NULL) {
+        PRINTOUT(F("The UDP instance and CoAP server must both be set!"));
+        completePublish(0);
+        return true;
+    }
+
+    // Leave records for the next message until the rest fit in one datagram
+    planMessage(MS_CBOR_MAX_RECORDS);
+    uint32_t payloadLength = writeMessage(NULL, _pendingSchema != 0,
+                                          _pendingFirstRecord,
+                                          _pendingEndRecord);
+    while (payloadLength > MS_COAP_MAX_PAYLOAD &&
+           _pendingEndRecord - _pendingFirstRecord > 1) {
+        _pendingEndRecord = _pendingFirstRecord +
+            (_pendingEndRecord - _pendingFirstRecord) / 2;
+        payloadLength = writeMessage(NULL, _pendingSchema != 0,
+                                     _pendingFirstRecord, _pendingEndRecord);
+    }
+    MS_DBG(F("Outgoing CBOR size:"), payloadLength);
+    if (payloadLength > MS_COAP_MAX_PAYLOAD) {
+        PRINTOUT(F("The CoAP payload is larger than"), MS_COAP_MAX_PAYLOAD,
+                 F("bytes and may be fragmented or lost!"));
+    }
+
+    // A new message ID and token for every new message; the same ones for
+    // every retransmission of it
+    _messageID++;
+    _messageToken  = random(0x10000);
+    _transmissions = 0;
+    _acknowledged  = false;
+    _ackTimeout_ms = MS_COAP_ACK_TIMEOUT_MS +
+        random(MS_COAP_ACK_TIMEOUT_MS / 2);
+
+    // There's no client to count on, so the datagrams are counted as they go
+    startMetering(NULL);
+    _udp->begin(MS_COAP_LOCAL_PORT);
+    sendMessage();
+
+    // Don't wait for the response here, publishDataPoll() will pick it up
+    _publishClient = NULL;
+    _publishStart  = millis();
+    _publishState  = PUBLISHER_AWAITING_RESPONSE;
+    return true;
+}
+
+
+// Checks for the response, retransmitting as needed
+bool CoAPPublisher::publishDataPoll(void) {
+    if (_publishState != PUBLISHER_AWAITING_RESPONSE) {
+        return CBORPublisher::publishDataPoll();
+    }
+
+    int16_t result = readResponse();
+    if (result < 0) {
+        if (_acknowledged) {
+            // The server has the message; just wait for its separate
+            // response, for the full timeout from the acknowledgement
+            if (millis() - _acknowledgedAt <
+                MS_PUBLISHER_RESPONSE_TIMEOUT_MS) {
+                return false;
+            }
+            result = 504;
+        } else if (millis() - _lastSent < _ackTimeout_ms) {
+            return false;
+        } else if (_transmissions <= MS_COAP_MAX_RETRANSMIT) {
+            MS_DBG(F("No acknowledgement after"), _ackTimeout_ms,
+                   F("ms; retransmitting"));
+            _ackTimeout_ms *= 2;
+            sendMessage();
+            return false;
+        } else {
+            result = 504;
+        }
+    }
+
+    MS_DBG(F("CoAP exchange done after"), millis() - _publishStart, F("ms and"),
+           _transmissions, F("transmissions"));
+    _udp->stop();
+    completePublish(result);
+    // Let the CBOR publisher mark the records and schema as accepted
+    return CBORPublisher::publishDataPoll();
+}
+
+
+// There's no client to close, but stop listening for the response
+void CoAPPublisher::publishDataAbort(void) {
+    if (_publishState == PUBLISHER_AWAITING_RESPONSE) _udp->stop();
+    CBORPublisher::publishDataAbort();
+}
+
+
+void CoAPPublisher::sendMessage(void) {
+    _udp->beginPacket(_host, _port);
+
+    // The fixed header and the token
+    size_t sent = _udp->write(COAP_CONFIRMABLE | COAP_TOKEN_LENGTH);
+    sent += _udp->write(COAP_POST);
+    sent += _udp->write(static_cast<uint8_t>(_messageID >> 8));
+    sent += _udp->write(static_cast<uint8_t>(_messageID & 0xFF));
+    sent += _udp->write(static_cast<uint8_t>(_messageToken >> 8));
+    sent += _udp->write(static_cast<uint8_t>(_messageToken & 0xFF));
+
+    // Each segment of the path is a separate Uri-Path option
+    uint8_t     lastOption = 0;
+    const char* segment    = _path;
+    while (*segment != '\0') {
+        const char* segmentEnd = strchr(segment, '/');
+        if (segmentEnd == NULL) segmentEnd = segment + strlen(segment);
+        if (segmentEnd > segment) {
+            sent += writeOption(COAP_OPTION_URI_PATH - lastOption,
+                                reinterpret_cast<const uint8_t*>(segment),
+                                segmentEnd - segment);
+            lastOption = COAP_OPTION_URI_PATH;
+        }
+        segment = (*segmentEnd == '/') ? segmentEnd + 1 : segmentEnd;
+    }
+    const uint8_t format = COAP_FORMAT_CBOR;
+    sent += writeOption(COAP_OPTION_CONTENT_FORMAT - lastOption, &format, 1);
+
+    sent += _udp->write(COAP_PAYLOAD_MARKER);
+    sent += writeMessage(_udp, _pendingSchema != 0, _pendingFirstRecord,
+                         _pendingEndRecord);
+    _udp->endPacket();
+    _meter.countWrite(sent);
+
+    _transmissions++;
+    _lastSent = millis();
+    MS_DBG(F("Sent CoAP message"), _messageID, F("to"), _host, ':', _port);
+}
+
+
+size_t CoAPPublisher::writeOption(uint8_t delta, const uint8_t* value,
+                                  uint8_t length) {
+    // Lengths of 13 or more go in an extra byte after the option header
+    size_t written;
+    if (length < 13) {
+        written = _udp->write(static_cast<uint8_t>(delta << 4 | length));
+    } else {
+        written = _udp->write(static_cast<uint8_t>(delta << 4 | 13));
+        written += _udp->write(static_cast<uint8_t>(length - 13));
+    }
+    return written + _udp->write(value, length);
+}
+
+
+int16_t CoAPPublisher::readResponse(void) {
+    int size = _udp->parsePacket();
+    if (size > 0) _meter.countRead(size);
+    if (size < 4) return -1;
+
+    uint8_t header[4];
+    _udp->read(header, 4);
+    uint8_t  type        = header[0] & 0xF0;
+    uint8_t  tokenLength = header[0] & 0x0F;
+    uint8_t  code        = header[1];
+    uint16_t messageID   = static_cast<uint16_t>(header[2]) << 8 | header[3];
+    uint16_t token       = 0;
+    for (uint8_t i = 0; i < tokenLength; i++) {
+        token = token << 8 | _udp->read();
+    }
+    // Options and payload of the response aren't needed
+    while (_udp->available() > 0) { _udp->read(); }
+    MS_DBG(F("Received CoAP type"), (type >> 4) & 0x03, F("code"), code >> 5,
+           '.', code & 0x1F, F("for message"), messageID);
+
+    bool isOurs = tokenLength == COAP_TOKEN_LENGTH && token == _messageToken;
+    if (messageID == _messageID &&
+        (type == COAP_ACKNOWLEDGEMENT || type == COAP_RESET)) {
+        if (type == COAP_RESET) {
+            PRINTOUT(F("The CoAP server reset the message"));
+            return 0;
+        }
+        // An empty acknowledgement means a separate response will follow
+        if (code == 0) {
+            if (!_acknowledged) _acknowledgedAt = millis();
+            _acknowledged = true;
+            return -1;
+        }
+        if (isOurs) return (code >> 5) * 100 + (code & 0x1F);
+    } else if (isOurs && code != 0 &&
+               (type == COAP_CONFIRMABLE || type == COAP_NON_CONFIRMABLE)) {
+        // A separate response; a confirmable one must be acknowledged
+        if (type == COAP_CONFIRMABLE) sendEmptyAck(messageID);
+        return (code >> 5) * 100 + (code & 0x1F);
+    }
+    return -1;
+}
+
+
+void CoAPPublisher::sendEmptyAck(uint16_t messageID) {
+    _udp->beginPacket(_host, _port);
+    _udp->write(COAP_ACKNOWLEDGEMENT);
+    _udp->write(static_cast<uint8_t>(0));
+    _udp->write(static_cast<uint8_t>(messageID >> 8));
+    _udp->write(static_cast<uint8_t>(messageID & 0xFF));
+    _udp->endPacket();
+    _meter.countWrite(4);
+}
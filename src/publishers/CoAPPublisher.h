@@ -0,0 +1,269 @@
+/**
+ * @file CoAPPublisher.h
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the CoAPPublisher subclass of CBORPublisher for publishing
+ * data in single CoAP datagrams over UDP.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_COAPPUBLISHER_H_
+#define SRC_PUBLISHERS_COAPPUBLISHER_H_
+
+// Debugging Statement
+// #define MS_COAPPUBLISHER_DEBUG
+
+#ifdef MS_COAPPUBLISHER_DEBUG
+#define MS_DEBUGGING_STD "CoAPPublisher"
+#endif
+
+/**
+ * @def MS_COAP_MAX_PAYLOAD
+ * @brief The largest CBOR payload to put in one datagram.
+ *
+ * Records are left for the next message until the payload fits.  The default
+ * keeps the whole datagram within the 576 bytes every IPv4 host must accept.
+ * This can be changed by setting the build flag MS_COAP_MAX_PAYLOAD when
+ * compiling.
+ *
+ * @ingroup the_publishers
+ */
+#ifndef MS_COAP_MAX_PAYLOAD
+#define MS_COAP_MAX_PAYLOAD 448
+#endif
+
+/**
+ * @def MS_COAP_ACK_TIMEOUT_MS
+ * @brief The time to wait for the first acknowledgement before
+ * retransmitting (CoAP's ACK_TIMEOUT).
+ *
+ * The actual first wait is a random time between this and 1.5 times this;
+ * every retransmission doubles it.  This can be changed by setting the build
+ * flag MS_COAP_ACK_TIMEOUT_MS when compiling.
+ *
+ * @ingroup the_publishers
+ */
+#ifndef MS_COAP_ACK_TIMEOUT_MS
+#define MS_COAP_ACK_TIMEOUT_MS 2000
+#endif
+
+/**
+ * @def MS_COAP_MAX_RETRANSMIT
+ * @brief The number of times a message is retransmitted before giving up
+ * (CoAP's MAX_RETRANSMIT).
+ *
+ * This can be changed by setting the build flag MS_COAP_MAX_RETRANSMIT when
+ * compiling.
+ *
+ * @ingroup the_publishers
+ */
+#ifndef MS_COAP_MAX_RETRANSMIT
+#define MS_COAP_MAX_RETRANSMIT 4
+#endif
+
+/**
+ * @def MS_COAP_LOCAL_PORT
+ * @brief The local UDP port to listen for responses on.
+ *
+ * This can be changed by setting the build flag MS_COAP_LOCAL_PORT when
+ * compiling.
+ *
+ * @ingroup the_publishers
+ */
+#ifndef MS_COAP_LOCAL_PORT
+#define MS_COAP_LOCAL_PORT 5683
+#endif
+
+// Included Dependencies
+#include "ModSensorDebugger.h"
+#undef MS_DEBUGGING_STD
+#include "CBORPublisher.h"
+#include <Udp.h>
+
+
+// ============================================================================
+//  Functions for a CoAP server.
+// ============================================================================
+/**
+ * @brief The CoAPPublisher subclass of CBORPublisher for publishing data to a
+ * [CoAP](https://tools.ietf.org/html/rfc7252) server over UDP.
+ *
+ * There is no connection to open or close and no text headers, so a publish
+ * is usually a single datagram out and a single datagram back.  That keeps
+ * the radio on for much less time than an HTTP request.
+ *
+ * Each message is a confirmable POST to the path given, with the content
+ * format `application/cbor` (60).  The payload is exactly the same CBOR
+ * message the CBORPublisher sends, including the schema handling.  If a
+ * LogBuffer is attached to the logger, as many unsent records as fit in
+ * #MS_COAP_MAX_PAYLOAD bytes are sent in the one datagram.
+ *
+ * Unacknowledged messages are retransmitted with exponential backoff, as
+ * described in the CoAP specification:  the first wait is between
+ * #MS_COAP_ACK_TIMEOUT_MS and 1.5 times that, and the wait doubles with each
+ * of up to #MS_COAP_MAX_RETRANSMIT retransmissions.  Both piggy-backed and
+ * separate responses are accepted.
+ *
+ * The CoAP response code is returned like an HTTP status code, with the class
+ * as the hundreds - ie, 2.04 (Changed) is returned as 204 and 4.09 (Conflict)
+ * as 409.  504 is returned if nothing was heard back.
+ *
+ * This publisher needs an Arduino UDP instance, like a WiFiUDP or EthernetUDP.
+ * It does not use a Client and is not counted in the daily publisher totals.
+ *
+ * @note The version of TinyGSM used by this library does not have UDP
+ * sockets, so none of the cellular modems (SIMCom, Quectel, u-blox, Sequans,
+ * or the XBees in bypass mode) can give this publisher a UDP instance.  It can
+ * only be used with a board or module that has its own Arduino UDP class, like
+ * WiFiUDP for the WiFi101 and WiFiNINA libraries or EthernetUDP.  A publisher
+ * given a Client instead ignores it.
+ *
+ * @ingroup the_publishers
+ */
+class CoAPPublisher : public CBORPublisher {
+ public:
+    // Constructors
+    /**
+     * @brief Construct a new CoAP Publisher object with no members set.
+     */
+    CoAPPublisher();
+    /**
+     * @brief Construct a new CoAP Publisher object
+     *
+     * @param baseLogger The logger supplying the data to be published
+     * @param sendEveryX Currently unimplemented, intended for future use to
+     * enable caching and bulk publishing
+     * @param sendOffset Currently unimplemented, intended for future use to
+     * enable publishing data at a time slightly delayed from when it is
+     * collected
+     */
+    explicit CoAPPublisher(Logger& baseLogger, uint8_t sendEveryX = 1,
+                           uint8_t sendOffset = 0);
+    /**
+     * @brief Construct a new CoAP Publisher object
+     *
+     * @param baseLogger The logger supplying the data to be published
+     * @param udp An Arduino UDP instance to send the datagrams with
+     * @param host The host name of the CoAP server
+     * @param port The port of the CoAP server
+     * @param path The path on the server to POST to
+     * @param sendEveryX Currently unimplemented, intended for future use to
+     * enable caching and bulk publishing
+     * @param sendOffset Currently unimplemented, intended for future use to
+     * enable publishing data at a time slightly delayed from when it is
+     * collected
+     */
+    CoAPPublisher(Logger& baseLogger, UDP* udp, const char* host,
+                  uint16_t port, const char* path, uint8_t sendEveryX = 1,
+                  uint8_t sendOffset = 0);
+    /**
+     * @brief Destroy the CoAP Publisher object
+     */
+    virtual ~CoAPPublisher();
+
+    /**
+     * @brief Set the UDP instance to send the datagrams with.
+     *
+     * @param udp An Arduino UDP instance
+     */
+    void setUDP(UDP* udp);
+
+    // A way to begin with everything already set
+    /**
+     * @copydoc dataPublisher::begin(Logger& baseLogger)
+     * @param udp An Arduino UDP instance to send the datagrams with
+     * @param host The host name of the CoAP server
+     * @param port The port of the CoAP server
+     * @param path The path on the server to POST to
+     */
+    void begin(Logger& baseLogger, UDP* udp, const char* host,
+               uint16_t port = 5683, const char* path = "/");
+
+    /**
+     * @brief Send a CoAP message of all unsent records (that fit) and wait for
+     * the response.
+     *
+     * @return **int16_t** The CoAP response code, as an http status code.
+     */
+    int16_t publishData() override;
+    /**
+     * @brief Send a CoAP message of all unsent records (that fit) and wait for
+     * the response.
+     *
+     * @param outClient Ignored, with a debugging message; CoAP is always sent
+     * with the UDP instance given in the constructor or begin().
+     * @return **int16_t** The CoAP response code, as an http status code.
+     */
+    int16_t publishData(Client* outClient) override;
+    /**
+     * @brief Send out the CoAP message, without waiting for the response.
+     *
+     * @return **bool** True if the message was started.
+     */
+    bool publishDataBegin(void) override;
+    /**
+     * @brief Send out the CoAP message, without waiting for the response.
+     *
+     * @param outClient Ignored; CoAP is sent with the UDP instance.
+     * @return **bool** True if the message was started.
+     */
+    bool publishDataBegin(Client* outClient) override;
+    /**
+     * @brief Check for the response, retransmitting the message if it's
+     * overdue.
+     *
+     * @return **bool** True once the publish is complete
+     */
+    bool publishDataPoll(void) override;
+    /**
+     * @brief Give up on the message in progress, if there is one, and stop
+     * listening for the response.
+     */
+    void publishDataAbort(void) override;
+
+ protected:
+    /**
+     * @brief Send the pending message in a datagram (again).
+     */
+    void sendMessage(void);
+    /**
+     * @brief Write one CoAP option.
+     *
+     * @param delta The option number minus the number of the option before
+     * @param value The option value
+     * @param length The length of the option value
+     * @return **size_t** The number of bytes written
+     */
+    size_t writeOption(uint8_t delta, const uint8_t* value, uint8_t length);
+    /**
+     * @brief Read a datagram, if there is one, and check if it's the
+     * response to the pending message.
+     *
+     * @return **int16_t** The response code as an http status code, or -1 if
+     * there's no response yet.
+     */
+    int16_t readResponse(void);
+    /**
+     * @brief Send an empty acknowledgement, for a separate response sent as
+     * a confirmable message.
+     *
+     * @param messageID The message ID of the response
+     */
+    void sendEmptyAck(uint16_t messageID);
+
+ private:
+    UDP*     _udp;
+    uint16_t _messageID;
+    uint16_t _messageToken;
+    uint8_t  _transmissions;
+    uint32_t _ackTimeout_ms;
+    uint32_t _lastSent;
+    // True once an empty acknowledgement says a separate response will follow
+    bool _acknowledged;
+    // When that acknowledgement came
+    uint32_t _acknowledgedAt;
+};
+
+#endif  // SRC_PUBLISHERS_COAPPUBLISHER_H_
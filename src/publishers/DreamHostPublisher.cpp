@@ -70,6 +70,7 @@ void DreamHostPublisher::printSensorDataDreamHost(Stream* stream) {
                          946684800));  // Correct time from epoch to y2k
 
     for (uint8_t i = 0; i < _baseLogger->getArrayVarCount(); i++) {
+        if (!_baseLogger->isValueReportedAtI(i)) continue;
         stream->print('&');
         stream->print(_baseLogger->getVarCodeAtI(i));
         stream->print('=');
@@ -110,9 +111,18 @@ void DreamHostPublisher::begin(Logger& baseLogger, const char* dhUrl) {
 // Post the data to dream host.
 // int16_t DreamHostPublisher::postDataDreamHost(void)
 int16_t DreamHostPublisher::publishData(Client* outClient) {
-    // Create a buffer for the portions of the request and response
-    char     tempBuffer[37] = "";
-    uint16_t did_respond    = 0;
+    if (!publishDataBegin(outClient)) return 0;
+    return publishDataFinish();
+}
+// This sends out the request but doesn't wait for the response
+bool DreamHostPublisher::publishDataBegin(Client* outClient) {
+    if (_publishState != PUBLISHER_IDLE) {
+        MS_DBG(F("Publisher is already busy!"));
+        return false;
+    }
+
+    // Create a buffer for the portions of the request
+    char tempBuffer[37] = "";
 
     // Open a TCP/IP connection to DreamHost
     MS_DBG(F("Connecting client"));
@@ -137,6 +147,9 @@ int16_t DreamHostPublisher::publishData(Client* outClient) {
         strcat(txBuffer, tempBuffer);
 
         for (uint8_t i = 0; i < _baseLogger->getArrayVarCount(); i++) {
+            // Values which haven't changed enough are left out
+            if (!_baseLogger->isValueReportedAtI(i)) continue;
+
             // Once the buffer fills, send it out
             if (bufferFree() < 47) printTxBuffer(outClient);
 
@@ -161,40 +174,12 @@ int16_t DreamHostPublisher::publishData(Client* outClient) {
         // Send out the finished request (or the last unsent section of it)
         printTxBuffer(outClient);
 
-        // Wait 10 seconds for a response from the server
-        uint32_t start = millis();
-        while ((millis() - start) < 10000L && outClient->available() < 12) {
-            delay(10);
-        }
-
-        // Read only the first 12 characters of the response
-        // We're only reading as far as the http code, anything beyond that
-        // we don't care about.
-        did_respond = outClient->readBytes(tempBuffer, 12);
-
-        // Close the TCP/IP connection
-        MS_DBG(F("Stopping client"));
-        MS_RESET_DEBUG_TIMER;
-        outClient->stop();
-        MS_DBG(F("Client stopped after"), MS_PRINT_DEBUG_TIMER, F("ms"));
+        // Don't wait for the response here, publishDataPoll() will pick it up
+        awaitHTTPResponse(outClient);
     } else {
         PRINTOUT(F("\n -- Unable to Establish Connection to DreamHost --"));
+        completePublish(504);
     }
 
-    // Process the HTTP response
-    int16_t responseCode = 0;
-    if (did_respond > 0) {
-        char responseCode_char[4];
-        for (uint8_t i = 0; i < 3; i++) {
-            responseCode_char[i] = tempBuffer[i + 9];
-        }
-        responseCode = atoi(responseCode_char);
-    } else {
-        responseCode = 504;
-    }
-
-    PRINTOUT(F("-- Response Code --"));
-    PRINTOUT(responseCode);
-
-    return responseCode;
+    return true;
 }
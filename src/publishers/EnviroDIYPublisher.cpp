@@ -82,15 +82,14 @@ uint16_t EnviroDIYPublisher::calculateJsonSize() {
     jsonLength += 36;          // sampling feature UUID
     jsonLength += 15;          // ","timestamp":"
     jsonLength += 25;          // markedISO8601Time
-    jsonLength += 2;           //  ",
+    jsonLength += 1;           //  "
     for (uint8_t i = 0; i < _baseLogger->getArrayVarCount(); i++) {
-        jsonLength += 1;   //  "
+        // Values which haven't changed enough are left out
+        if (!_baseLogger->isValueReportedAtI(i)) continue;
+        jsonLength += 2;   //  ,"
         jsonLength += 36;  // variable UUID
         jsonLength += 2;   //  ":
         jsonLength += _baseLogger->getValueStringAtI(i).length();
-        if (i + 1 != _baseLogger->getArrayVarCount()) {
-            jsonLength += 1;  // ,
-        }
     }
     jsonLength += 1;  // }
 
@@ -123,14 +122,14 @@ void EnviroDIYPublisher::printSensorDataJSON(Stream* stream) {
     stream->print(_baseLogger->getSamplingFeatureUUID());
     stream->print(timestampTag);
     stream->print(_baseLogger->formatDateTime_ISO8601(Logger::markedEpochTime));
-    stream->print(F("\","));
+    stream->print('"');
 
     for (uint8_t i = 0; i < _baseLogger->getArrayVarCount(); i++) {
-        stream->print('"');
+        if (!_baseLogger->isValueReportedAtI(i)) continue;
+        stream->print(F(",\""));
         stream->print(_baseLogger->getVarUUIDAtI(i));
         stream->print(F("\":"));
         stream->print(_baseLogger->getValueStringAtI(i));
-        if (i + 1 != _baseLogger->getArrayVarCount()) { stream->print(','); }
     }
 
     stream->print('}');
@@ -182,9 +181,18 @@ void EnviroDIYPublisher::begin(Logger&     baseLogger,
 // The return is the http status code of the response.
 // int16_t EnviroDIYPublisher::postDataEnviroDIY(void)
 int16_t EnviroDIYPublisher::publishData(Client* outClient) {
-    // Create a buffer for the portions of the request and response
-    char     tempBuffer[37] = "";
-    uint16_t did_respond    = 0;
+    if (!publishDataBegin(outClient)) return 0;
+    return publishDataFinish();
+}
+// This sends out the request but doesn't wait for the response
+bool EnviroDIYPublisher::publishDataBegin(Client* outClient) {
+    if (_publishState != PUBLISHER_IDLE) {
+        MS_DBG(F("Publisher is already busy!"));
+        return false;
+    }
+
+    // Create a buffer for the portions of the request
+    char tempBuffer[37] = "";
 
     MS_DBG(F("Outgoing JSON size:"), calculateJsonSize());
 
@@ -237,12 +245,15 @@ int16_t EnviroDIYPublisher::publishData(Client* outClient) {
             .toCharArray(tempBuffer, 37);
         strcat(txBuffer, tempBuffer);
         txBuffer[strlen(txBuffer)] = '"';
-        txBuffer[strlen(txBuffer)] = ',';
 
         for (uint8_t i = 0; i < _baseLogger->getArrayVarCount(); i++) {
+            // Values which haven't changed enough are left out
+            if (!_baseLogger->isValueReportedAtI(i)) continue;
+
             // Once the buffer fills, send it out
             if (bufferFree() < 47) printTxBuffer(outClient);
 
+            txBuffer[strlen(txBuffer)] = ',';
             txBuffer[strlen(txBuffer)] = '"';
             _baseLogger->getVarUUIDAtI(i).toCharArray(tempBuffer, 37);
             strcat(txBuffer, tempBuffer);
@@ -250,51 +261,20 @@ int16_t EnviroDIYPublisher::publishData(Client* outClient) {
             txBuffer[strlen(txBuffer)] = ':';
             _baseLogger->getValueStringAtI(i).toCharArray(tempBuffer, 37);
             strcat(txBuffer, tempBuffer);
-            if (i + 1 != _baseLogger->getArrayVarCount()) {
-                txBuffer[strlen(txBuffer)] = ',';
-            } else {
-                txBuffer[strlen(txBuffer)] = '}';
-            }
         }
+        if (bufferFree() < 2) printTxBuffer(outClient);
+        txBuffer[strlen(txBuffer)] = '}';
 
         // Send out the finished request (or the last unsent section of it)
         printTxBuffer(outClient, true);
 
-        // Wait 10 seconds for a response from the server
-        uint32_t start = millis();
-        while ((millis() - start) < 10000L && outClient->available() < 12) {
-            delay(10);
-        }
-
-        // Read only the first 12 characters of the response
-        // We're only reading as far as the http code, anything beyond that
-        // we don't care about.
-        did_respond = outClient->readBytes(tempBuffer, 12);
-
-        // Close the TCP/IP connection
-        MS_DBG(F("Stopping client"));
-        MS_RESET_DEBUG_TIMER;
-        outClient->stop();
-        MS_DBG(F("Client stopped after"), MS_PRINT_DEBUG_TIMER, F("ms"));
+        // Don't wait for the response here, publishDataPoll() will pick it up
+        awaitHTTPResponse(outClient);
     } else {
         PRINTOUT(F("\n -- Unable to Establish Connection to EnviroDIY Data "
                    "Portal --"));
+        completePublish(504);
     }
 
-    // Process the HTTP response
-    int16_t responseCode = 0;
-    if (did_respond > 0) {
-        char responseCode_char[4];
-        for (uint8_t i = 0; i < 3; i++) {
-            responseCode_char[i] = tempBuffer[i + 9];
-        }
-        responseCode = atoi(responseCode_char);
-    } else {
-        responseCode = 504;
-    }
-
-    PRINTOUT(F("-- Response Code --"));
-    PRINTOUT(responseCode);
-
-    return responseCode;
+    return true;
 }
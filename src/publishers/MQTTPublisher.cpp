@@ -0,0 +1,533 @@
+/**
+ * @file MQTTPublisher.cpp
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Implements the MQTTPublisher class.
+ */
+
+#include "MQTTPublisher.h"
+
+
+// ============================================================================
+//  Functions for a generic MQTT broker.
+// ============================================================================
+
+// Constant values for the MQTT control packets
+// I want to refer to these more than once while ensuring there is only one copy
+// in memory
+const uint8_t MQTTPublisher::mqttConnect    = 0x10;
+const uint8_t MQTTPublisher::mqttConnAck    = 0x20;
+const uint8_t MQTTPublisher::mqttPublish    = 0x30;
+const uint8_t MQTTPublisher::mqttPubAck     = 0x40;
+const uint8_t MQTTPublisher::mqttDisconnect = 0xE0;
+
+// The flags in the fixed header of a PUBLISH packet
+#define MQTT_PUBLISH_QOS1 0x02
+#define MQTT_PUBLISH_DUP 0x08
+
+// The largest fixed header: 1 byte of type and up to 4 bytes of length
+#define MQTT_MAX_HEADER_SIZE 5
+
+// The MQTT packet ID for a record in the log buffer
+// Packet ID's must not be 0, and the same record must always get the same ID
+// so the broker can recognize a duplicate.
+#define MQTT_RECORD_PACKET_ID(recordNum) \
+    static_cast<uint16_t>(((recordNum) % 0xFFFF) + 1)
+
+
+// Constructors
+MQTTPublisher::MQTTPublisher() : dataPublisher() {
+    setBroker(NULL);
+    setClientID(NULL);
+    setCredentials(NULL, NULL);
+    setTopicTemplate(NULL);
+    _cleanSession         = false;
+    _keepAlive_s          = 60;
+    _packetId             = 0;
+    _firstNeverSentRecord = 0;
+    _txLength             = 0;
+    _txOverflow           = false;
+    // MS_DBG(F("MQTTPublisher object created"));
+}
+MQTTPublisher::MQTTPublisher(Logger& baseLogger, uint8_t sendEveryX,
+                             uint8_t sendOffset)
+    : dataPublisher(baseLogger, sendEveryX, sendOffset) {
+    setBroker(NULL);
+    setClientID(NULL);
+    setCredentials(NULL, NULL);
+    setTopicTemplate(NULL);
+    _cleanSession         = false;
+    _keepAlive_s          = 60;
+    _packetId             = 0;
+    _firstNeverSentRecord = 0;
+    _txLength             = 0;
+    _txOverflow           = false;
+    // MS_DBG(F("MQTTPublisher object created"));
+}
+MQTTPublisher::MQTTPublisher(Logger& baseLogger, Client* inClient,
+                             uint8_t sendEveryX, uint8_t sendOffset)
+    : dataPublisher(baseLogger, inClient, sendEveryX, sendOffset) {
+    setBroker(NULL);
+    setClientID(NULL);
+    setCredentials(NULL, NULL);
+    setTopicTemplate(NULL);
+    _cleanSession         = false;
+    _keepAlive_s          = 60;
+    _packetId             = 0;
+    _firstNeverSentRecord = 0;
+    _txLength             = 0;
+    _txOverflow           = false;
+    // MS_DBG(F("MQTTPublisher object created"));
+}
+MQTTPublisher::MQTTPublisher(Logger& baseLogger, const char* brokerHost,
+                             uint16_t brokerPort, const char* clientID,
+                             const char* topicTemplate, uint8_t sendEveryX,
+                             uint8_t sendOffset)
+    : dataPublisher(baseLogger, sendEveryX, sendOffset) {
+    setBroker(brokerHost, brokerPort);
+    setClientID(clientID);
+    setCredentials(NULL, NULL);
+    setTopicTemplate(topicTemplate);
+    _cleanSession         = false;
+    _keepAlive_s          = 60;
+    _packetId             = 0;
+    _firstNeverSentRecord = 0;
+    _txLength             = 0;
+    _txOverflow           = false;
+    // MS_DBG(F("MQTTPublisher object created"));
+}
+MQTTPublisher::MQTTPublisher(Logger& baseLogger, Client* inClient,
+                             const char* brokerHost, uint16_t brokerPort,
+                             const char* clientID, const char* topicTemplate,
+                             uint8_t sendEveryX, uint8_t sendOffset)
+    : dataPublisher(baseLogger, inClient, sendEveryX, sendOffset) {
+    setBroker(brokerHost, brokerPort);
+    setClientID(clientID);
+    setCredentials(NULL, NULL);
+    setTopicTemplate(topicTemplate);
+    _cleanSession         = false;
+    _keepAlive_s          = 60;
+    _packetId             = 0;
+    _firstNeverSentRecord = 0;
+    _txLength             = 0;
+    _txOverflow           = false;
+    // MS_DBG(F("MQTTPublisher object created"));
+}
+// Destructor
+MQTTPublisher::~MQTTPublisher() {}
+
+
+void MQTTPublisher::setBroker(const char* brokerHost, uint16_t brokerPort) {
+    _brokerHost = brokerHost;
+    _brokerPort = brokerPort;
+    // MS_DBG(F("Broker set!"));
+}
+
+
+void MQTTPublisher::setClientID(const char* clientID) {
+    _clientID = clientID;
+    // MS_DBG(F("Client ID set!"));
+}
+
+
+void MQTTPublisher::setCredentials(const char* userName,
+                                   const char* password) {
+    _userName = userName;
+    _password = password;
+    // MS_DBG(F("Credentials set!"));
+}
+
+
+void MQTTPublisher::setTopicTemplate(const char* topicTemplate) {
+    _topicTemplate = topicTemplate;
+    // MS_DBG(F("Topic template set!"));
+}
+
+
+void MQTTPublisher::setCleanSession(bool cleanSession) {
+    _cleanSession = cleanSession;
+}
+
+
+void MQTTPublisher::setKeepAlive(uint16_t keepAlive_s) {
+    _keepAlive_s = keepAlive_s;
+}
+
+
+// A way to begin with everything already set
+void MQTTPublisher::begin(Logger& baseLogger, Client* inClient,
+                          const char* brokerHost, uint16_t brokerPort,
+                          const char* clientID, const char* topicTemplate) {
+    setBroker(brokerHost, brokerPort);
+    setClientID(clientID);
+    setTopicTemplate(topicTemplate);
+    dataPublisher::begin(baseLogger, inClient);
+}
+void MQTTPublisher::begin(Logger& baseLogger, const char* brokerHost,
+                          uint16_t brokerPort, const char* clientID,
+                          const char* topicTemplate) {
+    setBroker(brokerHost, brokerPort);
+    setClientID(clientID);
+    setTopicTemplate(topicTemplate);
+    dataPublisher::begin(baseLogger);
+}
+
+
+// This connects to the broker, publishes everything unsent, and disconnects
+int16_t MQTTPublisher::publishData(Client* outClient) {
+    if (_brokerHost == NULL || _clientID == NULL || _topicTemplate == NULL) {
+        PRINTOUT(F("The MQTT broker, client ID, and topic must all be set!"));
+        return -2;
+    }
+
+    char topic[MS_MQTT_MAX_TOPIC_LENGTH];
+    expandTopic(topic, MS_MQTT_MAX_TOPIC_LENGTH);
+    MS_DBG(F("Topic ["), strlen(topic), F("]:"), String(topic));
+
+    // Make sure any previous TCP connections are closed
+    if (outClient->connected()) { outClient->stop(); }
+
+    MS_DBG(F("Opening MQTT Connection to"), _brokerHost, ':', _brokerPort);
+    MS_START_DEBUG_TIMER;
+    int16_t state = connectBroker(outClient);
+    if (state == 0) {
+        MS_DBG(F("MQTT connected after"), MS_PRINT_DEBUG_TIMER, F("ms"));
+
+        LogBuffer* logBuffer = _baseLogger->getLogBuffer();
+        if (logBuffer != NULL) {
+            state = publishBufferedRecords(outClient, topic, logBuffer);
+        } else {
+            state = publishCurrentValues(outClient, topic);
+        }
+        if (state == 0) {
+            PRINTOUT(F("MQTT records published to"), _brokerHost);
+        } else {
+            PRINTOUT(F("MQTT publish failed with state:"),
+                     parseMQTTState(state));
+        }
+
+        // Disconnect from MQTT
+        MS_DBG(F("Disconnecting from MQTT"));
+        MS_RESET_DEBUG_TIMER
+        _txLength = 0;
+        txAppend(mqttDisconnect);
+        txAppend(static_cast<uint8_t>(0));
+        txSend(outClient);
+    } else {
+        PRINTOUT(F("MQTT connection failed with state:"),
+                 parseMQTTState(state));
+    }
+    outClient->stop();
+    MS_DBG(F("Disconnected after"), MS_PRINT_DEBUG_TIMER, F("ms"));
+    // Leave the shared buffer empty; see dataPublisher::txBuffer
+    _txLength = 0;
+    emptyTxBuffer();
+    return state;
+}
+
+
+void MQTTPublisher::expandTopic(char* topic, uint16_t maxLength) {
+    uint16_t    len = 0;
+    const char* in  = _topicTemplate;
+    while (*in != '\0' && len < maxLength - 1) {
+        const char* token = NULL;
+        if (strncmp(in, "{id}", 4) == 0) {
+            token = _baseLogger->getLoggerID();
+            in += 4;
+        } else if (strncmp(in, "{uuid}", 6) == 0) {
+            token = _baseLogger->getSamplingFeatureUUID();
+            in += 6;
+        } else {
+            topic[len++] = *in++;
+            continue;
+        }
+        while (token != NULL && *token != '\0' && len < maxLength - 1) {
+            topic[len++] = *token++;
+        }
+    }
+    topic[len] = '\0';
+}
+
+
+int16_t MQTTPublisher::connectBroker(Client* outClient) {
+    if (!outClient->connect(_brokerHost, _brokerPort)) {
+        MS_DBG(F("Could not open a TCP connection to the broker"));
+        return -2;  // MQTT_CONNECT_FAILED
+    }
+
+    // The connect flags
+    uint8_t flags = 0;
+    if (_userName != NULL) {
+        flags |= 0x80;
+        if (_password != NULL) flags |= 0x40;
+    }
+    if (_cleanSession) flags |= 0x02;
+
+    _txLength      = 0;
+    uint16_t start = beginPacket();
+    txAppend("MQTT", true);                  // protocol name
+    txAppend(static_cast<uint8_t>(4));       // protocol level - v3.1.1
+    txAppend(flags);                         // connect flags
+    txAppend(static_cast<uint8_t>(_keepAlive_s >> 8));
+    txAppend(static_cast<uint8_t>(_keepAlive_s & 0xFF));
+    txAppend(_clientID, true);
+    if (flags & 0x80) txAppend(_userName, true);
+    if (flags & 0x40) txAppend(_password, true);
+    if (!endPacket(mqttConnect, start)) {
+        PRINTOUT(F("The MQTT connect packet doesn't fit in the send buffer!"));
+        return -2;  // MQTT_CONNECT_FAILED
+    }
+    txSend(outClient);
+
+    uint8_t body[2] = {0, 0};
+    uint8_t type    = readPacket(outClient, body, sizeof(body));
+    if (type == 0) return -4;            // MQTT_CONNECTION_TIMEOUT
+    if (type != mqttConnAck) return -2;  // MQTT_CONNECT_FAILED
+    if (body[1] != 0) return body[1];    // the broker refused the connection
+
+    MS_DBG(F("Broker"), (body[0] & 0x01) ? F("resumed") : F("started"),
+           F("the MQTT session"));
+    return 0;
+}
+
+
+int16_t MQTTPublisher::publishBufferedRecords(Client*     outClient,
+                                              const char* topic,
+                                              LogBuffer*  logBuffer) {
+    uint32_t firstUnacked = getFirstUnsentRecord();
+    uint32_t nextToSend   = firstUnacked;
+    uint32_t endRecord    = logBuffer->getNextRecordNumber();
+    // Bit i is set when record firstUnacked + i has been acknowledged
+    uint32_t ackedMask = 0;
+    MS_DBG(endRecord - firstUnacked, F("records to publish"));
+
+    _txLength = 0;
+    while (firstUnacked < endRecord) {
+        // Fill the window of messages awaiting acknowledgement
+        while (nextToSend < endRecord &&
+               nextToSend - firstUnacked < MS_MQTT_MAX_INFLIGHT) {
+            if (addPublishPacket(topic, logBuffer, nextToSend,
+                                 MQTT_RECORD_PACKET_ID(nextToSend),
+                                 nextToSend < _firstNeverSentRecord)) {
+                nextToSend++;
+            } else if (_txLength > 0) {
+                // Send what we have to make room and try again
+                txSend(outClient);
+            } else {
+                PRINTOUT(F("Record"), nextToSend,
+                         F("doesn't fit in the send buffer and is skipped!"));
+                ackedMask |= 1UL << (nextToSend - firstUnacked);
+                nextToSend++;
+            }
+        }
+        txSend(outClient);
+        if (nextToSend > _firstNeverSentRecord) {
+            _firstNeverSentRecord = nextToSend;
+        }
+
+        // Slide the window past everything acknowledged so far
+        while (ackedMask & 1UL) {
+            ackedMask >>= 1;
+            firstUnacked++;
+        }
+        markRecordsSent(firstUnacked);
+        if (firstUnacked >= endRecord) break;
+
+        // Wait for the next acknowledgement
+        uint8_t body[2] = {0, 0};
+        uint8_t type    = readPacket(outClient, body, sizeof(body));
+        if (type == 0) {
+            return outClient->connected() ? -4 : -3;  // TIMEOUT or LOST
+        }
+        if (type != mqttPubAck) continue;
+        uint16_t ackedId = (static_cast<uint16_t>(body[0]) << 8) | body[1];
+        for (uint32_t r = firstUnacked; r < nextToSend; r++) {
+            if (MQTT_RECORD_PACKET_ID(r) == ackedId) {
+                ackedMask |= 1UL << (r - firstUnacked);
+                break;
+            }
+        }
+    }
+    MS_DBG(F("All records through"), endRecord - 1, F("acknowledged"));
+    return 0;
+}
+
+
+int16_t MQTTPublisher::publishCurrentValues(Client*     outClient,
+                                            const char* topic) {
+    // Without a log buffer there's nothing to match a packet ID to, so just
+    // roll through them
+    if (++_packetId == 0) _packetId = 1;
+
+    _txLength = 0;
+    if (!addPublishPacket(topic, NULL, 0, _packetId, false)) {
+        PRINTOUT(F("The MQTT message doesn't fit in the send buffer!"));
+        return -2;  // MQTT_CONNECT_FAILED
+    }
+    txSend(outClient);
+
+    uint8_t body[2] = {0, 0};
+    uint8_t type;
+    do {
+        type = readPacket(outClient, body, sizeof(body));
+        if (type == 0) {
+            return outClient->connected() ? -4 : -3;  // TIMEOUT or LOST
+        }
+    } while (type != mqttPubAck ||
+             ((static_cast<uint16_t>(body[0]) << 8) | body[1]) != _packetId);
+    return 0;
+}
+
+
+bool MQTTPublisher::addPublishPacket(const char* topic, LogBuffer* logBuffer,
+                                     uint32_t recordNum, uint16_t packetId,
+                                     bool duplicate) {
+    // Create a buffer for the portions of the payload
+    char tempBuffer[26] = "";
+
+    uint16_t start = beginPacket();
+    txAppend(topic, true);
+    txAppend(static_cast<uint8_t>(packetId >> 8));
+    txAppend(static_cast<uint8_t>(packetId & 0xFF));
+
+    // The buffered timestamps are in the logger's time zone; shift them the
+    // same way the current marked time is shifted to UTC
+    uint32_t timestamp = Logger::markedEpochTimeUTC;
+    if (logBuffer != NULL) {
+        timestamp = logBuffer->getRecordTimestamp(recordNum) -
+            (Logger::markedEpochTime - Logger::markedEpochTimeUTC);
+    }
+    snprintf(tempBuffer, sizeof(tempBuffer), "%lu",
+             static_cast<unsigned long>(timestamp));
+    txAppend(tempBuffer);
+
+    uint8_t numVariables = logBuffer != NULL ? logBuffer->getNumVariables()
+                                             : _baseLogger->getArrayVarCount();
+    for (uint8_t i = 0; i < numVariables; i++) {
+        txAppend(static_cast<uint8_t>(','));
+        // Values which haven't changed enough are left empty
+        if (logBuffer != NULL ? !logBuffer->isRecordValueReported(recordNum, i)
+                              : !_baseLogger->isValueReportedAtI(i)) {
+            continue;
+        }
+        if (logBuffer != NULL) {
+            _baseLogger
+                ->formatValueStringAtI(i,
+                                       logBuffer->getRecordValue(recordNum, i))
+                .toCharArray(tempBuffer, 26);
+        } else {
+            _baseLogger->getValueStringAtI(i).toCharArray(tempBuffer, 26);
+        }
+        txAppend(tempBuffer);
+    }
+
+    uint8_t header = mqttPublish | MQTT_PUBLISH_QOS1;
+    if (duplicate) header |= MQTT_PUBLISH_DUP;
+    return endPacket(header, start);
+}
+
+
+uint8_t MQTTPublisher::readPacket(Client* outClient, uint8_t* body,
+                                  uint8_t bodySize) {
+    uint32_t start = millis();
+
+    int16_t header = timedRead(outClient, start);
+    if (header < 0) return 0;
+
+    // The remaining length is 1-4 bytes, 7 bits at a time
+    uint32_t remaining  = 0;
+    uint32_t multiplier = 1;
+    int16_t  lengthByte;
+    do {
+        lengthByte = timedRead(outClient, start);
+        if (lengthByte < 0) return 0;
+        remaining += (lengthByte & 0x7F) * multiplier;
+        multiplier <<= 7;
+    } while ((lengthByte & 0x80) && multiplier <= 0x200000UL);
+
+    for (uint32_t i = 0; i < remaining; i++) {
+        int16_t b = timedRead(outClient, start);
+        if (b < 0) return 0;
+        if (i < bodySize) body[i] = b;
+    }
+
+    MS_DBG(F("Received MQTT packet type"), header >> 4, F("with"), remaining,
+           F("bytes after"), millis() - start, F("ms"));
+    return header & 0xF0;
+}
+
+
+int16_t MQTTPublisher::timedRead(Client* outClient, uint32_t start) {
+    while (outClient->available() == 0) {
+        if (millis() - start > MS_PUBLISHER_RESPONSE_TIMEOUT_MS) return -1;
+        if (!outClient->connected()) return -1;
+        delay(1);
+    }
+    return outClient->read();
+}
+
+
+uint16_t MQTTPublisher::beginPacket(void) {
+    uint16_t start = _txLength;
+    _txOverflow    = false;
+    for (uint8_t i = 0; i < MQTT_MAX_HEADER_SIZE; i++) {
+        txAppend(static_cast<uint8_t>(0));
+    }
+    return start;
+}
+
+
+bool MQTTPublisher::endPacket(uint8_t header, uint16_t start) {
+    if (_txOverflow) {
+        _txLength = start;
+        return false;
+    }
+    uint16_t bodyStart = start + MQTT_MAX_HEADER_SIZE;
+    uint16_t remaining = _txLength - bodyStart;
+
+    // Encode the remaining length after the packet type
+    uint8_t headerLength = 0;
+    txBuffer[start + headerLength++] = header;
+    do {
+        uint8_t lengthByte = remaining & 0x7F;
+        remaining >>= 7;
+        if (remaining > 0) lengthByte |= 0x80;
+        txBuffer[start + headerLength++] = lengthByte;
+    } while (remaining > 0);
+
+    // Close the gap left for a longer header
+    memmove(txBuffer + start + headerLength, txBuffer + bodyStart,
+            _txLength - bodyStart);
+    _txLength -= MQTT_MAX_HEADER_SIZE - headerLength;
+    return true;
+}
+
+
+void MQTTPublisher::txAppend(uint8_t b) {
+    if (_txLength < MS_SEND_BUFFER_SIZE) {
+        txBuffer[_txLength++] = b;
+    } else {
+        _txOverflow = true;
+    }
+}
+void MQTTPublisher::txAppend(const char* str, bool prefixLength) {
+    uint16_t len = strlen(str);
+    if (prefixLength) {
+        txAppend(static_cast<uint8_t>(len >> 8));
+        txAppend(static_cast<uint8_t>(len & 0xFF));
+    }
+    for (uint16_t i = 0; i < len; i++) {
+        txAppend(static_cast<uint8_t>(str[i]));
+    }
+}
+
+
+void MQTTPublisher::txSend(Client* outClient) {
+    if (_txLength == 0) return;
+    MS_DBG(F("Sending"), _txLength, F("bytes of MQTT packets"));
+    outClient->write(reinterpret_cast<const uint8_t*>(txBuffer), _txLength);
+    outClient->flush();
+    _txLength = 0;
+}
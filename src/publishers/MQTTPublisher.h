@@ -0,0 +1,407 @@
+/**
+ * @file MQTTPublisher.h
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the MQTTPublisher subclass of dataPublisher for publishing
+ * data to any MQTT broker.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_MQTTPUBLISHER_H_
+#define SRC_PUBLISHERS_MQTTPUBLISHER_H_
+
+// Debugging Statement
+// #define MS_MQTTPUBLISHER_DEBUG
+
+#ifdef MS_MQTTPUBLISHER_DEBUG
+#define MS_DEBUGGING_STD "MQTTPublisher"
+#endif
+
+/**
+ * @def MS_MQTT_MAX_INFLIGHT
+ * @brief The maximum number of QoS 1 messages sent without waiting for their
+ * acknowledgement.
+ *
+ * This can be changed by setting the build flag MS_MQTT_MAX_INFLIGHT when
+ * compiling.  It cannot be more than 32.
+ *
+ * @ingroup the_publishers
+ */
+#ifndef MS_MQTT_MAX_INFLIGHT
+#define MS_MQTT_MAX_INFLIGHT 8
+#endif
+#if MS_MQTT_MAX_INFLIGHT > 32
+#error MS_MQTT_MAX_INFLIGHT cannot be more than 32
+#endif
+
+/**
+ * @def MS_MQTT_MAX_TOPIC_LENGTH
+ * @brief The maximum length of a topic after the template is filled in.
+ *
+ * This can be changed by setting the build flag MS_MQTT_MAX_TOPIC_LENGTH when
+ * compiling.
+ *
+ * @ingroup the_publishers
+ */
+#ifndef MS_MQTT_MAX_TOPIC_LENGTH
+#define MS_MQTT_MAX_TOPIC_LENGTH 96
+#endif
+
+// Included Dependencies
+#include "ModSensorDebugger.h"
+#undef MS_DEBUGGING_STD
+#include "dataPublisherBase.h"
+
+
+// ============================================================================
+//  Functions for a generic MQTT broker.
+// ============================================================================
+/**
+ * @brief The MQTTPublisher subclass of dataPublisher for publishing data to
+ * any MQTT (v3.1.1) broker.
+ *
+ * Each record is sent as a single QoS 1 message with a compact payload of the
+ * UTC Unix timestamp followed by the value of every variable, in the order of
+ * the variable array, separated by commas:
+ * `1608000000,23.51,7.04,-9999`
+ *
+ * Values which have not changed by more than the variable's deadband (see
+ * Variable::setReportByException(float, uint32_t)) are left empty:
+ * `1608000000,23.51,,-9999`
+ *
+ * The topic is built from a template.  Within the template `{id}` is replaced
+ * by the logger ID and `{uuid}` is replaced by the sampling feature UUID.  For
+ * example, `sites/{id}/data`.
+ *
+ * By default the publisher asks the broker for a persistent session (clean
+ * session off) under a fixed client ID.  If a LogBuffer is attached to the
+ * logger, every record which has not been acknowledged by the broker is sent,
+ * oldest first.  Up to #MS_MQTT_MAX_INFLIGHT messages are sent before waiting
+ * for their acknowledgements, so a backlog does not need a round trip per
+ * record.  Records sent before but never acknowledged are re-sent with the
+ * duplicate flag set.
+ *
+ * The return of publishData() is the same as the PubSubClient states (see
+ * dataPublisher::parseMQTTState()); 0 means all records were acknowledged.
+ *
+ * @ingroup the_publishers
+ */
+class MQTTPublisher : public dataPublisher {
+ public:
+    // Constructors
+    /**
+     * @brief Construct a new MQTT Publisher object with no members set.
+     */
+    MQTTPublisher();
+    /**
+     * @brief Construct a new MQTT Publisher object
+     *
+     * @note If a client is never specified, the publisher will attempt to
+     * create and use a client on a LoggerModem instance tied to the attached
+     * logger.
+     *
+     * @param baseLogger The logger supplying the data to be published
+     * @param sendEveryX Currently unimplemented, intended for future use to
+     * enable caching and bulk publishing
+     * @param sendOffset Currently unimplemented, intended for future use to
+     * enable publishing data at a time slightly delayed from when it is
+     * collected
+     */
+    explicit MQTTPublisher(Logger& baseLogger, uint8_t sendEveryX = 1,
+                           uint8_t sendOffset = 0);
+    /**
+     * @brief Construct a new MQTT Publisher object
+     *
+     * @param baseLogger The logger supplying the data to be published
+     * @param inClient An Arduino client instance to use to print data to.
+     * Allows the use of any type of client and multiple clients tied to a
+     * single TinyGSM modem instance
+     * @param sendEveryX Currently unimplemented, intended for future use to
+     * enable caching and bulk publishing
+     * @param sendOffset Currently unimplemented, intended for future use to
+     * enable publishing data at a time slightly delayed from when it is
+     * collected
+     */
+    MQTTPublisher(Logger& baseLogger, Client* inClient, uint8_t sendEveryX = 1,
+                  uint8_t sendOffset = 0);
+    /**
+     * @brief Construct a new MQTT Publisher object
+     *
+     * @param baseLogger The logger supplying the data to be published
+     * @param brokerHost The host name of the MQTT broker
+     * @param brokerPort The port of the MQTT broker
+     * @param clientID The MQTT client ID; this must be unique to the logger
+     * for a persistent session to work
+     * @param topicTemplate The template for the topic to publish to
+     * @param sendEveryX Currently unimplemented, intended for future use to
+     * enable caching and bulk publishing
+     * @param sendOffset Currently unimplemented, intended for future use to
+     * enable publishing data at a time slightly delayed from when it is
+     * collected
+     */
+    MQTTPublisher(Logger& baseLogger, const char* brokerHost,
+                  uint16_t brokerPort, const char* clientID,
+                  const char* topicTemplate, uint8_t sendEveryX = 1,
+                  uint8_t sendOffset = 0);
+    /**
+     * @brief Construct a new MQTT Publisher object
+     *
+     * @param baseLogger The logger supplying the data to be published
+     * @param inClient An Arduino client instance to use to print data to.
+     * Allows the use of any type of client and multiple clients tied to a
+     * single TinyGSM modem instance
+     * @param brokerHost The host name of the MQTT broker
+     * @param brokerPort The port of the MQTT broker
+     * @param clientID The MQTT client ID; this must be unique to the logger
+     * for a persistent session to work
+     * @param topicTemplate The template for the topic to publish to
+     * @param sendEveryX Currently unimplemented, intended for future use to
+     * enable caching and bulk publishing
+     * @param sendOffset Currently unimplemented, intended for future use to
+     * enable publishing data at a time slightly delayed from when it is
+     * collected
+     */
+    MQTTPublisher(Logger& baseLogger, Client* inClient, const char* brokerHost,
+                  uint16_t brokerPort, const char* clientID,
+                  const char* topicTemplate, uint8_t sendEveryX = 1,
+                  uint8_t sendOffset = 0);
+    /**
+     * @brief Destroy the MQTT Publisher object
+     */
+    virtual ~MQTTPublisher();
+
+    // Returns the data destination
+    String getEndpoint(void) override {
+        return String(_brokerHost);
+    }
+    // Sends the records in the logger's LogBuffer that it hasn't yet sent
+    bool usesLogBuffer(void) override {
+        return true;
+    }
+    // Publishing returns the MQTT connection state, which is 0 when it worked
+    bool isPublishSuccess(int16_t result) override {
+        return result == 0;
+    }
+
+    /**
+     * @brief Set the MQTT broker.
+     *
+     * @param brokerHost The host name of the MQTT broker
+     * @param brokerPort The port of the MQTT broker; optional with a default
+     * value of 1883.
+     */
+    void setBroker(const char* brokerHost, uint16_t brokerPort = 1883);
+    /**
+     * @brief Set the MQTT client ID.
+     *
+     * @param clientID The MQTT client ID; this must be unique to the logger
+     * for a persistent session to work
+     */
+    void setClientID(const char* clientID);
+    /**
+     * @brief Set the user name and password for the broker, if needed.
+     *
+     * @param userName The MQTT user name
+     * @param password The MQTT password
+     */
+    void setCredentials(const char* userName, const char* password);
+    /**
+     * @brief Set the template for the topic.
+     *
+     * @param topicTemplate The template for the topic to publish to; `{id}`
+     * is replaced by the logger ID and `{uuid}` by the sampling feature UUID.
+     */
+    void setTopicTemplate(const char* topicTemplate);
+    /**
+     * @brief Choose whether to ask the broker for a clean session on every
+     * connection.
+     *
+     * @param cleanSession True to start a clean session every time; false
+     * (the default) to keep a persistent session.
+     */
+    void setCleanSession(bool cleanSession);
+    /**
+     * @brief Set the keep-alive interval sent to the broker.
+     *
+     * @param keepAlive_s The keep-alive in seconds; default is 60.
+     */
+    void setKeepAlive(uint16_t keepAlive_s);
+
+    // A way to begin with everything already set
+    /**
+     * @copydoc dataPublisher::begin(Logger& baseLogger, Client* inClient)
+     * @param brokerHost The host name of the MQTT broker
+     * @param brokerPort The port of the MQTT broker
+     * @param clientID The MQTT client ID
+     * @param topicTemplate The template for the topic to publish to
+     */
+    void begin(Logger& baseLogger, Client* inClient, const char* brokerHost,
+               uint16_t brokerPort, const char* clientID,
+               const char* topicTemplate);
+    /**
+     * @copydoc dataPublisher::begin(Logger& baseLogger)
+     * @param brokerHost The host name of the MQTT broker
+     * @param brokerPort The port of the MQTT broker
+     * @param clientID The MQTT client ID
+     * @param topicTemplate The template for the topic to publish to
+     */
+    void begin(Logger& baseLogger, const char* brokerHost, uint16_t brokerPort,
+               const char* clientID, const char* topicTemplate);
+
+    /**
+     * @brief Connect to the broker and publish all unsent records, then
+     * disconnect.
+     *
+     * @param outClient An Arduino client instance to use to print data to.
+     * Allows the use of any type of client and multiple clients tied to a
+     * single TinyGSM modem instance
+     * @return **int16_t** The final MQTT state; 0 if every record was
+     * acknowledged.
+     */
+    int16_t publishData(Client* outClient) override;
+
+ protected:
+    /**
+     * @anchor mqtt_packet_types
+     * @name MQTT control packet types
+     *
+     * @{
+     */
+    static const uint8_t mqttConnect;     ///< CONNECT
+    static const uint8_t mqttConnAck;     ///< CONNACK
+    static const uint8_t mqttPublish;     ///< PUBLISH
+    static const uint8_t mqttPubAck;      ///< PUBACK
+    static const uint8_t mqttDisconnect;  ///< DISCONNECT
+    /**@}*/
+
+    /**
+     * @brief Fill in the topic template.
+     *
+     * @param topic The buffer for the finished topic
+     * @param maxLength The size of the buffer
+     */
+    void expandTopic(char* topic, uint16_t maxLength);
+    /**
+     * @brief Send a CONNECT packet and wait for the CONNACK.
+     *
+     * @param outClient The client to use
+     * @return **int16_t** The MQTT state; 0 if connected.
+     */
+    int16_t connectBroker(Client* outClient);
+    /**
+     * @brief Publish every unsent record in the log buffer, pipelining up to
+     * #MS_MQTT_MAX_INFLIGHT messages.
+     *
+     * @param outClient The client to use
+     * @param topic The topic to publish to
+     * @param logBuffer The logger's LogBuffer
+     * @return **int16_t** The MQTT state; 0 if all records were acknowledged.
+     */
+    int16_t publishBufferedRecords(Client* outClient, const char* topic,
+                                   LogBuffer* logBuffer);
+    /**
+     * @brief Publish the current values of the variables, without a log
+     * buffer.
+     *
+     * @param outClient The client to use
+     * @param topic The topic to publish to
+     * @return **int16_t** The MQTT state; 0 if the record was acknowledged.
+     */
+    int16_t publishCurrentValues(Client* outClient, const char* topic);
+    /**
+     * @brief Add a QoS 1 PUBLISH packet for one record to the TX buffer.
+     *
+     * @param topic The topic to publish to
+     * @param logBuffer The log buffer to take the record from, or NULL for
+     * the current values
+     * @param recordNum The record number in the log buffer
+     * @param packetId The MQTT packet ID
+     * @param duplicate True if the record has been sent before
+     * @return **bool** True if the whole packet fit in the TX buffer
+     */
+    bool addPublishPacket(const char* topic, LogBuffer* logBuffer,
+                          uint32_t recordNum, uint16_t packetId,
+                          bool duplicate);
+    /**
+     * @brief Read one control packet from the broker.
+     *
+     * @param outClient The client to read from
+     * @param body A buffer for the start of the packet body
+     * @param bodySize The size of the body buffer; anything beyond it is
+     * discarded
+     * @return **uint8_t** The packet type or 0 if nothing arrived before the
+     * timeout
+     */
+    uint8_t readPacket(Client* outClient, uint8_t* body, uint8_t bodySize);
+    /**
+     * @brief Read one byte from the broker, waiting for it if necessary.
+     *
+     * @param outClient The client to read from
+     * @param start The processor time the wait for the packet began
+     * @return **int16_t** The byte or -1 if the connection timed out or was
+     * lost
+     */
+    int16_t timedRead(Client* outClient, uint32_t start);
+
+    /**
+     * @brief Start a new control packet at the end of the TX buffer, leaving
+     * room for the fixed header.
+     *
+     * @return **uint16_t** The position of the new packet in the TX buffer
+     */
+    uint16_t beginPacket(void);
+    /**
+     * @brief Finish a control packet by filling in the fixed header.
+     *
+     * If the packet didn't fit in the TX buffer, it is removed.
+     *
+     * @param header The first byte of the fixed header - the packet type and
+     * flags
+     * @param start The position returned by beginPacket()
+     * @return **bool** True if the whole packet fit in the TX buffer
+     */
+    bool endPacket(uint8_t header, uint16_t start);
+    /**
+     * @brief Add one byte to the TX buffer.
+     *
+     * @param b The byte
+     */
+    void txAppend(uint8_t b);
+    /**
+     * @brief Add characters to the TX buffer.
+     *
+     * @param str The characters to add
+     * @param prefixLength True to add the two-byte MQTT length prefix
+     */
+    void txAppend(const char* str, bool prefixLength = false);
+    /**
+     * @brief Write the binary contents of the TX buffer to a client.
+     *
+     * @param outClient The client to write to
+     */
+    void txSend(Client* outClient);
+    /**
+     * @brief The number of bytes in the TX buffer.
+     */
+    uint16_t _txLength;
+    /**
+     * @brief True if the last packet didn't fit in the TX buffer.
+     */
+    bool _txOverflow;
+
+ private:
+    const char* _brokerHost;
+    uint16_t    _brokerPort;
+    const char* _clientID;
+    const char* _userName;
+    const char* _password;
+    const char* _topicTemplate;
+    bool        _cleanSession;
+    uint16_t    _keepAlive_s;
+    uint16_t    _packetId;
+    uint32_t    _firstNeverSentRecord;
+};
+
+#endif  // SRC_PUBLISHERS_MQTTPUBLISHER_H_
@@ -22,6 +22,19 @@ const int   ThingSpeakPublisher::mqttPort       = 1883;
 const char* ThingSpeakPublisher::mqttClientName = THING_SPEAK_CLIENT_NAME;
 const char* ThingSpeakPublisher::mqttUser       = THING_SPEAK_USER_NAME;
 
+// Constant values for the bulk update HTTP post
+const char* ThingSpeakPublisher::bulkHost            = "api.thingspeak.com";
+const int   ThingSpeakPublisher::bulkPort            = 80;
+const char* ThingSpeakPublisher::bulkPathStart       = "/channels/";
+const char* ThingSpeakPublisher::bulkPathEnd         = "/bulk_update.json";
+const char* ThingSpeakPublisher::contentLengthHeader = "\r\nContent-Length: ";
+const char* ThingSpeakPublisher::contentTypeHeader =
+    "\r\nContent-Type: application/json\r\n\r\n";
+const char* ThingSpeakPublisher::writeKeyTag  = "{\"write_api_key\":\"";
+const char* ThingSpeakPublisher::updatesTag   = "\",\"updates\":[";
+const char* ThingSpeakPublisher::createdAtTag = "{\"created_at\":\"";
+const char* ThingSpeakPublisher::fieldTag     = ",\"field";
+
 
 // Constructors
 ThingSpeakPublisher::ThingSpeakPublisher() : dataPublisher() {
@@ -29,6 +42,7 @@ ThingSpeakPublisher::ThingSpeakPublisher() : dataPublisher() {
     _thingSpeakMQTTKey    = NULL;
     _thingSpeakChannelID  = NULL;
     _thingSpeakChannelKey = NULL;
+    _bulkEndRecord        = 0;
 }
 ThingSpeakPublisher::ThingSpeakPublisher(Logger& baseLogger, uint8_t sendEveryX,
                                          uint8_t sendOffset)
@@ -37,6 +51,7 @@ ThingSpeakPublisher::ThingSpeakPublisher(Logger& baseLogger, uint8_t sendEveryX,
     _thingSpeakMQTTKey    = NULL;
     _thingSpeakChannelID  = NULL;
     _thingSpeakChannelKey = NULL;
+    _bulkEndRecord        = 0;
 }
 ThingSpeakPublisher::ThingSpeakPublisher(Logger& baseLogger, Client* inClient,
                                          uint8_t sendEveryX, uint8_t sendOffset)
@@ -45,6 +60,7 @@ ThingSpeakPublisher::ThingSpeakPublisher(Logger& baseLogger, Client* inClient,
     _thingSpeakMQTTKey    = NULL;
     _thingSpeakChannelID  = NULL;
     _thingSpeakChannelKey = NULL;
+    _bulkEndRecord        = 0;
 }
 ThingSpeakPublisher::ThingSpeakPublisher(Logger&     baseLogger,
                                          const char* thingSpeakMQTTKey,
@@ -55,6 +71,7 @@ ThingSpeakPublisher::ThingSpeakPublisher(Logger&     baseLogger,
     setMQTTKey(thingSpeakMQTTKey);
     setChannelID(thingSpeakChannelID);
     setChannelKey(thingSpeakChannelKey);
+    _bulkEndRecord = 0;
     // MS_DBG(F("ThingSpeakPublisher object created"));
 }
 ThingSpeakPublisher::ThingSpeakPublisher(Logger& baseLogger, Client* inClient,
@@ -66,6 +83,7 @@ ThingSpeakPublisher::ThingSpeakPublisher(Logger& baseLogger, Client* inClient,
     setMQTTKey(thingSpeakMQTTKey);
     setChannelID(thingSpeakChannelID);
     setChannelKey(thingSpeakChannelKey);
+    _bulkEndRecord = 0;
     // MS_DBG(F("ThingSpeakPublisher object created"));
 }
 // Destructor
@@ -123,6 +141,12 @@ void ThingSpeakPublisher::begin(Logger&     baseLogger,
 // This sends the data to ThingSpeak
 // bool ThingSpeakPublisher::mqttThingSpeak(void)
 int16_t ThingSpeakPublisher::publishData(Client* outClient) {
+    // Send any backlog in bulk over HTTP
+    if (getNumUnsentRecords() > 1) {
+        if (!publishDataBegin(outClient)) return 0;
+        return publishDataFinish();
+    }
+
     bool retVal = false;
 
     // Make sure we don't have too many fields
@@ -150,16 +174,16 @@ int16_t ThingSpeakPublisher::publishData(Client* outClient) {
         .toCharArray(tempBuffer, 26);
     strcat(txBuffer, "created_at=");
     strcat(txBuffer, tempBuffer);
-    txBuffer[strlen(txBuffer)] = '&';
 
     for (uint8_t i = 0; i < numChannels; i++) {
-        strcat(txBuffer, "field");
+        // Values which haven't changed enough are left out
+        if (!_baseLogger->isValueReportedAtI(i)) continue;
+        strcat(txBuffer, "&field");
         itoa(i + 1, tempBuffer, 10);  // BASE 10
         strcat(txBuffer, tempBuffer);
         txBuffer[strlen(txBuffer)] = '=';
         _baseLogger->getValueStringAtI(i).toCharArray(tempBuffer, 26);
         strcat(txBuffer, tempBuffer);
-        if (i + 1 != numChannels) { txBuffer[strlen(txBuffer)] = '&'; }
     }
     MS_DBG(F("Message ["), strlen(txBuffer), F("]:"), String(txBuffer));
 
@@ -187,6 +211,10 @@ int16_t ThingSpeakPublisher::publishData(Client* outClient) {
             PRINTOUT(F("ThingSpeak topic published!  Current state:"),
                      parseMQTTState(_mqttClient.state()));
             retVal = true;
+            if (_baseLogger->getLogBuffer() != NULL) {
+                markRecordsSent(
+                    _baseLogger->getLogBuffer()->getNextRecordNumber());
+            }
         } else {
             PRINTOUT(F("MQTT publish failed with state:"),
                      parseMQTTState(_mqttClient.state()));
@@ -206,3 +234,139 @@ int16_t ThingSpeakPublisher::publishData(Client* outClient) {
     MS_DBG(F("Disconnected after"), MS_PRINT_DEBUG_TIMER, F("ms"));
     return retVal;
 }
+
+
+// This streams a bulk update of all unsent records to the ThingSpeak REST API
+// but doesn't wait for the response
+bool ThingSpeakPublisher::publishDataBegin(Client* outClient) {
+    // A single new record goes out over MQTT
+    if (getNumUnsentRecords() <= 1) {
+        return dataPublisher::publishDataBegin(outClient);
+    }
+    if (_publishState != PUBLISHER_IDLE) {
+        MS_DBG(F("Publisher is already busy!"));
+        return false;
+    }
+
+    // Create a buffer for the portions of the request
+    char tempBuffer[12] = "";
+
+    uint32_t firstRecord = getFirstUnsentRecord();
+    uint32_t endRecord   = _baseLogger->getLogBuffer()->getNextRecordNumber();
+    if (endRecord - firstRecord > MS_THINGSPEAK_BULK_LIMIT) {
+        endRecord = firstRecord + MS_THINGSPEAK_BULK_LIMIT;
+    }
+    MS_DBG(endRecord - firstRecord, F("records will be sent to ThingSpeak"));
+
+    // Count the JSON first so the content length is known before streaming it
+    uint32_t jsonLength = writeBulkJSON(NULL, firstRecord, endRecord);
+    MS_DBG(F("Outgoing JSON size:"), jsonLength);
+
+    // Make sure any previous TCP connections are closed
+    if (outClient->connected()) { outClient->stop(); }
+
+    MS_DBG(F("Connecting client"));
+    MS_START_DEBUG_TIMER;
+    if (outClient->connect(bulkHost, bulkPort)) {
+        MS_DBG(F("Client connected after"), MS_PRINT_DEBUG_TIMER, F("ms\n"));
+
+        emptyTxBuffer();
+        strcat(txBuffer, postHeader);
+        strcat(txBuffer, bulkPathStart);
+        strcat(txBuffer, _thingSpeakChannelID);
+        strcat(txBuffer, bulkPathEnd);
+        strcat(txBuffer, HTTPtag);
+        strcat(txBuffer, hostHeader);
+        strcat(txBuffer, bulkHost);
+        strcat(txBuffer, contentLengthHeader);
+        ltoa(jsonLength, tempBuffer, 10);  // BASE 10
+        strcat(txBuffer, tempBuffer);
+        strcat(txBuffer, contentTypeHeader);
+        printTxBuffer(outClient);
+
+        writeBulkJSON(outClient, firstRecord, endRecord);
+
+        // Don't wait for the response here, publishDataPoll() will pick it up
+        _bulkEndRecord = endRecord;
+        awaitHTTPResponse(outClient);
+    } else {
+        PRINTOUT(F("\n -- Unable to Establish Connection to ThingSpeak --"));
+        completePublish(504);
+    }
+
+    return true;
+}
+
+
+// Marks the records as sent once ThingSpeak has accepted the bulk update
+bool ThingSpeakPublisher::publishDataPoll(void) {
+    if (!dataPublisher::publishDataPoll()) return false;
+    if (_bulkEndRecord != 0) {
+        // ThingSpeak answers a successful bulk update with 202 (Accepted)
+        if (_publishResult == 202 || _publishResult == 200) {
+            markRecordsSent(_bulkEndRecord);
+        }
+        _bulkEndRecord = 0;
+    }
+    return true;
+}
+
+
+uint32_t ThingSpeakPublisher::writeBulkJSON(Client*  outClient,
+                                            uint32_t firstRecord,
+                                            uint32_t endRecord) {
+    LogBuffer* logBuffer   = _baseLogger->getLogBuffer();
+    uint8_t    numChannels = min(logBuffer->getNumVariables(), 8);
+    uint32_t   byteCount   = 0;
+
+    // Create a buffer for the portions of the request
+    char tempBuffer[26] = "";
+
+    emptyTxBuffer();
+    strcat(txBuffer, writeKeyTag);
+    strcat(txBuffer, _thingSpeakChannelKey);
+    strcat(txBuffer, updatesTag);
+
+    for (uint32_t r = firstRecord; r < endRecord; r++) {
+        // Once the buffer fills, send it out
+        if (bufferFree() < 45) flushBulkBuffer(outClient, byteCount);
+        strcat(txBuffer, createdAtTag);
+        _baseLogger->formatDateTime_ISO8601(logBuffer->getRecordTimestamp(r))
+            .toCharArray(tempBuffer, 26);
+        strcat(txBuffer, tempBuffer);
+        txBuffer[strlen(txBuffer)] = '"';
+
+        for (uint8_t i = 0; i < numChannels; i++) {
+            if (!logBuffer->isRecordValueReported(r, i)) continue;
+            if (bufferFree() < 38) flushBulkBuffer(outClient, byteCount);
+            strcat(txBuffer, fieldTag);
+            itoa(i + 1, tempBuffer, 10);  // BASE 10
+            strcat(txBuffer, tempBuffer);
+            txBuffer[strlen(txBuffer)] = '"';
+            txBuffer[strlen(txBuffer)] = ':';
+            _baseLogger
+                ->formatValueStringAtI(i, logBuffer->getRecordValue(r, i))
+                .toCharArray(tempBuffer, 26);
+            strcat(txBuffer, tempBuffer);
+        }
+        txBuffer[strlen(txBuffer)] = '}';
+        if (r + 1 != endRecord) { txBuffer[strlen(txBuffer)] = ','; }
+    }
+
+    if (bufferFree() < 3) flushBulkBuffer(outClient, byteCount);
+    txBuffer[strlen(txBuffer)] = ']';
+    txBuffer[strlen(txBuffer)] = '}';
+    flushBulkBuffer(outClient, byteCount);
+    return byteCount;
+}
+
+
+void ThingSpeakPublisher::flushBulkBuffer(Client*   outClient,
+                                          uint32_t& byteCount) {
+    byteCount += strlen(txBuffer);
+    if (outClient != NULL) {
+        printTxBuffer(outClient);
+    } else {
+        emptyTxBuffer();
+    }
+}
@@ -33,6 +33,20 @@
  */
 #define THING_SPEAK_CLIENT_NAME "MS"
 
+/**
+ * @def MS_THINGSPEAK_BULK_LIMIT
+ * @brief The maximum number of records sent in a single bulk update.
+ *
+ * ThingSpeak accepts up to 960 entries in one bulk update request.  This can
+ * be lowered by setting the build flag MS_THINGSPEAK_BULK_LIMIT when
+ * compiling.
+ *
+ * @ingroup the_publishers
+ */
+#ifndef MS_THINGSPEAK_BULK_LIMIT
+#define MS_THINGSPEAK_BULK_LIMIT 960
+#endif
+
 // Included Dependencies
 #include "ModSensorDebugger.h"
 #undef MS_DEBUGGING_STD
@@ -58,6 +72,13 @@
  * be "Field3".  Any text names you have given to your fields in ThingSpeak are
  * also irrelevant.
  *
+ * A single new record is published over MQTT.  If a LogBuffer is attached to
+ * the logger and more than one record is waiting to be sent (for example,
+ * after an outage), the waiting records are instead sent to the channel's
+ * [bulk update](https://www.mathworks.com/help/thingspeak/bulkwritejsondata.html)
+ * endpoint in a single HTTP POST, up to #MS_THINGSPEAK_BULK_LIMIT records at a
+ * time.  Each record keeps its original timestamp, so the gaps are backfilled.
+ *
  * @ingroup the_publishers
  */
 class ThingSpeakPublisher : public dataPublisher {
@@ -157,6 +178,15 @@ class ThingSpeakPublisher : public dataPublisher {
     String getEndpoint(void) override {
         return String(mqttServer);
     }
+    // Sends the records in the logger's LogBuffer that it hasn't yet sent
+    bool usesLogBuffer(void) override {
+        return true;
+    }
+    // A single record is published over MQTT, returning true if it worked;
+    // a backlog goes in bulk over HTTP
+    bool isPublishSuccess(int16_t result) override {
+        return result == true || dataPublisher::isPublishSuccess(result);
+    }
 
     /**
      * @brief Set the MQTT API Key from Account > MyProfile
@@ -212,6 +242,28 @@ class ThingSpeakPublisher : public dataPublisher {
     // This sends the data to ThingSpeak
     // bool mqttThingSpeak(void);
     int16_t publishData(Client* outClient) override;
+    /**
+     * @brief Begin sending data to ThingSpeak.
+     *
+     * If more than one record is waiting in the logger's LogBuffer, this
+     * opens a connection to the ThingSpeak REST API and streams out a bulk
+     * update of all of them without waiting for the response.  Otherwise, the
+     * current record is published over MQTT.
+     *
+     * @param outClient An Arduino client instance to use to print data to.
+     * Allows the use of any type of client and multiple clients tied to a
+     * single TinyGSM modem instance
+     * @return **bool** True if the publish was started; false if the
+     * publisher was already busy.
+     */
+    bool publishDataBegin(Client* outClient) override;
+    /**
+     * @brief Check for the response to a bulk update and mark the records as
+     * sent if it was accepted.
+     *
+     * @return **bool** True if the request is complete.
+     */
+    bool publishDataPoll(void) override;
 
  protected:
     /**
@@ -226,12 +278,55 @@ class ThingSpeakPublisher : public dataPublisher {
     static const char* mqttUser;        ///< The MQTT user name
                                         /**@}*/
 
+    /**
+     * @anchor ts_bulk_vars
+     * @name Portions of the bulk update HTTP request
+     *
+     * @{
+     */
+    static const char* bulkHost;             ///< The REST API host
+    static const int   bulkPort;             ///< The REST API port
+    static const char* bulkPathStart;        ///< The start of the URL path
+    static const char* bulkPathEnd;          ///< The end of the URL path
+    static const char* contentLengthHeader;  ///< The content length header
+    static const char* contentTypeHeader;    ///< The content type header
+    static const char* writeKeyTag;          ///< The JSON write key tag
+    static const char* updatesTag;           ///< The JSON updates tag
+    static const char* createdAtTag;         ///< The JSON timestamp tag
+    static const char* fieldTag;             ///< The start of a field tag
+    /**@}*/
+
+    /**
+     * @brief Write the JSON body of a bulk update.
+     *
+     * The body is built up in the TX buffer and sent out each time the buffer
+     * fills, so there is never more than one buffer's worth of it in memory.
+     *
+     * @param outClient The client to write to; if NULL nothing is sent and
+     * the bytes are only counted.
+     * @param firstRecord The record number of the first record to include
+     * @param endRecord One more than the record number of the last record to
+     * include
+     * @return **uint32_t** The number of bytes in the body
+     */
+    uint32_t writeBulkJSON(Client* outClient, uint32_t firstRecord,
+                           uint32_t endRecord);
+    /**
+     * @brief Send out or count the TX buffer and empty it.
+     *
+     * @param outClient The client to write to; if NULL nothing is sent.
+     * @param byteCount The running count of bytes to add the TX buffer to
+     */
+    void flushBulkBuffer(Client* outClient, uint32_t& byteCount);
+
  private:
     // Keys for ThingSpeak
     const char*  _thingSpeakMQTTKey;
     const char*  _thingSpeakChannelID;
     const char*  _thingSpeakChannelKey;
     PubSubClient _mqttClient;
+    // One more than the last record in the bulk update in progress; 0 if none
+    uint32_t _bulkEndRecord;
 };
 
 #endif  // SRC_PUBLISHERS_THINGSPEAKPUBLISHER_H_
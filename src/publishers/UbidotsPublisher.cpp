@@ -83,7 +83,14 @@ uint16_t UbidotsPublisher::calculateJsonSize() {
     // jsonLength += 15;          // ","timestamp":"
     // jsonLength += 25;          // markedISO8601Time
     // jsonLength += 2;           //  ",
+    bool firstValue = true;
     for (uint8_t i = 0; i < _baseLogger->getArrayVarCount(); i++) {
+        // Values which haven't changed enough are left out
+        if (!_baseLogger->isValueReportedAtI(i)) continue;
+        if (!firstValue) {
+            jsonLength += 1;  // ,
+        }
+        firstValue = false;
         jsonLength += 1;  //  "
         jsonLength +=
             _baseLogger->getVarUUIDAtI(i).length();  // parameter ID length
@@ -91,11 +98,9 @@ uint16_t UbidotsPublisher::calculateJsonSize() {
         jsonLength += _baseLogger->getValueStringAtI(i).length();
         jsonLength += 13;  // ,"timestamp":
         jsonLength += 13;  // epoch time in milliseconds
-        if (i + 1 != _baseLogger->getArrayVarCount()) {
-            jsonLength += 2;  // ,
-        }
+        jsonLength += 1;   // }
     }
-    jsonLength += 2;  // }
+    jsonLength += 1;  // }
 
     return jsonLength;
 }
@@ -105,7 +110,11 @@ uint16_t UbidotsPublisher::calculateJsonSize() {
 void UbidotsPublisher::printSensorDataJSON(Stream* stream) {
     stream->print(payload);
 
+    bool firstValue = true;
     for (uint8_t i = 0; i < _baseLogger->getArrayVarCount(); i++) {
+        if (!_baseLogger->isValueReportedAtI(i)) continue;
+        if (!firstValue) { stream->print(','); }
+        firstValue = false;
         stream->print('"');
         stream->print(_baseLogger->getVarUUIDAtI(i));
         stream->print(F("\":{'value':"));
@@ -114,10 +123,9 @@ void UbidotsPublisher::printSensorDataJSON(Stream* stream) {
         stream->print(Logger::markedEpochTimeUTC);
         stream->print(
             F("000}"));  // Convert microseconds to milliseconds for ubidots
-        if (i + 1 != _baseLogger->getArrayVarCount()) { stream->print(','); }
     }
 
-    stream->print(F("}}"));
+    stream->print('}');
 }
 
 
@@ -166,9 +174,18 @@ void UbidotsPublisher::begin(Logger&     baseLogger,
 // The return is the http status code of the response.
 // int16_t EnviroDIYPublisher::postDataEnviroDIY(void)
 int16_t UbidotsPublisher::publishData(Client* outClient) {
-    // Create a buffer for the portions of the request and response
-    char     tempBuffer[37] = "";
-    uint16_t did_respond    = 0;
+    if (!publishDataBegin(outClient)) return 0;
+    return publishDataFinish();
+}
+// This sends out the request but doesn't wait for the response
+bool UbidotsPublisher::publishDataBegin(Client* outClient) {
+    if (_publishState != PUBLISHER_IDLE) {
+        MS_DBG(F("Publisher is already busy!"));
+        return false;
+    }
+
+    // Create a buffer for the portions of the request
+    char tempBuffer[37] = "";
 
     MS_DBG(F("Outgoing JSON size:"), calculateJsonSize());
 
@@ -209,10 +226,16 @@ int16_t UbidotsPublisher::publishData(Client* outClient) {
 
         strcat(txBuffer, payload);
 
+        bool firstValue = true;
         for (uint8_t i = 0; i < _baseLogger->getArrayVarCount(); i++) {
+            // Values which haven't changed enough are left out
+            if (!_baseLogger->isValueReportedAtI(i)) continue;
+
             // Once the buffer fills, send it out
             if (bufferFree() < 47) printTxBuffer(outClient);
 
+            if (!firstValue) { txBuffer[strlen(txBuffer)] = ','; }
+            firstValue                 = false;
             txBuffer[strlen(txBuffer)] = '"';
             _baseLogger->getVarUUIDAtI(i).toCharArray(tempBuffer, 37);
             strcat(txBuffer, tempBuffer);
@@ -232,52 +255,20 @@ int16_t UbidotsPublisher::publishData(Client* outClient) {
             ltoa((Logger::markedEpochTimeUTC), tempBuffer, 10);  // BASE 10
             strcat(txBuffer, tempBuffer);
             strcat(txBuffer, "000");
-            if (i + 1 != _baseLogger->getArrayVarCount()) {
-                txBuffer[strlen(txBuffer)] = '}';
-                txBuffer[strlen(txBuffer)] = ',';
-            } else {
-                txBuffer[strlen(txBuffer)] = '}';
-                txBuffer[strlen(txBuffer)] = '}';
-            }
+            txBuffer[strlen(txBuffer)] = '}';
         }
+        if (bufferFree() < 2) printTxBuffer(outClient);
+        txBuffer[strlen(txBuffer)] = '}';
 
         // Send out the finished request (or the last unsent section of it)
         printTxBuffer(outClient, true);
 
-        // Wait 10 seconds for a response from the server
-        uint32_t start = millis();
-        while ((millis() - start) < 10000L && outClient->available() < 12) {
-            delay(10);
-        }
-
-        // Read only the first 12 characters of the response
-        // We're only reading as far as the http code, anything beyond that
-        // we don't care about.
-        did_respond = outClient->readBytes(tempBuffer, 12);
-
-        // Close the TCP/IP connection
-        MS_DBG(F("Stopping client"));
-        MS_RESET_DEBUG_TIMER;
-        outClient->stop();
-        MS_DBG(F("Client stopped after"), MS_PRINT_DEBUG_TIMER, F("ms"));
+        // Don't wait for the response here, publishDataPoll() will pick it up
+        awaitHTTPResponse(outClient);
     } else {
         PRINTOUT(F("\n -- Unable to Establish Connection to Ubiots --"));
+        completePublish(504);
     }
 
-    // Process the HTTP response
-    int16_t responseCode = 0;
-    if (did_respond > 0) {
-        char responseCode_char[4];
-        for (uint8_t i = 0; i < 3; i++) {
-            responseCode_char[i] = tempBuffer[i + 9];
-        }
-        responseCode = atoi(responseCode_char);
-    } else {
-        responseCode = 504;
-    }
-
-    PRINTOUT(F("-- Response Code --"));
-    PRINTOUT(responseCode);
-
-    return responseCode;
+    return true;
 }
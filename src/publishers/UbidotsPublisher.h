@@ -217,6 +217,18 @@ class UbidotsPublisher : public dataPublisher {
      * @return **int16_t** The http status code of the response.
      */
     int16_t publishData(Client* outClient) override;
+    /**
+     * @brief Open a TCP connection and send out the request, without waiting
+     * for the response.
+     *
+     * The response is picked up by dataPublisher::publishDataPoll().
+     *
+     * @param outClient An Arduino client instance to use to print data to.
+     * Allows the use of any type of client and multiple clients tied to a
+     * single TinyGSM modem instance
+     * @return **bool** True if the request was started.
+     */
+    bool publishDataBegin(Client* outClient) override;
 
  protected:
     /**
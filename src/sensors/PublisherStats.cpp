@@ -0,0 +1,59 @@
+/**
+ * @file PublisherStats.cpp
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Implements the PublisherStats class.
+ */
+
+#include "PublisherStats.h"
+
+
+// Constructor
+PublisherStats::PublisherStats(dataPublisher* publisher)
+    : Sensor("PublisherStats", PUBSTATS_NUM_VARIABLES,
+             PUBSTATS_WARM_UP_TIME_MS, PUBSTATS_STABILIZATION_TIME_MS,
+             PUBSTATS_MEASUREMENT_TIME_MS, -1, -1, 1) {
+    _publisher = publisher;
+}
+// Destructor
+PublisherStats::~PublisherStats() {}
+
+
+String PublisherStats::getSensorLocation(void) {
+    return _publisher->getEndpoint();
+}
+
+
+bool PublisherStats::addSingleMeasurementResult(void) {
+    publisherStats stats = _publisher->getDailyStats();
+
+    verifyAndAddMeasurementResult(PUBSTATS_BYTES_SENT_VAR_NUM,
+                                  static_cast<float>(stats.bytesSent));
+    verifyAndAddMeasurementResult(PUBSTATS_BYTES_RECEIVED_VAR_NUM,
+                                  static_cast<float>(stats.bytesReceived));
+
+    // Report the mean response time, or -9999 if nothing has been timed yet
+    float meanResponse = -9999;
+    if (stats.numResponses > 0) {
+        meanResponse = static_cast<float>(stats.responseTime_ms) /
+            stats.numResponses;
+    }
+    verifyAndAddMeasurementResult(PUBSTATS_RESPONSE_TIME_VAR_NUM,
+                                  meanResponse);
+
+    // The result counts are indexed by the hundreds digit of the HTTP status
+    uint16_t failures = stats.resultCounts[4] + stats.resultCounts[5] +
+        stats.numTimeouts;
+    verifyAndAddMeasurementResult(PUBSTATS_FAILURES_VAR_NUM,
+                                  static_cast<float>(failures));
+
+    // Unset the time stamp for the beginning of this measurement
+    _millisMeasurementRequested = 0;
+    // Unset the status bits for a measurement request (bits 5 & 6)
+    _sensorStatus &= 0b10011111;
+
+    // Return true when finished
+    return true;
+}
@@ -0,0 +1,383 @@
+/**
+ * @file PublisherStats.h
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the PublisherStats sensor subclass and the variable
+ * subclasses for the daily usage totals of a data publisher.
+ *
+ * These are for metadata on the publisher's use of the internet connection.
+ */
+/* clang-format off */
+/**
+ * @defgroup sensor_publisher Publisher Metadata
+ * Classes for using a data publisher's usage totals as a sensor.
+ *
+ * @ingroup the_sensors
+ *
+ * @tableofcontents
+ * @m_footernavigation
+ *
+ * @section sensor_publisher_intro Introduction
+ *
+ * Every data publisher keeps running totals of how much it uses the internet
+ * connection over the day: the bytes it sends and receives, the time it takes
+ * to connect and to get responses, and how the remote answered.  (See
+ * dataPublisher::getDailyStats().)  The PublisherStats "sensor" reads those
+ * totals so they can be logged and published like any other variable.  The
+ * totals start over at midnight.
+ *
+ * Only the totals that show what a publisher costs are reported as variables:
+ * the bytes each way, the response time, and the failures.  The rest of the
+ * totals, like the connection time and the count of each class of response,
+ * are in the publisherStats struct from dataPublisher::getDailyStats().
+ *
+ * Because the sensors are updated before the data is published, the values
+ * logged with each record include everything up to the publish before it.
+ *
+ * To keep the totals through a restart, give each publisher its own EEPROM
+ * address with dataPublisher::setStatsAddress(int16_t).
+ *
+ * @section sensor_publisher_sensor_ctor Sensor Constructor
+ * {{ @ref PublisherStats::PublisherStats }}
+ */
+/* clang-format on */
+
+// Header Guards
+#ifndef SRC_SENSORS_PUBLISHERSTATS_H_
+#define SRC_SENSORS_PUBLISHERSTATS_H_
+
+// Debugging Statement
+// #define MS_PUBLISHERSTATS_DEBUG
+
+#ifdef MS_PUBLISHERSTATS_DEBUG
+#define MS_DEBUGGING_STD "PublisherStats"
+#endif
+
+// Included Dependencies
+#include "ModSensorDebugger.h"
+#undef MS_DEBUGGING_STD
+#include "VariableBase.h"
+#include "SensorBase.h"
+#include "dataPublisherBase.h"
+
+// Sensor Specific Defines
+/** @ingroup sensor_publisher */
+/**@{*/
+
+/// @brief Sensor::_numReturnedValues; the publisher can report 4 values.
+#define PUBSTATS_NUM_VARIABLES 4
+
+/**
+ * @anchor sensor_publisher_timing
+ * @name Sensor Timing
+ * The totals are already in memory - there is nothing to wait for.
+ */
+/**@{*/
+/// @brief Sensor::_warmUpTime_ms; there is no warm up.
+#define PUBSTATS_WARM_UP_TIME_MS 0
+/// @brief Sensor::_stabilizationTime_ms; there is no stabilization.
+#define PUBSTATS_STABILIZATION_TIME_MS 0
+/// @brief Sensor::_measurementTime_ms; the totals are read immediately.
+#define PUBSTATS_MEASUREMENT_TIME_MS 0
+/**@}*/
+
+/**
+ * @anchor sensor_publisher_bytesSent
+ * @name Bytes Sent
+ * The number of bytes the publisher has written to its client so far today.
+ *
+ * {{ @ref PublisherStats_BytesSent::PublisherStats_BytesSent }}
+ */
+/**@{*/
+/// @brief Decimals places in string representation; should have 0.
+#define PUBSTATS_BYTES_SENT_RESOLUTION 0
+/// @brief Bytes Sent is stored in sensorValues[0]
+#define PUBSTATS_BYTES_SENT_VAR_NUM 0
+/// @brief Variable name; "bytesSent"
+#define PUBSTATS_BYTES_SENT_VAR_NAME "bytesSent"
+/// @brief Variable unit name; "Byte"
+#define PUBSTATS_BYTES_SENT_UNIT_NAME "Byte"
+/// @brief Default variable short code; "BytesSent"
+#define PUBSTATS_BYTES_SENT_DEFAULT_CODE "BytesSent"
+/**@}*/
+
+/**
+ * @anchor sensor_publisher_bytesReceived
+ * @name Bytes Received
+ * The number of bytes the publisher has read from its client so far today.
+ *
+ * {{ @ref PublisherStats_BytesReceived::PublisherStats_BytesReceived }}
+ */
+/**@{*/
+/// @brief Decimals places in string representation; should have 0.
+#define PUBSTATS_BYTES_RECEIVED_RESOLUTION 0
+/// @brief Bytes Received is stored in sensorValues[1]
+#define PUBSTATS_BYTES_RECEIVED_VAR_NUM 1
+/// @brief Variable name; "bytesReceived"
+#define PUBSTATS_BYTES_RECEIVED_VAR_NAME "bytesReceived"
+/// @brief Variable unit name; "Byte"
+#define PUBSTATS_BYTES_RECEIVED_UNIT_NAME "Byte"
+/// @brief Default variable short code; "BytesReceived"
+#define PUBSTATS_BYTES_RECEIVED_DEFAULT_CODE "BytesReceived"
+/**@}*/
+
+/**
+ * @anchor sensor_publisher_responseTime
+ * @name Response Time
+ * The mean time from the end of a request to the first byte of its response
+ * today.
+ *
+ * {{ @ref PublisherStats_ResponseTime::PublisherStats_ResponseTime }}
+ */
+/**@{*/
+/// @brief Decimals places in string representation; should have 0.
+#define PUBSTATS_RESPONSE_TIME_RESOLUTION 0
+/// @brief Response Time is stored in sensorValues[2]
+#define PUBSTATS_RESPONSE_TIME_VAR_NUM 2
+/// @brief Variable name; "responseTime"
+#define PUBSTATS_RESPONSE_TIME_VAR_NAME "responseTime"
+/// @brief Variable unit name; "millisecond"
+#define PUBSTATS_RESPONSE_TIME_UNIT_NAME "millisecond"
+/// @brief Default variable short code; "ResponseTime"
+#define PUBSTATS_RESPONSE_TIME_DEFAULT_CODE "ResponseTime"
+/**@}*/
+
+/**
+ * @anchor sensor_publisher_publishFailures
+ * @name Failures
+ * The number of publishes today that got a 4xx or 5xx HTTP status code or no
+ * response at all.
+ *
+ * {{ @ref PublisherStats_Failures::PublisherStats_Failures }}
+ */
+/**@{*/
+/// @brief Decimals places in string representation; should have 0.
+#define PUBSTATS_FAILURES_RESOLUTION 0
+/// @brief Failures is stored in sensorValues[3]
+#define PUBSTATS_FAILURES_VAR_NUM 3
+/// @brief Variable name; "publishFailures"
+#define PUBSTATS_FAILURES_VAR_NAME "publishFailures"
+/// @brief Variable unit name; "count"
+#define PUBSTATS_FAILURES_UNIT_NAME "count"
+/// @brief Default variable short code; "Failures"
+#define PUBSTATS_FAILURES_DEFAULT_CODE "Failures"
+/**@}*/
+/**@}*/
+
+
+/**
+ * @brief The main class to use a data publisher's daily usage totals as a
+ * sensor.
+ *
+ * @ingroup sensor_publisher
+ */
+class PublisherStats : public Sensor {
+ public:
+    /**
+     * @brief Construct a new Publisher Stats object.
+     *
+     * @param publisher The data publisher to report the totals of
+     */
+    explicit PublisherStats(dataPublisher* publisher);
+    /**
+     * @brief Destroy the Publisher Stats object
+     */
+    ~PublisherStats();
+
+    /**
+     * @copydoc Sensor::getSensorLocation()
+     *
+     * This returns the endpoint of the publisher.
+     */
+    String getSensorLocation(void) override;
+
+    /**
+     * @copydoc Sensor::addSingleMeasurementResult()
+     */
+    bool addSingleMeasurementResult(void) override;
+
+ private:
+    dataPublisher* _publisher;
+};
+
+
+/**
+ * @brief The Variable sub-class used for the
+ * [bytes sent](@ref sensor_publisher_bytesSent) of a data publisher.
+ *
+ * @ingroup sensor_publisher
+ */
+class PublisherStats_BytesSent : public Variable {
+ public:
+    /**
+     * @brief Construct a new PublisherStats_BytesSent object.
+     *
+     * @param parentSense The parent PublisherStats providing the result
+     * values.
+     * @param uuid A universally unique identifier (UUID or GUID) for the
+     * variable; optional with the default value of an empty string.
+     * @param varCode A short code to help identify the variable in files;
+     * optional with a default value of "BytesSent".
+     */
+    explicit PublisherStats_BytesSent(
+        PublisherStats* parentSense, const char* uuid = "",
+        const char* varCode = PUBSTATS_BYTES_SENT_DEFAULT_CODE)
+        : Variable(parentSense, (const uint8_t)PUBSTATS_BYTES_SENT_VAR_NUM,
+                   (uint8_t)PUBSTATS_BYTES_SENT_RESOLUTION,
+                   PUBSTATS_BYTES_SENT_VAR_NAME, PUBSTATS_BYTES_SENT_UNIT_NAME,
+                   varCode, uuid) {}
+    /**
+     * @brief Construct a new PublisherStats_BytesSent object.
+     *
+     * @note This must be tied with a parent PublisherStats before it can be
+     * used.
+     */
+    PublisherStats_BytesSent()
+        : Variable((const uint8_t)PUBSTATS_BYTES_SENT_VAR_NUM,
+                   (uint8_t)PUBSTATS_BYTES_SENT_RESOLUTION,
+                   PUBSTATS_BYTES_SENT_VAR_NAME, PUBSTATS_BYTES_SENT_UNIT_NAME,
+                   PUBSTATS_BYTES_SENT_DEFAULT_CODE) {}
+    /**
+     * @brief Destroy the PublisherStats_BytesSent object - no action
+     * needed.
+     */
+    ~PublisherStats_BytesSent() {}
+};
+
+
+/**
+ * @brief The Variable sub-class used for the
+ * [bytes received](@ref sensor_publisher_bytesReceived) of a data publisher.
+ *
+ * @ingroup sensor_publisher
+ */
+class PublisherStats_BytesReceived : public Variable {
+ public:
+    /**
+     * @brief Construct a new PublisherStats_BytesReceived object.
+     *
+     * @param parentSense The parent PublisherStats providing the result
+     * values.
+     * @param uuid A universally unique identifier (UUID or GUID) for the
+     * variable; optional with the default value of an empty string.
+     * @param varCode A short code to help identify the variable in files;
+     * optional with a default value of "BytesReceived".
+     */
+    explicit PublisherStats_BytesReceived(
+        PublisherStats* parentSense, const char* uuid = "",
+        const char* varCode = PUBSTATS_BYTES_RECEIVED_DEFAULT_CODE)
+        : Variable(parentSense, (const uint8_t)PUBSTATS_BYTES_RECEIVED_VAR_NUM,
+                   (uint8_t)PUBSTATS_BYTES_RECEIVED_RESOLUTION,
+                   PUBSTATS_BYTES_RECEIVED_VAR_NAME,
+                   PUBSTATS_BYTES_RECEIVED_UNIT_NAME, varCode, uuid) {}
+    /**
+     * @brief Construct a new PublisherStats_BytesReceived object.
+     *
+     * @note This must be tied with a parent PublisherStats before it can be
+     * used.
+     */
+    PublisherStats_BytesReceived()
+        : Variable((const uint8_t)PUBSTATS_BYTES_RECEIVED_VAR_NUM,
+                   (uint8_t)PUBSTATS_BYTES_RECEIVED_RESOLUTION,
+                   PUBSTATS_BYTES_RECEIVED_VAR_NAME,
+                   PUBSTATS_BYTES_RECEIVED_UNIT_NAME,
+                   PUBSTATS_BYTES_RECEIVED_DEFAULT_CODE) {}
+    /**
+     * @brief Destroy the PublisherStats_BytesReceived object - no action
+     * needed.
+     */
+    ~PublisherStats_BytesReceived() {}
+};
+
+
+/**
+ * @brief The Variable sub-class used for the
+ * [response time](@ref sensor_publisher_responseTime) of a data publisher.
+ *
+ * @ingroup sensor_publisher
+ */
+class PublisherStats_ResponseTime : public Variable {
+ public:
+    /**
+     * @brief Construct a new PublisherStats_ResponseTime object.
+     *
+     * @param parentSense The parent PublisherStats providing the result
+     * values.
+     * @param uuid A universally unique identifier (UUID or GUID) for the
+     * variable; optional with the default value of an empty string.
+     * @param varCode A short code to help identify the variable in files;
+     * optional with a default value of "ResponseTime".
+     */
+    explicit PublisherStats_ResponseTime(
+        PublisherStats* parentSense, const char* uuid = "",
+        const char* varCode = PUBSTATS_RESPONSE_TIME_DEFAULT_CODE)
+        : Variable(parentSense, (const uint8_t)PUBSTATS_RESPONSE_TIME_VAR_NUM,
+                   (uint8_t)PUBSTATS_RESPONSE_TIME_RESOLUTION,
+                   PUBSTATS_RESPONSE_TIME_VAR_NAME,
+                   PUBSTATS_RESPONSE_TIME_UNIT_NAME, varCode, uuid) {}
+    /**
+     * @brief Construct a new PublisherStats_ResponseTime object.
+     *
+     * @note This must be tied with a parent PublisherStats before it can be
+     * used.
+     */
+    PublisherStats_ResponseTime()
+        : Variable((const uint8_t)PUBSTATS_RESPONSE_TIME_VAR_NUM,
+                   (uint8_t)PUBSTATS_RESPONSE_TIME_RESOLUTION,
+                   PUBSTATS_RESPONSE_TIME_VAR_NAME,
+                   PUBSTATS_RESPONSE_TIME_UNIT_NAME,
+                   PUBSTATS_RESPONSE_TIME_DEFAULT_CODE) {}
+    /**
+     * @brief Destroy the PublisherStats_ResponseTime object - no action
+     * needed.
+     */
+    ~PublisherStats_ResponseTime() {}
+};
+
+
+/**
+ * @brief The Variable sub-class used for the
+ * [failures](@ref sensor_publisher_publishFailures) of a data publisher.
+ *
+ * @ingroup sensor_publisher
+ */
+class PublisherStats_Failures : public Variable {
+ public:
+    /**
+     * @brief Construct a new PublisherStats_Failures object.
+     *
+     * @param parentSense The parent PublisherStats providing the result
+     * values.
+     * @param uuid A universally unique identifier (UUID or GUID) for the
+     * variable; optional with the default value of an empty string.
+     * @param varCode A short code to help identify the variable in files;
+     * optional with a default value of "Failures".
+     */
+    explicit PublisherStats_Failures(
+        PublisherStats* parentSense, const char* uuid = "",
+        const char* varCode = PUBSTATS_FAILURES_DEFAULT_CODE)
+        : Variable(parentSense, (const uint8_t)PUBSTATS_FAILURES_VAR_NUM,
+                   (uint8_t)PUBSTATS_FAILURES_RESOLUTION,
+                   PUBSTATS_FAILURES_VAR_NAME, PUBSTATS_FAILURES_UNIT_NAME,
+                   varCode, uuid) {}
+    /**
+     * @brief Construct a new PublisherStats_Failures object.
+     *
+     * @note This must be tied with a parent PublisherStats before it can be
+     * used.
+     */
+    PublisherStats_Failures()
+        : Variable((const uint8_t)PUBSTATS_FAILURES_VAR_NUM,
+                   (uint8_t)PUBSTATS_FAILURES_RESOLUTION,
+                   PUBSTATS_FAILURES_VAR_NAME, PUBSTATS_FAILURES_UNIT_NAME,
+                   PUBSTATS_FAILURES_DEFAULT_CODE) {}
+    /**
+     * @brief Destroy the PublisherStats_Failures object - no action
+     * needed.
+     */
+    ~PublisherStats_Failures() {}
+};
+
+#endif  // SRC_SENSORS_PUBLISHERSTATS_H_
@@ -0,0 +1,258 @@
+/**
+ * @file ModemTranscript.cpp
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the modem replay tool for the EnviroDIY ModularSensors library for
+ * Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Implements the ModemTranscript class.
+ */
+
+#include "ModemTranscript.h"
+
+// The direction markers in the transcript
+#define TRANSCRIPT_SENT '>'
+#define TRANSCRIPT_RECEIVED '<'
+// How long to wait for the next character of a transcript being played back
+#define TRANSCRIPT_READ_TIMEOUT_MS 100
+
+// Constructors
+ModemTranscript::ModemTranscript(Stream* modemStream, Print* recording)
+    : _modemStream(modemStream), _replayStream(NULL), _recordStream(recording),
+      _realTime(true), _startTime(0), _lastDirection(0), _entryLength(0),
+      _entryPosition(0), _entryDirection(0), _entryTime(0), _entryReadyAt(0) {
+    resetStats();
+}
+ModemTranscript::ModemTranscript(Stream* recording, bool realTime)
+    : _modemStream(NULL), _replayStream(recording), _recordStream(NULL),
+      _realTime(realTime), _startTime(0), _lastDirection(0), _entryLength(0),
+      _entryPosition(0), _entryDirection(0), _entryTime(0), _entryReadyAt(0) {
+    resetStats();
+}
+// Destructor
+ModemTranscript::~ModemTranscript() {}
+
+
+void ModemTranscript::begin(void) {
+    _startTime      = millis();
+    _lastDirection  = 0;
+    _entryLength    = 0;
+    _entryPosition  = 0;
+    _entryDirection = 0;
+    _entryTime      = 0;
+    _entryReadyAt   = _startTime;
+    resetStats();
+    if (_replayStream != NULL) readEntry();
+}
+void ModemTranscript::end(void) {
+    if (_recordStream != NULL) writeEntry();
+}
+bool ModemTranscript::isReplayDone(void) {
+    return _replayStream != NULL && _entryDirection == 0;
+}
+
+
+transcriptStats ModemTranscript::getStats(void) {
+    return _stats;
+}
+void ModemTranscript::resetStats(void) {
+    _stats.bytesSent     = 0;
+    _stats.bytesReceived = 0;
+    _stats.roundTrips    = 0;
+    _stats.mismatches    = 0;
+    _stats.skipped       = 0;
+}
+void ModemTranscript::printStats(Stream* stream) {
+    stream->print(_stats.roundTrips);
+    stream->print(F(" round trips, "));
+    stream->print(_stats.bytesSent);
+    stream->print(F(" bytes sent, "));
+    stream->print(_stats.bytesReceived);
+    stream->print(F(" bytes received"));
+    if (_replayStream != NULL) {
+        stream->print(F(", "));
+        stream->print(_stats.mismatches);
+        stream->print(F(" mismatched, "));
+        stream->print(_stats.skipped);
+        stream->print(F(" skipped"));
+    }
+    stream->println();
+}
+
+
+int ModemTranscript::available() {
+    if (_modemStream != NULL) return _modemStream->available();
+    // Nothing to read until everything recorded as sent before it is sent
+    if (_entryDirection != TRANSCRIPT_RECEIVED) return 0;
+    if (static_cast<int32_t>(millis() - _entryReadyAt) < 0) return 0;
+    return _entryLength - _entryPosition;
+}
+int ModemTranscript::read() {
+    int b;
+    if (_modemStream != NULL) {
+        b = _modemStream->read();
+        if (b < 0) return b;
+        recordByte(TRANSCRIPT_RECEIVED, b);
+    } else {
+        if (available() == 0) return -1;
+        b = _entry[_entryPosition++];
+        if (_entryPosition >= _entryLength) readEntry();
+    }
+    countDirection(TRANSCRIPT_RECEIVED);
+    _stats.bytesReceived++;
+    return b;
+}
+int ModemTranscript::peek() {
+    if (_modemStream != NULL) return _modemStream->peek();
+    if (available() == 0) return -1;
+    return _entry[_entryPosition];
+}
+void ModemTranscript::flush() {
+    if (_modemStream != NULL) _modemStream->flush();
+}
+
+
+size_t ModemTranscript::write(uint8_t b) {
+    countDirection(TRANSCRIPT_SENT);
+    _stats.bytesSent++;
+    if (_modemStream != NULL) {
+        recordByte(TRANSCRIPT_SENT, b);
+        return _modemStream->write(b);
+    }
+
+    // Anything recorded as received before this wasn't read; skip it
+    while (_entryDirection == TRANSCRIPT_RECEIVED) {
+        _stats.skipped += _entryLength - _entryPosition;
+        readEntry();
+    }
+    if (_entryDirection != TRANSCRIPT_SENT) {
+        MS_DBG(F("Sent past the end of the transcript"));
+        _stats.mismatches++;
+        return 1;
+    }
+    if (_entry[_entryPosition] != b) {
+        MS_DBG(F("Sent"), static_cast<char>(b), F("but recorded"),
+               static_cast<char>(_entry[_entryPosition]));
+        _stats.mismatches++;
+    }
+    if (++_entryPosition >= _entryLength) readEntry();
+    return 1;
+}
+size_t ModemTranscript::write(const uint8_t* buf, size_t size) {
+    size_t written = 0;
+    for (size_t i = 0; i < size; i++) { written += write(buf[i]); }
+    return written;
+}
+
+
+void ModemTranscript::recordByte(char direction, uint8_t b) {
+    if (_entryDirection != direction ||
+        _entryLength >= MS_TRANSCRIPT_ENTRY_SIZE) {
+        writeEntry();
+        _entryDirection = direction;
+        _entryTime      = millis() - _startTime;
+    }
+    _entry[_entryLength++] = b;
+    // End the entry at each line feed to keep the transcript readable
+    if (b == '\n') writeEntry();
+}
+
+
+void ModemTranscript::writeEntry(void) {
+    if (_entryLength == 0) return;
+    _recordStream->print(_entryTime);
+    _recordStream->print(' ');
+    _recordStream->print(_entryDirection);
+    _recordStream->print(' ');
+    for (uint16_t i = 0; i < _entryLength; i++) {
+        uint8_t b = _entry[i];
+        if (b == '\r') {
+            _recordStream->print(F("\\r"));
+        } else if (b == '\n') {
+            _recordStream->print(F("\\n"));
+        } else if (b == '\\') {
+            _recordStream->print(F("\\\\"));
+        } else if (b >= 0x20 && b < 0x7F) {
+            _recordStream->write(b);
+        } else {
+            _recordStream->print(F("\\x"));
+            if (b < 0x10) _recordStream->print('0');
+            _recordStream->print(b, HEX);
+        }
+    }
+    _recordStream->println();
+    _entryLength    = 0;
+    _entryDirection = 0;
+}
+
+
+bool ModemTranscript::readEntry(void) {
+    uint32_t lastTime = _entryTime;
+    _entryLength      = 0;
+    _entryPosition    = 0;
+    _entryDirection   = 0;
+
+    // The time, then the direction, each followed by a space
+    int c = readRecordingChar();
+    while (c == '\r' || c == '\n') c = readRecordingChar();
+    if (c < 0) {
+        MS_DBG(F("End of the transcript"));
+        return false;
+    }
+    _entryTime = 0;
+    while (c >= '0' && c <= '9') {
+        _entryTime = _entryTime * 10 + (c - '0');
+        c          = readRecordingChar();
+    }
+    char direction = readRecordingChar();
+    readRecordingChar();
+
+    // Then the bytes, to the end of the line
+    while ((c = readRecordingChar()) >= 0 && c != '\n') {
+        if (c == '\r') continue;
+        if (c == '\\') {
+            c = readRecordingChar();
+            if (c == 'r') {
+                c = '\r';
+            } else if (c == 'n') {
+                c = '\n';
+            } else if (c == 'x') {
+                char hex[3] = {static_cast<char>(readRecordingChar()),
+                               static_cast<char>(readRecordingChar()), '\0'};
+                c           = strtol(hex, NULL, 16);
+            }
+        }
+        if (_entryLength < MS_TRANSCRIPT_ENTRY_SIZE) {
+            _entry[_entryLength++] = c;
+        }
+    }
+    if (_entryLength == 0 ||
+        (direction != TRANSCRIPT_SENT && direction != TRANSCRIPT_RECEIVED)) {
+        MS_DBG(F("Bad transcript entry at"), _entryTime);
+        return false;
+    }
+
+    _entryDirection = direction;
+    _entryReadyAt   = millis();
+    if (_realTime && _entryTime > lastTime) {
+        _entryReadyAt += _entryTime - lastTime;
+    }
+    return true;
+}
+
+
+int ModemTranscript::readRecordingChar(void) {
+    uint32_t start = millis();
+    while (_replayStream->available() == 0) {
+        if (millis() - start > TRANSCRIPT_READ_TIMEOUT_MS) return -1;
+    }
+    return _replayStream->read();
+}
+
+
+void ModemTranscript::countDirection(char direction) {
+    if (direction == TRANSCRIPT_SENT && _lastDirection != TRANSCRIPT_SENT) {
+        _stats.roundTrips++;
+    }
+    _lastDirection = direction;
+}
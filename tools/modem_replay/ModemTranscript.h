@@ -0,0 +1,200 @@
+/**
+ * @file ModemTranscript.h
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the modem replay tool for the EnviroDIY ModularSensors library for
+ * Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the ModemTranscript class - a Stream that sits between a
+ * modem and its serial port to record the AT traffic or to play a recording
+ * back.
+ */
+
+// Header Guards
+#ifndef TOOLS_MODEM_REPLAY_MODEMTRANSCRIPT_H_
+#define TOOLS_MODEM_REPLAY_MODEMTRANSCRIPT_H_
+
+// Debugging Statement
+// #define MS_MODEMTRANSCRIPT_DEBUG
+
+#ifdef MS_MODEMTRANSCRIPT_DEBUG
+#define MS_DEBUGGING_STD "ModemTranscript"
+#endif
+
+/**
+ * @def MS_TRANSCRIPT_ENTRY_SIZE
+ * @brief The most bytes in a single transcript entry.
+ *
+ * Longer runs of traffic in one direction are split over several entries.
+ * This can be changed by setting the build flag MS_TRANSCRIPT_ENTRY_SIZE when
+ * compiling.
+ */
+#ifndef MS_TRANSCRIPT_ENTRY_SIZE
+#define MS_TRANSCRIPT_ENTRY_SIZE 64
+#endif
+
+// Included Dependencies
+#include <ModSensorDebugger.h>
+#undef MS_DEBUGGING_STD
+#include <Stream.h>
+
+/**
+ * @brief The counters kept by a ModemTranscript.
+ */
+typedef struct transcriptStats {
+    uint32_t bytesSent;      ///< Bytes written by the modem code
+    uint32_t bytesReceived;  ///< Bytes read by the modem code
+    uint16_t roundTrips;     ///< Times the code went from reading to writing
+    uint16_t mismatches;     ///< Bytes written that differ from the recording
+    uint32_t skipped;        ///< Recorded bytes the modem code never read
+} transcriptStats;
+
+/**
+ * @brief The ModemTranscript class is a Stream to put between a loggerModem
+ * and its serial port, to record the AT traffic, or in place of the serial
+ * port, to play a recording back.
+ *
+ * Give it to the modem constructor in place of the modem's serial stream.
+ *
+ * In record mode, everything written and read is passed through to the real
+ * serial port and also written to the transcript, one entry per line.  Each
+ * entry is the milliseconds since begin(), `>` for bytes sent to the modem or
+ * `<` for bytes received from it, and the bytes themselves.  Carriage returns,
+ * line feeds, back slashes and anything unprintable are escaped (`\r`, `\n`,
+ * `\\` and `\xHH`) so each entry stays on one line:
+ * @code{.txt}
+ * 1523 > AT+CSQ\r
+ * 1561 < \r\n+CSQ: 17,99\r\n\r\nOK\r\n
+ * @endcode
+ * An entry ends at each line feed or when the direction changes.
+ *
+ * In replay mode, no modem is needed.  The bytes recorded as received are
+ * handed to the modem code, in order, once it has written everything recorded
+ * as sent before them.  The bytes the code writes are checked against the
+ * recording and any differences are counted.  Anything recorded as received
+ * that the code never reads before writing again is skipped.  By default the
+ * responses are available right away, so a replay is repeatable and as fast
+ * as the code allows.  With real-time replay, each entry waits out the time
+ * recorded since the entry before it.
+ *
+ * Either way, the number of round trips - times the code stopped reading and
+ * started writing again - is counted, as a count of the AT commands used.
+ */
+class ModemTranscript : public Stream {
+ public:
+    /**
+     * @brief Construct a new Modem Transcript object to record the traffic on
+     * a serial port.
+     *
+     * @param modemStream The stream connected to the modem
+     * @param recording Where to write the transcript; ie, an SD card file
+     */
+    ModemTranscript(Stream* modemStream, Print* recording);
+    /**
+     * @brief Construct a new Modem Transcript object to play back a recorded
+     * transcript.
+     *
+     * @param recording The transcript to play back; ie, an SD card file
+     * @param realTime True to wait out the recorded times between entries;
+     * false to make each entry available as soon as it could be.
+     */
+    ModemTranscript(Stream* recording, bool realTime);
+    /**
+     * @brief Destroy the Modem Transcript object - no action taken.
+     */
+    virtual ~ModemTranscript();
+
+    /**
+     * @brief Start the clock and the counters; in replay mode, also read the
+     * first entry.
+     *
+     * Call this once the recording is open and before the modem is used.
+     */
+    void begin(void);
+    /**
+     * @brief Write out the last partial entry, when recording.
+     */
+    void end(void);
+    /**
+     * @brief Check if a replay has reached the end of the transcript.
+     *
+     * @return **bool** True if there's nothing left to play back.
+     */
+    bool isReplayDone(void);
+
+    /**
+     * @brief Get the counters since they were last reset.
+     *
+     * @return **transcriptStats** The counters
+     */
+    transcriptStats getStats(void);
+    /**
+     * @brief Set all of the counters back to zero.
+     */
+    void resetStats(void);
+    /**
+     * @brief Print the counters.
+     *
+     * @param stream The stream to print to
+     */
+    void printStats(Stream* stream);
+
+    // The Stream interface
+    int    available() override;
+    int    read() override;
+    int    peek() override;
+    void   flush() override;
+    size_t write(uint8_t b) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+
+ protected:
+    /**
+     * @brief Add a byte to the entry being recorded, writing out the entry
+     * first if it's in the other direction or full.
+     *
+     * @param direction `>` for sent or `<` for received
+     * @param b The byte
+     */
+    void recordByte(char direction, uint8_t b);
+    /**
+     * @brief Write out the entry being recorded, if there is one.
+     */
+    void writeEntry(void);
+    /**
+     * @brief Read the next entry of the transcript being played back.
+     *
+     * @return **bool** True if there was another entry.
+     */
+    bool readEntry(void);
+    /**
+     * @brief Read one character of the transcript, waiting briefly for it.
+     *
+     * @return **int** The character, or -1 at the end of the transcript
+     */
+    int readRecordingChar(void);
+    /**
+     * @brief Note which way the traffic is going, counting round trips.
+     *
+     * @param direction `>` for sent or `<` for received
+     */
+    void countDirection(char direction);
+
+    Stream* _modemStream;
+    Stream* _replayStream;
+    Print*  _recordStream;
+    bool    _realTime;
+
+    transcriptStats _stats;
+    uint32_t        _startTime;
+    char            _lastDirection;
+
+    // The entry being recorded or played back
+    uint8_t  _entry[MS_TRANSCRIPT_ENTRY_SIZE];
+    uint16_t _entryLength;
+    uint16_t _entryPosition;
+    char     _entryDirection;
+    uint32_t _entryTime;
+    uint32_t _entryReadyAt;
+};
+
+#endif  // TOOLS_MODEM_REPLAY_MODEMTRANSCRIPT_H_
@@ -0,0 +1,139 @@
+/** =========================================================================
+ * @file modem_replay.ino
+ * @brief Records the AT traffic of a modem's wake, connect, and sleep, or
+ * plays a recording back to the same modem code without the modem, to time
+ * the code paths and count the AT round trips each uses.
+ *
+ * To record, set RECORD_TRANSCRIPT below and attach the modem to Serial1.  The
+ * transcript is written to the SD card.  To replay, comment it out.  No modem
+ * is needed; the transcript is read back from the SD card and fed to the
+ * modem code in place of the modem.
+ *
+ * Change the modem object to profile a different modem.  The same transcript
+ * must be used with the same modem type it was recorded from.
+ *
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ * @copyright (c) 2017-2020 Stroud Water Research Center (SWRC)
+ *                          and the EnviroDIY Development Team
+ *            This example is published under the BSD-3 license.
+ *
+ * Build Environment: Visual Studios Code with PlatformIO
+ * Hardware Platform: EnviroDIY Mayfly Arduino Datalogger
+ *
+ * DISCLAIMER:
+ * THIS CODE IS PROVIDED "AS IS" - NO WARRANTY IS GIVEN.
+ * ======================================================================= */
+
+#include <Arduino.h>
+#include <SdFat.h>
+#include <modems/SIMComSIM7000.h>
+#include "ModemTranscript.h"
+
+// Comment this out to play the transcript back instead of recording it
+#define RECORD_TRANSCRIPT
+
+const char*   transcriptFile = "modem.txt";
+const int8_t  sdCardSSPin    = 12;
+const int32_t modemBaud      = 9600;
+
+SdFat sd;
+File  transcriptFileHandle;
+
+#ifdef RECORD_TRANSCRIPT
+// Pass everything through to the modem on Serial1, writing it to the card
+ModemTranscript transcript(&Serial1, &transcriptFileHandle);
+// The real pins are needed to wake the modem
+const int8_t modemVccPin     = -2;
+const int8_t modemStatusPin  = 19;
+const int8_t modemResetPin   = 20;
+const int8_t modemSleepRqPin = 23;
+#else
+// Play the card back as fast as the code will take it
+ModemTranscript transcript(&transcriptFileHandle, false);
+// No pins; there is no modem
+const int8_t modemVccPin     = -1;
+const int8_t modemStatusPin  = -1;
+const int8_t modemResetPin   = -1;
+const int8_t modemSleepRqPin = -1;
+#endif
+
+SIMComSIM7000 modem(&transcript, modemVccPin, modemStatusPin, modemResetPin,
+                    modemSleepRqPin, "hologram");
+
+
+// Prints the time and traffic used since the last phase
+transcriptStats lastStats;
+uint32_t        phaseStart;
+void            printPhase(const __FlashStringHelper* name, bool success) {
+    transcriptStats stats = transcript.getStats();
+    Serial.print(name);
+    Serial.print(success ? F(": ") : F(" (FAILED): "));
+    Serial.print(millis() - phaseStart);
+    Serial.print(F(" ms, "));
+    Serial.print(stats.roundTrips - lastStats.roundTrips);
+    Serial.print(F(" round trips, "));
+    Serial.print(stats.bytesSent - lastStats.bytesSent);
+    Serial.print(F(" bytes sent, "));
+    Serial.print(stats.bytesReceived - lastStats.bytesReceived);
+    Serial.println(F(" bytes received"));
+    lastStats  = stats;
+    phaseStart = millis();
+}
+
+
+void setup() {
+    Serial.begin(115200);
+    Serial1.begin(modemBaud);
+    Serial.println(F("Modem transcript recorder and replayer"));
+    Serial.print(F("Using ModularSensors Library version "));
+    Serial.println(MODULAR_SENSORS_VERSION);
+
+    if (!sd.begin(sdCardSSPin)) {
+        Serial.println(F("Could not open the SD card!"));
+        return;
+    }
+#ifdef RECORD_TRANSCRIPT
+    transcriptFileHandle = sd.open(transcriptFile,
+                                   O_WRITE | O_CREAT | O_TRUNC);
+    Serial.println(F("Recording..."));
+#else
+    transcriptFileHandle = sd.open(transcriptFile, O_READ);
+    Serial.println(F("Replaying..."));
+#endif
+
+    transcript.begin();
+    lastStats  = transcript.getStats();
+    phaseStart = millis();
+
+    bool success = modem.modemSetup();
+    printPhase(F("Setup"), success);
+    success = modem.modemWake();
+    printPhase(F("Wake"), success);
+    success = modem.connectInternet(120000L);
+    printPhase(F("Connect"), success);
+    // There are no modem variables here to turn on the metadata, so ask for
+    // all of it
+    modem.enableMetadataPolling(MODEM_SIGNAL_ENABLE_BITMASK |
+                                MODEM_BATTERY_ENABLE_BITMASK |
+                                MODEM_TEMPERATURE_ENABLE_BITMASK);
+    success = modem.updateModemMetadata();
+    printPhase(F("Metadata"), success);
+    modem.disconnectInternet();
+    printPhase(F("Disconnect"), true);
+    success = modem.modemSleepPowerDown();
+    printPhase(F("Sleep"), success);
+
+    transcript.end();
+    transcriptFileHandle.close();
+
+    Serial.print(F("Total: "));
+    transcript.printStats(&Serial);
+#ifndef RECORD_TRANSCRIPT
+    if (!transcript.isReplayDone()) {
+        Serial.println(F("The code stopped before the end of the transcript"));
+    }
+#endif
+    Serial.println(F("Done"));
+}
+
+void loop() {}
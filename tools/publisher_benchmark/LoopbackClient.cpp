@@ -0,0 +1,563 @@
+/**
+ * @file LoopbackClient.cpp
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the publisher benchmark tool for the EnviroDIY ModularSensors
+ * library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Implements the LoopbackClient and LoopbackUDP classes.
+ */
+
+#include "LoopbackClient.h"
+
+
+// Prints the counters of either stand-in
+void printLoopbackStats(Stream* stream, const loopbackStats& stats,
+                        uint16_t numRecords, uint32_t elapsed_ms) {
+    if (numRecords == 0) numRecords = 1;
+    stream->print(numRecords);
+    stream->print(F(" records; bytes sent: "));
+    stream->print(stats.bytesSent);
+    stream->print(F(" ("));
+    stream->print(static_cast<float>(stats.bytesSent) / numRecords, 1);
+    stream->print(F("/record); bytes received: "));
+    stream->print(stats.bytesReceived);
+    stream->print(F("; connections: "));
+    stream->print(stats.connections);
+    stream->print(F("; round trips: "));
+    stream->print(stats.roundTrips);
+    stream->print(F(" ("));
+    stream->print(static_cast<float>(stats.roundTrips) / numRecords, 2);
+    stream->print(F("/record); dropped: "));
+    stream->print(stats.dropped);
+    stream->print(F("; time: "));
+    stream->print(elapsed_ms);
+    stream->print(F(" ms ("));
+    stream->print(static_cast<float>(elapsed_ms) / numRecords, 1);
+    stream->println(F(" ms/record)"));
+}
+
+
+// Constructor
+LoopbackClient::LoopbackClient() {
+    _connectLatency_ms  = 0;
+    _responseLatency_ms = 0;
+    _dropPercent        = 0;
+    _httpResponseCode   = 0;
+    _connected          = false;
+    _protocol           = LOOPBACK_UNKNOWN;
+    _responseLength     = 0;
+    _responseRead       = 0;
+    _responseReadyAt    = 0;
+    resetStats();
+    resetParsers();
+}
+// Destructor
+LoopbackClient::~LoopbackClient() {}
+
+
+void LoopbackClient::setLatency(uint32_t connectLatency_ms,
+                                uint32_t responseLatency_ms) {
+    _connectLatency_ms  = connectLatency_ms;
+    _responseLatency_ms = responseLatency_ms;
+}
+void LoopbackClient::setDropRate(uint8_t dropPercent) {
+    _dropPercent = dropPercent;
+}
+void LoopbackClient::setHTTPResponseCode(int16_t responseCode) {
+    _httpResponseCode = responseCode;
+}
+
+
+loopbackStats LoopbackClient::getStats(void) {
+    return _stats;
+}
+void LoopbackClient::resetStats(void) {
+    _stats.bytesSent     = 0;
+    _stats.bytesReceived = 0;
+    _stats.connections   = 0;
+    _stats.roundTrips    = 0;
+    _stats.dropped       = 0;
+}
+void LoopbackClient::printStats(Stream* stream, uint16_t numRecords,
+                                uint32_t elapsed_ms) {
+    printLoopbackStats(stream, _stats, numRecords, elapsed_ms);
+}
+
+
+int LoopbackClient::connect(IPAddress ip, uint16_t port) {
+    return connect("IP address", port);
+}
+int LoopbackClient::connect(const char* host, uint16_t port) {
+    delay(_connectLatency_ms);
+    if (shouldDrop()) {
+        MS_DBG(F("Dropped connection to"), host, ':', port);
+        return 0;
+    }
+    MS_DBG(F("Connected to loopback stand-in for"), host, ':', port);
+    _connected      = true;
+    _protocol       = LOOPBACK_UNKNOWN;
+    _responseLength = 0;
+    _responseRead   = 0;
+    resetParsers();
+    _stats.connections++;
+    return 1;
+}
+
+
+size_t LoopbackClient::write(uint8_t b) {
+    if (!_connected) return 0;
+    _stats.bytesSent++;
+    // The first byte of a conversation gives away the protocol
+    if (_protocol == LOOPBACK_UNKNOWN) {
+        _protocol = (b == 0x10) ? LOOPBACK_MQTT : LOOPBACK_HTTP;
+    }
+    if (_protocol == LOOPBACK_MQTT) {
+        receiveMQTT(b);
+    } else {
+        receiveHTTP(b);
+    }
+    return 1;
+}
+size_t LoopbackClient::write(const uint8_t* buf, size_t size) {
+    size_t written = 0;
+    for (size_t i = 0; i < size; i++) { written += write(buf[i]); }
+    return written;
+}
+
+
+int LoopbackClient::available() {
+    if (_responseRead >= _responseLength) return 0;
+    if (static_cast<int32_t>(millis() - _responseReadyAt) < 0) return 0;
+    return _responseLength - _responseRead;
+}
+int LoopbackClient::read() {
+    if (available() == 0) return -1;
+    _stats.bytesReceived++;
+    return _response[_responseRead++];
+}
+int LoopbackClient::read(uint8_t* buf, size_t size) {
+    size_t n = 0;
+    while (n < size && available() > 0) { buf[n++] = read(); }
+    return n;
+}
+int LoopbackClient::peek() {
+    if (available() == 0) return -1;
+    return _response[_responseRead];
+}
+void LoopbackClient::flush() {}
+void LoopbackClient::stop() {
+    _connected      = false;
+    _responseLength = 0;
+    _responseRead   = 0;
+}
+uint8_t LoopbackClient::connected() {
+    // Like a real socket, unread data keeps the connection "open"
+    return _connected || _responseRead < _responseLength;
+}
+
+
+void LoopbackClient::receiveHTTP(uint8_t b) {
+    if (_inBody) {
+        if (--_bodyRemaining == 0) completeHTTPRequest();
+        return;
+    }
+    if (!_requestLineDone) {
+        // Skip stray line endings between requests
+        if (_requestLineLength == 0 && (b == '\r' || b == '\n')) return;
+        if (b == '\n') {
+            _requestLineDone = true;
+        } else if (b != '\r' && _requestLineLength < sizeof(_requestLine) - 1) {
+            _requestLine[_requestLineLength++] = b;
+            _requestLine[_requestLineLength]   = '\0';
+        }
+        return;
+    }
+    if (b == '\r') return;
+    if (b != '\n') {
+        if (_headerLineLength < sizeof(_headerLine) - 1) {
+            _headerLine[_headerLineLength++] = b;
+            _headerLine[_headerLineLength]   = '\0';
+        }
+        return;
+    }
+    // A blank line ends the headers
+    if (_headerLineLength == 0) {
+        if (_bodyRemaining > 0) {
+            _inBody = true;
+        } else {
+            completeHTTPRequest();
+        }
+        return;
+    }
+    if (strncasecmp(_headerLine, "Content-Length:", 15) == 0) {
+        _bodyRemaining = atol(_headerLine + 15);
+    }
+    _headerLineLength = 0;
+    _headerLine[0]    = '\0';
+}
+
+
+void LoopbackClient::completeHTTPRequest(void) {
+    int16_t responseCode = _httpResponseCode;
+    if (responseCode == 0) {
+        if (strstr(_requestLine, "bulk_update") != NULL) {
+            responseCode = 202;
+        } else if (strncmp(_requestLine, "POST ", 5) == 0 &&
+                   strstr(_requestLine, "/api/data-stream/") != NULL) {
+            responseCode = 201;
+        } else {
+            responseCode = 200;
+        }
+    }
+    MS_DBG(F("Answering"), _requestLine, F("with"), responseCode);
+
+    char response[MS_LOOPBACK_RESPONSE_SIZE];
+    snprintf(response, sizeof(response),
+             "HTTP/1.1 %d OK\r\nContent-Length: 0\r\n\r\n", responseCode);
+    queueResponse(reinterpret_cast<const uint8_t*>(response),
+                  strlen(response));
+    resetParsers();
+}
+
+
+void LoopbackClient::receiveMQTT(uint8_t b) {
+    if (_mqttHeader == 0) {
+        _mqttHeader     = b;
+        _mqttRemaining  = 0;
+        _mqttMultiplier = 1;
+        _mqttInLength   = true;
+        _mqttBodyIndex  = 0;
+        return;
+    }
+    if (_mqttInLength) {
+        _mqttRemaining += (b & 0x7F) * _mqttMultiplier;
+        _mqttMultiplier <<= 7;
+        if ((b & 0x80) == 0) {
+            _mqttInLength = false;
+            if (_mqttRemaining == 0) completeMQTTPacket();
+        }
+        return;
+    }
+
+    // Pick the topic length and packet ID out of a PUBLISH
+    if ((_mqttHeader & 0xF0) == 0x30) {
+        if (_mqttBodyIndex == 0) {
+            _mqttTopicLength = static_cast<uint16_t>(b) << 8;
+        } else if (_mqttBodyIndex == 1) {
+            _mqttTopicLength |= b;
+        } else if (_mqttBodyIndex == _mqttTopicLength + 2) {
+            _mqttPacketId = static_cast<uint16_t>(b) << 8;
+        } else if (_mqttBodyIndex == _mqttTopicLength + 3) {
+            _mqttPacketId |= b;
+        }
+    }
+    _mqttBodyIndex++;
+    if (--_mqttRemaining == 0) completeMQTTPacket();
+}
+
+
+void LoopbackClient::completeMQTTPacket(void) {
+    uint8_t type = _mqttHeader & 0xF0;
+    uint8_t qos  = (_mqttHeader >> 1) & 0x03;
+    MS_DBG(F("Answering MQTT packet type"), type >> 4);
+    switch (type) {
+        case 0x10: {  // CONNECT
+            const uint8_t connAck[] = {0x20, 0x02, 0x00, 0x00};
+            queueResponse(connAck, sizeof(connAck));
+            break;
+        }
+        case 0x30: {  // PUBLISH
+            if (qos == 1) {
+                const uint8_t pubAck[] = {
+                    0x40, 0x02, static_cast<uint8_t>(_mqttPacketId >> 8),
+                    static_cast<uint8_t>(_mqttPacketId & 0xFF)};
+                queueResponse(pubAck, sizeof(pubAck));
+            }
+            break;
+        }
+        case 0xC0: {  // PINGREQ
+            const uint8_t pingResp[] = {0xD0, 0x00};
+            queueResponse(pingResp, sizeof(pingResp));
+            break;
+        }
+        case 0xE0: {  // DISCONNECT
+            _connected = false;
+            break;
+        }
+        default: break;
+    }
+    _mqttHeader = 0;
+}
+
+
+void LoopbackClient::resetParsers(void) {
+    _requestLineLength = 0;
+    _requestLine[0]    = '\0';
+    _requestLineDone   = false;
+    _headerLineLength  = 0;
+    _headerLine[0]     = '\0';
+    _inBody            = false;
+    _bodyRemaining     = 0;
+    _mqttHeader        = 0;
+    _mqttRemaining     = 0;
+    _mqttMultiplier    = 1;
+    _mqttInLength      = false;
+    _mqttBodyIndex     = 0;
+    _mqttTopicLength   = 0;
+    _mqttPacketId      = 0;
+}
+
+
+void LoopbackClient::queueResponse(const uint8_t* response, uint8_t length) {
+    if (shouldDrop()) {
+        MS_DBG(F("Dropped the response"));
+        return;
+    }
+    // Start over once everything queued has been read
+    if (_responseRead >= _responseLength) {
+        _responseLength  = 0;
+        _responseRead    = 0;
+        _responseReadyAt = millis() + _responseLatency_ms;
+    }
+    if (_responseLength + length > MS_LOOPBACK_RESPONSE_SIZE) {
+        MS_DBG(F("No room to queue the response"));
+        _stats.dropped++;
+        return;
+    }
+    memcpy(_response + _responseLength, response, length);
+    _responseLength += length;
+    _stats.roundTrips++;
+}
+
+
+bool LoopbackClient::shouldDrop(void) {
+    if (_dropPercent == 0 || random(100) >= _dropPercent) return false;
+    _stats.dropped++;
+    return true;
+}
+
+
+// ============================================================================
+//  The UDP stand-in, answering CoAP
+// ============================================================================
+
+// Constructor
+LoopbackUDP::LoopbackUDP() {
+    _responseLatency_ms = 0;
+    _dropPercent        = 0;
+    _coapResponseCode   = 0x44;  // 2.04 Changed
+    _ntpTime            = 1577836800;
+    _ntpTimeSetAt       = 0;
+    _requestLength      = 0;
+    _inPacket           = false;
+    _responseLength     = 0;
+    _responseRead       = 0;
+    _responseReadyAt    = 0;
+    _responseParsed     = false;
+    resetStats();
+}
+// Destructor
+LoopbackUDP::~LoopbackUDP() {}
+
+
+void LoopbackUDP::setLatency(uint32_t responseLatency_ms) {
+    _responseLatency_ms = responseLatency_ms;
+}
+void LoopbackUDP::setDropRate(uint8_t dropPercent) {
+    _dropPercent = dropPercent;
+}
+void LoopbackUDP::setCoAPResponseCode(uint8_t responseCode) {
+    _coapResponseCode = responseCode;
+}
+void LoopbackUDP::setNTPTime(uint32_t unixTime) {
+    _ntpTime      = unixTime;
+    _ntpTimeSetAt = millis();
+}
+
+
+loopbackStats LoopbackUDP::getStats(void) {
+    return _stats;
+}
+void LoopbackUDP::resetStats(void) {
+    _stats.bytesSent     = 0;
+    _stats.bytesReceived = 0;
+    _stats.connections   = 0;
+    _stats.roundTrips    = 0;
+    _stats.dropped       = 0;
+}
+void LoopbackUDP::printStats(Stream* stream, uint16_t numRecords,
+                             uint32_t elapsed_ms) {
+    printLoopbackStats(stream, _stats, numRecords, elapsed_ms);
+}
+
+
+uint8_t LoopbackUDP::begin(uint16_t port) {
+    MS_DBG(F("Loopback UDP listening on port"), port);
+    return 1;
+}
+void LoopbackUDP::stop() {
+    _responseLength = 0;
+    _responseRead   = 0;
+    _responseParsed = false;
+}
+
+
+int LoopbackUDP::beginPacket(IPAddress ip, uint16_t port) {
+    return beginPacket("IP address", port);
+}
+int LoopbackUDP::beginPacket(const char* host, uint16_t port) {
+    MS_DBG(F("Sending datagram to loopback stand-in for"), host, ':', port);
+    _requestLength = 0;
+    _inPacket      = true;
+    return 1;
+}
+int LoopbackUDP::endPacket() {
+    if (!_inPacket) return 0;
+    _inPacket = false;
+    if (shouldDrop()) {
+        MS_DBG(F("Dropped the request"));
+    } else if (_requestLength == 48 && (_request[0] & 0x07) == 3) {
+        answerNTP();
+    } else {
+        answerCoAP();
+    }
+    return 1;
+}
+size_t LoopbackUDP::write(uint8_t b) {
+    if (!_inPacket) return 0;
+    _stats.bytesSent++;
+    // Only the start of the datagram is needed to answer it
+    if (_requestLength < MS_LOOPBACK_RESPONSE_SIZE) {
+        _request[_requestLength] = b;
+    }
+    _requestLength++;
+    return 1;
+}
+size_t LoopbackUDP::write(const uint8_t* buf, size_t size) {
+    size_t written = 0;
+    for (size_t i = 0; i < size; i++) { written += write(buf[i]); }
+    return written;
+}
+
+
+int LoopbackUDP::parsePacket() {
+    // Parsing a new packet discards whatever is left of the last one
+    if (_responseParsed) {
+        _responseLength = 0;
+        _responseRead   = 0;
+        _responseParsed = false;
+    }
+    if (_responseLength == 0) return 0;
+    if (static_cast<int32_t>(millis() - _responseReadyAt) < 0) return 0;
+    _responseParsed = true;
+    return _responseLength;
+}
+int LoopbackUDP::available() {
+    if (!_responseParsed) return 0;
+    return _responseLength - _responseRead;
+}
+int LoopbackUDP::read() {
+    if (available() == 0) return -1;
+    _stats.bytesReceived++;
+    return _response[_responseRead++];
+}
+int LoopbackUDP::read(unsigned char* buf, size_t len) {
+    size_t n = 0;
+    while (n < len && available() > 0) { buf[n++] = read(); }
+    return n;
+}
+int LoopbackUDP::read(char* buf, size_t len) {
+    return read(reinterpret_cast<unsigned char*>(buf), len);
+}
+int LoopbackUDP::peek() {
+    if (available() == 0) return -1;
+    return _response[_responseRead];
+}
+void LoopbackUDP::flush() {}
+IPAddress LoopbackUDP::remoteIP() {
+    return IPAddress(127, 0, 0, 1);
+}
+uint16_t LoopbackUDP::remotePort() {
+    return 5683;
+}
+
+
+void LoopbackUDP::answerCoAP(void) {
+    if (_requestLength < 4) return;
+    uint8_t version     = _request[0] >> 6;
+    uint8_t type        = (_request[0] >> 4) & 0x03;
+    uint8_t tokenLength = _request[0] & 0x0F;
+    uint8_t code        = _request[1];
+    // Only confirmable requests (0.01-0.31) get a piggy-backed response
+    if (version != 1 || type != 0 || code == 0 || code > 0x1F ||
+        tokenLength > 8 || _requestLength < 4 + tokenLength) {
+        return;
+    }
+    if (shouldDrop()) {
+        MS_DBG(F("Dropped the response"));
+        return;
+    }
+    MS_DBG(F("Answering CoAP request"), _request[2] << 8 | _request[3],
+           F("with"), _coapResponseCode >> 5, '.', _coapResponseCode & 0x1F);
+
+    // An acknowledgement with the same message ID and token
+    _response[0] = 0x60 | tokenLength;
+    _response[1] = _coapResponseCode;
+    _response[2] = _request[2];
+    _response[3] = _request[3];
+    memcpy(_response + 4, _request + 4, tokenLength);
+    _responseLength  = 4 + tokenLength;
+    _responseRead    = 0;
+    _responseParsed  = false;
+    _responseReadyAt = millis() + _responseLatency_ms;
+    _stats.roundTrips++;
+}
+
+
+void LoopbackUDP::answerNTP(void) {
+    if (shouldDrop()) {
+        MS_DBG(F("Dropped the response"));
+        return;
+    }
+    MS_DBG(F("Answering SNTP request"));
+
+    // A stratum 1 server with no leap second warning, answering in the
+    // version it was asked in
+    memset(_response, 0, 48);
+    _response[0] = (_request[0] & 0x38) | 4;
+    _response[1] = 1;
+    _response[2] = _request[2];
+    // Identify the reference clock as "LOOP"
+    memcpy(_response + 12, "LOOP", 4);
+    // The originate timestamp is the client's transmit timestamp
+    memcpy(_response + 24, _request + 40, 8);
+    writeNTPTimestamp(_response + 16);
+    writeNTPTimestamp(_response + 32);
+    writeNTPTimestamp(_response + 40);
+    _responseLength  = 48;
+    _responseRead    = 0;
+    _responseParsed  = false;
+    _responseReadyAt = millis() + _responseLatency_ms;
+    _stats.roundTrips++;
+}
+
+
+void LoopbackUDP::writeNTPTimestamp(uint8_t* timestamp) {
+    uint32_t elapsed_ms = millis() - _ntpTimeSetAt;
+    // Seconds since 1900, then the fraction of a second in units of 2^-32 s
+    uint32_t seconds  = _ntpTime + 2208988800UL + elapsed_ms / 1000;
+    uint32_t fraction = (static_cast<uint64_t>(elapsed_ms % 1000) << 32) /
+        1000;
+    for (uint8_t i = 0; i < 4; i++) {
+        timestamp[i]     = static_cast<uint8_t>(seconds >> (24 - 8 * i));
+        timestamp[4 + i] = static_cast<uint8_t>(fraction >> (24 - 8 * i));
+    }
+}
+
+
+bool LoopbackUDP::shouldDrop(void) {
+    if (_dropPercent == 0 || random(100) >= _dropPercent) return false;
+    _stats.dropped++;
+    return true;
+}
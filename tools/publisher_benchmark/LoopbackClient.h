@@ -0,0 +1,382 @@
+/**
+ * @file LoopbackClient.h
+ * @copyright 2020 Stroud Water Research Center
+ * Part of the publisher benchmark tool for the EnviroDIY ModularSensors
+ * library for Arduino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the LoopbackClient and LoopbackUDP classes - stand-ins for
+ * a real internet connection that answer publishers locally, for benchmarking
+ * them.
+ */
+
+// Header Guards
+#ifndef TOOLS_PUBLISHER_BENCHMARK_LOOPBACKCLIENT_H_
+#define TOOLS_PUBLISHER_BENCHMARK_LOOPBACKCLIENT_H_
+
+// Debugging Statement
+// #define MS_LOOPBACKCLIENT_DEBUG
+
+#ifdef MS_LOOPBACKCLIENT_DEBUG
+#define MS_DEBUGGING_STD "LoopbackClient"
+#endif
+
+/**
+ * @def MS_LOOPBACK_RESPONSE_SIZE
+ * @brief The maximum size of a single queued response from the loopback
+ * endpoint.
+ */
+#ifndef MS_LOOPBACK_RESPONSE_SIZE
+#define MS_LOOPBACK_RESPONSE_SIZE 64
+#endif
+
+// Included Dependencies
+#include <ModSensorDebugger.h>
+#undef MS_DEBUGGING_STD
+#include <Client.h>
+#include <Udp.h>
+
+/**
+ * @brief The counters kept by a LoopbackClient.
+ */
+typedef struct loopbackStats {
+    uint32_t bytesSent;      ///< Bytes written by the publisher
+    uint32_t bytesReceived;  ///< Bytes read by the publisher
+    uint16_t connections;    ///< Successful connections opened
+    uint16_t roundTrips;     ///< Requests answered by the endpoint
+    uint16_t dropped;        ///< Connections refused or packets never sent
+} loopbackStats;
+
+/**
+ * @brief Print loopback counters, with the totals divided by the number of
+ * records to give per-record figures.
+ *
+ * @param stream The stream to print to
+ * @param stats The counters
+ * @param numRecords The number of records sent since the counters were reset
+ * @param elapsed_ms The wall time taken to send the records
+ */
+void printLoopbackStats(Stream* stream, const loopbackStats& stats,
+                        uint16_t numRecords, uint32_t elapsed_ms);
+
+/**
+ * @brief The LoopbackClient class is an Arduino Client that doesn't touch the
+ * network.  Instead it plays the part of the remote endpoint itself.
+ *
+ * Give one to a publisher in place of a modem's client to measure how many
+ * bytes and round trips the publisher uses for each record, and how long it
+ * takes, without a real data portal on the other end.
+ *
+ * The endpoint recognizes the protocol from the first byte written after
+ * connecting:
+ * - HTTP requests (as sent to the EnviroDIY data portal, Ubidots, DreamHost,
+ * and the ThingSpeak REST API) are answered once the full request (headers and
+ * any Content-Length body) has arrived.  POSTs to the EnviroDIY
+ * `/api/data-stream/` get a 201, ThingSpeak bulk updates get a 202, and
+ * everything else gets a 200.  A fixed response code can be set with
+ * setHTTPResponseCode().
+ * - MQTT packets (as sent to ThingSpeak or any other MQTT broker) are answered
+ * like a broker would: CONNECT with a CONNACK, QoS 1 PUBLISH with a PUBACK,
+ * and PINGREQ with a PINGRESP.
+ *
+ * Latency and dropped packets can be added to mimic a slow or lossy cellular
+ * connection.
+ */
+class LoopbackClient : public Client {
+ public:
+    /**
+     * @brief Construct a new Loopback Client object with no latency or drops.
+     */
+    LoopbackClient();
+    /**
+     * @brief Destroy the Loopback Client object - no action taken.
+     */
+    virtual ~LoopbackClient();
+
+    /**
+     * @brief Set the simulated latencies.
+     *
+     * @param connectLatency_ms The time taken by each call to connect(...)
+     * @param responseLatency_ms The time between a request being completely
+     * written and the response becoming available
+     */
+    void setLatency(uint32_t connectLatency_ms, uint32_t responseLatency_ms);
+    /**
+     * @brief Set the chance that a connection is refused or a response is
+     * never sent.
+     *
+     * @param dropPercent The percent (0-100) of connections and responses to
+     * drop
+     */
+    void setDropRate(uint8_t dropPercent);
+    /**
+     * @brief Answer all HTTP requests with a fixed response code.
+     *
+     * @param responseCode The HTTP status code to respond with; 0 to choose
+     * the response code based on the request.
+     */
+    void setHTTPResponseCode(int16_t responseCode);
+
+    /**
+     * @brief Get the counters since they were last reset.
+     *
+     * @return **loopbackStats** The counters
+     */
+    loopbackStats getStats(void);
+    /**
+     * @brief Set all of the counters back to zero.
+     */
+    void resetStats(void);
+    /**
+     * @brief Print the counters, with the totals divided by the number of
+     * records to give per-record figures.
+     *
+     * @param stream The stream to print to
+     * @param numRecords The number of records sent since the counters were
+     * reset
+     * @param elapsed_ms The wall time taken to send the records
+     */
+    void printStats(Stream* stream, uint16_t numRecords, uint32_t elapsed_ms);
+
+    // The Client interface
+    int     connect(IPAddress ip, uint16_t port) override;
+    int     connect(const char* host, uint16_t port) override;
+    size_t  write(uint8_t b) override;
+    size_t  write(const uint8_t* buf, size_t size) override;
+    int     available() override;
+    int     read() override;
+    int     read(uint8_t* buf, size_t size) override;
+    int     peek() override;
+    void    flush() override;
+    void    stop() override;
+    uint8_t connected() override;
+    operator bool() override {
+        return connected();
+    }
+
+ protected:
+    /**
+     * @brief The protocol the endpoint recognized on this connection.
+     */
+    typedef enum loopbackProtocol {
+        LOOPBACK_UNKNOWN = 0,
+        LOOPBACK_HTTP,
+        LOOPBACK_MQTT
+    } loopbackProtocol;
+
+    /**
+     * @brief Feed one HTTP request byte to the endpoint.
+     *
+     * @param b The byte
+     */
+    void receiveHTTP(uint8_t b);
+    /**
+     * @brief Feed one MQTT byte to the endpoint.
+     *
+     * @param b The byte
+     */
+    void receiveMQTT(uint8_t b);
+    /**
+     * @brief Answer a complete HTTP request.
+     */
+    void completeHTTPRequest(void);
+    /**
+     * @brief Answer a complete MQTT packet.
+     */
+    void completeMQTTPacket(void);
+    /**
+     * @brief Forget any partly parsed request.
+     */
+    void resetParsers(void);
+    /**
+     * @brief Queue a response, unless it is dropped.
+     *
+     * @param response The response bytes
+     * @param length The number of bytes in the response
+     */
+    void queueResponse(const uint8_t* response, uint8_t length);
+    /**
+     * @brief Decide if this packet should be dropped.
+     *
+     * @return **bool** True to drop it
+     */
+    bool shouldDrop(void);
+
+    uint32_t _connectLatency_ms;
+    uint32_t _responseLatency_ms;
+    uint8_t  _dropPercent;
+    int16_t  _httpResponseCode;
+
+    loopbackStats    _stats;
+    bool             _connected;
+    loopbackProtocol _protocol;
+
+    // Queued responses
+    uint8_t  _response[MS_LOOPBACK_RESPONSE_SIZE];
+    uint8_t  _responseLength;
+    uint8_t  _responseRead;
+    uint32_t _responseReadyAt;
+
+    // HTTP request parsing
+    char     _requestLine[64];
+    uint8_t  _requestLineLength;
+    bool     _requestLineDone;
+    char     _headerLine[24];
+    uint8_t  _headerLineLength;
+    bool     _inBody;
+    uint32_t _bodyRemaining;
+
+    // MQTT packet parsing
+    uint8_t  _mqttHeader;
+    uint32_t _mqttRemaining;
+    uint32_t _mqttMultiplier;
+    bool     _mqttInLength;
+    uint16_t _mqttBodyIndex;
+    uint16_t _mqttTopicLength;
+    uint16_t _mqttPacketId;
+};
+
+
+/**
+ * @brief The LoopbackUDP class is an Arduino UDP instance that doesn't touch
+ * the network.  Instead it plays the part of a CoAP server or an NTP server
+ * itself.
+ *
+ * Give one to a CoAPPublisher or an SNTPClient in place of a real UDP
+ * instance to measure the bytes and round trips used without a real server on
+ * the other end.
+ *
+ * Confirmable CoAP requests are answered with a piggy-backed acknowledgement,
+ * with the response code 2.04 (Changed) unless another code is set with
+ * setCoAPResponseCode().  SNTP requests are answered by a stratum 1 server
+ * whose clock is set with setNTPTime().  Anything else sent is swallowed.
+ *
+ * As with the LoopbackClient, latency and dropped packets can be added to
+ * mimic a slow or lossy cellular connection.  Both the request and the
+ * response can be dropped, so the publisher's retransmissions get exercised.
+ */
+class LoopbackUDP : public UDP {
+ public:
+    /**
+     * @brief Construct a new Loopback UDP object with no latency or drops.
+     */
+    LoopbackUDP();
+    /**
+     * @brief Destroy the Loopback UDP object - no action taken.
+     */
+    virtual ~LoopbackUDP();
+
+    /**
+     * @brief Set the simulated latency.
+     *
+     * @param responseLatency_ms The time between a request being sent and the
+     * response becoming available
+     */
+    void setLatency(uint32_t responseLatency_ms);
+    /**
+     * @brief Set the chance that a datagram (in either direction) is lost.
+     *
+     * @param dropPercent The percent (0-100) of datagrams to drop
+     */
+    void setDropRate(uint8_t dropPercent);
+    /**
+     * @brief Set the CoAP response code to answer with.
+     *
+     * @param responseCode The code, as the class in the top 3 bits and the
+     * detail in the bottom 5 bits; ie, 0x44 for 2.04.
+     */
+    void setCoAPResponseCode(uint8_t responseCode);
+    /**
+     * @brief Set the clock of the NTP server stand-in.
+     *
+     * The clock runs on from the time given with the processor's millis().
+     *
+     * @param unixTime The current time in seconds since January 1, 1970 in
+     * UTC
+     */
+    void setNTPTime(uint32_t unixTime);
+
+    /**
+     * @brief Get the counters since they were last reset.
+     *
+     * @return **loopbackStats** The counters
+     */
+    loopbackStats getStats(void);
+    /**
+     * @brief Set all of the counters back to zero.
+     */
+    void resetStats(void);
+    /**
+     * @brief Print the counters, with the totals divided by the number of
+     * records to give per-record figures.
+     *
+     * @param stream The stream to print to
+     * @param numRecords The number of records sent since the counters were
+     * reset
+     * @param elapsed_ms The wall time taken to send the records
+     */
+    void printStats(Stream* stream, uint16_t numRecords, uint32_t elapsed_ms);
+
+    // The UDP interface
+    uint8_t   begin(uint16_t port) override;
+    void      stop() override;
+    int       beginPacket(IPAddress ip, uint16_t port) override;
+    int       beginPacket(const char* host, uint16_t port) override;
+    int       endPacket() override;
+    size_t    write(uint8_t b) override;
+    size_t    write(const uint8_t* buf, size_t size) override;
+    int       parsePacket() override;
+    int       available() override;
+    int       read() override;
+    int       read(unsigned char* buf, size_t len) override;
+    int       read(char* buf, size_t len) override;
+    int       peek() override;
+    void      flush() override;
+    IPAddress remoteIP() override;
+    uint16_t  remotePort() override;
+
+ protected:
+    /**
+     * @brief Answer the datagram just sent, if it's a confirmable CoAP
+     * request.
+     */
+    void answerCoAP(void);
+    /**
+     * @brief Answer the datagram just sent, if it's an SNTP request.
+     */
+    void answerNTP(void);
+    /**
+     * @brief Write the stand-in's current time as an NTP timestamp.
+     *
+     * @param timestamp The 8 bytes to write the timestamp to
+     */
+    void writeNTPTimestamp(uint8_t* timestamp);
+    /**
+     * @brief Decide if this datagram should be dropped.
+     *
+     * @return **bool** True to drop it
+     */
+    bool shouldDrop(void);
+
+    uint32_t _responseLatency_ms;
+    uint8_t  _dropPercent;
+    uint8_t  _coapResponseCode;
+    uint32_t _ntpTime;
+    uint32_t _ntpTimeSetAt;
+
+    loopbackStats _stats;
+
+    // The datagram being sent
+    uint8_t  _request[MS_LOOPBACK_RESPONSE_SIZE];
+    uint16_t _requestLength;
+    bool     _inPacket;
+
+    // The queued response and how much of it has been read
+    uint8_t  _response[MS_LOOPBACK_RESPONSE_SIZE];
+    uint8_t  _responseLength;
+    uint8_t  _responseRead;
+    uint32_t _responseReadyAt;
+    bool     _responseParsed;
+};
+
+#endif  // TOOLS_PUBLISHER_BENCHMARK_LOOPBACKCLIENT_H_
@@ -0,0 +1,217 @@
+/** =========================================================================
+ * @file publisher_benchmark.ino
+ * @brief Measures the bytes, round trips, and time each data publisher uses
+ * per record, against local stand-ins for the real data portals.
+ *
+ * Every publisher is given its own LoopbackClient instead of a modem client
+ * (or a LoopbackUDP, for CoAP), so no modem, internet connection, or portal
+ * account is needed.  The stand-ins are in this sketch's folder, not the
+ * library.  The publishers are run once per record and once per batch of
+ * records (as after an outage) under a few latency and packet-drop profiles.
+ * In a batch, publishers that don't send from the LogBuffer only send the
+ * newest record, so their figures are for that one record.  An SNTP clock
+ * sync against the LoopbackUDP's NTP stand-in is run under each profile too.
+ *
+ * The logger's clock is faked, so no RTC or SD card is needed either.
+ *
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ * @copyright (c) 2017-2020 Stroud Water Research Center (SWRC)
+ *                          and the EnviroDIY Development Team
+ *            This example is published under the BSD-3 license.
+ *
+ * Build Environment: Visual Studios Code with PlatformIO
+ * Hardware Platform: EnviroDIY Mayfly Arduino Datalogger
+ *
+ * DISCLAIMER:
+ * THIS CODE IS PROVIDED "AS IS" - NO WARRANTY IS GIVEN.
+ * ======================================================================= */
+
+#include <Arduino.h>
+#include <LoggerBase.h>
+#include <SNTPClient.h>
+#include <publishers/CBORPublisher.h>
+#include <publishers/CoAPPublisher.h>
+#include <publishers/DreamHostPublisher.h>
+#include <publishers/EnviroDIYPublisher.h>
+#include <publishers/MQTTPublisher.h>
+#include <publishers/ThingSpeakPublisher.h>
+#include <publishers/UbidotsPublisher.h>
+#include "LoopbackClient.h"
+
+// The number of records sent one at a time and in each batch
+const uint8_t numRecords = 10;
+
+// The latency and drop profiles to test
+typedef struct benchmarkProfile {
+    const char* name;
+    uint32_t    connectLatency_ms;
+    uint32_t    responseLatency_ms;
+    uint8_t     dropPercent;
+} benchmarkProfile;
+const benchmarkProfile profiles[] = {
+    {"Ideal", 0, 0, 0},
+    {"Cellular", 1500, 600, 0},
+    {"Lossy cellular", 1500, 600, 10},
+};
+const uint8_t numProfiles = sizeof(profiles) / sizeof(profiles[0]);
+
+
+// ==========================================================================
+//  Fake variables, logger, and log buffer
+// ==========================================================================
+uint32_t recordCount = 0;
+float    fakeTemperature() {
+    return 15.0 + (recordCount % 20) * 0.25;
+}
+float fakeConductivity() {
+    return 250.0 + (recordCount % 7) * 3.5;
+}
+float fakeBattery() {
+    return 4.1 - (recordCount % 50) * 0.01;
+}
+
+Variable* variableList[] = {
+    new Variable(fakeTemperature, 2, "temperature", "degreeCelsius", "Temp",
+                 "12345678-abcd-1234-ef00-1234567890ab"),
+    new Variable(fakeConductivity, 1, "specificConductance",
+                 "microsiemenPerCentimeter", "Cond",
+                 "12345678-abcd-1234-ef00-1234567890ab"),
+    new Variable(fakeBattery, 3, "batteryVoltage", "volt", "Batt",
+                 "12345678-abcd-1234-ef00-1234567890ab")};
+int           variableCount = sizeof(variableList) / sizeof(variableList[0]);
+VariableArray varArray(variableCount, variableList);
+Logger        dataLogger("benchmark", 5, &varArray);
+LogBuffer     logBuffer;
+
+
+// ==========================================================================
+//  The publishers, each with its own loopback client
+// ==========================================================================
+EnviroDIYPublisher  EnviroDIYPOST;
+DreamHostPublisher  DreamHostGET;
+UbidotsPublisher    UbidotsPOST;
+ThingSpeakPublisher TsMqtt;
+MQTTPublisher       mqttBroker;
+CBORPublisher       cborReceiver;
+
+dataPublisher* publishers[] = {&EnviroDIYPOST, &DreamHostGET, &UbidotsPOST,
+                               &TsMqtt,        &mqttBroker,   &cborReceiver};
+const uint8_t  numPublishers = sizeof(publishers) / sizeof(publishers[0]);
+LoopbackClient clients[numPublishers];
+
+// CoAP goes over UDP instead of a client
+CoAPPublisher coapServer;
+LoopbackUDP   udp;
+
+// So does the clock sync
+SNTPClient timeClient(&udp);
+
+
+// Adds one record to the log buffer with a faked clock
+void logRecord() {
+    recordCount++;
+    Logger::markedEpochTime    = 1600000000L + recordCount * 300L;
+    Logger::markedEpochTimeUTC = Logger::markedEpochTime;
+    dataLogger.addRecordToLogBuffer();
+}
+
+
+// Logs numRecords records, either publishing after each or all at once.
+// Returns the time taken and sets the number of records actually sent.
+uint32_t runBenchmark(dataPublisher* publisher, bool batched,
+                      uint16_t& recordsSent) {
+    // Start from an empty buffer so only this run's records are pending
+    logBuffer.clear();
+
+    uint32_t start = millis();
+    for (uint8_t i = 0; i < numRecords; i++) {
+        logRecord();
+        if (!batched) publisher->publishData();
+    }
+    if (batched) publisher->publishData();
+    // Publishers without the LogBuffer only send the current values
+    recordsSent = batched && !publisher->usesLogBuffer() ? 1 : numRecords;
+    return millis() - start;
+}
+void printMode(bool batched) {
+    Serial.print(batched ? F("  Batch:      ") : F("  Per record: "));
+}
+
+
+void setup() {
+    Serial.begin(115200);
+    Serial.println(F("Publisher benchmark against loopback endpoints"));
+    Serial.print(F("Using ModularSensors Library version "));
+    Serial.println(MODULAR_SENSORS_VERSION);
+
+    dataLogger.attachLogBuffer(logBuffer);
+
+    EnviroDIYPOST.begin(dataLogger, &clients[0],
+                        "12345678-abcd-1234-ef00-1234567890ab",
+                        "12345678-abcd-1234-ef00-1234567890ab");
+    DreamHostGET.begin(dataLogger, &clients[1],
+                       "xxxx.dreamhosters.com/portalRX_xxxx.php");
+    UbidotsPOST.begin(dataLogger, &clients[2], "BBFF-xxxxxxxxxxxxxxxx",
+                      "12345678-abcd-1234-ef00-1234567890ab");
+    TsMqtt.begin(dataLogger, &clients[3], "XXXXXXXXXXXXXXXX", "######",
+                 "XXXXXXXXXXXXXXXX");
+    mqttBroker.begin(dataLogger, &clients[4], "broker.example.com", 1883,
+                     "benchmark", "loggers/{id}/data");
+    cborReceiver.begin(dataLogger, &clients[5], "receiver.example.com", 80,
+                       "/api/cbor/");
+    coapServer.begin(dataLogger, &udp, "receiver.example.com", 5683,
+                     "api/cbor");
+    timeClient.addServer("time.example.com");
+    udp.setNTPTime(1600000000L);
+
+    for (uint8_t f = 0; f < numProfiles; f++) {
+        Serial.println();
+        Serial.print(F("=== Profile: "));
+        Serial.print(profiles[f].name);
+        Serial.println(F(" ==="));
+        for (uint8_t p = 0; p < numPublishers; p++) {
+            clients[p].setLatency(profiles[f].connectLatency_ms,
+                                  profiles[f].responseLatency_ms);
+            clients[p].setDropRate(profiles[f].dropPercent);
+
+            Serial.println(publishers[p]->getEndpoint());
+            for (uint8_t batched = 0; batched < 2; batched++) {
+                clients[p].resetStats();
+                uint16_t recordsSent;
+                uint32_t elapsed = runBenchmark(publishers[p], batched,
+                                                recordsSent);
+                printMode(batched);
+                clients[p].printStats(&Serial, recordsSent, elapsed);
+            }
+        }
+
+        udp.setLatency(profiles[f].responseLatency_ms);
+        udp.setDropRate(profiles[f].dropPercent);
+        Serial.print(coapServer.getEndpoint());
+        Serial.println(F(" (CoAP)"));
+        for (uint8_t batched = 0; batched < 2; batched++) {
+            udp.resetStats();
+            uint16_t recordsSent;
+            uint32_t elapsed = runBenchmark(&coapServer, batched, recordsSent);
+            printMode(batched);
+            udp.printStats(&Serial, recordsSent, elapsed);
+        }
+
+        Serial.println(F("time.example.com (SNTP)"));
+        udp.resetStats();
+        uint32_t start = millis();
+        if (timeClient.sync()) {
+            Serial.print(F("  Round trip delay: "));
+            Serial.print(timeClient.getRoundTripDelay());
+            Serial.println(F(" ms"));
+        } else {
+            Serial.println(F("  No answer"));
+        }
+        Serial.print(F("  Clock sync: "));
+        udp.printStats(&Serial, 1, millis() - start);
+    }
+    Serial.println();
+    Serial.println(F("Done"));
+}
+
+void loop() {}